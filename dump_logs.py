@@ -29,7 +29,7 @@ LOG_HEADING = ' '.join([
     'target roll, target pitch, target yaw,',
     'pid roll, pid pitch, pid yaw,',
     'output r elevon, output l elevon, output r motor, output l motor, output gear,',
-    'control mode, flight mode, transition state, flags\n'
+    'control mode, flight mode, transition state, flags, noise hz\n'
 ])
 
 def log_file_name() -> str:
@@ -1,67 +1,129 @@
+/*
+ * The float implementation is inline in 3dmath.h. This file only holds the
+ * fixed point implementation selected by MATH3D_FIXED_POINT.
+ */
 #include "3dmath.h"
+#include "fixmath.h"
+
+#ifdef MATH3D_FIXED_POINT
+struct fix_quaternion {
+    q30_t w;
+    q30_t x;
+    q30_t y;
+    q30_t z;
+};
+
+typedef struct fix_quaternion fix_quaternion_t;
+
+static inline fix_quaternion_t quaternion_to_fix(const quaternion_t* q) {
+    fix_quaternion_t result = {
+        .w = q30_from_float(q->w),
+        .x = q30_from_float(q->x),
+        .y = q30_from_float(q->y),
+        .z = q30_from_float(q->z)
+    };
+
+    return result;
+}
+
+static inline quaternion_t quaternion_from_fix(const fix_quaternion_t* q) {
+    quaternion_t result = {
+        .w = q30_to_float(q->w),
+        .x = q30_to_float(q->x),
+        .y = q30_to_float(q->y),
+        .z = q30_to_float(q->z)
+    };
+
+    return result;
+}
 
 /*
- * returns the magnitude of vector v
+ * returns the product of two unit quaternions
  */
-float vector_norm(const vector_t* v) {
-    return sqrt(v->x * v->x + v->y * v->y + v->z * v->z);
+static fix_quaternion_t fix_quaternion_product(const fix_quaternion_t* p, const fix_quaternion_t* q) {
+    fix_quaternion_t result = {
+        .w = ((int64_t)p->w * q->w - (int64_t)p->x * q->x - (int64_t)p->y * q->y - (int64_t)p->z * q->z) >> 30,
+        .x = ((int64_t)p->w * q->x + (int64_t)p->x * q->w + (int64_t)p->y * q->z - (int64_t)p->z * q->y) >> 30,
+        .y = ((int64_t)p->w * q->y - (int64_t)p->x * q->z + (int64_t)p->y * q->w + (int64_t)p->z * q->x) >> 30,
+        .z = ((int64_t)p->w * q->z + (int64_t)p->x * q->y - (int64_t)p->y * q->x + (int64_t)p->z * q->w) >> 30
+    };
+
+    /*
+     * scale for noise reduction. The product is close to unit length, so one
+     * newton step of 1 / sqrt(n) around 1 normalizes it without a divide.
+     */
+    int64_t n = ((int64_t)result.w * result.w + (int64_t)result.x * result.x +
+                 (int64_t)result.y * result.y + (int64_t)result.z * result.z) >> 30;
+    q30_t scale = (3 * (int64_t)Q30_ONE - n) >> 1;
+
+    result.w = q30_mul(result.w, scale);
+    result.x = q30_mul(result.x, scale);
+    result.y = q30_mul(result.y, scale);
+    result.z = q30_mul(result.z, scale);
+
+    return result;
 }
 
 /*
  * returns the magnitude of quaternion q
  */
 float quaternion_norm(const quaternion_t* q) {
-    return sqrt(q->w * q->w + q->x * q->x + q->y * q->y + q->z * q->z);
+    fix_quaternion_t f = quaternion_to_fix(q);
+
+    uint64_t n = (int64_t)f.w * f.w + (int64_t)f.x * f.x +
+                 (int64_t)f.y * f.y + (int64_t)f.z * f.z;
+
+    return q30_to_float(fix_isqrt64(n));
 }
 
 /*
  * returns the product of two unit quaternions
  */
 quaternion_t quaternion_product(const quaternion_t* p, const quaternion_t* q) {
-    quaternion_t result = {
-        .w = p->w * q->w - p->x * q->x - p->y * q->y - p->z * q->z,
-        .x = p->w * q->x + p->x * q->w + p->y * q->z - p->z * q->y,
-        .y = p->w * q->y - p->x * q->z + p->y * q->w + p->z * q->x,
-        .z = p->w * q->z + p->x * q->y - p->y * q->x + p->z * q->w
-    };
+    fix_quaternion_t fp = quaternion_to_fix(p);
+    fix_quaternion_t fq = quaternion_to_fix(q);
 
-    /* scale for noise reduction */
-    float l = quaternion_norm(&result);
+    fix_quaternion_t result = fix_quaternion_product(&fp, &fq);
 
-    result.w /= l;
-    result.x /= l;
-    result.y /= l;
-    result.x /= l;
-
-    return result;
+    return quaternion_from_fix(&result);
 }
 
 /*
  * rotates unit quaternion orientation about roll axis by angle
  */
 quaternion_t quaternion_rotate_roll(const quaternion_t* orientation, float angle) {
-    quaternion_t rotation = {
-        .w = cos(angle * RADIANS_PER_DEGREE * 0.5), 
-        .x = sin(angle * RADIANS_PER_DEGREE * 0.5),
-        .y = 0.0001,
-        .z = 0.0001
+    q28_t half_angle = q28_from_float(angle * RADIANS_PER_DEGREE * 0.5f);
+
+    fix_quaternion_t rotation = {
+        .w = fix_cos(half_angle),
+        .x = fix_sin(half_angle),
+        .y = 0,
+        .z = 0
     };
 
-    return quaternion_product(orientation, &rotation);
+    fix_quaternion_t fo = quaternion_to_fix(orientation);
+    fix_quaternion_t result = fix_quaternion_product(&fo, &rotation);
+
+    return quaternion_from_fix(&result);
 }
 
 /*
  * rotates unit quaternion orientation about pitch axis by angle
  */
 quaternion_t quaternion_rotate_pitch(const quaternion_t* orientation, float angle) {
-    quaternion_t rotation = {
-        .w = cos(angle * RADIANS_PER_DEGREE * 0.5), 
-        .x = 0.0001, 
-        .y = sin(angle * RADIANS_PER_DEGREE * 0.5), 
-        .z = 0.0001 
+    q28_t half_angle = q28_from_float(angle * RADIANS_PER_DEGREE * 0.5f);
+
+    fix_quaternion_t rotation = {
+        .w = fix_cos(half_angle),
+        .x = 0,
+        .y = fix_sin(half_angle),
+        .z = 0
     };
 
-    return quaternion_product(orientation, &rotation);
+    fix_quaternion_t fo = quaternion_to_fix(orientation);
+    fix_quaternion_t result = fix_quaternion_product(&fo, &rotation);
+
+    return quaternion_from_fix(&result);
 }
 
 /*
@@ -69,19 +131,19 @@ quaternion_t quaternion_rotate_pitch(const quaternion_t* orientation, float angl
  * -180 < roll < 180
  */
 float quaternion_get_roll(const quaternion_t* q) {
-    float result = atan2(
-        2 * q->x * q->w - 2 * q->y * q->z,
-        1 - 2 * q->x * q->x - 2 * q->z * q->z
-    );
+    fix_quaternion_t f = quaternion_to_fix(q);
 
-    result /= RADIANS_PER_DEGREE;
+    q16_t result = fix_atan2(
+        q30_mul(f.x, f.w) - q30_mul(f.y, f.z),
+        (Q30_ONE >> 1) - q30_mul(f.x, f.x) - q30_mul(f.z, f.z)
+    );
 
-    if (result < -90) 
-        result += 270;
-    else 
-        result -= 90;
+    if (result < -90 * Q16_ONE)
+        result += 270 * Q16_ONE;
+    else
+        result -= 90 * Q16_ONE;
 
-    return result;
+    return q16_to_float(result);
 }
 
 /*
@@ -89,9 +151,18 @@ float quaternion_get_roll(const quaternion_t* q) {
  * -90 < pitch < 90
  */
 float quaternion_get_pitch(const quaternion_t* q) {
-    float result = asin(2 * q->x * q->y + 2 * q->z * q->w);
+    fix_quaternion_t f = quaternion_to_fix(q);
+
+    /* asin(s) = atan2(s, sqrt(1 - s^2)) */
+    q30_t s = 2 * (q30_mul(f.x, f.y) + q30_mul(f.z, f.w));
+    if (s > Q30_ONE)
+        s = Q30_ONE;
+    else if (s < -Q30_ONE)
+        s = -Q30_ONE;
+
+    q30_t c = fix_isqrt64(((int64_t)Q30_ONE - q30_mul(s, s)) << 30);
 
-    return result / RADIANS_PER_DEGREE;
+    return q16_to_float(fix_atan2(s, c));
 }
 
 /*
@@ -99,10 +170,45 @@ float quaternion_get_pitch(const quaternion_t* q) {
  * -180 < yaw < 180
  */
 float quaternion_get_yaw(const quaternion_t* q) {
-    float result = atan2(
-        2 * q->y * q->w - 2 * q->x * q->z,
-        1 - 2 * q->y * q->y - 2 * q->z * q->z
+    fix_quaternion_t f = quaternion_to_fix(q);
+
+    q16_t result = fix_atan2(
+        q30_mul(f.y, f.w) - q30_mul(f.x, f.z),
+        (Q30_ONE >> 1) - q30_mul(f.y, f.y) - q30_mul(f.z, f.z)
     );
 
-    return result / RADIANS_PER_DEGREE;
+    return q16_to_float(result);
+}
+
+/*
+ * Gets roll, pitch and yaw in degrees, converting q to fixed point once
+ */
+void quaternion_get_euler(const quaternion_t* q, euler_t* euler) {
+    fix_quaternion_t f = quaternion_to_fix(q);
+
+    q30_t zz = q30_mul(f.z, f.z);
+
+    q16_t roll = fix_atan2(
+        q30_mul(f.x, f.w) - q30_mul(f.y, f.z),
+        (Q30_ONE >> 1) - q30_mul(f.x, f.x) - zz
+    ) - 90 * Q16_ONE;
+
+    if (roll < -180 * Q16_ONE)
+        roll += 360 * Q16_ONE;
+
+    q30_t s = 2 * (q30_mul(f.x, f.y) + q30_mul(f.z, f.w));
+    if (s > Q30_ONE)
+        s = Q30_ONE;
+    else if (s < -Q30_ONE)
+        s = -Q30_ONE;
+
+    q30_t c = fix_isqrt64(((int64_t)Q30_ONE - q30_mul(s, s)) << 30);
+
+    euler->roll = q16_to_float(roll);
+    euler->pitch = q16_to_float(fix_atan2(s, c));
+    euler->yaw = q16_to_float(fix_atan2(
+        q30_mul(f.y, f.w) - q30_mul(f.x, f.z),
+        (Q30_ONE >> 1) - q30_mul(f.y, f.y) - zz
+    ));
 }
+#endif /* MATH3D_FIXED_POINT */
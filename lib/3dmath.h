@@ -6,6 +6,13 @@
 
 #define RADIANS_PER_DEGREE 0.01745329f
 
+/*
+ * When enabled, the quaternion operations are computed in Q1.30 fixed point
+ * with the float interface unchanged, see fixmath.h. Avoids soft float on
+ * cpus without an fpu.
+ */
+/*#define MATH3D_FIXED_POINT*/
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -27,48 +34,182 @@ struct vector {
 
 typedef struct vector vector_t;
 
+/*
+ * euler angles in degrees, see quaternion_get_euler()
+ */
+struct euler {
+    float roll;
+    float pitch;
+    float yaw;
+};
+
+typedef struct euler euler_t;
+
 /*
  * returns the magnitude of vector v
  */
-float vector_norm(const vector_t* v);
+static inline float vector_norm(const vector_t* v) {
+    return sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
+}
 
+#ifdef MATH3D_FIXED_POINT
 /*
- * returns the magnitude of quaternion q
+ * Implemented in 3dmath.c, with the same behaviour as the float versions below
  */
 float quaternion_norm(const quaternion_t* q);
+quaternion_t quaternion_product(const quaternion_t* p, const quaternion_t* q);
+quaternion_t quaternion_rotate_roll(const quaternion_t* orientation, float angle);
+quaternion_t quaternion_rotate_pitch(const quaternion_t* orientation, float angle);
+float quaternion_get_roll(const quaternion_t* q);
+float quaternion_get_pitch(const quaternion_t* q);
+float quaternion_get_yaw(const quaternion_t* q);
+void quaternion_get_euler(const quaternion_t* q, euler_t* euler);
+#else
+/*
+ * returns q scaled to unit length, with one divide
+ */
+static inline quaternion_t quaternion_normalize(quaternion_t q) {
+    float scale = 1.0f / sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+
+    q.w *= scale;
+    q.x *= scale;
+    q.y *= scale;
+    q.z *= scale;
+
+    return q;
+}
+
+/*
+ * returns the magnitude of quaternion q
+ */
+static inline float quaternion_norm(const quaternion_t* q) {
+    return sqrtf(q->w * q->w + q->x * q->x + q->y * q->y + q->z * q->z);
+}
 
 /*
  * returns the product of two unit quaternions
  */
-quaternion_t quaternion_product(const quaternion_t* p, const quaternion_t* q);
+static inline quaternion_t quaternion_product(const quaternion_t* p, const quaternion_t* q) {
+    quaternion_t result = {
+        .w = p->w * q->w - p->x * q->x - p->y * q->y - p->z * q->z,
+        .x = p->w * q->x + p->x * q->w + p->y * q->z - p->z * q->y,
+        .y = p->w * q->y - p->x * q->z + p->y * q->w + p->z * q->x,
+        .z = p->w * q->z + p->x * q->y - p->y * q->x + p->z * q->w
+    };
+
+    /* scale for noise reduction */
+    return quaternion_normalize(result);
+}
 
 /*
  * rotates unit quaternion orientation about roll axis by angle
  */
-quaternion_t quaternion_rotate_roll(const quaternion_t* orientation, float angle);
+static inline quaternion_t quaternion_rotate_roll(const quaternion_t* orientation, float angle) {
+    float c = cosf(angle * RADIANS_PER_DEGREE * 0.5f);
+    float s = sinf(angle * RADIANS_PER_DEGREE * 0.5f);
+
+    /* the product with (c, s, 0, 0), without the terms that are zero */
+    quaternion_t result = {
+        .w = orientation->w * c - orientation->x * s,
+        .x = orientation->w * s + orientation->x * c,
+        .y = orientation->y * c + orientation->z * s,
+        .z = orientation->z * c - orientation->y * s
+    };
+
+    return quaternion_normalize(result);
+}
 
 /*
  * rotates unit quaternion orientation about pitch axis by angle
  */
-quaternion_t quaternion_rotate_pitch(const quaternion_t* orientation, float angle);
+static inline quaternion_t quaternion_rotate_pitch(const quaternion_t* orientation, float angle) {
+    float c = cosf(angle * RADIANS_PER_DEGREE * 0.5f);
+    float s = sinf(angle * RADIANS_PER_DEGREE * 0.5f);
+
+    /* the product with (c, 0, s, 0), without the terms that are zero */
+    quaternion_t result = {
+        .w = orientation->w * c - orientation->y * s,
+        .x = orientation->x * c - orientation->z * s,
+        .y = orientation->w * s + orientation->y * c,
+        .z = orientation->z * c + orientation->x * s
+    };
+
+    return quaternion_normalize(result);
+}
 
 /*
  * Returns the roll angle in degrees
  * -180 < roll < 180
  */
-float quaternion_get_roll(const quaternion_t* q);
+static inline float quaternion_get_roll(const quaternion_t* q) {
+    float result = atan2f(
+        2 * (q->x * q->w - q->y * q->z),
+        1 - 2 * (q->x * q->x + q->z * q->z)
+    );
+
+    result = result / RADIANS_PER_DEGREE - 90;
+
+    if (result < -180)
+        result += 360;
+
+    return result;
+}
 
 /*
  * Returns the pitch angle in degrees
  * -90 < pitch < 90
  */
-float quaternion_get_pitch(const quaternion_t* q);
+static inline float quaternion_get_pitch(const quaternion_t* q) {
+    float s = 2 * (q->x * q->y + q->z * q->w);
+
+    /* rounding can push a unit quaternion just outside the domain of asin */
+    s = fminf(fmaxf(s, -1.0f), 1.0f);
+
+    return asinf(s) / RADIANS_PER_DEGREE;
+}
 
 /*
  * Returns the yaw angle in degrees
  * -180 < yaw < 180
  */
-float quaternion_get_yaw(const quaternion_t* q);
+static inline float quaternion_get_yaw(const quaternion_t* q) {
+    float result = atan2f(
+        2 * (q->y * q->w - q->x * q->z),
+        1 - 2 * (q->y * q->y + q->z * q->z)
+    );
+
+    return result / RADIANS_PER_DEGREE;
+}
+
+/*
+ * Gets roll, pitch and yaw in degrees, sharing the products they have in
+ * common. Same results as quaternion_get_roll(), quaternion_get_pitch() and
+ * quaternion_get_yaw().
+ */
+static inline void quaternion_get_euler(const quaternion_t* q, euler_t* euler) {
+    float xx = q->x * q->x;
+    float yy = q->y * q->y;
+    float zz = q->z * q->z;
+
+    float roll = atan2f(
+        2 * (q->x * q->w - q->y * q->z),
+        1 - 2 * (xx + zz)
+    ) / RADIANS_PER_DEGREE - 90;
+
+    if (roll < -180)
+        roll += 360;
+
+    float s = 2 * (q->x * q->y + q->z * q->w);
+    s = fminf(fmaxf(s, -1.0f), 1.0f);
+
+    euler->roll = roll;
+    euler->pitch = asinf(s) / RADIANS_PER_DEGREE;
+    euler->yaw = atan2f(
+        2 * (q->y * q->w - q->x * q->z),
+        1 - 2 * (yy + zz)
+    ) / RADIANS_PER_DEGREE;
+}
+#endif /* MATH3D_FIXED_POINT */
 
 #ifdef __cplusplus
 }
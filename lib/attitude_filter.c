@@ -0,0 +1,172 @@
+#include "attitude_filter.h"
+
+/*
+ * returns true if the magnitude of accel is close enough to 1g to be used as
+ * a measurement of gravity
+ */
+static int attitude_accel_valid(const vector_t* accel, float* norm) {
+    *norm = vector_norm(accel);
+
+    return *norm > ATTITUDE_ACCEL_MIN_G && *norm < ATTITUDE_ACCEL_MAX_G;
+}
+
+/*
+ * integrates the body rates w over dt seconds with a first order step and
+ * normalizes the result. Cheaper than an exact rotation on a cpu without an fpu.
+ */
+static void attitude_integrate(attitude_filter_t* f, float wx, float wy, float wz, float dt) {
+    quaternion_t* q = &f->q;
+
+    float h = 0.5f * dt;
+
+    quaternion_t dq = {
+        .w = (-q->x * wx - q->y * wy - q->z * wz) * h,
+        .x = ( q->w * wx + q->y * wz - q->z * wy) * h,
+        .y = ( q->w * wy - q->x * wz + q->z * wx) * h,
+        .z = ( q->w * wz + q->x * wy - q->y * wx) * h
+    };
+
+    q->w += dq.w;
+    q->x += dq.x;
+    q->y += dq.y;
+    q->z += dq.z;
+
+    float l = quaternion_norm(q);
+
+    q->w /= l;
+    q->x /= l;
+    q->y /= l;
+    q->z /= l;
+}
+
+/*
+ * Initializes the filter level with the accelerometer measurement accel.
+ * Heading is arbitrary. Units of accel do not matter.
+ */
+void attitude_filter_init(attitude_filter_t* f, const vector_t* accel) {
+    float norm = vector_norm(accel);
+
+    float ax = accel->x / norm;
+    float ay = accel->y / norm;
+    float az = accel->z / norm;
+
+    /* shortest rotation from the measured gravity direction to +z */
+    if (az < -0.9999f) {
+        f->q.w = 0;
+        f->q.x = 1;
+        f->q.y = 0;
+        f->q.z = 0;
+    } else {
+        f->q.w = 1 + az;
+        f->q.x = ay;
+        f->q.y = -ax;
+        f->q.z = 0;
+
+        float l = quaternion_norm(&f->q);
+
+        f->q.w /= l;
+        f->q.x /= l;
+        f->q.y /= l;
+    }
+
+    f->bias.x = 0;
+    f->bias.y = 0;
+    f->bias.z = 0;
+}
+
+/*
+ * Updates the attitude with gyro rates (units: radians per second) and
+ * accel (units: g) measured over dt seconds, using a Mahony complementary
+ * filter. The gyro bias is estimated by the integral term.
+ */
+void attitude_mahony_update(attitude_filter_t* f, const vector_t* gyro, const vector_t* accel, float dt) {
+    const quaternion_t* q = &f->q;
+
+    float wx = gyro->x - f->bias.x;
+    float wy = gyro->y - f->bias.y;
+    float wz = gyro->z - f->bias.z;
+
+    float norm;
+    if (attitude_accel_valid(accel, &norm)) {
+        float ax = accel->x / norm;
+        float ay = accel->y / norm;
+        float az = accel->z / norm;
+
+        /* direction of gravity in the sensor frame predicted by q */
+        float vx = 2 * (q->x * q->z - q->w * q->y);
+        float vy = 2 * (q->w * q->x + q->y * q->z);
+        float vz = q->w * q->w - q->x * q->x - q->y * q->y + q->z * q->z;
+
+        /* rotation from the predicted to the measured gravity direction */
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        f->bias.x -= ATTITUDE_MAHONY_KI * ex * dt;
+        f->bias.y -= ATTITUDE_MAHONY_KI * ey * dt;
+        f->bias.z -= ATTITUDE_MAHONY_KI * ez * dt;
+
+        wx += ATTITUDE_MAHONY_KP * ex;
+        wy += ATTITUDE_MAHONY_KP * ey;
+        wz += ATTITUDE_MAHONY_KP * ez;
+    }
+
+    attitude_integrate(f, wx, wy, wz, dt);
+}
+
+/*
+ * Updates the attitude with gyro rates (units: radians per second) and
+ * accel (units: g) measured over dt seconds, using a Madgwick gradient
+ * descent filter. The gyro bias is estimated from the correction step.
+ */
+void attitude_madgwick_update(attitude_filter_t* f, const vector_t* gyro, const vector_t* accel, float dt) {
+    quaternion_t* q = &f->q;
+
+    float norm;
+    if (attitude_accel_valid(accel, &norm)) {
+        float ax = accel->x / norm;
+        float ay = accel->y / norm;
+        float az = accel->z / norm;
+
+        float qw = q->w, qx = q->x, qy = q->y, qz = q->z;
+
+        /* gradient of the error between predicted and measured gravity */
+        float sw = 4 * qw * qy * qy + 2 * qy * ax + 4 * qw * qx * qx - 2 * qx * ay;
+        float sx = 4 * qx * qz * qz - 2 * qz * ax + 4 * qw * qw * qx - 2 * qw * ay
+            - 4 * qx + 8 * qx * qx * qx + 8 * qx * qy * qy + 4 * qx * az;
+        float sy = 4 * qw * qw * qy + 2 * qw * ax + 4 * qy * qz * qz - 2 * qz * ay
+            - 4 * qy + 8 * qy * qx * qx + 8 * qy * qy * qy + 4 * qy * az;
+        float sz = 4 * qx * qx * qz - 2 * qx * ax + 4 * qy * qy * qz - 2 * qy * ay;
+
+        float s_norm = sqrtf(sw * sw + sx * sx + sy * sy + sz * sz);
+
+        if (s_norm > 0) {
+            sw /= s_norm;
+            sx /= s_norm;
+            sy /= s_norm;
+            sz /= s_norm;
+
+            /* the correction expressed as a body rate is the bias error */
+            float ex = 2 * (qw * sx - qx * sw - qy * sz + qz * sy);
+            float ey = 2 * (qw * sy + qx * sz - qy * sw - qz * sx);
+            float ez = 2 * (qw * sz - qx * sy + qy * sx - qz * sw);
+
+            f->bias.x += ATTITUDE_MADGWICK_ZETA * ex * dt;
+            f->bias.y += ATTITUDE_MADGWICK_ZETA * ey * dt;
+            f->bias.z += ATTITUDE_MADGWICK_ZETA * ez * dt;
+
+            /* step against the gradient, applied to q before integration */
+            q->w -= ATTITUDE_MADGWICK_BETA * sw * dt;
+            q->x -= ATTITUDE_MADGWICK_BETA * sx * dt;
+            q->y -= ATTITUDE_MADGWICK_BETA * sy * dt;
+            q->z -= ATTITUDE_MADGWICK_BETA * sz * dt;
+        }
+    }
+
+    attitude_integrate(f,
+        gyro->x - f->bias.x,
+        gyro->y - f->bias.y,
+        gyro->z - f->bias.z,
+        dt
+    );
+}
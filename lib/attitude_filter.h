@@ -0,0 +1,67 @@
+#ifndef __ATTITUDE_FILTER_H__
+#define __ATTITUDE_FILTER_H__
+
+#include <math.h>
+#include <3dmath.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/********** MAHONY FILTER GAINS **********/
+#define ATTITUDE_MAHONY_KP 0.5f   /* units: radians per second per unit error */
+#define ATTITUDE_MAHONY_KI 0.02f  /* gyro bias gain, 0 disables bias estimation */
+
+/********** MADGWICK FILTER GAINS **********/
+#define ATTITUDE_MADGWICK_BETA 0.05f  /* units: radians per second */
+#define ATTITUDE_MADGWICK_ZETA 0.01f  /* gyro bias gain, 0 disables bias estimation */
+
+/*
+ * The accelerometer only measures gravity when the aircraft is not
+ * accelerating. Measurements outside this range do not correct the attitude.
+ */
+#define ATTITUDE_ACCEL_MIN_G 0.8f
+#define ATTITUDE_ACCEL_MAX_G 1.2f
+
+/*
+ * object for encapsulating attitude filter state. Both filters estimate the
+ * orientation of the sensor in a level frame where gravity points along +z.
+ */
+struct attitude_filter {
+    /* rotates vectors from the sensor frame to the level frame */
+    quaternion_t q;
+
+    /* estimated gyro bias, units: radians per second */
+    vector_t bias;
+};
+
+/*
+ * type for encapsulating attitude filter state
+ */
+typedef struct attitude_filter attitude_filter_t;
+
+/*
+ * Initializes the filter level with the accelerometer measurement accel.
+ * Heading is arbitrary. Units of accel do not matter.
+ */
+void attitude_filter_init(attitude_filter_t* f, const vector_t* accel);
+
+/*
+ * Updates the attitude with gyro rates (units: radians per second) and
+ * accel (units: g) measured over dt seconds, using a Mahony complementary
+ * filter. The gyro bias is estimated by the integral term.
+ */
+void attitude_mahony_update(attitude_filter_t* f, const vector_t* gyro, const vector_t* accel, float dt);
+
+/*
+ * Updates the attitude with gyro rates (units: radians per second) and
+ * accel (units: g) measured over dt seconds, using a Madgwick gradient
+ * descent filter. The gyro bias is estimated from the correction step.
+ */
+void attitude_madgwick_update(attitude_filter_t* f, const vector_t* gyro, const vector_t* accel, float dt);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __ATTITUDE_FILTER_H__ */
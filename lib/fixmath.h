@@ -0,0 +1,189 @@
+#ifndef __FIXMATH_H__
+#define __FIXMATH_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*
+ * Q format fixed point helpers for the paths that can be built without soft
+ * float, see MATH3D_FIXED_POINT, PID_FIXED_POINT and FIR_FIXED_POINT.
+ * Multiplies are done in 64 bits and shifted back, which the M0+ does in a
+ * handful of integer instructions.
+ */
+
+/* Q15.16, range +/- 32768: angles in degrees, rates and pid terms */
+typedef int32_t q16_t;
+
+/* Q3.28, range +/- 8: angles in radians */
+typedef int32_t q28_t;
+
+/* Q1.30, range +/- 2: unit quaternion components, sines and cosines */
+typedef int32_t q30_t;
+
+#define Q16_ONE ((q16_t)1 << 16)
+#define Q28_ONE ((q28_t)1 << 28)
+#define Q30_ONE ((q30_t)1 << 30)
+
+#define Q28_PI 843314857 /* pi in Q3.28 */
+#define Q28_HALF_PI 421657428
+#define Q30_HALF_PI 1686629713
+#define Q16_DEGREES_PER_RADIAN 3754936 /* 180 / pi in Q15.16 */
+
+/*
+ * clamps v to the range of a 32 bit value
+ */
+static inline int32_t fix_saturate(int64_t v) {
+    if (v > INT32_MAX)
+        return INT32_MAX;
+    if (v < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)v;
+}
+
+/*
+ * converts f to a fixed point value with the given number of fraction bits,
+ * rounding to nearest and saturating
+ */
+static inline int32_t fix_from_float(float f, int frac_bits) {
+    f *= (float)((int64_t)1 << frac_bits);
+    if (f >= 2147483647.0f)
+        return INT32_MAX;
+    if (f <= -2147483648.0f)
+        return INT32_MIN;
+    return (int32_t)(f < 0 ? f - 0.5f : f + 0.5f);
+}
+
+static inline float fix_to_float(int32_t v, int frac_bits) {
+    return (float)v / (float)((int64_t)1 << frac_bits);
+}
+
+static inline q16_t q16_from_float(float f) { return fix_from_float(f, 16); }
+static inline float q16_to_float(q16_t v) { return fix_to_float(v, 16); }
+
+static inline q28_t q28_from_float(float f) { return fix_from_float(f, 28); }
+
+static inline q30_t q30_from_float(float f) { return fix_from_float(f, 30); }
+static inline float q30_to_float(q30_t v) { return fix_to_float(v, 30); }
+
+/*
+ * returns a * b, saturating
+ */
+static inline q16_t q16_mul(q16_t a, q16_t b) {
+    return fix_saturate(((int64_t)a * b) >> 16);
+}
+
+/*
+ * returns a * b. The result must fit, which holds for unit values.
+ */
+static inline q28_t q28_mul(q28_t a, q28_t b) {
+    return (q28_t)(((int64_t)a * b) >> 28);
+}
+
+/*
+ * returns a * b. The result must fit, which holds for unit values.
+ */
+static inline q30_t q30_mul(q30_t a, q30_t b) {
+    return (q30_t)(((int64_t)a * b) >> 30);
+}
+
+/*
+ * returns the integer square root of v
+ */
+static inline uint32_t fix_isqrt64(uint64_t v) {
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v)
+        bit >>= 2;
+
+    while (bit) {
+        if (v >= result + bit) {
+            v -= result + bit;
+            result = (result >> 1) + bit;
+        } else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint32_t)result;
+}
+
+/*
+ * returns sin(x) for x in radians, accurate to about 1e-7
+ */
+static inline q30_t fix_sin(q28_t x) {
+    while (x > Q28_PI)
+        x -= 2 * Q28_PI;
+    while (x < -Q28_PI)
+        x += 2 * Q28_PI;
+
+    /* reflect into [-pi/2, pi/2] where the series converges quickly */
+    if (x > Q28_HALF_PI)
+        x = Q28_PI - x;
+    else if (x < -Q28_HALF_PI)
+        x = -Q28_PI - x;
+
+    q28_t x2 = q28_mul(x, x);
+
+    /* x (1 - x^2/6 (1 - x^2/20 (1 - x^2/42 (1 - x^2/72 (1 - x^2/110))))) */
+    q28_t t = Q28_ONE - q28_mul(x2, Q28_ONE / 110);
+    t = Q28_ONE - q28_mul(q28_mul(x2, Q28_ONE / 72), t);
+    t = Q28_ONE - q28_mul(q28_mul(x2, Q28_ONE / 42), t);
+    t = Q28_ONE - q28_mul(q28_mul(x2, Q28_ONE / 20), t);
+    t = Q28_ONE - q28_mul(q28_mul(x2, Q28_ONE / 6), t);
+
+    return q28_mul(x, t) << 2;
+}
+
+/*
+ * returns cos(x) for x in radians
+ */
+static inline q30_t fix_cos(q28_t x) {
+    if (x > Q28_PI)
+        x -= 2 * Q28_PI;
+    return fix_sin(x + Q28_HALF_PI);
+}
+
+/*
+ * returns atan2(y, x) in degrees. y and x can use any common Q format.
+ * Accurate to about 1e-3 degrees.
+ */
+static inline q16_t fix_atan2(int32_t y, int32_t x) {
+    int64_t ax = x < 0 ? -(int64_t)x : x;
+    int64_t ay = y < 0 ? -(int64_t)y : y;
+
+    if (ax == 0 && ay == 0)
+        return 0;
+
+    /* atan of the ratio in [0, 1] */
+    q30_t z = ay > ax ? (q30_t)((ax << 30) / ay) : (q30_t)((ay << 30) / ax);
+    q30_t z2 = q30_mul(z, z);
+
+    q30_t p = 22371518; /* 0.0208351 */
+    p = q30_mul(p, z2) - 91410863; /* 0.0851330 */
+    p = q30_mul(p, z2) + 193424926; /* 0.1801410 */
+    p = q30_mul(p, z2) - 354656388; /* 0.3302995 */
+    p = q30_mul(p, z2) + 1073597943; /* 0.9998660 */
+
+    /* up to pi, which does not fit in Q1.30 */
+    int64_t a = q30_mul(p, z);
+
+    if (ay > ax)
+        a = Q30_HALF_PI - a;
+    if (x < 0)
+        a = 2 * (int64_t)Q30_HALF_PI - a;
+    if (y < 0)
+        a = -a;
+
+    return (q16_t)((a * Q16_DEGREES_PER_RADIAN) >> 30);
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __FIXMATH_H__
@@ -1,43 +1,14 @@
 #include "mpu6050.h"
 
 /*
- * Configures mpu6050 power management and sensor accuracy.
+ * writes value to register reg
  * Returns 0 if successfull
  * Returns 1 if there is no i2c response
  */
-static int mpu6050_config(mpu6050_inst_t* inst) {
-    uint8_t buffer[2];
-
-    int ret;
-
-    /* configure power management */
-    buffer[0] = MPU6050_REG_POWER_MANAGEMENT;
-    buffer[1] = MPU6050_COMMAND_POWER_ON;
-    ret = i2c_write_timeout_us(
-        inst->i2c,
-        MPU6050_I2C_ADDRESS,
-        buffer, 2,
-        false,
-        MPU6050_I2C_TIMEOUT_PRE_BYTE * 2
-    );
-    if (ret != 2) return 1;
-
-    /* configure gyro accuracy */
-    buffer[0] = MPU6050_REG_GYRO_CONFIG;
-    buffer[1] = MPU6050_GYRO_ACCURACY;
-    ret = i2c_write_timeout_us(
-        inst->i2c,
-        MPU6050_I2C_ADDRESS,
-        buffer, 2,
-        false,
-        MPU6050_I2C_TIMEOUT_PRE_BYTE * 2
-    );
-    if (ret != 2) return 1;
+static int mpu6050_write(mpu6050_inst_t* inst, uint8_t reg, uint8_t value) {
+    uint8_t buffer[2] = { reg, value };
 
-    /* configure accelerometer accuracy */
-    buffer[0] = MPU6050_REG_ACCEL_CONFIG;
-    buffer[1] = MPU6050_ACCEL_ACCURACY;
-    ret = i2c_write_timeout_us(
+    int ret = i2c_write_timeout_us(
         inst->i2c,
         MPU6050_I2C_ADDRESS,
         buffer, 2,
@@ -50,16 +21,11 @@ static int mpu6050_config(mpu6050_inst_t* inst) {
 }
 
 /*
- * gets the most recent measurements from the sensors and
- * stores them in mpu6050 object inst.
+ * reads len bytes starting at register reg into buffer
  * Returns 0 if successfull
- * Returns 1 if there is no response on i2c bus
+ * Returns 1 if there is no i2c response
  */
-static int mpu6050_fetch(mpu6050_inst_t* inst) {
-    uint8_t buffer[14];
-
-    uint8_t reg = MPU6050_REG_ACCEL_XOUT_H;
-
+static int mpu6050_read(mpu6050_inst_t* inst, uint8_t reg, uint8_t* buffer, uint16_t len) {
     int ret;
 
     ret = i2c_write_timeout_us(
@@ -74,19 +40,134 @@ static int mpu6050_fetch(mpu6050_inst_t* inst) {
     ret = i2c_read_timeout_us(
         inst->i2c,
         MPU6050_I2C_ADDRESS,
-        buffer, 14,
+        buffer, len,
         false,
-        MPU6050_I2C_TIMEOUT_PRE_BYTE * 14
+        MPU6050_I2C_TIMEOUT_PRE_BYTE * len
     );
-    if (ret != 14) return 1;
+    if (ret != len) return 1;
+
+    return 0;
+}
+
+/*
+ * Configures mpu6050 power management and sensor accuracy.
+ * Returns 0 if successfull
+ * Returns 1 if there is no i2c response
+ */
+static int mpu6050_config(mpu6050_inst_t* inst) {
+    /* configure power management */
+    if (mpu6050_write(inst, MPU6050_REG_POWER_MANAGEMENT, MPU6050_COMMAND_POWER_ON))
+        return 1;
+
+    /* configure gyro accuracy */
+    if (mpu6050_write(inst, MPU6050_REG_GYRO_CONFIG, MPU6050_GYRO_ACCURACY))
+        return 1;
+
+    /* configure accelerometer accuracy */
+    if (mpu6050_write(inst, MPU6050_REG_ACCEL_CONFIG, MPU6050_ACCEL_ACCURACY))
+        return 1;
+
+    #if defined(MPU6050_FIFO) || defined(MPU6050_DATA_READY)
+    /* configure sample rate */
+    if (mpu6050_write(inst, MPU6050_REG_CONFIG, MPU6050_COMMAND_DLPF_188HZ))
+        return 1;
+    if (mpu6050_write(inst, MPU6050_REG_SMPLRT_DIV, MPU6050_COMMAND_SAMPLE_DIV))
+        return 1;
+    #endif /* MPU6050_FIFO || MPU6050_DATA_READY */
+
+    #ifdef MPU6050_FIFO
+    /* configure which measurements are queued in the fifo */
+    if (mpu6050_write(inst, MPU6050_REG_FIFO_EN, MPU6050_COMMAND_FIFO_SENSORS))
+        return 1;
+    #endif /* MPU6050_FIFO */
+
+    return 0;
+}
+
+#ifdef MPU6050_FIFO
+/*
+ * discards all queued samples and restarts the fifo
+ * Returns 0 if successfull
+ * Returns 1 if there is no i2c response
+ */
+static int mpu6050_fifo_reset(mpu6050_inst_t* inst) {
+    return mpu6050_write(inst, MPU6050_REG_USER_CTRL,
+        MPU6050_COMMAND_FIFO_ENABLE | MPU6050_COMMAND_FIFO_RESET);
+}
+
+/*
+ * gets the number of complete samples queued in the fifo, at most
+ * MPU6050_FIFO_MAX_SAMPLES. The fifo is reset if it overflowed.
+ * Returns 0 if successfull
+ * Returns 1 if there is no i2c response
+ * Returns MPU6050_FIFO_OVERFLOW if samples were lost
+ */
+static int mpu6050_fifo_samples(mpu6050_inst_t* inst, uint16_t* samples) {
+    uint8_t buffer[2];
+
+    *samples = 0;
+
+    if (mpu6050_read(inst, MPU6050_REG_FIFO_COUNT_H, buffer, 2))
+        return 1;
+
+    uint16_t count = buffer[0] << 8 | buffer[1];
+
+    /*
+     * the fifo size is not a multiple of the sample size, so a full fifo or a
+     * partial sample means the oldest data was overwritten
+     */
+    if (count >= MPU6050_FIFO_SIZE || count % MPU6050_FIFO_SAMPLE_SIZE) {
+        if (mpu6050_fifo_reset(inst))
+            return 1;
+        return MPU6050_FIFO_OVERFLOW;
+    }
+
+    *samples = count / MPU6050_FIFO_SAMPLE_SIZE;
+    if (*samples > MPU6050_FIFO_MAX_SAMPLES)
+        *samples = MPU6050_FIFO_MAX_SAMPLES;
+
+    return 0;
+}
+
+/*
+ * converts a fifo sample to raw data, the temperature is not queued
+ */
+static void mpu6050_decode_fifo(mpu6050_data_t* data, const uint8_t* buffer) {
+    data->accel_x = buffer[0] << 8 | buffer[1];
+    data->accel_y = buffer[2] << 8 | buffer[3];
+    data->accel_z = buffer[4] << 8 | buffer[5];
+    data->gyro_x = buffer[6] << 8 | buffer[7];
+    data->gyro_y = buffer[8] << 8 | buffer[9];
+    data->gyro_z = buffer[10] << 8 | buffer[11];
+}
+#endif /* MPU6050_FIFO */
+
+/*
+ * converts a sensor burst starting at MPU6050_REG_ACCEL_XOUT_H to raw data
+ */
+static void mpu6050_decode(mpu6050_data_t* data, const uint8_t* buffer) {
+    data->accel_x = buffer[0] << 8 | buffer[1];
+    data->accel_y = buffer[2] << 8 | buffer[3];
+    data->accel_z = buffer[4] << 8 | buffer[5];
+    data->temp = buffer[6] << 8 | buffer[7];
+    data->gyro_x = buffer[8] << 8 | buffer[9];
+    data->gyro_y = buffer[10] << 8 | buffer[11];
+    data->gyro_z = buffer[12] << 8 | buffer[13];
+}
+
+/*
+ * gets the most recent measurements from the sensors and
+ * stores them in mpu6050 object inst.
+ * Returns 0 if successfull
+ * Returns 1 if there is no response on i2c bus
+ */
+static int mpu6050_fetch(mpu6050_inst_t* inst) {
+    uint8_t buffer[MPU6050_BURST_SIZE];
+
+    if (mpu6050_read(inst, MPU6050_REG_ACCEL_XOUT_H, buffer, MPU6050_BURST_SIZE))
+        return 1;
 
-    inst->data.accel_x = buffer[0] << 8 | buffer[1];
-    inst->data.accel_y = buffer[2] << 8 | buffer[3];
-    inst->data.accel_z = buffer[4] << 8 | buffer[5];
-    inst->data.temp = buffer[6] << 8 | buffer[7];
-    inst->data.gyro_x = buffer[8] << 8 | buffer[9];
-    inst->data.gyro_y = buffer[10] << 8 | buffer[11];
-    inst->data.gyro_z = buffer[12] << 8 | buffer[13];
+    mpu6050_decode(&inst->data, buffer);
 
     return 0;
 }
@@ -150,11 +231,20 @@ int mpu6050_init(mpu6050_inst_t* inst, i2c_inst_t* i2c, uint pin) {
 
     inst->start = 1;
 
+    inst->dma_busy = 0;
+
     inst->orientation.w = 0.70710;
     inst->orientation.x = 0.70710;
     inst->orientation.y = 0.00001;
     inst->orientation.z = 0.00001;
 
+    inst->rates.x = 0;
+    inst->rates.y = 0;
+    inst->rates.z = 0;
+
+    inst->gyro_filter = NULL;
+    inst->gyro_filter_context = NULL;
+
     if (mpu6050_config(inst))
         return 1;
 
@@ -192,6 +282,25 @@ int mpu6050_init(mpu6050_inst_t* inst, i2c_inst_t* i2c, uint pin) {
     inst->orientation = quaternion_rotate_pitch(&inst->orientation, angle_y_accel);
     #endif /* MPU6050_CAL_GRAVITY_ZERO */
 
+    #if defined(MPU6050_FILTER_MAHONY) || defined(MPU6050_FILTER_MADGWICK)
+    attitude_filter_init(&inst->filter, &accel_net);
+
+    /* keep reporting orientation in the frame set up above */
+    quaternion_t level = {
+        .w = inst->filter.q.w,
+        .x = -inst->filter.q.x,
+        .y = -inst->filter.q.y,
+        .z = -inst->filter.q.z
+    };
+    inst->filter_frame = quaternion_product(&inst->orientation, &level);
+    #endif /* MPU6050_FILTER_MAHONY || MPU6050_FILTER_MADGWICK */
+
+    #ifdef MPU6050_FIFO
+    /* start queueing samples now that calibration is done */
+    if (mpu6050_fifo_reset(inst))
+        return 1;
+    #endif /* MPU6050_FIFO */
+
     gpio_put(inst->led_pin, 0);
 
     return 0;
@@ -250,49 +359,354 @@ int mpu6050_avg_reading(mpu6050_inst_t* inst, mpu6050_data_t* data, uint16_t n)
     return 0;
 }
 
+/*
+ * rotates orientation by the angular rates in the raw data in inst
+ * measured over t_delta seconds
+ */
+static void mpu6050_rotate(mpu6050_inst_t* inst, float t_delta) {
+    inst->rates.x = (inst->data.gyro_x - inst->x_zero) * MPU6050_DEGREES_PER_TICK;
+    inst->rates.y = (inst->data.gyro_y - inst->y_zero) * MPU6050_DEGREES_PER_TICK;
+    inst->rates.z = (inst->data.gyro_z - inst->z_zero) * MPU6050_DEGREES_PER_TICK;
+
+    if (inst->gyro_filter)
+        inst->gyro_filter(inst->gyro_filter_context, &inst->rates);
+
+    vector_t w = {
+        .x = inst->rates.x * MPU6050_RADIANS_PER_DEGREE,
+        .y = inst->rates.y * MPU6050_RADIANS_PER_DEGREE,
+        .z = inst->rates.z * MPU6050_RADIANS_PER_DEGREE
+    };
+
+    #if defined(MPU6050_FILTER_MAHONY) || defined(MPU6050_FILTER_MADGWICK)
+    vector_t a = {
+        .x = (inst->data.accel_x - MPU6050_ACCELX_LEVEL) / MPU6050_TICKS_PER_G,
+        .y = (inst->data.accel_y - MPU6050_ACCELY_LEVEL) / MPU6050_TICKS_PER_G,
+        .z = (inst->data.accel_z - MPU6050_ACCELZ_LEVEL) / MPU6050_TICKS_PER_G
+    };
+
+    #ifdef MPU6050_FILTER_MAHONY
+    attitude_mahony_update(&inst->filter, &w, &a, t_delta);
+    #else
+    attitude_madgwick_update(&inst->filter, &w, &a, t_delta);
+    #endif /* MPU6050_FILTER_MAHONY */
+
+    /* report rates without the estimated bias */
+    inst->rates.x -= inst->filter.bias.x / MPU6050_RADIANS_PER_DEGREE;
+    inst->rates.y -= inst->filter.bias.y / MPU6050_RADIANS_PER_DEGREE;
+    inst->rates.z -= inst->filter.bias.z / MPU6050_RADIANS_PER_DEGREE;
+
+    inst->orientation = quaternion_product(&inst->filter_frame, &inst->filter.q);
+    #else
+    float w_norm = vector_norm(&w);
+
+    if (w_norm == 0)
+        w_norm = 0.00001f;
+
+    quaternion_t rotation = {
+        .w = cos((t_delta * w_norm) / 2),
+        .x = (sin((t_delta * w_norm) / 2) * w.x) / w_norm,
+        .y = (sin((t_delta * w_norm) / 2) * w.y) / w_norm,
+        .z = (sin((t_delta * w_norm) / 2) * w.z) / w_norm
+    };
+
+    inst->orientation = quaternion_product(&inst->orientation, &rotation);
+    #endif /* MPU6050_FILTER_MAHONY || MPU6050_FILTER_MADGWICK */
+}
+
+/*
+ * updates orientation with the raw data in inst, sampled at time
+ */
+static void mpu6050_integrate(mpu6050_inst_t* inst, absolute_time_t time) {
+    if (inst->start)  {
+        inst->start = 0;
+        inst->timer = time;
+    } else {
+        /* units: seconds */
+        float t_delta = absolute_time_diff_us(inst->timer, time);
+              t_delta /= 1000000.0;
+        inst->timer = time;
+
+        mpu6050_rotate(inst, t_delta);
+    }
+}
+
+#ifdef MPU6050_FIFO
+/*
+ * updates orientation with n fifo samples in buffer. Each sample is
+ * integrated over the sensor's own sample period.
+ */
+static void mpu6050_integrate_fifo(mpu6050_inst_t* inst, const uint8_t* buffer, uint16_t n) {
+    for (uint16_t i = 0; i < n; ++i) {
+        mpu6050_decode_fifo(&inst->data, buffer + i * MPU6050_FIFO_SAMPLE_SIZE);
+        mpu6050_rotate(inst, MPU6050_SAMPLE_PERIOD_US / 1000000.0f);
+    }
+}
+#endif /* MPU6050_FIFO */
+
 /*
  * Reads sensors and updates orientation.
- * call between 50Hz and 250Hz for best results.
+ * call between 50Hz and 1kHz for best results. In fifo mode, call at least
+ * every MPU6050_FIFO_MAX_SAMPLES sample periods.
  * Returns 0 if successfull.
  * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_FIFO_OVERFLOW if samples were lost in fifo mode.
  */
 int mpu6050_update_state(mpu6050_inst_t* inst) {
+    return mpu6050_update_state_at(inst, get_absolute_time());
+}
+
+/*
+ * Same as mpu6050_update_state() with the sensors read at time
+ */
+int mpu6050_update_state_at(mpu6050_inst_t* inst, absolute_time_t time) {
+    #ifdef MPU6050_FIFO
+    uint16_t n;
+    int ret = mpu6050_fifo_samples(inst, &n);
+    if (ret)
+        return ret;
+
+    if (n == 0)
+        return 0;
+
+    uint8_t buffer[MPU6050_FIFO_MAX_SAMPLES * MPU6050_FIFO_SAMPLE_SIZE];
+    if (mpu6050_read(inst, MPU6050_REG_FIFO_R_W, buffer, n * MPU6050_FIFO_SAMPLE_SIZE))
+        return 1;
+
+    /* fifo samples are integrated over the sensor's own sample period */
+    (void)time;
+    mpu6050_integrate_fifo(inst, buffer, n);
+    #else
     if (mpu6050_fetch(inst))
         return 1;
 
-    if (inst->start)  {
-        inst->start = 0;
-        inst->timer = get_absolute_time();
-    } else {
-        /* units: seconds */
-        float t_delta = absolute_time_diff_us(inst->timer, get_absolute_time());
-              t_delta /= 1000000.0;
-        inst->timer = get_absolute_time();
+    mpu6050_integrate(inst, time);
+    #endif /* MPU6050_FIFO */
+
+    return 0;
+}
+
+/*
+ * stops a background read and clears the i2c abort it caused
+ */
+static void mpu6050_abort_dma(mpu6050_inst_t* inst) {
+    i2c_hw_t *hw = i2c_get_hw(inst->i2c);
+
+    dma_channel_abort(inst->dma_tx);
+    dma_channel_abort(inst->dma_rx);
 
-        vector_t w = {
-            .x = (inst->data.gyro_x - inst->x_zero),
-            .y = (inst->data.gyro_y - inst->y_zero),
-            .z = (inst->data.gyro_z - inst->z_zero)
-        };
+    /* reading clears the abort and flushes the fifos */
+    (void)hw->clr_tx_abrt;
 
-        w.x *= MPU6050_DEGREES_PER_TICK * MPU6050_RADIANS_PER_DEGREE;
-        w.y *= MPU6050_DEGREES_PER_TICK * MPU6050_RADIANS_PER_DEGREE;
-        w.z *= MPU6050_DEGREES_PER_TICK * MPU6050_RADIANS_PER_DEGREE;;
+    inst->dma_busy = 0;
+}
+
+/*
+ * Claims two dma channels for mpu6050_start_update(). Call after mpu6050_init().
+ */
+void mpu6050_init_dma(mpu6050_inst_t* inst) {
+    i2c_hw_t *hw = i2c_get_hw(inst->i2c);
+
+    inst->dma_tx = dma_claim_unused_channel(true);
+    inst->dma_rx = dma_claim_unused_channel(true);
+    inst->dma_busy = 0;
+
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+}
 
-        float w_norm = vector_norm(&w);
+/*
+ * starts a dma read of len bytes beginning at register reg
+ */
+static void mpu6050_start_dma(mpu6050_inst_t* inst, uint8_t reg, uint16_t len) {
+    i2c_hw_t *hw = i2c_get_hw(inst->i2c);
+
+    /*
+     * The i2c block is driven through its data/command register: write the
+     * register address, then clock out one read command per byte. The first
+     * read restarts the bus so the address is not followed by a stop.
+     */
+    inst->dma_cmd[0] = reg;
+    for (uint16_t i = 1; i <= len; ++i)
+        inst->dma_cmd[i] = I2C_IC_DATA_CMD_CMD_BITS;
+    inst->dma_cmd[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    inst->dma_cmd[len] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    /* the target address can only be changed while the block is disabled */
+    hw->enable = 0;
+    hw->tar = MPU6050_I2C_ADDRESS;
+    hw->enable = I2C_IC_ENABLE_ENABLE_BITS;
+
+    dma_channel_config rx = dma_channel_get_default_config(inst->dma_rx);
+    channel_config_set_transfer_data_size(&rx, DMA_SIZE_32);
+    channel_config_set_read_increment(&rx, false);
+    channel_config_set_write_increment(&rx, true);
+    channel_config_set_dreq(&rx, i2c_get_dreq(inst->i2c, false));
+    dma_channel_configure(inst->dma_rx, &rx,
+        inst->dma_buffer, &hw->data_cmd, len, false);
+
+    dma_channel_config tx = dma_channel_get_default_config(inst->dma_tx);
+    channel_config_set_transfer_data_size(&tx, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx, true);
+    channel_config_set_write_increment(&tx, false);
+    channel_config_set_dreq(&tx, i2c_get_dreq(inst->i2c, true));
+    dma_channel_configure(inst->dma_tx, &tx,
+        &hw->data_cmd, inst->dma_cmd, len + 1, false);
+
+    inst->dma_len = len;
+    inst->dma_busy = 1;
+
+    dma_start_channel_mask((1u << inst->dma_rx) | (1u << inst->dma_tx));
+}
+
+#ifdef MPU6050_DATA_READY
+/* the raw gpio handler takes no argument, so only one sensor can use it */
+static mpu6050_inst_t* mpu6050_irq_inst;
+
+/*
+ * Runs on every data ready edge. Timestamps the sample and starts reading it.
+ */
+static void mpu6050_data_ready_irq(void) {
+    absolute_time_t time = get_absolute_time();
+    mpu6050_inst_t* inst = mpu6050_irq_inst;
 
-        if (w_norm == 0)
-            w_norm = 0.00001f;
+    if (!(gpio_get_irq_event_mask(inst->int_pin) & GPIO_IRQ_EDGE_RISE))
+        return;
+    gpio_acknowledge_irq(inst->int_pin, GPIO_IRQ_EDGE_RISE);
 
-        quaternion_t rotation = {
-            .w = cos((t_delta * w_norm) / 2),
-            .x = (sin((t_delta * w_norm) / 2) * w.x) / w_norm,
-            .y = (sin((t_delta * w_norm) / 2) * w.y) / w_norm,
-            .z = (sin((t_delta * w_norm) / 2) * w.z) / w_norm
-        };
+    /* the previous sample has not been integrated yet, skip this one */
+    if (inst->dma_busy)
+        return;
 
-        inst->orientation = quaternion_product(&inst->orientation, &rotation);
+    inst->dma_time = time;
+    mpu6050_start_dma(inst, MPU6050_REG_ACCEL_XOUT_H, MPU6050_BURST_SIZE);
+}
+
+/*
+ * Starts reading the sensors on every data ready pulse from the INT pin,
+ * connected to gpio pin. The interrupt runs on the calling core.
+ * Call after mpu6050_init_dma().
+ * Returns 0 if successfull.
+ * Returns 1 if there is no response on i2c bus.
+ */
+int mpu6050_init_data_ready(mpu6050_inst_t* inst, uint pin) {
+    inst->int_pin = pin;
+    mpu6050_irq_inst = inst;
+
+    gpio_init(pin);
+    gpio_set_dir(pin, GPIO_IN);
+    gpio_pull_down(pin);
+
+    gpio_add_raw_irq_handler(pin, mpu6050_data_ready_irq);
+    gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    /* INT pulses high for 50us each time a new sample is in the registers */
+    if (mpu6050_write(inst, MPU6050_REG_INT_PIN_CFG, MPU6050_COMMAND_INT_PULSE))
+        return 1;
+    if (mpu6050_write(inst, MPU6050_REG_INT_ENABLE, MPU6050_COMMAND_DATA_RDY_EN))
+        return 1;
+
+    return 0;
+}
+#endif /* MPU6050_DATA_READY */
+
+/*
+ * Starts reading the sensors in the background with dma. The cpu is free
+ * while the transfer runs. Call mpu6050_finish_update() to complete the update.
+ * Does nothing if a background read is already running. In fifo mode, the
+ * number of queued samples is read before the transfer starts. In data ready
+ * mode, reads are started by the interrupt and this does nothing.
+ * Returns 0 if successfull.
+ * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_FIFO_OVERFLOW if samples were lost in fifo mode.
+ */
+int mpu6050_start_update(mpu6050_inst_t* inst) {
+    return mpu6050_start_update_at(inst, get_absolute_time());
+}
+
+/*
+ * Same as mpu6050_start_update() with the read timestamped at time
+ */
+int mpu6050_start_update_at(mpu6050_inst_t* inst, absolute_time_t time) {
+    #ifdef MPU6050_DATA_READY
+    return 0;
+    #else
+    if (inst->dma_busy)
+        return 0;
+
+    inst->dma_time = time;
+
+    #ifdef MPU6050_FIFO
+    uint16_t n;
+    int ret = mpu6050_fifo_samples(inst, &n);
+    if (ret)
+        return ret;
+
+    if (n)
+        mpu6050_start_dma(inst, MPU6050_REG_FIFO_R_W, n * MPU6050_FIFO_SAMPLE_SIZE);
+    #else
+    mpu6050_start_dma(inst, MPU6050_REG_ACCEL_XOUT_H, MPU6050_BURST_SIZE);
+    #endif /* MPU6050_FIFO */
+
+    return 0;
+    #endif /* MPU6050_DATA_READY */
+}
+
+/*
+ * Updates orientation with the data from the background read started by
+ * mpu6050_start_update(). Does not block.
+ * Returns 0 if successfull or if no background read was started.
+ * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_UPDATE_PENDING if the read has not completed yet, or in
+ * data ready mode if there is no new sample.
+ */
+int mpu6050_finish_update(mpu6050_inst_t* inst) {
+    if (!inst->dma_busy) {
+        #ifdef MPU6050_DATA_READY
+        return MPU6050_UPDATE_PENDING;
+        #else
+        return 0;
+        #endif /* MPU6050_DATA_READY */
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(inst->i2c);
+
+    /* a nack aborts the transfer and leaves the dma channels waiting */
+    if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        mpu6050_abort_dma(inst);
+        return 1;
+    }
+
+    if (dma_channel_is_busy(inst->dma_rx)) {
+        int64_t elapsed = absolute_time_diff_us(inst->dma_time, get_absolute_time());
+        if (elapsed > MPU6050_I2C_TIMEOUT_PRE_BYTE * (inst->dma_len + 1)) {
+            mpu6050_abort_dma(inst);
+            return 1;
+        }
+        return MPU6050_UPDATE_PENDING;
     }
+
+    /* copy out before releasing the buffer to the data ready interrupt */
+    #ifndef MPU6050_FIFO
+    absolute_time_t time = inst->dma_time;
+    #endif /* MPU6050_FIFO */
+    uint8_t buffer[MPU6050_DMA_MAX_BYTES];
+    for (uint16_t i = 0; i < inst->dma_len; ++i)
+        buffer[i] = (uint8_t)inst->dma_buffer[i];
+
+    inst->dma_busy = 0;
+
+    #ifdef MPU6050_FIFO
+    mpu6050_integrate_fifo(inst, buffer, inst->dma_len / MPU6050_FIFO_SAMPLE_SIZE);
+    #else
+    mpu6050_decode(&inst->data, buffer);
+
+    /*
+     * the sensors are sampled at the start of the burst, or at the data ready
+     * edge which removes the interrupt and bus latency from dt
+     */
+    mpu6050_integrate(inst, time);
+    #endif /* MPU6050_FIFO */
+
     return 0;
 }
 
@@ -303,6 +717,22 @@ quaternion_t mpu6050_get_quaternion(const mpu6050_inst_t *inst) {
     return inst->orientation;
 }
 
+/*
+ * Passes every gyro sample through filter before it is integrated
+ */
+void mpu6050_set_gyro_filter(mpu6050_inst_t *inst, mpu6050_gyro_filter_t filter, void *context) {
+    inst->gyro_filter = filter;
+    inst->gyro_filter_context = context;
+}
+
+/*
+ * Returns the calibrated angular rates measured by the most recent update
+ * units: degrees per second
+ */
+vector_t mpu6050_get_rates(const mpu6050_inst_t *inst) {
+    return inst->rates;
+}
+
 /*
  * Returns the roll angle in degrees
  * -180 < roll < 180
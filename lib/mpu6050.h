@@ -3,11 +3,14 @@
 
 #include <stdlib.h>
 #include <3dmath.h>
+#include <attitude_filter.h>
 
 #include "pico/stdlib.h"
 #include "pico/time.h"
+#include "hardware/dma.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
+#include "hardware/irq.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -43,6 +46,35 @@ extern "C" {
  * starting the calibration routine in calibrate().
  */
 #define MPU6050_CAL_WAIT_FOR_REST
+/*
+ * When enabled, the sensor samples into its fifo every
+ * MPU6050_SAMPLE_PERIOD_US. Every queued sample is integrated on update, so
+ * samples between updates are not lost and updates can be late.
+ */
+#define MPU6050_FIFO
+/*
+ * When enabled, the sensor pulses its INT pin every MPU6050_SAMPLE_PERIOD_US
+ * and each sample is read by dma from the gpio interrupt, see
+ * mpu6050_init_data_ready(). Samples are integrated over the time between
+ * data ready edges. Cannot be used with MPU6050_FIFO.
+ */
+/*#define MPU6050_DATA_READY*/
+
+/*
+ * Selects the attitude filter that corrects gyro drift with the accelerometer
+ * and estimates the gyro bias, see attitude_filter.h. When neither is
+ * enabled, orientation is pure gyro integration after calibration.
+ */
+#define MPU6050_FILTER_MAHONY
+/*#define MPU6050_FILTER_MADGWICK*/
+
+#if defined(MPU6050_FILTER_MAHONY) && defined(MPU6050_FILTER_MADGWICK)
+#error "only one of MPU6050_FILTER_MAHONY and MPU6050_FILTER_MADGWICK can be enabled"
+#endif
+
+#if defined(MPU6050_FIFO) && defined(MPU6050_DATA_READY)
+#error "MPU6050_FIFO and MPU6050_DATA_READY cannot both be enabled"
+#endif
 
 /********** MPU6050 I2C AND REGISTER ADDRESSES **********/
 #define MPU6050_I2C_ADDRESS 0x68
@@ -50,13 +82,52 @@ extern "C" {
 #define MPU6050_REG_GYRO_CONFIG 0x1B
 #define MPU6050_REG_ACCEL_CONFIG 0x1C
 #define MPU6050_REG_ACCEL_XOUT_H 0x3B
+#define MPU6050_REG_SMPLRT_DIV 0x19
+#define MPU6050_REG_CONFIG 0x1A
+#define MPU6050_REG_FIFO_EN 0x23
+#define MPU6050_REG_USER_CTRL 0x6A
+#define MPU6050_REG_FIFO_COUNT_H 0x72
+#define MPU6050_REG_FIFO_R_W 0x74
+#define MPU6050_REG_INT_PIN_CFG 0x37
+#define MPU6050_REG_INT_ENABLE 0x38
 
 /* units: microseconds */
 #define MPU6050_I2C_TIMEOUT_PRE_BYTE 500
 
+/* number of bytes read by a sensor burst, starting at MPU6050_REG_ACCEL_XOUT_H */
+#define MPU6050_BURST_SIZE 14
+
+/* returned by mpu6050_finish_update() while the background read is running */
+#define MPU6050_UPDATE_PENDING 2
+
+/* returned by update functions if samples were lost because the fifo was full */
+#define MPU6050_FIFO_OVERFLOW 3
+
 /********** MPU6050 POWER SETTINGS **********/
 #define MPU6050_COMMAND_POWER_ON 0b00000000
 
+/********** MPU6050 INTERRUPT SETTINGS **********/
+#define MPU6050_COMMAND_INT_PULSE 0b00000000   /* active high, 50us pulse */
+#define MPU6050_COMMAND_DATA_RDY_EN 0b00000001
+
+/********** MPU6050 FIFO SETTINGS **********/
+#define MPU6050_COMMAND_DLPF_188HZ 0b00000001   /* sets gyro output rate to 1kHz */
+#define MPU6050_COMMAND_SAMPLE_DIV 0            /* sample rate = 1kHz / (1 + div) */
+#define MPU6050_COMMAND_FIFO_SENSORS 0b01111000 /* gyro x, y, z and accel */
+#define MPU6050_COMMAND_FIFO_ENABLE 0b01000000
+#define MPU6050_COMMAND_FIFO_RESET 0b00000100
+
+#define MPU6050_SAMPLE_PERIOD_US (1000 * (1 + MPU6050_COMMAND_SAMPLE_DIV))
+#define MPU6050_FIFO_SIZE 1024
+#define MPU6050_FIFO_SAMPLE_SIZE 12 /* accel x, y, z then gyro x, y, z */
+#define MPU6050_FIFO_MAX_SAMPLES 16 /* most samples read by a single update */
+
+#ifdef MPU6050_FIFO
+#define MPU6050_DMA_MAX_BYTES (MPU6050_FIFO_MAX_SAMPLES * MPU6050_FIFO_SAMPLE_SIZE)
+#else
+#define MPU6050_DMA_MAX_BYTES MPU6050_BURST_SIZE
+#endif /* MPU6050_FIFO */
+
 /********** MPU6050 GYROSCOPE ACCURACY SETTINGS **********/
 /*#define MPU6050_GYRO_ACCURACY 0b00000000*/     /* +/-  250 deg/sec */
 #define MPU6050_GYRO_ACCURACY 0b00001000       /* +/-  500 deg/sec */
@@ -92,6 +163,12 @@ struct mpu6050_data {
 */
 typedef struct mpu6050_data mpu6050_data_t;
 
+/*
+ * called with every calibrated gyro sample before it is integrated, and can
+ * filter the rates in place. units: degrees per second
+ */
+typedef void (*mpu6050_gyro_filter_t)(void *context, vector_t *rates);
+
 /*
 * object for encapsulating mpu6050 state
 */
@@ -100,6 +177,20 @@ struct mpu6050_inst {
 
     quaternion_t orientation;
 
+    /*
+     * attitude filter state, in a level frame. filter_frame rotates the level
+     * frame into the frame orientation is reported in.
+     */
+    attitude_filter_t filter;
+    quaternion_t filter_frame;
+
+    /* calibrated angular rates, units: degrees per second */
+    vector_t rates;
+
+    /* optional, see mpu6050_set_gyro_filter() */
+    mpu6050_gyro_filter_t gyro_filter;
+    void *gyro_filter_context;
+
     absolute_time_t timer;
 
     mpu6050_data_t data;
@@ -109,6 +200,17 @@ struct mpu6050_inst {
     uint led_pin;
 
     uint8_t start;
+
+    /* background read state, see mpu6050_start_update() */
+    uint dma_tx;
+    uint dma_rx;
+    uint32_t dma_cmd[MPU6050_DMA_MAX_BYTES + 1];
+    uint32_t dma_buffer[MPU6050_DMA_MAX_BYTES];
+    uint16_t dma_len;
+    absolute_time_t dma_time;
+    volatile uint8_t dma_busy; /* also set by the data ready interrupt */
+
+    uint int_pin;
 };
 
 /*
@@ -132,17 +234,83 @@ int mpu6050_avg_reading(mpu6050_inst_t* inst, mpu6050_data_t* data, uint16_t n);
 
 /*
  * Reads sensors and updates orientation.
- * call between 50Hz and 250Hz for best results.
+ * call between 50Hz and 1kHz for best results. In fifo mode, call at least
+ * every MPU6050_FIFO_MAX_SAMPLES sample periods.
  * Returns 0 if successfull.
  * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_FIFO_OVERFLOW if samples were lost in fifo mode.
  */
 int mpu6050_update_state(mpu6050_inst_t *inst);
 
+/*
+ * Same as mpu6050_update_state() with the sensors read at time, taken by the
+ * caller, instead of reading the timer. time is only used to integrate
+ * without the fifo, where it should be the time the update was due.
+ */
+int mpu6050_update_state_at(mpu6050_inst_t *inst, absolute_time_t time);
+
+/*
+ * Claims two dma channels for mpu6050_start_update(). Call after mpu6050_init().
+ */
+void mpu6050_init_dma(mpu6050_inst_t *inst);
+
+/*
+ * Starts reading the sensors in the background with dma. The cpu is free
+ * while the transfer runs. Call mpu6050_finish_update() to complete the update.
+ * Does nothing if a background read is already running. In fifo mode, the
+ * number of queued samples is read before the transfer starts. In data ready
+ * mode, reads are started by the interrupt and this does nothing.
+ * Returns 0 if successfull.
+ * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_FIFO_OVERFLOW if samples were lost in fifo mode.
+ */
+int mpu6050_start_update(mpu6050_inst_t *inst);
+
+/*
+ * Same as mpu6050_start_update() with the read timestamped at time, taken by
+ * the caller just before, instead of reading the timer.
+ */
+int mpu6050_start_update_at(mpu6050_inst_t *inst, absolute_time_t time);
+
+#ifdef MPU6050_DATA_READY
+/*
+ * Starts reading the sensors on every data ready pulse from the INT pin,
+ * connected to gpio pin. The interrupt runs on the calling core.
+ * Call after mpu6050_init_dma().
+ * Returns 0 if successfull.
+ * Returns 1 if there is no response on i2c bus.
+ */
+int mpu6050_init_data_ready(mpu6050_inst_t *inst, uint pin);
+#endif /* MPU6050_DATA_READY */
+
+/*
+ * Updates orientation with the data from the background read started by
+ * mpu6050_start_update(). Does not block.
+ * Returns 0 if successfull or if no background read was started.
+ * Returns 1 if there is no response on i2c bus.
+ * Returns MPU6050_UPDATE_PENDING if the read has not completed yet, or in
+ * data ready mode if there is no new sample.
+ */
+int mpu6050_finish_update(mpu6050_inst_t *inst);
+
+/*
+ * Passes every gyro sample through filter before it is integrated, at the
+ * sensor sample rate. filter runs on the core that updates the sensor.
+ * Pass NULL to remove the filter.
+ */
+void mpu6050_set_gyro_filter(mpu6050_inst_t *inst, mpu6050_gyro_filter_t filter, void *context);
+
 /*
  * Returns the quaternion used internally by the mpu6050 to track orientation
  */
 quaternion_t mpu6050_get_quaternion(const mpu6050_inst_t *inst);
 
+/*
+ * Returns the calibrated angular rates measured by the most recent update
+ * units: degrees per second
+ */
+vector_t mpu6050_get_rates(const mpu6050_inst_t *inst);
+
 /*
  * Returns the roll angle in degrees
  * -180 < roll < 180
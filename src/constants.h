@@ -12,6 +12,8 @@
 #define I2C_SDA_PIN 20
 #define I2C_SCL_PIN 21
 
+#define MPU6050_INT_PIN 22 // only used with MPU6050_DATA_READY
+
 #define AR610_THRO_PIN 1
 #define AR610_AILE_PIN 3
 #define AR610_ELEV_PIN 5
@@ -22,11 +24,31 @@
 #define STDIO_WAIT 2 // units: seconds
 #define USB_WAIT 3 // units: seconds
 
-#define LOOP_PERIOD_US 4000
-#define USB_TIMEOUT_PADDING_US 500
+#define LOOP_PERIOD_US 1000 // scheduler tick
+
+// When defined, core1 runs the imu update at IMU_PERIOD_US and publishes the
+// attitude to core0 through a mailbox. Otherwise, everything runs on core0.
+#define DUAL_CORE
+
+// When defined, prop vibration is found with an fft of the gyro samples and
+// removed by notch filters that follow it, see dyn_notch.h
+#define DYN_NOTCH
+
+// Task periods must be multiples of LOOP_PERIOD_US
+#define IMU_PERIOD_US 1000
+#define RX_PERIOD_US 20000
+#define BMP_PERIOD_US 20000
+#define FC_PERIOD_US 20000
+#define LOG_PERIOD_US 20000
+
+// When defined, the execution time of every loop phase is recorded.
+// Dump the results with COMMAND_DUMP_PROFILE.
+#define PROFILE_LOOP
 
 #define COMMAND_DUMP_LOGS 'd'
+#define COMMAND_DUMP_PROFILE 'p'
 #define COMMAND_REBOOT 'r'
 #define COMMAND_BOOTSEL 'b'
+#define COMMAND_SCHED_STATS 's'
 
 #endif // CONSTANTS_H
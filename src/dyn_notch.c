@@ -0,0 +1,252 @@
+#include "dyn_notch.h"
+
+#define PI 3.14159265f
+
+#define HALF_SIZE (DYN_NOTCH_FFT_SIZE / 2)
+#define SAMPLE_MASK (DYN_NOTCH_FFT_SIZE - 1)
+
+#if (1 << (DYN_NOTCH_FFT_STAGES + 1)) != DYN_NOTCH_FFT_SIZE
+#error "DYN_NOTCH_FFT_STAGES does not match DYN_NOTCH_FFT_SIZE"
+#endif
+
+// analysis steps, in order. Each runs in one call to dyn_notch_update().
+enum {
+    STEP_DETREND = 0,
+    STEP_LOAD = 1,
+    STEP_FFT = 2, // one step per fft stage
+    STEP_SPLIT = STEP_FFT + DYN_NOTCH_FFT_STAGES,
+    STEP_PEAK = STEP_SPLIT + 1
+};
+
+static inline uint16_t bit_reverse(uint16_t i) {
+    uint16_t result = 0;
+    for (int bit = 0; bit < DYN_NOTCH_FFT_STAGES; ++bit) {
+        result = (result << 1) | ((i >> bit) & 1);
+    }
+    return result;
+}
+
+static inline uint16_t min_bin(const Dyn_Notch *dn) {
+    uint16_t bin = DYN_NOTCH_MIN_HZ * DYN_NOTCH_FFT_SIZE / dn->sample_hz;
+    return bin < 2 ? 2 : bin;
+}
+
+static inline uint16_t max_bin(const Dyn_Notch *dn) {
+    uint16_t bin = DYN_NOTCH_MAX_HZ * DYN_NOTCH_FFT_SIZE / dn->sample_hz + 1;
+    return bin > HALF_SIZE - 2 ? HALF_SIZE - 2 : bin;
+}
+
+void dyn_notch_init(Dyn_Notch *dn, float sample_hz) {
+    dn->sample_hz = sample_hz;
+    dn->front = 0;
+    dn->count = 0;
+    dn->step = STEP_DETREND;
+    dn->axis = 0;
+
+    for (int i = 0; i < DYN_NOTCH_FFT_SIZE; ++i) {
+        dn->window[i] = 0.5f - 0.5f * cosf(2 * PI * i / DYN_NOTCH_FFT_SIZE);
+    }
+
+    for (int k = 0; k < HALF_SIZE; ++k) {
+        dn->twiddle_re[k] = cosf(2 * PI * k / DYN_NOTCH_FFT_SIZE);
+        dn->twiddle_im[k] = -sinf(2 * PI * k / DYN_NOTCH_FFT_SIZE);
+    }
+
+    for (int axis = 0; axis < DYN_NOTCH_AXES; ++axis) {
+        dn->center_hz[axis] = DYN_NOTCH_MAX_HZ;
+        dn->peak_power[axis] = 0;
+        dn->active[axis] = false;
+        biquad_filter_init_notch(&dn->notch[axis], DYN_NOTCH_MAX_HZ, sample_hz, DYN_NOTCH_Q);
+    }
+}
+
+void dyn_notch_apply(Dyn_Notch *dn, vector_t *rates) {
+    dn->samples[0][dn->front] = rates->x;
+    dn->samples[1][dn->front] = rates->y;
+    dn->samples[2][dn->front] = rates->z;
+    dn->front = (dn->front + 1) & SAMPLE_MASK;
+    if (dn->count < DYN_NOTCH_FFT_SIZE) {
+        ++dn->count;
+    }
+
+    if (dn->active[0]) {
+        rates->x = biquad_filter_apply(&dn->notch[0], rates->x);
+    }
+    if (dn->active[1]) {
+        rates->y = biquad_filter_apply(&dn->notch[1], rates->y);
+    }
+    if (dn->active[2]) {
+        rates->z = biquad_filter_apply(&dn->notch[2], rates->z);
+    }
+}
+
+// fits a line to the samples of the current axis. Slow maneuvers are mostly
+// a ramp over the window, and would otherwise leak into the lowest bins.
+static void detrend(Dyn_Notch *dn) {
+    const float *samples = dn->samples[dn->axis];
+    const float center = 0.5f * (DYN_NOTCH_FFT_SIZE - 1);
+
+    float sum = 0;
+    float moment = 0;
+    for (uint16_t n = 0; n < DYN_NOTCH_FFT_SIZE; ++n) {
+        float sample = samples[(dn->front + n) & SAMPLE_MASK];
+        sum += sample;
+        moment += (n - center) * sample;
+    }
+
+    // sum of (n - center)^2
+    const float spread = (float)DYN_NOTCH_FFT_SIZE *
+        ((float)DYN_NOTCH_FFT_SIZE * DYN_NOTCH_FFT_SIZE - 1) / 12;
+
+    dn->trend_mean = sum / DYN_NOTCH_FFT_SIZE;
+    dn->trend_slope = moment / spread;
+}
+
+// windows the detrended samples of the current axis and packs even and odd samples as
+// the real and imaginary parts of a half size complex fft, in bit reversed
+// order
+static void load(Dyn_Notch *dn) {
+    const float *samples = dn->samples[dn->axis];
+
+    // the line fitted by detrend(), starting at the oldest sample
+    float trend = dn->trend_mean - 0.5f * (DYN_NOTCH_FFT_SIZE - 1) * dn->trend_slope;
+
+    for (uint16_t i = 0; i < HALF_SIZE; ++i) {
+        uint16_t n = 2 * i;
+        uint16_t j = bit_reverse(i);
+        dn->re[j] = (samples[(dn->front + n) & SAMPLE_MASK] - trend) * dn->window[n];
+        trend += dn->trend_slope;
+        dn->im[j] = (samples[(dn->front + n + 1) & SAMPLE_MASK] - trend) * dn->window[n + 1];
+        trend += dn->trend_slope;
+    }
+}
+
+// one radix 2 stage of the half size complex fft
+static void fft_stage(Dyn_Notch *dn, uint8_t stage) {
+    uint16_t half = 1 << stage;
+    uint16_t stride = HALF_SIZE / half; // twiddle index step, W_N^(N / len)
+
+    for (uint16_t start = 0; start < HALF_SIZE; start += 2 * half) {
+        for (uint16_t j = 0; j < half; ++j) {
+            float wr = dn->twiddle_re[j * stride];
+            float wi = dn->twiddle_im[j * stride];
+
+            uint16_t a = start + j;
+            uint16_t b = a + half;
+
+            float tr = dn->re[b] * wr - dn->im[b] * wi;
+            float ti = dn->re[b] * wi + dn->im[b] * wr;
+
+            dn->re[b] = dn->re[a] - tr;
+            dn->im[b] = dn->im[a] - ti;
+            dn->re[a] += tr;
+            dn->im[a] += ti;
+        }
+    }
+}
+
+// recovers the power of the real fft bins in the searched range from the
+// half size complex fft
+static void split(Dyn_Notch *dn) {
+    uint16_t last = max_bin(dn);
+
+    for (uint16_t k = min_bin(dn) - 1; k <= last + 1; ++k) {
+        uint16_t c = HALF_SIZE - k;
+
+        // even part (z[k] + conj(z[c])) / 2 and odd part -j (z[k] - conj(z[c])) / 2
+        float even_r = 0.5f * (dn->re[k] + dn->re[c]);
+        float even_i = 0.5f * (dn->im[k] - dn->im[c]);
+        float odd_r = 0.5f * (dn->im[k] + dn->im[c]);
+        float odd_i = -0.5f * (dn->re[k] - dn->re[c]);
+
+        float xr = even_r + dn->twiddle_re[k] * odd_r - dn->twiddle_im[k] * odd_i;
+        float xi = even_i + dn->twiddle_re[k] * odd_i + dn->twiddle_im[k] * odd_r;
+
+        dn->power[k] = xr * xr + xi * xi;
+    }
+}
+
+// finds the strongest bin, refines it between bins and moves the notch
+static void find_peak(Dyn_Notch *dn) {
+    uint16_t first = min_bin(dn);
+    uint16_t last = max_bin(dn);
+    uint8_t axis = dn->axis;
+
+    uint16_t peak = first;
+    float sum = 0;
+    for (uint16_t k = first; k <= last; ++k) {
+        sum += dn->power[k];
+        if (dn->power[k] > dn->power[peak]) {
+            peak = k;
+        }
+    }
+
+    float mean = sum / (last - first + 1);
+    if (dn->power[peak] <= DYN_NOTCH_PEAK_RATIO * mean || dn->power[peak] == 0) {
+        dn->peak_power[axis] = 0;
+        return;
+    }
+
+    // parabola through the magnitudes of the peak and its neighbours
+    float l = sqrtf(dn->power[peak - 1]);
+    float m = sqrtf(dn->power[peak]);
+    float r = sqrtf(dn->power[peak + 1]);
+    float d = l - 2 * m + r;
+    float offset = d < 0 ? 0.5f * (l - r) / d : 0;
+
+    float hz = (peak + offset) * dn->sample_hz / DYN_NOTCH_FFT_SIZE;
+    if (hz < DYN_NOTCH_MIN_HZ) {
+        hz = DYN_NOTCH_MIN_HZ;
+    } else if (hz > DYN_NOTCH_MAX_HZ) {
+        hz = DYN_NOTCH_MAX_HZ;
+    }
+
+    if (dn->active[axis]) {
+        dn->center_hz[axis] += DYN_NOTCH_SMOOTHING * (hz - dn->center_hz[axis]);
+    } else {
+        dn->center_hz[axis] = hz;
+        dn->active[axis] = true;
+    }
+    dn->peak_power[axis] = dn->power[peak];
+
+    biquad_filter_update_notch(&dn->notch[axis],
+        dn->center_hz[axis], dn->sample_hz, DYN_NOTCH_Q
+    );
+}
+
+void dyn_notch_update(Dyn_Notch *dn) {
+    if (dn->count < DYN_NOTCH_FFT_SIZE) {
+        return;
+    }
+
+    if (dn->step == STEP_DETREND) {
+        detrend(dn);
+    } else if (dn->step == STEP_LOAD) {
+        load(dn);
+    } else if (dn->step < STEP_SPLIT) {
+        fft_stage(dn, dn->step - STEP_FFT);
+    } else if (dn->step == STEP_SPLIT) {
+        split(dn);
+    } else {
+        find_peak(dn);
+        dn->axis = (dn->axis + 1) % DYN_NOTCH_AXES;
+        dn->step = STEP_DETREND;
+        return;
+    }
+
+    ++dn->step;
+}
+
+float dyn_notch_get_peak_hz(const Dyn_Notch *dn) {
+    float peak_hz = 0;
+    float peak_power = 0;
+
+    for (int axis = 0; axis < DYN_NOTCH_AXES; ++axis) {
+        if (dn->peak_power[axis] > peak_power) {
+            peak_power = dn->peak_power[axis];
+            peak_hz = dn->center_hz[axis];
+        }
+    }
+
+    return peak_hz;
+}
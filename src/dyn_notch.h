@@ -0,0 +1,85 @@
+#ifndef __DYN_NOTCH_H__
+#define __DYN_NOTCH_H__
+
+#include <3dmath.h>
+
+#include "pico/stdlib.h"
+
+#include "filter.h"
+
+// real samples per analysis, a power of 2. The resolution is
+// sample_hz / DYN_NOTCH_FFT_SIZE, 7.8 Hz at 1 kHz.
+#define DYN_NOTCH_FFT_SIZE 128
+#define DYN_NOTCH_FFT_STAGES 6 // log2(DYN_NOTCH_FFT_SIZE / 2)
+
+// range searched for noise peaks, units: Hz
+#define DYN_NOTCH_MIN_HZ 60
+#define DYN_NOTCH_MAX_HZ 400
+
+#define DYN_NOTCH_Q 3.0f
+
+// a peak must have this many times the mean power of the searched range
+#define DYN_NOTCH_PEAK_RATIO 10.0f
+
+// weight of a new peak in the tracked center frequency
+#define DYN_NOTCH_SMOOTHING 0.5f
+
+#define DYN_NOTCH_AXES 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Finds the strongest vibration peak of each gyro axis with a real fft and
+// keeps a notch filter on each axis centered on it. The fft is spread over
+// calls to dyn_notch_update(), one bounded step per call, so the analysis
+// can run once per sample without overrunning the loop. Axes are analyzed
+// in turn.
+typedef struct {
+    float sample_hz;
+
+    // newest DYN_NOTCH_FFT_SIZE samples of each axis, before the notch
+    float samples[DYN_NOTCH_AXES][DYN_NOTCH_FFT_SIZE];
+    uint16_t front; // index of the oldest sample
+    uint16_t count; // samples received, up to DYN_NOTCH_FFT_SIZE
+
+    // fft of the current axis, packed as DYN_NOTCH_FFT_SIZE / 2 complex values
+    float re[DYN_NOTCH_FFT_SIZE / 2];
+    float im[DYN_NOTCH_FFT_SIZE / 2];
+    float power[DYN_NOTCH_FFT_SIZE / 2];
+
+    uint8_t step;
+    uint8_t axis;
+
+    // line removed from the samples before the fft
+    float trend_mean;
+    float trend_slope;
+
+    float center_hz[DYN_NOTCH_AXES];
+    float peak_power[DYN_NOTCH_AXES]; // 0 if no peak was found
+    bool active[DYN_NOTCH_AXES];
+    biquad_filter_t notch[DYN_NOTCH_AXES];
+
+    float window[DYN_NOTCH_FFT_SIZE];
+    float twiddle_re[DYN_NOTCH_FFT_SIZE / 2]; // e^(-2 pi j k / DYN_NOTCH_FFT_SIZE)
+    float twiddle_im[DYN_NOTCH_FFT_SIZE / 2];
+} Dyn_Notch;
+
+// sample_hz is the rate samples are passed to dyn_notch_apply()
+void dyn_notch_init(Dyn_Notch *dn, float sample_hz);
+
+// Records a gyro sample for analysis and filters it in place
+void dyn_notch_apply(Dyn_Notch *dn, vector_t *rates);
+
+// Runs the next step of the analysis. Call once per sample.
+void dyn_notch_update(Dyn_Notch *dn);
+
+// Returns the center of the strongest peak found on any axis, 0 if none
+// units: Hz
+float dyn_notch_get_peak_hz(const Dyn_Notch *dn);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __DYN_NOTCH_H__
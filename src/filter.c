@@ -0,0 +1,109 @@
+#include "filter.h"
+
+#define PI 3.14159265f
+
+void pt1_filter_init(pt1_filter_t *filter, float cutoff_hz, float sample_hz) {
+    float rc = 1.0f / (2.0f * PI * cutoff_hz);
+    float dt = 1.0f / sample_hz;
+
+    filter->k = dt / (rc + dt);
+    filter->state = 0;
+}
+
+static void set_lpf(biquad_filter_t *filter, float cutoff_hz, float sample_hz, float q) {
+    float omega = 2.0f * PI * cutoff_hz / sample_hz;
+    float sn = sinf(omega);
+    float cs = cosf(omega);
+    float alpha = sn / (2.0f * q);
+    float a0 = 1.0f / (1.0f + alpha);
+
+    filter->b0 = (1.0f - cs) * 0.5f * a0;
+    filter->b1 = (1.0f - cs) * a0;
+    filter->b2 = filter->b0;
+    filter->a1 = -2.0f * cs * a0;
+    filter->a2 = (1.0f - alpha) * a0;
+}
+
+static void set_notch(biquad_filter_t *filter, float center_hz, float sample_hz, float q) {
+    float omega = 2.0f * PI * center_hz / sample_hz;
+    float sn = sinf(omega);
+    float cs = cosf(omega);
+    float alpha = sn / (2.0f * q);
+    float a0 = 1.0f / (1.0f + alpha);
+
+    filter->b0 = a0;
+    filter->b1 = -2.0f * cs * a0;
+    filter->b2 = a0;
+    filter->a1 = filter->b1;
+    filter->a2 = (1.0f - alpha) * a0;
+}
+
+void biquad_filter_init_lpf(biquad_filter_t *filter, float cutoff_hz, float sample_hz) {
+    set_lpf(filter, cutoff_hz, sample_hz, FILTER_BUTTERWORTH_Q);
+    filter->z1 = 0;
+    filter->z2 = 0;
+}
+
+void biquad_filter_init_notch(biquad_filter_t *filter, float center_hz, float sample_hz, float q) {
+    set_notch(filter, center_hz, sample_hz, q);
+    filter->z1 = 0;
+    filter->z2 = 0;
+}
+
+void biquad_filter_update_notch(biquad_filter_t *filter, float center_hz, float sample_hz, float q) {
+    set_notch(filter, center_hz, sample_hz, q);
+}
+
+float filter_notch_q(float center_hz, float cutoff_hz) {
+    return center_hz * cutoff_hz / (center_hz * center_hz - cutoff_hz * cutoff_hz);
+}
+
+void filter_init_none(filter_t *filter) {
+    filter->type = FILTER_NONE;
+}
+
+void filter_init_pt1(filter_t *filter, float cutoff_hz, float sample_hz) {
+    filter->type = FILTER_PT1;
+    pt1_filter_init(&filter->pt1, cutoff_hz, sample_hz);
+}
+
+void filter_init_biquad_lpf(filter_t *filter, float cutoff_hz, float sample_hz) {
+    filter->type = FILTER_BIQUAD;
+    biquad_filter_init_lpf(&filter->biquad, cutoff_hz, sample_hz);
+}
+
+void filter_init_notch(filter_t *filter, float center_hz, float sample_hz, float q) {
+    filter->type = FILTER_BIQUAD;
+    biquad_filter_init_notch(&filter->biquad, center_hz, sample_hz, q);
+}
+
+void filter_init_fir(filter_t *filter, const float *response) {
+    filter->type = FILTER_FIR;
+    fir_filter_init(&filter->fir, response);
+}
+
+float filter_apply(filter_t *filter, float input) {
+    switch (filter->type) {
+    case FILTER_PT1:
+        return pt1_filter_apply(&filter->pt1, input);
+    case FILTER_BIQUAD:
+        return biquad_filter_apply(&filter->biquad, input);
+    case FILTER_FIR:
+        return fir_filter_calculate(&filter->fir, input);
+    default:
+        return input;
+    }
+}
+
+q16_t filter_apply_q16(filter_t *filter, q16_t input) {
+    switch (filter->type) {
+    case FILTER_NONE:
+        return input;
+#   ifdef FIR_FIXED_POINT
+    case FILTER_FIR:
+        return fir_filter_calculate_q16(&filter->fir, input);
+#   endif // FIR_FIXED_POINT
+    default:
+        return q16_from_float(filter_apply(filter, q16_to_float(input)));
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef __FILTER_H__
+#define __FILTER_H__
+
+#include <math.h>
+
+#include <fixmath.h>
+
+#include "pico/stdlib.h"
+
+#include "fir_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// q of a second order butterworth low pass
+#define FILTER_BUTTERWORTH_Q 0.7071068f
+
+typedef enum {
+    FILTER_NONE = 0,
+    FILTER_PT1 = 1,
+    FILTER_BIQUAD = 2,
+    FILTER_FIR = 3
+} filter_type_t;
+
+// first order low pass
+typedef struct {
+    float k;
+    float state;
+} pt1_filter_t;
+
+// second order section, transposed direct form II
+typedef struct {
+    float b0;
+    float b1;
+    float b2;
+    float a1;
+    float a2;
+
+    float z1;
+    float z2;
+} biquad_filter_t;
+
+// any of the filters above behind one interface, see filter_apply()
+typedef struct {
+    filter_type_t type;
+
+    union {
+        pt1_filter_t pt1;
+        biquad_filter_t biquad;
+        fir_inst_t fir;
+    };
+} filter_t;
+
+/*
+ * Coefficients are computed from cutoff frequencies in Hz and the rate the
+ * filter is applied at, sample_hz. Cutoffs must be below sample_hz / 2.
+ */
+void pt1_filter_init(pt1_filter_t *filter, float cutoff_hz, float sample_hz);
+
+void biquad_filter_init_lpf(biquad_filter_t *filter, float cutoff_hz, float sample_hz);
+void biquad_filter_init_notch(biquad_filter_t *filter, float center_hz, float sample_hz, float q);
+
+// moves the notch without clearing the filter history
+void biquad_filter_update_notch(biquad_filter_t *filter, float center_hz, float sample_hz, float q);
+
+// returns the q of a notch centered on center_hz that is 3 dB down at cutoff_hz
+float filter_notch_q(float center_hz, float cutoff_hz);
+
+static inline float pt1_filter_apply(pt1_filter_t *filter, float input) {
+    filter->state += filter->k * (input - filter->state);
+    return filter->state;
+}
+
+static inline float biquad_filter_apply(biquad_filter_t *filter, float input) {
+    float output = filter->b0 * input + filter->z1;
+
+    filter->z1 = filter->b1 * input - filter->a1 * output + filter->z2;
+    filter->z2 = filter->b2 * input - filter->a2 * output;
+
+    return output;
+}
+
+void filter_init_none(filter_t *filter);
+void filter_init_pt1(filter_t *filter, float cutoff_hz, float sample_hz);
+void filter_init_biquad_lpf(filter_t *filter, float cutoff_hz, float sample_hz);
+void filter_init_notch(filter_t *filter, float center_hz, float sample_hz, float q);
+void filter_init_fir(filter_t *filter, const float *response);
+
+float filter_apply(filter_t *filter, float input);
+
+// uses the integer fir path when FIR_FIXED_POINT is defined, the other
+// filters are computed in float
+q16_t filter_apply_q16(filter_t *filter, q16_t input);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __FILTER_H__
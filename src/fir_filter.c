@@ -1,7 +1,13 @@
 #include "fir_filter.h"
 
 void fir_filter_init(fir_inst_t *filter, const float *response) {
-    filter->response = response;
+#   ifdef FIR_FIXED_POINT
+        for (size_t i = 0; i < FIR_NUM_TAPS; ++i) {
+            filter->response[i] = q30_from_float(response[i]);
+        }
+#   else
+        filter->response = response;
+#   endif // FIR_FIXED_POINT
     filter->front = 0;
     filter->startup_counter = 0;
 }
@@ -10,24 +16,54 @@ void fir_filter_flush(fir_inst_t *filter) {
     filter->startup_counter = 0;
 }
 
+static inline size_t push_front(fir_inst_t *filter) {
+    filter->front = filter->front ? filter->front - 1 : FIR_NUM_TAPS - 1;
+    return filter->front;
+}
+
+#ifdef FIR_FIXED_POINT
+q16_t fir_filter_calculate_q16(fir_inst_t *filter, q16_t input) {
+    size_t front = push_front(filter);
+
+    filter->buffer[front] = input;
+    filter->buffer[front + FIR_NUM_TAPS] = input;
+
+    if (filter->startup_counter < FIR_NUM_TAPS) {
+        ++filter->startup_counter;
+        return input;
+    }
+
+    // accumulate at full precision and round once
+    const q16_t *window = &filter->buffer[front];
+    int64_t result = 0;
+
+    for (size_t i = 0; i < FIR_NUM_TAPS; ++i) {
+        result += (int64_t)window[i] * filter->response[i];
+    }
+    return fix_saturate(result >> 30);
+}
+
+float fir_filter_calculate(fir_inst_t *filter, float input) {
+    return q16_to_float(fir_filter_calculate_q16(filter, q16_from_float(input)));
+}
+#else
 float fir_filter_calculate(fir_inst_t *filter, float input) {
-    filter->front = (filter->front + 1) % FIR_BUFFER_SIZE;
+    size_t front = push_front(filter);
 
-    filter->buffer[filter->front] = input;
+    filter->buffer[front] = input;
+    filter->buffer[front + FIR_NUM_TAPS] = input;
 
-    if (filter->startup_counter < FIR_BUFFER_SIZE) {
+    if (filter->startup_counter < FIR_NUM_TAPS) {
         ++filter->startup_counter;
         return input;
     }
 
+    const float *window = &filter->buffer[front];
     float result = 0;
 
-    for (size_t i = 0; i < FIR_BUFFER_SIZE; ++i) {
-        int buffer_index = filter->front - i;
-        if (buffer_index < 0) {
-            buffer_index += FIR_BUFFER_SIZE;
-        }
-        result += filter->buffer[buffer_index] * filter->response[i];
+    for (size_t i = 0; i < FIR_NUM_TAPS; ++i) {
+        result += window[i] * filter->response[i];
     }
     return result;
 }
+#endif // FIR_FIXED_POINT
@@ -1,27 +1,48 @@
 #ifndef __FIR_FILTER_H__
 #define __FIR_FILTER_H__
 
+#include <fixmath.h>
+
 #include "pico/stdlib.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
-#define FIR_BUFFER_SIZE 10
+// number of taps, fixed at compile time
+#ifndef FIR_NUM_TAPS
+#define FIR_NUM_TAPS 4
+#endif // FIR_NUM_TAPS
+
+// When defined, the filter history is stored in Q15.16 and the taps in Q1.30
+// fixed point, so taps must be in (-2, 2). The float interface is unchanged.
+//#define FIR_FIXED_POINT
 
+// The history is stored twice, so the newest FIR_NUM_TAPS samples are always
+// contiguous from buffer[front] and no wrap around is needed when summing
 typedef struct {
-    const float *response;
+#   ifdef FIR_FIXED_POINT
+        q30_t response[FIR_NUM_TAPS]; // copied from the float taps at init
+        q16_t buffer[2 * FIR_NUM_TAPS];
+#   else
+        const float *response;
+        float buffer[2 * FIR_NUM_TAPS];
+#   endif // FIR_FIXED_POINT
 
-    float buffer[FIR_BUFFER_SIZE];
     size_t front;
 
     uint8_t startup_counter;
 } fir_inst_t;
 
+// response must have FIR_NUM_TAPS taps, newest sample first
 void fir_filter_init(fir_inst_t *filter, const float *response);
 void fir_filter_flush(fir_inst_t *filter);
 float fir_filter_calculate(fir_inst_t *filter, float input);
 
+#ifdef FIR_FIXED_POINT
+q16_t fir_filter_calculate_q16(fir_inst_t *filter, q16_t input);
+#endif // FIR_FIXED_POINT
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
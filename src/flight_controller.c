@@ -1,6 +1,5 @@
 #include "flight_controller.h"
-
-static Fc_State fc;
+#include "gain_schedule.h"
 
 static inline float absf(float val) {
     if (val < 0) {
@@ -20,7 +19,7 @@ static inline float interpolate(
     return (((val - min_from) / (max_from - min_from)) * (max_to - min_to)) + min_to;
 }
 
-static inline int8_t constrain8(int8_t val, int8_t min, int8_t max) {
+static inline float constrainf(float val, float min, float max) {
     if (val < min) {
         return min;
     } else if (val > max) {
@@ -30,14 +29,9 @@ static inline int8_t constrain8(int8_t val, int8_t min, int8_t max) {
     }
 }
 
-static inline float constrainf(float val, float min, float max) {
-    if (val < min) {
-        return min;
-    } else if (val > max) {
-        return max;
-    } else {
-        return val;
-    }
+// nearest entry of the tables indexed by tstate
+static inline int8_t tstate_index(float tstate) {
+    return (int8_t)(tstate + 0.5f);
 }
 
 static inline float constrain_output(float val) {
@@ -121,11 +115,8 @@ static Fc_Flight_Mode get_flight_mode(const Fc_Input *input, Fc_Flags flags) {
     return mode;
 }
 
-static float get_target_roll(float input, float curr, float target, Fc_Ctrl_Mode mode) {
-    static bool start = true;
-
+static float get_target_roll(bool start, float input, float curr, float target, Fc_Ctrl_Mode mode, float dt) {
     if (start) {
-        start = false;
         target = curr;
     } else {
         switch (mode) {
@@ -139,7 +130,7 @@ static float get_target_roll(float input, float curr, float target, Fc_Ctrl_Mode
             target += interpolate(input,
                 -FC_MAX_ATTITUDE, FC_MAX_ATTITUDE,
                 -FC_RATE_MAX_ROLL_RATE, FC_RATE_MAX_ROLL_RATE
-            );
+            ) * dt;
             target = optimize_target(target, curr, FC_RATE_MAX_ROLL_ERROR);
             break;
         case FC_CTRL_MANUAL:
@@ -150,11 +141,8 @@ static float get_target_roll(float input, float curr, float target, Fc_Ctrl_Mode
     return target;
 }
 
-static float get_target_pitch(float input, float curr, float target, Fc_Ctrl_Mode mode) {
-    static bool start = true;
-
+static float get_target_pitch(bool start, float input, float curr, float target, Fc_Ctrl_Mode mode, float dt) {
     if (start) {
-        start = false;
         target = curr;
     } else {
         switch (mode) {
@@ -168,7 +156,7 @@ static float get_target_pitch(float input, float curr, float target, Fc_Ctrl_Mod
             target += interpolate(input,
                 -FC_MAX_ATTITUDE, FC_MAX_ATTITUDE,
                 -FC_RATE_MAX_PITCH_RATE, FC_RATE_MAX_PITCH_RATE
-            );
+            ) * dt;
             target = optimize_target(target, curr, FC_RATE_MAX_PITCH_ERROR);
             break;
         case FC_CTRL_MANUAL:
@@ -179,11 +167,8 @@ static float get_target_pitch(float input, float curr, float target, Fc_Ctrl_Mod
     return target;
 }
 
-static float get_target_yaw(float input, float curr, float target, Fc_Ctrl_Mode mode) {
-    static bool start = true;
-
+static float get_target_yaw(bool start, float input, float curr, float target, Fc_Ctrl_Mode mode, float dt) {
     if (start) {
-        start = false;
         target = curr;
     } else {
         switch (mode) {
@@ -194,7 +179,7 @@ static float get_target_yaw(float input, float curr, float target, Fc_Ctrl_Mode
             target += interpolate(input,
                 -FC_MAX_ATTITUDE, FC_MAX_ATTITUDE,
                 -FC_RATE_MAX_YAW_RATE, FC_RATE_MAX_YAW_RATE
-            );
+            ) * dt;
             target = optimize_target(target, curr, FC_RATE_MAX_YAW_ERROR);
             break;
         }
@@ -202,147 +187,89 @@ static float get_target_yaw(float input, float curr, float target, Fc_Ctrl_Mode
     return target;
 }
 
-static int8_t get_transition_state(int8_t state, Fc_Flight_Mode mode) {
-    static bool start = true;
-    static uint8_t counter = 0;
-
+static float get_transition_state(bool start, float state, Fc_Flight_Mode mode, float dt) {
     if (start) {
-        start = false;
         state = 0;
     } else {
         switch (mode) {
         case FC_FMODE_HORIZONTAL:
-            --state;
+            state -= FC_TSTATE_RATE_HORZ * dt;
             break;
         default:
-            if (counter++ % 2) {
-                ++state;
-            }
+            state += FC_TSTATE_RATE_VERT * dt;
             break;
         }
     }
-    return constrain8(state, FC_MIN_TSTATE, FC_MAX_TSTATE);
+    return constrainf(state, FC_MIN_TSTATE, FC_MAX_TSTATE);
 }
 
-static float get_roll_pid(pid_inst_t *pid, float error, int8_t tstate) {
-    static bool start = true;
-
-    float p = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_ROLL_P, FC_VERT_ROLL_P
-    );
-    float i = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_ROLL_I, FC_VERT_ROLL_I
-    );
-    float d = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_ROLL_D, FC_VERT_ROLL_D
-    );
-    float i_max = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_ROLL_I_MAX, FC_VERT_ROLL_I_MAX
-    );
-
-    if (start) {
-        start = false;
-        pid_init(pid, p, i, d, i_max);
-    } else {
-        pid_set_gains(pid, p, i, d, i_max);
-    }
-
-    return pid_calculate(pid, error);
+static void init_pid(pid_inst_t *pid, const Fc_Pid_Gains *gains) {
+    pid_init(pid, gains->p, gains->i, gains->d, gains->i_max);
 }
 
-static float get_pitch_pid(pid_inst_t *pid, float error, int8_t tstate) {
-    static bool start = true;
-
-    float p = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_PITCH_P, FC_VERT_PITCH_P
-    );
-    float i = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_PITCH_I, FC_VERT_PITCH_I
-    );
-    float d = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_PITCH_D, FC_VERT_PITCH_D
-    );
-    float i_max = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_PITCH_I_MAX, FC_VERT_PITCH_I_MAX
-    );
-
-    if (start) {
-        start = false;
-        pid_init(pid, p, i, d, i_max);
-    } else {
-        pid_set_gains(pid, p, i, d, i_max);
-    }
-
-    return pid_calculate(pid, error);
+static float run_pid(pid_inst_t *pid, const Fc_Pid_Gains *gains, float error, uint32_t dt_us) {
+    pid_set_gains(pid, gains->p, gains->i, gains->d, gains->i_max);
+    return pid_calculate_dt(pid, error, dt_us);
 }
 
-static float get_yaw_pid(pid_inst_t *pid, float error, int8_t tstate) {
-    static bool start = true;
-
-    float p = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_YAW_P, FC_VERT_YAW_P
-    );
-    float i = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_YAW_I, FC_VERT_YAW_I
-    );
-    float d = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_YAW_D, FC_VERT_YAW_D
-    );
-    float i_max = interpolate(tstate,
-        FC_HORZ_TSTATE, FC_VERT_TSTATE,
-        FC_HORZ_YAW_I_MAX, FC_VERT_YAW_I_MAX
-    );
+static float get_roll_pid(const Fc_Gains *schedule, pid_inst_t *pid, float error,
+    int8_t tstate, uint32_t dt_us) {
+    return run_pid(pid, &schedule[tstate].roll, error, dt_us);
+}
 
-    if (start) {
-        start = false;
-        pid_init(pid, p, i, d, i_max);
-    } else {
-        pid_set_gains(pid, p, i, d, i_max);
-    }
+static float get_pitch_pid(const Fc_Gains *schedule, pid_inst_t *pid, float error,
+    int8_t tstate, uint32_t dt_us) {
+    return run_pid(pid, &schedule[tstate].pitch, error, dt_us);
+}
 
-    return pid_calculate(pid, error);
+static float get_yaw_pid(const Fc_Gains *schedule, pid_inst_t *pid, float error,
+    int8_t tstate, uint32_t dt_us) {
+    return run_pid(pid, &schedule[tstate].yaw, error, dt_us);
 }
 
-float get_roll(const quaternion_t *q) {
-    float roll = quaternion_get_roll(q);
+static void get_attitude(const quaternion_t *q, euler_t *attitude) {
+    quaternion_get_euler(q, attitude);
 
 #   if FC_INVERT_ROLL == 1
-        roll  *= -1;
+        attitude->roll *= -1;
 #   endif
 
-    return roll;
-}
-
-float get_pitch(const quaternion_t *q) {
-    float pitch = quaternion_get_pitch(q);
-
 #   if FC_INVERT_PITCH == 1
-        pitch *= -1;
+        attitude->pitch *= -1;
 #   endif
 
-    return pitch;
+#   if FC_INVERT_YAW == 1
+        attitude->yaw *= -1;
+#   endif
 }
 
-float get_yaw(const quaternion_t *q) {
-    float yaw = quaternion_get_yaw(q);
+#ifdef FC_CASCADED
+// Gets the rates of get_attitude() from the gyro rates. The attitude is taken
+// in a frame pitched by tstate from the imu, so roll and yaw rates are mixed
+// by tstate.
+static void get_attitude_rates(const vector_t *rates, float tstate, euler_t *attitude_rates) {
+    // cos and sin of tstate from the half angle compensation quaternion
+    const quaternion_t *r = &fc_tstate_rotation[tstate_index(tstate)];
+    float c = r->w * r->w - r->y * r->y;
+    float s = -2 * r->w * r->y;
 
-#   if FC_INVERT_YAW == 1
-        yaw *= -1;
+    attitude_rates->roll = c * rates->x + s * rates->z;
+    attitude_rates->pitch = rates->y;
+    attitude_rates->yaw = s * rates->x - c * rates->z;
+
+#   if FC_INVERT_ROLL == 1
+        attitude_rates->roll *= -1;
 #   endif
 
-    return yaw;
+#   if FC_INVERT_PITCH == 1
+        attitude_rates->pitch *= -1;
+#   endif
+
+#   if FC_INVERT_YAW == 1
+        attitude_rates->yaw *= -1;
+#   endif
 }
+#endif // FC_CASCADED
 
 static inline bool use_horz_ctrls(float tstate) {
     return tstate < FC_TSTATE_CTRL_THRESHOLD;
@@ -456,68 +383,156 @@ static Fc_Output get_output(
     return output;
 }
 
-const Fc_Output *fc_calc(const Fc_Input *input, Fc_Flags flags) {
-    static bool start = true;
-    if (start) {
-        fc.waiting = true;
-        start = false;
-    }
+#ifdef FC_CASCADED
+// Runs the inner rate loop and updates the outputs
+static void calc_rate(Fc_State *fc, const vector_t *rates, uint32_t dt_us) {
+    int8_t index = tstate_index(fc->tstate);
+
+    euler_t attitude_rates;
+    get_attitude_rates(rates, fc->tstate, &attitude_rates);
+
+    fc->roll_rate = attitude_rates.roll;
+    fc->pitch_rate = attitude_rates.pitch;
+    fc->yaw_rate = attitude_rates.yaw;
+
+    float error_roll = fc->target_roll_rate - fc->roll_rate;
+    float error_pitch = fc->target_pitch_rate - fc->pitch_rate;
+    float error_yaw = fc->target_yaw_rate - fc->yaw_rate;
+
+    fc->pid_out.roll = get_roll_pid(fc->rate_gain_schedule, &fc->pid_roll_rate, error_roll, index, dt_us);
+    fc->pid_out.pitch = get_pitch_pid(fc->rate_gain_schedule, &fc->pid_pitch_rate, error_pitch, index, dt_us);
+    fc->pid_out.yaw = get_yaw_pid(fc->rate_gain_schedule, &fc->pid_yaw_rate, error_yaw, index, dt_us);
+
+    fc->output = get_output(&fc->ctrl_input, &fc->pid_out, fc->ctrl_mode, fc->tstate);
+}
+#endif // FC_CASCADED
+
+void fc_init(Fc_State *fc) {
+    *fc = (Fc_State){ 0 };
+
+    fc->start = true;
+    fc->waiting = true;
+    fc->tstate = FC_MIN_TSTATE;
 
-    fc.input = *input;
-    fc.flags = flags;
+    // the outputs of waiting, for an fc_calc_rate() before the first fc_calc()
+    fc->output.right_elevon = FC_CEN_OUTPUT;
+    fc->output.left_elevon = FC_CEN_OUTPUT;
+    fc->output.right_motor = FC_MIN_OUTPUT;
+    fc->output.left_motor = FC_MIN_OUTPUT;
+    fc->output.gear = map_gear(fc->tstate);
 
-    fc.ctrl_mode = get_ctrl_mode(&fc.input, fc.flags);
-    fc.flight_mode = get_flight_mode(&fc.input, fc.flags);
-    fc.tstate = get_transition_state(fc.tstate, fc.flight_mode);
+    fc->gain_schedule = fc_gain_schedule;
+    fc->rate_gain_schedule = fc_rate_gain_schedule;
 
-    if (fc.waiting) {
-        if ((fc.tstate == 0) &&
-            (fc.flight_mode == FC_FMODE_HORIZONTAL) &&
-            (fc.ctrl_mode == FC_CTRL_MANUAL) &&
-            (!(fc.flags & FC_RX_FAILED)) &&
-            (fc.input.thro < FC_MIN_INPUT + FC_DEAD_STICK)) {
-            fc.waiting = false;
+    // tstate holds on the first call, so the pids start on its gains
+    int8_t index = tstate_index(fc->tstate);
+
+    init_pid(&fc->pid_roll, &fc->gain_schedule[index].roll);
+    init_pid(&fc->pid_pitch, &fc->gain_schedule[index].pitch);
+    init_pid(&fc->pid_yaw, &fc->gain_schedule[index].yaw);
+
+#   ifdef FC_CASCADED
+        init_pid(&fc->pid_roll_rate, &fc->rate_gain_schedule[index].roll);
+        init_pid(&fc->pid_pitch_rate, &fc->rate_gain_schedule[index].pitch);
+        init_pid(&fc->pid_yaw_rate, &fc->rate_gain_schedule[index].yaw);
+#   endif // FC_CASCADED
+}
+
+const Fc_Output *fc_calc(Fc_State *fc, const Fc_Input *input, Fc_Flags flags, uint32_t dt_us) {
+    // the first call takes the targets from the attitude and holds tstate
+    bool start = fc->start;
+    fc->start = false;
+
+    // units: seconds
+    float dt = dt_us / 1000000.0f;
+
+    fc->input = *input;
+    fc->flags = flags;
+
+    fc->ctrl_mode = get_ctrl_mode(&fc->input, fc->flags);
+    fc->flight_mode = get_flight_mode(&fc->input, fc->flags);
+    fc->tstate = get_transition_state(start, fc->tstate, fc->flight_mode, dt);
+
+    if (fc->waiting) {
+        if ((fc->tstate == 0) &&
+            (fc->flight_mode == FC_FMODE_HORIZONTAL) &&
+            (fc->ctrl_mode == FC_CTRL_MANUAL) &&
+            (!(fc->flags & FC_RX_FAILED)) &&
+            (fc->input.thro < FC_MIN_INPUT + FC_DEAD_STICK)) {
+            fc->waiting = false;
         } else {
-            fc.flight_mode = FC_FMODE_DISABLED;
-            fc.flags |= FC_WAITING;
+            fc->flight_mode = FC_FMODE_DISABLED;
+            fc->flags |= FC_WAITING;
         }
     }
 
-    if ((fc.flight_mode == FC_FMODE_DISABLED) || (fc.flags & FC_RX_FAILED)) {
-        fc.input.thro = FC_MIN_INPUT;
-        fc.input.aile = FC_CEN_INPUT;
-        fc.input.elev = FC_CEN_INPUT;
-        fc.input.rudd = FC_CEN_INPUT;
+    if ((fc->flight_mode == FC_FMODE_DISABLED) || (fc->flags & FC_RX_FAILED)) {
+        fc->input.thro = FC_MIN_INPUT;
+        fc->input.aile = FC_CEN_INPUT;
+        fc->input.elev = FC_CEN_INPUT;
+        fc->input.rudd = FC_CEN_INPUT;
     }
 
+    int8_t index = tstate_index(fc->tstate);
+
     // compensate pitch based on transition state.
-    quaternion_t q = quaternion_rotate_pitch(&fc.input.orientation, fc.tstate * -1);
+    quaternion_t q = quaternion_product(&fc->input.orientation, &fc_tstate_rotation[index]);
 
-    fc.roll = get_roll(&q);
-    fc.pitch = get_pitch(&q);
-    fc.yaw = get_yaw(&q);
+    euler_t attitude;
+    get_attitude(&q, &attitude);
 
-    fc.target_roll = get_target_roll(fc.input.aile, fc.roll, fc.target_roll, fc.ctrl_mode);
-    fc.target_pitch = get_target_pitch(fc.input.elev, fc.pitch, fc.target_pitch, fc.ctrl_mode);
-    fc.target_yaw = get_target_yaw(fc.input.rudd, fc.yaw, fc.target_yaw, fc.ctrl_mode);
+    fc->roll = attitude.roll;
+    fc->pitch = attitude.pitch;
+    fc->yaw = attitude.yaw;
 
-    float error_roll = constrain_angle(fc.target_roll - fc.roll);
-    float error_pitch = constrain_angle(fc.target_pitch - fc.pitch);
-    float error_yaw = constrain_angle(fc.target_yaw - fc.yaw);
+    fc->target_roll = get_target_roll(start, fc->input.aile, fc->roll, fc->target_roll, fc->ctrl_mode, dt);
+    fc->target_pitch = get_target_pitch(start, fc->input.elev, fc->pitch, fc->target_pitch, fc->ctrl_mode, dt);
+    fc->target_yaw = get_target_yaw(start, fc->input.rudd, fc->yaw, fc->target_yaw, fc->ctrl_mode, dt);
 
-    fc.pid_out.thro = fc.input.thro;
-    fc.pid_out.roll = get_roll_pid(&fc.pid_roll, error_roll, fc.tstate);
-    fc.pid_out.pitch = get_pitch_pid(&fc.pid_pitch, error_pitch, fc.tstate);
-    fc.pid_out.yaw = get_yaw_pid(&fc.pid_yaw, error_yaw, fc.tstate);
+    float error_roll = constrain_angle(fc->target_roll - fc->roll);
+    float error_pitch = constrain_angle(fc->target_pitch - fc->pitch);
+    float error_yaw = constrain_angle(fc->target_yaw - fc->yaw);
 
-    fc.output = get_output(&fc.input, &fc.pid_out, fc.ctrl_mode, fc.tstate);
+    fc->pid_out.thro = fc->input.thro;
+
+#   ifdef FC_CASCADED
+        // the angle pids set the targets of the rate loop
+        fc->target_roll_rate = get_roll_pid(fc->gain_schedule, &fc->pid_roll, error_roll, index, dt_us);
+        fc->target_pitch_rate = get_pitch_pid(fc->gain_schedule, &fc->pid_pitch, error_pitch, index, dt_us);
+        fc->target_yaw_rate = get_yaw_pid(fc->gain_schedule, &fc->pid_yaw, error_yaw, index, dt_us);
+
+        fc->ctrl_input = fc->input;
+        if (fc->rate_loop_external) {
+            // the rate pids are stepped by fc_calc_rate() on their own dt
+            fc->output = get_output(&fc->ctrl_input, &fc->pid_out, fc->ctrl_mode, fc->tstate);
+        } else {
+            calc_rate(fc, &fc->input.rates, dt_us);
+        }
+#   else
+        fc->pid_out.roll = get_roll_pid(fc->gain_schedule, &fc->pid_roll, error_roll, index, dt_us);
+        fc->pid_out.pitch = get_pitch_pid(fc->gain_schedule, &fc->pid_pitch, error_pitch, index, dt_us);
+        fc->pid_out.yaw = get_yaw_pid(fc->gain_schedule, &fc->pid_yaw, error_yaw, index, dt_us);
+
+        fc->output = get_output(&fc->input, &fc->pid_out, fc->ctrl_mode, fc->tstate);
+#   endif // FC_CASCADED
 
     // save original input for logging
-    fc.input = *input;
+    fc->input = *input;
 
-    return &fc.output;
+    return &fc->output;
 }
 
-const Fc_State *fc_get_state(void) {
-    return &fc;
+#ifdef FC_CASCADED
+const Fc_Output *fc_calc_rate(Fc_State *fc, const vector_t *rates, uint32_t dt_us) {
+    fc->rate_loop_external = true;
+
+    // manual outputs do not depend on the rates, and are set by fc_calc()
+    if (fc->ctrl_mode == FC_CTRL_MANUAL) {
+        return &fc->output;
+    }
+
+    calc_rate(fc, rates, dt_us);
+
+    return &fc->output;
 }
+#endif // FC_CASCADED
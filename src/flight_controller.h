@@ -19,6 +19,10 @@
 #define FC_VERT_TSTATE FC_MAX_TSTATE
 #define FC_TSTATE_CTRL_THRESHOLD 45
 
+// transition speed, units: degrees of tstate per second
+#define FC_TSTATE_RATE_VERT 25 // towards vertical flight
+#define FC_TSTATE_RATE_HORZ 50 // towards horizontal flight
+
 #define FC_MIN_INPUT -100
 #define FC_CEN_INPUT 0
 #define FC_MAX_INPUT 100
@@ -31,53 +35,30 @@
 
 #define FC_ANGLE_MAX_PITCH_TARGET   20  // units: degrees
 #define FC_ANGLE_MAX_ROLL_TARGET    20  // units: degrees
-#define FC_ANGLE_MAX_YAW_RATE       2.5 // units: degrees per 20 ms
+#define FC_ANGLE_MAX_YAW_RATE       125 // units: degrees per second
 #define FC_ANGLE_MAX_YAW_ERROR      20  // units: degrees
 
-#define FC_RATE_MAX_ROLL_RATE       1.5 // units: degrees per 20 ms
-#define FC_RATE_MAX_PITCH_RATE      1.0 // units: degrees per 20 ms
-#define FC_RATE_MAX_YAW_RATE        2.5 // units: degrees per 20 ms
+// rates are scaled by the time between fc_calc() calls, so the control rate
+// can change without retuning
+#define FC_RATE_MAX_ROLL_RATE       75  // units: degrees per second
+#define FC_RATE_MAX_PITCH_RATE      50  // units: degrees per second
+#define FC_RATE_MAX_YAW_RATE        125 // units: degrees per second
 #define FC_RATE_MAX_ROLL_ERROR      30  // units: degrees
 #define FC_RATE_MAX_PITCH_ERROR     30  // units: degrees
 #define FC_RATE_MAX_YAW_ERROR       30  // units: degrees
 
+// When defined, the angle pids set rate targets in degrees per second and an
+// inner rate pid on the gyro rates drives the outputs, see fc_calc_rate().
+// The inner loop can be run faster than fc_calc(), up to the imu rate.
+//#define FC_CASCADED
+
 #define FC_INVERT_ROLL 1 // set as 1 to invert roll input from imu
 #define FC_INVERT_PITCH 0 // set as 1 to invert pitch input from imu
 #define FC_INVERT_YAW 0 // set as 1 to invert yaw input from imu
 
-// ********** Horizontal Flight PID Gains ********** //
-#define FC_HORZ_ROLL_P      3.0
-#define FC_HORZ_ROLL_I      0.0
-#define FC_HORZ_ROLL_D      0.0
-#define FC_HORZ_ROLL_I_MAX  1.0
-
-#define FC_HORZ_PITCH_P     3.0
-#define FC_HORZ_PITCH_I     0.0
-#define FC_HORZ_PITCH_D     0.0
-#define FC_HORZ_PITCH_I_MAX 1.0
-
-#define FC_HORZ_YAW_P       0.5
-#define FC_HORZ_YAW_I       0.0
-#define FC_HORZ_YAW_D       0.0
-#define FC_HORZ_YAW_I_MAX   1.0
-
-// ********** Vertical Flight PID Gains ********** //
-// NOTE: vertical roll == horizontal yaw
-//       vertical yaw == horizontal roll
-#define FC_VERT_ROLL_P      0.1
-#define FC_VERT_ROLL_I      0.1 // was 0.0
-#define FC_VERT_ROLL_D      0.5
-#define FC_VERT_ROLL_I_MAX  5.0 // was 1.0
-
-#define FC_VERT_PITCH_P     3.0
-#define FC_VERT_PITCH_I     0.0
-#define FC_VERT_PITCH_D     0.2
-#define FC_VERT_PITCH_I_MAX 1.0
-
-#define FC_VERT_YAW_P       3.0
-#define FC_VERT_YAW_I       0.0
-#define FC_VERT_YAW_D       0.3 // was 0.2
-#define FC_VERT_YAW_I_MAX   1.0
+// ********** PID Gains ********** //
+// PID gains are scheduled over tstate from the breakpoints in
+// gain_schedule.txt, tabulated at build time by gain_schedule.py
 
 // ********** Control Map/Mix Gains ********** //
 #define FC_YAW_DIFFERENTIAL 0.2
@@ -118,6 +99,10 @@ typedef struct {
 
     quaternion_t orientation;
     float alt;
+
+    vector_t rates; // calibrated gyro rates, units: degrees per second
+
+    float noise_hz; // strongest gyro vibration peak, 0 if none
 } Fc_Input;
 
 typedef struct {
@@ -127,6 +112,19 @@ typedef struct {
     float yaw;
 } Fc_Pid_Output;
 
+typedef struct {
+    float p;
+    float i;
+    float d;
+    float i_max;
+} Fc_Pid_Gains;
+
+typedef struct {
+    Fc_Pid_Gains roll;
+    Fc_Pid_Gains pitch;
+    Fc_Pid_Gains yaw;
+} Fc_Gains;
+
 typedef struct {
     float thro;
     float roll;
@@ -157,26 +155,69 @@ typedef struct {
     float target_pitch;
     float target_yaw;
 
+    // only used with FC_CASCADED, units: degrees per second
+    float roll_rate;
+    float pitch_rate;
+    float yaw_rate;
+
+    float target_roll_rate;
+    float target_pitch_rate;
+    float target_yaw_rate;
+
     // number between 0 and 90 inclusive
     // 0 - in horizontal flight mode
     // 90 - in vertical flight mode
     // other values indicate transition between flight modes
-    // corresponds to pitch offset from horizontal
-    int8_t tstate;
+    // corresponds to pitch offset from horizontal, units: degrees
+    // changes at most FC_TSTATE_RATE_VERT or FC_TSTATE_RATE_HORZ
+    float tstate;
+
+    // pid gains indexed by tstate, FC_MAX_TSTATE + 1 entries each. Set by
+    // fc_init() to the tables generated from gain_schedule.txt, the rate table
+    // is only used with FC_CASCADED. The gains are read on every call, so
+    // these may be pointed at other tables after fc_init(), as the tuner on
+    // the host does.
+    const Fc_Gains *gain_schedule;
+    const Fc_Gains *rate_gain_schedule;
 
     pid_inst_t pid_roll;
     pid_inst_t pid_pitch;
     pid_inst_t pid_yaw;
 
+    // input after failsafes, kept for fc_calc_rate()
+    Fc_Input ctrl_input;
+
+    pid_inst_t pid_roll_rate;
+    pid_inst_t pid_pitch_rate;
+    pid_inst_t pid_yaw_rate;
+
+    // set once fc_calc_rate() runs the rate loop, fc_calc() then only mixes
+    bool rate_loop_external;
+
     Fc_Pid_Output pid_out;
 
     Fc_Output output;
 
     bool waiting;
+
+    // set by fc_init(), the first fc_calc() then starts from the attitude
+    bool start;
 } Fc_State;
 
-const Fc_Output *fc_calc(const Fc_Input* input, Fc_Flags flags);
-const Fc_State *fc_get_state(void);
+// Each instance is a separate controller. Nothing is shared between
+// instances, so they can run side by side, one thread per instance.
+void fc_init(Fc_State *fc);
+
+// dt_us is the time since the last call, measured once per tick by the caller
+const Fc_Output *fc_calc(Fc_State *fc, const Fc_Input* input, Fc_Flags flags, uint32_t dt_us);
+
+#ifdef FC_CASCADED
+// Runs the inner rate loop on new gyro rates, towards the rate targets set by
+// the last fc_calc(). Outputs are unchanged in manual control. Once called,
+// fc_calc() leaves the rate loop to this function.
+// units: degrees per second, dt_us is the time since the last call
+const Fc_Output *fc_calc_rate(Fc_State *fc, const vector_t *rates, uint32_t dt_us);
+#endif // FC_CASCADED
 
 #ifdef __cplusplus
 }
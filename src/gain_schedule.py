@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+
+# A script for generating the gain_schedule.h header file from the gain
+# schedule breakpoints, run by the build. The input can hold several tables,
+# each starting with a [name] line. Breakpoints before the first [name] line
+# belong to DEFAULT_TABLE.
+
+from sys import argv
+from math import sin, cos, pi
+
+USAGE = f'usage: {argv[0]} <input file> <output file>'
+MIN_TSTATE = 0
+MAX_TSTATE = 90
+NUM_GAINS = 12
+INDEX_TSTATE = 0
+INDEX_ROLL = 1
+INDEX_PITCH = 5
+INDEX_YAW = 9
+DEFAULT_TABLE = 'fc_gain_schedule'
+
+RADIANS_PER_DEGREE = pi / 180
+
+GAIN_SCHEDULE_H_PRE = f'''#ifndef __GAIN_SCHEDULE_H__
+#define __GAIN_SCHEDULE_H__
+
+// file generated by {argv[0]}
+
+#include "flight_controller.h"
+
+#if FC_MIN_TSTATE != {MIN_TSTATE} || FC_MAX_TSTATE != {MAX_TSTATE}
+#error "gain schedule generated for a different tstate range"
+#endif
+
+'''
+
+GAIN_SCHEDULE_H_POST = '''
+#endif // __GAIN_SCHEDULE_H__
+'''
+
+def check_args() -> None:
+    if len(argv) != 3:
+        exit(USAGE)
+
+def interpolate(val:float, a:float, b:float, x:float, y:float) -> float:
+    return (((val - a) / (b - a)) * (y - x)) + x
+
+def read_tables() -> dict:
+    with open(argv[1], 'r') as f:
+        lines = f.read().splitlines()
+
+    tables = {}
+    name = DEFAULT_TABLE
+    points = []
+    for count, line in enumerate(lines, 1):
+        line = line.split('#')[0].strip()
+        if not line:
+            continue
+        if line.startswith('['):
+            if points:
+                tables[name] = check_breakpoints(name, points)
+            name = line.strip('[]').strip()
+            if not name.isidentifier() or name in tables:
+                exit(f'error: invalid table name (line {count})')
+            points = []
+            continue
+        point = [ float(elem) for elem in line.split() ]
+        if len(point) != NUM_GAINS + 1:
+            exit(f'error: expected {NUM_GAINS + 1} values (line {count})')
+        if point[INDEX_TSTATE] % 1:
+            exit(f'error: invalid tstate (line {count})')
+        if points and point[INDEX_TSTATE] <= points[-1][INDEX_TSTATE]:
+            exit(f'error: tstate must be increasing (line {count})')
+        points.append(point)
+
+    tables[name] = check_breakpoints(name, points)
+    return tables
+
+def check_breakpoints(name:str, points:list) -> list:
+    if not points or points[0][INDEX_TSTATE] != MIN_TSTATE:
+        exit(f'error: first breakpoint of {name} must be at tstate {MIN_TSTATE}')
+    if points[-1][INDEX_TSTATE] != MAX_TSTATE:
+        exit(f'error: last breakpoint of {name} must be at tstate {MAX_TSTATE}')
+    return points
+
+def get_gains(points:list, tstate:int) -> list:
+    for first, second in zip(points, points[1:]):
+        if tstate <= second[INDEX_TSTATE]:
+            return [
+                interpolate(tstate, first[INDEX_TSTATE], second[INDEX_TSTATE], x, y)
+                for x, y in zip(first[1:], second[1:])
+            ]
+
+def write_pid_gains(f, gains:list) -> None:
+    f.write('{ ' + ', '.join(f'{gain:.6f}f' for gain in gains) + ' }')
+
+def write_table(f, name:str, points:list) -> None:
+    f.write('// pid gains indexed by tstate\n')
+    f.write(f'static const Fc_Gains {name}[FC_MAX_TSTATE + 1] = {{\n')
+    for tstate in range(MIN_TSTATE, MAX_TSTATE + 1):
+        gains = get_gains(points, tstate)
+        f.write('    { ')
+        write_pid_gains(f, gains[INDEX_ROLL-1:INDEX_PITCH-1])
+        f.write(', ')
+        write_pid_gains(f, gains[INDEX_PITCH-1:INDEX_YAW-1])
+        f.write(', ')
+        write_pid_gains(f, gains[INDEX_YAW-1:])
+        f.write(' }' + (',\n' if tstate < MAX_TSTATE else '\n'))
+    f.write('};\n\n')
+
+def gen_schedule() -> None:
+    tables = read_tables()
+
+    with open(argv[2], 'w') as f:
+        f.write(GAIN_SCHEDULE_H_PRE)
+
+        for name, points in tables.items():
+            write_table(f, name, points)
+
+        # rotation about the pitch axis by -tstate, which takes the
+        # orientation from the vertical reference back to horizontal
+        f.write('// pitch compensation quaternions indexed by tstate\n')
+        f.write('static const quaternion_t fc_tstate_rotation[FC_MAX_TSTATE + 1] = {\n')
+        for tstate in range(MIN_TSTATE, MAX_TSTATE + 1):
+            half = -tstate * RADIANS_PER_DEGREE * 0.5
+            f.write(f'    {{ {cos(half):.8f}f, 0.0f, {sin(half):.8f}f, 0.0f }}')
+            f.write(',\n' if tstate < MAX_TSTATE else '\n')
+        f.write('};\n')
+
+        f.write(GAIN_SCHEDULE_H_POST)
+
+def main() -> None:
+    check_args()
+    gen_schedule()
+
+if __name__ == '__main__':
+    main()
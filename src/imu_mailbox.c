@@ -0,0 +1,48 @@
+#include "imu_mailbox.h"
+
+#include "hardware/sync.h"
+
+void imu_mailbox_init(Imu_Mailbox *box) {
+    box->slot[0] = 0;
+    box->slot[1] = 0;
+    box->latest = 0;
+    box->reading = 0;
+
+    Imu_Sample empty = {
+        .orientation = { .w = 1, .x = 0, .y = 0, .z = 0 },
+        .rates = { .x = 0, .y = 0, .z = 0 },
+        .time_us = 0,
+        .errors = 0
+    };
+
+    for (uint8_t pair = 0; pair < 2; ++pair) {
+        for (uint8_t index = 0; index < 2; ++index) {
+            box->data[pair][index] = empty;
+        }
+    }
+}
+
+void imu_mailbox_write(Imu_Mailbox *box, const Imu_Sample *sample) {
+    // write to the pair the reader is not using, in the slot that is not the
+    // most recent one of that pair
+    uint8_t pair = !box->reading;
+    uint8_t index = !box->slot[pair];
+
+    box->data[pair][index] = *sample;
+
+    // the sample must be visible to the other core before it is published
+    __dmb();
+    box->slot[pair] = index;
+    __dmb();
+    box->latest = pair;
+}
+
+void imu_mailbox_read(Imu_Mailbox *box, Imu_Sample *sample) {
+    uint8_t pair = box->latest;
+    box->reading = pair;
+    __dmb();
+    uint8_t index = box->slot[pair];
+    __dmb();
+
+    *sample = box->data[pair][index];
+}
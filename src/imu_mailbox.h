@@ -0,0 +1,45 @@
+#ifndef __IMU_MAILBOX_H__
+#define __IMU_MAILBOX_H__
+
+#include <3dmath.h>
+
+#include "pico/stdlib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+    quaternion_t orientation;
+    vector_t rates; // units: degrees per second
+    float noise_hz; // strongest gyro vibration peak, 0 if none
+
+    uint32_t time_us; // time the sample was published
+    uint32_t errors; // number of failed imu updates since boot
+} Imu_Sample;
+
+// Single-producer/single-consumer mailbox that always holds the most recent
+// sample. Implemented as Simpson's four-slot mechanism: neither the writer nor
+// the reader ever waits or retries, and only plain loads and stores are used,
+// which suits the cortex-m0+ since it has no exclusive access instructions.
+typedef struct {
+    Imu_Sample data[2][2];
+
+    volatile uint8_t slot[2];
+    volatile uint8_t latest;
+    volatile uint8_t reading;
+} Imu_Mailbox;
+
+void imu_mailbox_init(Imu_Mailbox *box);
+
+// Only call from the producing core
+void imu_mailbox_write(Imu_Mailbox *box, const Imu_Sample *sample);
+
+// Only call from the consuming core
+void imu_mailbox_read(Imu_Mailbox *box, Imu_Sample *sample);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __IMU_MAILBOX_H__
@@ -2,6 +2,27 @@
 
 static uint8_t buffer[FLASH_PAGE_SIZE];
 
+// four entries per flash page, see dump_logs.py
+_Static_assert(sizeof(Log_Data) == FLASH_PAGE_SIZE / 4, "Log_Data must fill a quarter page");
+
+// Flash can not be read while it is being programmed, so core1 must be paused
+// while core0 writes logs if it is executing from flash.
+static inline void flash_lockout_start(void) {
+#   ifdef DUAL_CORE
+        if (multicore_lockout_victim_is_initialized(1)) {
+            multicore_lockout_start_blocking();
+        }
+#   endif // DUAL_CORE
+}
+
+static inline void flash_lockout_end(void) {
+#   ifdef DUAL_CORE
+        if (multicore_lockout_victim_is_initialized(1)) {
+            multicore_lockout_end_blocking();
+        }
+#   endif // DUAL_CORE
+}
+
 static void print_state(const Fc_State* state) {
     printf("log: ");
 #   ifdef PRINT_INPUTS
@@ -51,19 +72,24 @@ static void print_state(const Fc_State* state) {
         printf("%d ", state->flight_mode);
 #   endif // PRINT_FLIGHT_MODE
 #   ifdef PRINT_TSTATE
-        printf("%d ", state->tstate);
+        printf("%.1f ", state->tstate);
 #   endif // PRINT_TSTATE
 #   ifdef PRINT_FLAGS
         printf("%d ", state->flags);
 #   endif // PRINT_FLAGS
+#   ifdef PRINT_NOISE
+        printf("%f ", state->input.noise_hz);
+#   endif // PRINT_NOISE
     printf("\n");
 }
 
 void init_logging(void) {
     // clear flash contents
+    flash_lockout_start();
     uint32_t ints = save_and_disable_interrupts();
     flash_range_erase(LOG_FLASH_START, LOG_FLASH_SIZE_BYTES);
     restore_interrupts(ints);
+    flash_lockout_end();
 
 #   if LOG_FLASH_START % FLASH_SECTOR_SIZE
 #       error "start of flash log not aligned with flash sector"
@@ -74,12 +100,10 @@ void init_logging(void) {
 #   endif
 }
 
-void do_logging(void) {
+void do_logging(const Fc_State *state) {
     static uint32_t flash_offset = LOG_FLASH_START;
     static uint8_t loop_counter = 0;
 
-    const Fc_State *state = fc_get_state();
-
 #   ifdef DO_USB_LOGGING
         print_state(state);
 #   endif
@@ -113,15 +137,26 @@ void do_logging(void) {
 
     log_data.ctrl_mode = (uint8_t) state->ctrl_mode;
     log_data.flight_mode = (uint8_t) state->flight_mode;
-    log_data.tstate = (uint8_t) state->tstate;
+    log_data.tstate = (uint8_t) (state->tstate + 0.5f);
     log_data.flags = (uint8_t) state->flags;
 
+    float noise_peak = state->input.noise_hz / 2 + 0.5f;
+    log_data.noise_peak = noise_peak > UINT8_MAX ? UINT8_MAX : (uint8_t) noise_peak;
+
+    // The whole page is programmed every time, and programming can only clear
+    // bits. Entries not written yet must stay erased, not hold the last page.
+    if (loop_counter == 0) {
+        memset(buffer, 0xFF, sizeof(buffer));
+    }
+
     uint8_t offset = loop_counter * sizeof(Log_Data);
     memcpy(buffer + offset, &log_data, sizeof(Log_Data));
 
+    flash_lockout_start();
     uint32_t ints = save_and_disable_interrupts();
     flash_range_program(flash_offset, buffer, FLASH_PAGE_SIZE);
     restore_interrupts(ints);
+    flash_lockout_end();
 
     if (loop_counter == 3) {
         flash_offset += FLASH_PAGE_SIZE;
@@ -136,7 +171,7 @@ void do_logging(void) {
 void dump_logs(void) {
     const Log_Data *flash = (const Log_Data *)(XIP_BASE + LOG_FLASH_START);
 
-    while ((uint32_t)(flash) - XIP_BASE < PICO_FLASH_SIZE_BYTES) {
+    while ((uintptr_t)(flash) - XIP_BASE < PICO_FLASH_SIZE_BYTES) {
         printf("%d, %d, %d, %d, %d, %d, ",
             flash->input_thro,
             flash->input_aile,
@@ -167,11 +202,12 @@ void dump_logs(void) {
             flash->output_left_motor,
             flash->output_gear
         );
-        printf("%d, %d, %d, %d\n",
+        printf("%d, %d, %d, %d, %d\n",
             flash->ctrl_mode,
             flash->flight_mode,
             flash->tstate,
-            flash->flags
+            flash->flags,
+            flash->noise_peak * 2
         );
 
         ++flash;
@@ -5,9 +5,11 @@
 #include <string.h>
 
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
 
+#include "constants.h"
 #include "flight_controller.h"
 
 #define PRINT_INPUTS
@@ -19,6 +21,7 @@
 #define PRINT_FLIGHT_MODE
 #define PRINT_TSTATE
 #define PRINT_FLAGS
+#define PRINT_NOISE
 
 // must be greater than the program size
 #define LOG_FLASH_START 128 * 1024 // units: bytes
@@ -58,10 +61,11 @@ typedef struct {
     uint8_t flight_mode;
     uint8_t tstate;
     uint8_t flags;
+    uint8_t noise_peak; // strongest gyro vibration peak, units: 2 Hz
 } Log_Data;
 
 void init_logging(void);
-void do_logging(void);
+void do_logging(const Fc_State *state);
 void dump_logs(void);
 
 #ifdef __cplusplus
@@ -76,7 +80,8 @@ void dump_logs(void);
     defined(PRINT_CTRL_MODE) || \
     defined(PRINT_FLIGHT_MODE) || \
     defined(PRINT_TSTATE) || \
-    defined(PRINT_FLAGS)
+    defined(PRINT_FLAGS) || \
+    defined(PRINT_NOISE)
 #       define DO_USB_LOGGING
 #endif
 
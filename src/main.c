@@ -2,33 +2,103 @@
 #include <ar610.h>
 
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
 
 #include "constants.h"
+#include "dyn_notch.h"
 #include "flight_controller.h"
+#include "imu_mailbox.h"
 #include "logging.h"
+#include "profiler.h"
 #include "pwm.h"
 #include "reboot.h"
+#include "scheduler.h"
 
 #include <stdio.h>
 
-typedef enum {
-    RUN_BMP_REQ = 0,
-    RUN_AR_GET = 1,
-    RUN_BMP_GET = 2,
-    RUN_FC_CALC = 3,
-    RUN_SERV_SET = 4
-} Loop_State;
+// rate gyro samples reach the mpu6050 gyro filter
+#if defined(MPU6050_FIFO) || defined(MPU6050_DATA_READY)
+#   define GYRO_SAMPLE_HZ (1000000.0f / MPU6050_SAMPLE_PERIOD_US)
+#else
+#   define GYRO_SAMPLE_HZ (1000000.0f / IMU_PERIOD_US)
+#endif
+
+// with the cascaded controller, outputs follow the inner rate loop
+#ifdef FC_CASCADED
+#   define SERV_PERIOD_US IMU_PERIOD_US
+#else
+#   define SERV_PERIOD_US FC_PERIOD_US
+#endif
+
+typedef struct {
+    mpu6050_inst_t *mpu;
+    ar610_inst_t *ar;
+
+    Fc_State *fc;
+    Fc_Flags flags;
+    Fc_Input input;
+    Fc_Output output;
+} Loop_Context;
 
 static int hardware_init(i2c_inst_t* i2c, mpu6050_inst_t* mpu, ar610_inst_t* ar);
 
-static void loop(mpu6050_inst_t *mpu, ar610_inst_t *ar);
-static void run_bmp_req();
-static Fc_Input run_ar_get(mpu6050_inst_t *mpu, ar610_inst_t *ar, Fc_Flags *flags);
-static void run_bmp_get();
-static Fc_Output run_fc_calc(const Fc_Input *input, Fc_Flags *flags);
-static void run_serv_set(const Fc_Output *output);
+static void loop(Sched_Inst *sched, Loop_Context *ctx);
+static void handle_usb_command(Sched_Inst *sched);
+#ifndef DUAL_CORE
+static void run_imu_update(void *context, const Sched_Time *time);
+#endif
+static void run_bmp_req(void *context, const Sched_Time *time);
+static void run_ar_get(void *context, const Sched_Time *time);
+static void run_bmp_get(void *context, const Sched_Time *time);
+static void run_fc_calc(void *context, const Sched_Time *time);
+#ifdef FC_CASCADED
+static void run_fc_rate(void *context, const Sched_Time *time);
+#endif
+static void run_serv_set(void *context, const Sched_Time *time);
+static void run_logging(void *context, const Sched_Time *time);
+#if !defined(DUAL_CORE) && defined(DYN_NOTCH)
+static void run_dyn_notch(void *context, const Sched_Time *time);
+#endif
+
+// Tasks due in the same tick run in table order
+static Sched_Task loop_tasks[] = {
+//    name         period_us      phase_us  deadline_us      run
+#   ifndef DUAL_CORE
+    { "imu",       IMU_PERIOD_US, 0,        IMU_PERIOD_US,   run_imu_update },
+#   ifdef DYN_NOTCH
+    { "dyn_notch", IMU_PERIOD_US, 0,        IMU_PERIOD_US,   run_dyn_notch },
+#   endif // DYN_NOTCH
+#   endif // DUAL_CORE
+#   ifdef FC_CASCADED
+    { "fc_rate",   IMU_PERIOD_US, 0,        IMU_PERIOD_US,   run_fc_rate },
+#   endif // FC_CASCADED
+    { "ar_get",    RX_PERIOD_US,  1000,     LOOP_PERIOD_US,  run_ar_get },
+    { "bmp_req",   BMP_PERIOD_US, 2000,     LOOP_PERIOD_US,  run_bmp_req },
+    { "fc_calc",   FC_PERIOD_US,  3000,     LOOP_PERIOD_US,  run_fc_calc },
+    { "serv_set",  SERV_PERIOD_US, 3000,    LOOP_PERIOD_US,  run_serv_set },
+    { "logging",   LOG_PERIOD_US, 4000,     LOG_PERIOD_US,   run_logging },
+    { "bmp_get",   BMP_PERIOD_US, 12000,    LOOP_PERIOD_US,  run_bmp_get },
+};
+
+// the one flight controller instance, kept off the small core0 stack
+static Fc_State fc_state;
+
+#ifdef DYN_NOTCH
+static Dyn_Notch dyn_notch;
+
+static void apply_dyn_notch(void *context, vector_t *rates) {
+    dyn_notch_apply(context, rates);
+}
+#endif // DYN_NOTCH
+
+#ifdef DUAL_CORE
+static Imu_Mailbox imu_mailbox;
+static mpu6050_inst_t *core1_mpu;
+
+static void core1_main(void);
+#endif // DUAL_CORE
 
 int main() {
     // ESC pins must be configured immediately.
@@ -59,8 +129,25 @@ int main() {
             if (err) {
                 reboot();
             }
+
+            fc_init(&fc_state);
+
+            Loop_Context ctx = {
+                .mpu = &mpu,
+                .ar = &ar610,
+                .fc = &fc_state,
+                .flags = 0
+            };
+
+            Sched_Inst sched;
+            sched_init(&sched,
+                loop_tasks, sizeof(loop_tasks) / sizeof(loop_tasks[0]),
+                LOOP_PERIOD_US, &ctx
+            );
+
+            sched_start(&sched);
             for (;;) {
-                loop(&mpu, &ar610);
+                loop(&sched, &ctx);
             }
         } else {
             printf("error: unrecognized command\n");
@@ -71,6 +158,10 @@ int main() {
 }
 
 int hardware_init(i2c_inst_t* i2c, mpu6050_inst_t* mpu, ar610_inst_t* ar) {
+#   ifdef PROFILE_LOOP
+        profiler_init();
+#   endif // PROFILE_LOOP
+
     // Initialize status led
     gpio_init(STATUS_LED_PIN);
     gpio_set_dir(STATUS_LED_PIN, GPIO_OUT);
@@ -109,47 +200,222 @@ int hardware_init(i2c_inst_t* i2c, mpu6050_inst_t* mpu, ar610_inst_t* ar) {
         return 1;
     }
 
+#   ifdef DYN_NOTCH
+        // every gyro sample is analyzed and notched before it is integrated
+        dyn_notch_init(&dyn_notch, GYRO_SAMPLE_HZ);
+        mpu6050_set_gyro_filter(mpu, apply_dyn_notch, &dyn_notch);
+#   endif // DYN_NOTCH
+
+#   ifdef DUAL_CORE
+        // core1 owns the imu from here on
+        printf("info: starting imu on core1 ...\n");
+        imu_mailbox_init(&imu_mailbox);
+        core1_mpu = mpu;
+        multicore_launch_core1(core1_main);
+#   else
+        // core0 reads the imu in the background while other tasks run
+        mpu6050_init_dma(mpu);
+#       ifdef MPU6050_DATA_READY
+            if (mpu6050_init_data_ready(mpu, MPU6050_INT_PIN)) {
+                printf("error: failed to enable imu data ready interrupt\n");
+                return 1;
+            }
+#       endif // MPU6050_DATA_READY
+#   endif // DUAL_CORE
+
     return 0;
 }
 
-void run_bmp_req() {
+#ifdef DUAL_CORE
+// Runs on core1. Updates the imu at a fixed rate and publishes the attitude
+// so that logging and usb stalls on core0 do not delay gyro integration.
+void core1_main(void) {
+    mpu6050_inst_t *mpu = core1_mpu;
+
+    // allow core0 to pause this core while it writes to flash
+    multicore_lockout_victim_init();
+
+#   ifdef PROFILE_LOOP
+        profiler_init();
+#   endif // PROFILE_LOOP
+
+    Imu_Sample sample;
+    sample.errors = 0;
+
+#   ifdef MPU6050_DATA_READY
+        mpu6050_init_dma(mpu);
+        if (mpu6050_init_data_ready(mpu, MPU6050_INT_PIN)) {
+            ++sample.errors;
+        }
+#   else
+        absolute_time_t time = get_absolute_time();
+#   endif // MPU6050_DATA_READY
+
+    for (;;) {
+#       ifdef MPU6050_DATA_READY
+            // the sensor paces this core, its interrupt starts each read
+            int imu_error;
+            do {
+                imu_error = mpu6050_finish_update(mpu);
+            } while (imu_error == MPU6050_UPDATE_PENDING);
+
+            if (imu_error) {
+                ++sample.errors;
+            }
+#       else
+            time = delayed_by_us(time, IMU_PERIOD_US);
+
+            // resynchronize if this core fell behind, e.g. after a flash lockout
+            absolute_time_t now = get_absolute_time();
+            if (absolute_time_diff_us(now, time) < 0) {
+                time = now;
+            }
+            busy_wait_until(time);
+
+            PROFILE_BEGIN(PROF_IMU);
+            if (mpu6050_update_state_at(mpu, time)) {
+                ++sample.errors;
+            }
+            PROFILE_END(PROF_IMU);
+#       endif // MPU6050_DATA_READY
+
+#       ifdef DYN_NOTCH
+            // one step of the spectral analysis per sample period
+            PROFILE_BEGIN(PROF_DYN_NOTCH);
+            dyn_notch_update(&dyn_notch);
+            PROFILE_END(PROF_DYN_NOTCH);
+            sample.noise_hz = dyn_notch_get_peak_hz(&dyn_notch);
+#       else
+            sample.noise_hz = 0;
+#       endif // DYN_NOTCH
+
+        sample.orientation = mpu6050_get_quaternion(mpu);
+        sample.rates = mpu6050_get_rates(mpu);
+        sample.time_us = time_us_32();
+
+        imu_mailbox_write(&imu_mailbox, &sample);
+    }
+}
+#endif // DUAL_CORE
+
+#ifndef DUAL_CORE
+void run_imu_update(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
+
+    // complete the read started last tick, then start the next one. The
+    // bus transfer overlaps with the other tasks instead of blocking the cpu.
+    PROFILE_BEGIN(PROF_IMU);
+    int imu_error = mpu6050_finish_update(ctx->mpu);
+    if (imu_error != MPU6050_UPDATE_PENDING) {
+        int start_error = mpu6050_start_update_at(ctx->mpu, time->now);
+        if (start_error) {
+            imu_error = start_error;
+        }
+    }
+    PROFILE_END(PROF_IMU);
+
+    // samples lost to a fifo overflow leave a gap in the integrated attitude
+    if (imu_error == 1 || imu_error == MPU6050_FIFO_OVERFLOW) {
+        ctx->flags |= FC_IMU_FAILED;
+    }
+}
+#endif // DUAL_CORE
+
+#if !defined(DUAL_CORE) && defined(DYN_NOTCH)
+void run_dyn_notch(void *context, const Sched_Time *time) {
+    // one step of the spectral analysis per sample period
+    PROFILE_BEGIN(PROF_DYN_NOTCH);
+    dyn_notch_update(&dyn_notch);
+    PROFILE_END(PROF_DYN_NOTCH);
+}
+#endif // !DUAL_CORE && DYN_NOTCH
+
+void run_bmp_req(void *context, const Sched_Time *time) {
     return;
 }
 
-Fc_Input run_ar_get(mpu6050_inst_t *mpu, ar610_inst_t *ar, Fc_Flags *flags) {
-    Fc_Input input;
+void run_ar_get(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
+    ar610_inst_t *ar = ctx->ar;
+
+    PROFILE_BEGIN(PROF_AR_GET);
 
     ar610_update_state(ar);
 
     if (!ar610_is_connected(ar)) {
-        *flags |= FC_RX_FAILED;
+        ctx->flags |= FC_RX_FAILED;
     }
 
-    input.thro = ar610_get_thro(ar);
-    input.elev = ar610_get_elev(ar);
-    input.aile = ar610_get_aile(ar);
-    input.rudd = ar610_get_rudd(ar);
-    input.gear = ar610_get_gear(ar);
-    input.aux1 = ar610_get_aux1(ar);
-
-    input.orientation = mpu6050_get_quaternion(mpu);
+    ctx->input.thro = ar610_get_thro(ar);
+    ctx->input.elev = ar610_get_elev(ar);
+    ctx->input.aile = ar610_get_aile(ar);
+    ctx->input.rudd = ar610_get_rudd(ar);
+    ctx->input.gear = ar610_get_gear(ar);
+    ctx->input.aux1 = ar610_get_aux1(ar);
 
-    return input;
+    PROFILE_END(PROF_AR_GET);
 }
 
-void run_bmp_get() {
+void run_bmp_get(void *context, const Sched_Time *time) {
     return;
 }
 
-Fc_Output run_fc_calc(const Fc_Input *input, Fc_Flags *flags) {
-    const Fc_Output *output;
-    output = fc_calc(input, *flags);
-    *flags = 0;
-    return *output;
+static void run_imu_get(Loop_Context *ctx) {
+#   ifdef DUAL_CORE
+        static uint32_t imu_errors = 0;
+
+        Imu_Sample sample;
+        imu_mailbox_read(&imu_mailbox, &sample);
+
+        if (sample.errors != imu_errors) {
+            imu_errors = sample.errors;
+            ctx->flags |= FC_IMU_FAILED;
+        }
+
+        ctx->input.orientation = sample.orientation;
+        ctx->input.rates = sample.rates;
+        ctx->input.noise_hz = sample.noise_hz;
+#   else
+        ctx->input.orientation = mpu6050_get_quaternion(ctx->mpu);
+        ctx->input.rates = mpu6050_get_rates(ctx->mpu);
+#       ifdef DYN_NOTCH
+            ctx->input.noise_hz = dyn_notch_get_peak_hz(&dyn_notch);
+#       endif // DYN_NOTCH
+#   endif // DUAL_CORE
+}
+
+void run_fc_calc(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
+
+    run_imu_get(ctx);
+
+    PROFILE_BEGIN(PROF_FC_CALC);
+    ctx->output = *fc_calc(ctx->fc, &ctx->input, ctx->flags, time->dt_us);
+    PROFILE_END(PROF_FC_CALC);
+
+    ctx->flags = 0;
 }
 
-void run_serv_set(const Fc_Output *output) {
-    const Fc_State *state = fc_get_state();
+#ifdef FC_CASCADED
+// Runs the inner rate loop on the newest gyro rates, between runs of fc_calc
+void run_fc_rate(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
+
+    run_imu_get(ctx);
+
+    PROFILE_BEGIN(PROF_FC_RATE);
+    ctx->output = *fc_calc_rate(ctx->fc, &ctx->input.rates, time->dt_us);
+    PROFILE_END(PROF_FC_RATE);
+}
+#endif // FC_CASCADED
+
+void run_serv_set(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
+    const Fc_Output *output = &ctx->output;
+
+    PROFILE_BEGIN(PROF_SERV_SET);
+
+    const Fc_State *state = ctx->fc;
     if (state->waiting || (state->flight_mode == FC_FMODE_DISABLED)) {
         pwm_disable_all_outputs();
     } else {
@@ -158,73 +424,44 @@ void run_serv_set(const Fc_Output *output) {
         pwm_set_right_motor(output->right_motor);
         pwm_set_left_motor(output->left_motor);
     }
-    do_logging();
-}
-
-void loop(mpu6050_inst_t *mpu, ar610_inst_t *ar) {
-    static Loop_State loop_state = RUN_BMP_GET;
 
-    static Fc_Flags fc_flags = 0;
-    static Fc_Input fc_input;
-    static Fc_Output fc_output;
+    PROFILE_END(PROF_SERV_SET);
+}
 
-    static absolute_time_t time = { 0 };
+void run_logging(void *context, const Sched_Time *time) {
+    Loop_Context *ctx = context;
 
-    int32_t diff_us;
-    if (to_us_since_boot(time) == 0) { // takes if first call
-        diff_us = LOOP_PERIOD_US - (2 * USB_TIMEOUT_PADDING_US);
-    } else {
-        diff_us = absolute_time_diff_us(time, get_absolute_time());
-    }
-
-    int32_t timeout_us = LOOP_PERIOD_US - diff_us - USB_TIMEOUT_PADDING_US;
-    if (timeout_us > 0) {
-        char ch = getchar_timeout_us(timeout_us);
-        if (ch == COMMAND_REBOOT) {
-            reboot();
-        } else if (ch == COMMAND_BOOTSEL) {
-            bootsel();
-        }
-    }
+    PROFILE_BEGIN(PROF_LOGGING);
+    do_logging(ctx->fc);
+    PROFILE_END(PROF_LOGGING);
+}
 
-    diff_us = absolute_time_diff_us(time, get_absolute_time());
-    if (diff_us < LOOP_PERIOD_US) {
-        while (diff_us < LOOP_PERIOD_US) {
-            diff_us = absolute_time_diff_us(time, get_absolute_time());
-        }
-    } else {
-        fc_flags |= FC_OVERRUN;
+void handle_usb_command(Sched_Inst *sched) {
+    int ch = getchar_timeout_us(0);
+    if (ch == COMMAND_REBOOT) {
+        reboot();
+    } else if (ch == COMMAND_BOOTSEL) {
+        bootsel();
+    } else if (ch == COMMAND_SCHED_STATS) {
+        sched_print_stats(sched);
+    } else if (ch == COMMAND_DUMP_PROFILE) {
+        profiler_print();
     }
-    time = get_absolute_time();
+}
 
-    int imu_error = mpu6050_update_state(mpu);
-    if (imu_error) {
-        fc_flags |= FC_IMU_FAILED;
-    }
+void loop(Sched_Inst *sched, Loop_Context *ctx) {
+    absolute_time_t release = sched_wait(sched);
 
-    if (fc_get_state()->flags) {
+    if (ctx->fc->flags) {
         gpio_put(STATUS_LED_PIN, true);
     } else {
         gpio_put(STATUS_LED_PIN, false);
     }
 
-    switch (loop_state) {
-    case RUN_BMP_REQ:
-        run_bmp_req();
-        break;
-    case RUN_AR_GET:
-        fc_input = run_ar_get(mpu, ar, &fc_flags);
-        break;
-    case RUN_BMP_GET:
-        run_bmp_get();
-        break;
-    case RUN_FC_CALC:
-        fc_output = run_fc_calc(&fc_input, &fc_flags);
-        break;
-    case RUN_SERV_SET:
-        run_serv_set(&fc_output);
-        break;
-    };
-
-    loop_state = (loop_state + 1) % 5;
+    if (sched_run(sched, release)) {
+        ctx->flags |= FC_OVERRUN;
+    }
+
+    // usb commands are handled off the critical path, after the tick's tasks
+    handle_usb_command(sched);
 }
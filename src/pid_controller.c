@@ -1,5 +1,80 @@
 #include "pid_controller.h"
 
+#if FIR_NUM_TAPS < 4
+#error "the default derivative filter needs at least 4 fir taps"
+#endif
+
+// default derivative filter, the remaining taps are zero
+static const float d_response[FIR_NUM_TAPS] = { 0.4, 0.3, 0.2, 0.1 };
+
+void pid_set_d_filter(pid_inst_t *pid, const filter_t *filter) {
+    pid->d_filter = *filter;
+}
+
+#ifdef PID_FIXED_POINT
+static q16_t constrain_q16(q16_t val, q16_t min, q16_t max) {
+    if (val > max) {
+        return max;
+    } else if (val < min) {
+        return min;
+    } else {
+        return val;
+    }
+}
+
+void pid_init(pid_inst_t *pid, float p, float i, float d, float i_max) {
+    pid_set_gains(pid, p, i, d, i_max);
+
+    pid->i_output = 0;
+    pid->prev_error = 0;
+
+    filter_init_fir(&pid->d_filter, d_response);
+
+    pid->start = 1;
+}
+
+void pid_set_gains(pid_inst_t *pid, float p, float i, float d, float i_max) {
+    pid->p = q16_from_float(p);
+    pid->i = q16_from_float(i);
+    pid->d = q16_from_float(d);
+    pid->i_max = q16_from_float(i_max);
+
+    // the only divide, done when the gains change instead of every update
+    pid->i_limit = (i != 0) ? q16_from_float(i_max / i) : 0;
+}
+
+float pid_calculate_dt(pid_inst_t *pid, float error_f, uint32_t dt_us) {
+    if (pid->start) {
+        pid->start = 0;
+        return 0;
+    } else {
+        int64_t t_delta_us = dt_us ? dt_us : 1;
+
+        q16_t error = q16_from_float(error_f);
+
+        int64_t output = q16_mul(pid->p, error);
+
+        // round the increment, truncation would bias the integral over time
+        int64_t i_delta = error * t_delta_us;
+        i_delta = (i_delta + (i_delta < 0 ? -500000 : 500000)) / 1000000;
+        pid->i_output = fix_saturate(pid->i_output + i_delta);
+        pid->i_output = constrain_q16(pid->i_output, -pid->i_limit, pid->i_limit);
+        output += constrain_q16(q16_mul(pid->i, pid->i_output), -pid->i_max, pid->i_max);
+
+        q16_t d_input = fix_saturate(
+            ((int64_t)(error - pid->prev_error) * 1000000) / t_delta_us
+        );
+        q16_t d_error = filter_apply_q16(&pid->d_filter, d_input);
+
+        output += q16_mul(pid->d, d_error);
+        pid->prev_error = error;
+
+        return q16_to_float(constrain_q16(fix_saturate(output),
+            -PID_MAX_OUTPUT * Q16_ONE, PID_MAX_OUTPUT * Q16_ONE
+        ));
+    }
+}
+#else
 static float constrain(float val, float min, float max) {
     if (val > max) {
         return max;
@@ -19,15 +94,7 @@ void pid_init(pid_inst_t *pid, float p, float i, float d, float i_max) {
     pid->i_output = 0;
     pid->prev_error = 0;
 
-    for (size_t i = 0; i < FIR_BUFFER_SIZE; ++i) {
-        pid->d_response[i] = 0;
-    }
-    pid->d_response[0] = 0.4;
-    pid->d_response[1] = 0.3;
-    pid->d_response[2] = 0.2;
-    pid->d_response[3] = 0.1;
-
-    fir_filter_init(&pid->d_filter, pid->d_response);
+    filter_init_fir(&pid->d_filter, d_response);
 
     pid->start = 1;
 }
@@ -39,16 +106,12 @@ void pid_set_gains(pid_inst_t *pid, float p, float i, float d, float i_max) {
     pid->i_max = i_max;
 }
 
-float pid_calculate(pid_inst_t *pid, float error) {
+float pid_calculate_dt(pid_inst_t *pid, float error, uint32_t dt_us) {
     if (pid->start) {
         pid->start = 0;
-        pid->time = get_absolute_time();
         return 0;
     } else {
-        int64_t t_delta_us = absolute_time_diff_us(pid->time, get_absolute_time());
-        pid->time = get_absolute_time();
-
-        float t_delta = (float)t_delta_us / 1000000.0f;
+        float t_delta = (float)(dt_us ? dt_us : 1) / 1000000.0f;
 
         float output = pid->p * error;
 
@@ -56,7 +119,7 @@ float pid_calculate(pid_inst_t *pid, float error) {
         pid->i_output = constrain(pid->i_output, (-1 * pid->i_max) / pid->i, pid->i_max / pid->i);
         output += constrain(pid->i * pid->i_output, -1 * pid->i_max, pid->i_max);
 
-        float d_error = fir_filter_calculate(&pid->d_filter,
+        float d_error = filter_apply(&pid->d_filter,
             (error - pid->prev_error) / t_delta
         );
 
@@ -66,3 +129,13 @@ float pid_calculate(pid_inst_t *pid, float error) {
         return constrain(output, -PID_MAX_OUTPUT, PID_MAX_OUTPUT);
     }
 }
+#endif // PID_FIXED_POINT
+
+float pid_calculate(pid_inst_t *pid, float error) {
+    // one timer read, shared by the previous and the next delta
+    absolute_time_t now = get_absolute_time();
+    uint32_t dt_us = pid->start ? 0 : (uint32_t)absolute_time_diff_us(pid->time, now);
+    pid->time = now;
+
+    return pid_calculate_dt(pid, error, dt_us);
+}
@@ -1,38 +1,61 @@
 #ifndef __PID_CONTROLLER_H__
 #define __PID_CONTROLLER_H__
 
+#include <fixmath.h>
+
 #include "pico/stdlib.h"
 #include "pico/time.h"
 
-#include "fir_filter.h"
+#include "filter.h"
 
 #define PID_MAX_OUTPUT 100
 
+// When defined, the controller state and gains are stored in Q15.16 fixed
+// point and the float interface is unchanged
+//#define PID_FIXED_POINT
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+#ifdef PID_FIXED_POINT
+typedef q16_t pid_real_t;
+#else
+typedef float pid_real_t;
+#endif // PID_FIXED_POINT
+
 typedef struct {
-    float p;
-    float i;
-    float d;
-    float i_max;
+    pid_real_t p;
+    pid_real_t i;
+    pid_real_t d;
+    pid_real_t i_max;
+#   ifdef PID_FIXED_POINT
+        pid_real_t i_limit; // i_max / i, the bound on i_output
+#   endif // PID_FIXED_POINT
 
-    float i_output;
-    float prev_error;
+    pid_real_t i_output;
+    pid_real_t prev_error;
 
     uint8_t start;
     absolute_time_t time;
 
-    float d_response[FIR_BUFFER_SIZE];
-
-    fir_inst_t d_filter;
+    filter_t d_filter;
 } pid_inst_t;
 
 void pid_init(pid_inst_t *pid, float p, float i, float d, float i_max);
 void pid_set_gains(pid_inst_t *pid, float p, float i, float d, float i_max);
+
+// replaces the default fir on the derivative, call after pid_init()
+void pid_set_d_filter(pid_inst_t *pid, const filter_t *filter);
+
+// measures the time since the last call with the system timer
 float pid_calculate(pid_inst_t *pid, float error);
 
+// same as pid_calculate() over dt_us microseconds measured by the caller, so
+// that every controller updated in a tick agrees on dt. The first call after
+// pid_init() only primes the derivative and returns 0.
+float pid_calculate_dt(pid_inst_t *pid, float error, uint32_t dt_us);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,85 @@
+#include "profiler.h"
+
+static const char *phase_names[PROF_NUM_PHASES] = {
+    "imu",
+    "ar_get",
+    "fc_calc",
+    "serv_set",
+    "logging",
+    "dyn_notch",
+    "fc_rate"
+};
+
+static Prof_Stats stats[PROF_NUM_PHASES];
+
+// returns the number of bits needed to represent val
+static inline uint8_t bit_length(uint32_t val) {
+    uint8_t bits = 0;
+    while (val) {
+        ++bits;
+        val >>= 1;
+    }
+    return bits;
+}
+
+void profiler_init(void) {
+    systick_hw->csr = 0;
+    systick_hw->rvr = PROFILER_COUNTER_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = M0PLUS_SYST_CSR_CLKSOURCE_BITS | M0PLUS_SYST_CSR_ENABLE_BITS;
+
+    for (size_t phase = 0; phase < PROF_NUM_PHASES; ++phase) {
+        stats[phase].min = UINT32_MAX;
+    }
+}
+
+void profiler_record(Prof_Phase phase, uint32_t start) {
+    // the counter counts down
+    uint32_t cycles = (start - profiler_now()) & PROFILER_COUNTER_MASK;
+
+    Prof_Stats *s = &stats[phase];
+
+    ++s->count;
+    s->sum += cycles;
+    if (cycles < s->min) {
+        s->min = cycles;
+    }
+    if (cycles > s->max) {
+        s->max = cycles;
+    }
+    ++s->histogram[bit_length(cycles)];
+}
+
+void profiler_print(void) {
+#   ifdef PROFILE_LOOP
+        printf("prof: clk_sys %lu Hz\n", (unsigned long)clock_get_hz(clk_sys));
+        printf("prof: phase count min max mean (cycles)\n");
+
+        for (size_t phase = 0; phase < PROF_NUM_PHASES; ++phase) {
+            const Prof_Stats *s = &stats[phase];
+            if (s->count == 0) {
+                continue;
+            }
+
+            printf("prof: %s %lu %lu %lu %lu\n",
+                phase_names[phase],
+                (unsigned long)s->count,
+                (unsigned long)s->min,
+                (unsigned long)s->max,
+                (unsigned long)(s->sum / s->count)
+            );
+
+            for (size_t bucket = 0; bucket < PROFILER_NUM_BUCKETS; ++bucket) {
+                if (s->histogram[bucket]) {
+                    printf("prof: %s < 2^%u: %lu\n",
+                        phase_names[phase],
+                        (unsigned)bucket,
+                        (unsigned long)s->histogram[bucket]
+                    );
+                }
+            }
+        }
+#   else
+        printf("prof: profiler disabled, define PROFILE_LOOP\n");
+#   endif // PROFILE_LOOP
+}
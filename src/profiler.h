@@ -0,0 +1,68 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+
+#include "constants.h"
+
+// SysTick is a 24 bit down counter clocked by clk_sys, so a single phase can
+// be measured for up to 2^24 cycles (134 ms at 125 MHz)
+#define PROFILER_COUNTER_MASK 0xFFFFFF
+#define PROFILER_NUM_BUCKETS 25 // one per bit of the counter, plus zero
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef enum {
+    PROF_IMU = 0,
+    PROF_AR_GET = 1,
+    PROF_FC_CALC = 2,
+    PROF_SERV_SET = 3,
+    PROF_LOGGING = 4,
+    PROF_DYN_NOTCH = 5,
+    PROF_FC_RATE = 6, // FC_CASCADED only
+    PROF_NUM_PHASES = 7
+} Prof_Phase;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+
+    // bucket n counts measurements of n bits, [2^(n-1), 2^n) cycles
+    uint32_t histogram[PROFILER_NUM_BUCKETS];
+} Prof_Stats;
+
+// Starts the cycle counter of the calling core. Call once on every core that
+// records a phase.
+void profiler_init(void);
+
+void profiler_record(Prof_Phase phase, uint32_t start);
+
+// Prints the statistics and histogram of every phase over usb
+void profiler_print(void);
+
+static inline uint32_t profiler_now(void) {
+    return systick_hw->cvr;
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+// The profiler compiles out completely when PROFILE_LOOP is not defined
+#ifdef PROFILE_LOOP
+#   define PROFILE_BEGIN(phase) uint32_t profile_##phase = profiler_now()
+#   define PROFILE_END(phase) profiler_record(phase, profile_##phase)
+#else
+#   define PROFILE_BEGIN(phase)
+#   define PROFILE_END(phase)
+#endif // PROFILE_LOOP
+
+#endif // __PROFILER_H__
@@ -0,0 +1,168 @@
+#include "scheduler.h"
+
+// Runs in the timer interrupt. Only releases the tick, the tasks run in
+// thread mode so that usb and flash interrupts are not blocked.
+static bool sched_timer_callback(repeating_timer_t *timer) {
+    Sched_Inst *sched = timer->user_data;
+    ++sched->released;
+    __sev();
+    return true;
+}
+
+void sched_init(Sched_Inst *sched, Sched_Task *tasks, size_t num_tasks,
+    uint32_t tick_us, void *context) {
+    sched->tasks = tasks;
+    sched->num_tasks = num_tasks;
+    sched->context = context;
+    sched->tick_us = tick_us;
+    sched->ticks = 0;
+    sched->released = 0;
+
+    sched->jitter.late_min_us = UINT32_MAX;
+    sched->jitter.late_max_us = 0;
+    sched->jitter.late_sum_us = 0;
+    sched->jitter.period_min_us = UINT32_MAX;
+    sched->jitter.period_max_us = 0;
+    sched->jitter.last_start_us = 0;
+
+    for (size_t i = 0; i < num_tasks; ++i) {
+        Sched_Task *task = &tasks[i];
+
+        task->countdown = task->phase_us / tick_us;
+        task->runs = 0;
+        task->misses = 0;
+        task->last_us = 0;
+        task->max_us = 0;
+        task->max_finish_us = 0;
+    }
+}
+
+void sched_start(Sched_Inst *sched) {
+    sched->release = get_absolute_time();
+    sched->start = sched->release;
+    ++sched->released;
+
+    // a negative delay keeps the period fixed regardless of callback latency
+    add_repeating_timer_us(-(int64_t)sched->tick_us,
+        sched_timer_callback, sched, &sched->timer
+    );
+}
+
+absolute_time_t sched_wait(Sched_Inst *sched) {
+    while (sched->released == sched->ticks) {
+        __wfe();
+    }
+
+    absolute_time_t release = sched->release;
+    sched->release = delayed_by_us(sched->release, sched->tick_us);
+
+    sched->start = get_absolute_time();
+
+    uint32_t start_us = (uint32_t)to_us_since_boot(sched->start);
+    uint32_t late_us = start_us - (uint32_t)to_us_since_boot(release);
+
+    Sched_Jitter *jitter = &sched->jitter;
+    if (late_us < jitter->late_min_us) {
+        jitter->late_min_us = late_us;
+    }
+    if (late_us > jitter->late_max_us) {
+        jitter->late_max_us = late_us;
+    }
+    jitter->late_sum_us += late_us;
+
+    if (sched->ticks) {
+        uint32_t period_us = start_us - jitter->last_start_us;
+        if (period_us < jitter->period_min_us) {
+            jitter->period_min_us = period_us;
+        }
+        if (period_us > jitter->period_max_us) {
+            jitter->period_max_us = period_us;
+        }
+    }
+    jitter->last_start_us = start_us;
+
+    return release;
+}
+
+bool sched_run(Sched_Inst *sched, absolute_time_t release) {
+    bool missed = false;
+
+    uint32_t release_us = (uint32_t)to_us_since_boot(release);
+
+    for (size_t i = 0; i < sched->num_tasks; ++i) {
+        Sched_Task *task = &sched->tasks[i];
+
+        if (task->countdown) {
+            --task->countdown;
+            continue;
+        }
+        task->countdown = (task->period_us / sched->tick_us) - 1;
+
+        Sched_Time time = {
+            .now = sched->start,
+            .dt_us = task->runs ?
+                (uint32_t)absolute_time_diff_us(task->last_run, sched->start) :
+                task->period_us
+        };
+        task->last_run = sched->start;
+
+        uint32_t start_us = time_us_32();
+        task->run(sched->context, &time);
+        uint32_t end_us = time_us_32();
+
+        uint32_t exec_us = end_us - start_us;
+        uint32_t finish_us = end_us - release_us;
+
+        ++task->runs;
+        task->last_us = exec_us;
+        if (exec_us > task->max_us) {
+            task->max_us = exec_us;
+        }
+        if (finish_us > task->max_finish_us) {
+            task->max_finish_us = finish_us;
+        }
+        if (finish_us > task->deadline_us) {
+            ++task->misses;
+            missed = true;
+        }
+    }
+
+    ++sched->ticks;
+
+    return missed;
+}
+
+void sched_print_stats(const Sched_Inst *sched) {
+    const Sched_Jitter *jitter = &sched->jitter;
+    uint32_t ticks = sched->ticks ? sched->ticks : 1;
+
+    printf("sched: %lu ticks of %lu us\n",
+        (unsigned long)sched->ticks,
+        (unsigned long)sched->tick_us
+    );
+    printf("sched: tick late min %lu max %lu mean %lu us\n",
+        (unsigned long)jitter->late_min_us,
+        (unsigned long)jitter->late_max_us,
+        (unsigned long)(jitter->late_sum_us / ticks)
+    );
+    printf("sched: tick period min %lu max %lu us\n",
+        (unsigned long)jitter->period_min_us,
+        (unsigned long)jitter->period_max_us
+    );
+    printf("sched: task period phase deadline runs misses last max finish\n");
+
+    for (size_t i = 0; i < sched->num_tasks; ++i) {
+        const Sched_Task *task = &sched->tasks[i];
+        printf("sched: %s %lu %lu %lu %lu %lu %lu %lu %lu\n",
+            task->name,
+            (unsigned long)task->period_us,
+            (unsigned long)task->phase_us,
+            (unsigned long)task->deadline_us,
+            (unsigned long)task->runs,
+            (unsigned long)task->misses,
+            (unsigned long)task->last_us,
+            (unsigned long)task->max_us,
+            (unsigned long)task->max_finish_us
+        );
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Time context of a task run. The tick start is read once per tick and shared
+// by every task in it, so all stages of a tick agree on the time.
+typedef struct {
+    absolute_time_t now; // start of the tick
+    uint32_t dt_us; // since the task last ran, its period on the first run
+} Sched_Time;
+
+typedef void (*Sched_Fn)(void *context, const Sched_Time *time);
+
+// A periodic task. Only the first block of members is set in the task table,
+// the accounting members are zeroed by sched_init().
+typedef struct {
+    const char *name;
+
+    uint32_t period_us; // must be a multiple of the scheduler tick
+    uint32_t phase_us; // release offset within the period, multiple of the tick
+    uint32_t deadline_us; // measured from the start of the tick it is released in
+
+    Sched_Fn run;
+
+    // ===== deadline accounting =====
+    uint32_t countdown; // ticks until the next release
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t last_us; // execution time of the last run
+    uint32_t max_us; // longest execution time
+    uint32_t max_finish_us; // latest completion relative to release
+    absolute_time_t last_run; // tick start of the last run
+} Sched_Task;
+
+// Tick start jitter: how late each tick started relative to its release time
+typedef struct {
+    uint32_t late_min_us;
+    uint32_t late_max_us;
+    uint64_t late_sum_us;
+
+    // time between the start of consecutive ticks
+    uint32_t period_min_us;
+    uint32_t period_max_us;
+
+    uint32_t last_start_us;
+} Sched_Jitter;
+
+typedef struct {
+    Sched_Task *tasks;
+    size_t num_tasks;
+
+    void *context; // passed to every task
+
+    uint32_t tick_us;
+    uint32_t ticks;
+
+    repeating_timer_t timer;
+    volatile uint32_t released; // ticks released by the timer
+    absolute_time_t release; // release time of the next tick to run
+    absolute_time_t start; // start time of the current tick
+
+    Sched_Jitter jitter;
+} Sched_Inst;
+
+// Tasks due in the same tick run in table order.
+void sched_init(Sched_Inst *sched, Sched_Task *tasks, size_t num_tasks,
+    uint32_t tick_us, void *context);
+
+// Starts the hardware timer that releases a tick every tick_us
+void sched_start(Sched_Inst *sched);
+
+// Sleeps until the timer releases the next tick and returns its release time.
+// If ticks were released while the previous tick ran, returns immediately so
+// that every task keeps its rate. Also records the tick start time passed to
+// the tasks.
+absolute_time_t sched_wait(Sched_Inst *sched);
+
+// Runs every task due in the current tick. release is the time the tick was
+// due to start. Returns true if any task finished after its deadline.
+bool sched_run(Sched_Inst *sched, absolute_time_t release);
+
+// Prints the tick jitter and the deadline accounting of every task over usb
+void sched_print_stats(const Sched_Inst *sched);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __SCHEDULER_H__
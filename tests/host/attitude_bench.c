@@ -0,0 +1,221 @@
+// Compares the cost and drift of the attitude filters against plain gyro
+// integration on a simulated flight with gyro bias, sensor noise and bursts
+// of linear acceleration. Fails if a filter does not bound the tilt error.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <3dmath.h>
+#include <attitude_filter.h>
+
+#define SAMPLE_RATE_HZ 1000
+#define SAMPLE_PERIOD_S (1.0 / SAMPLE_RATE_HZ)
+#define FLIGHT_TIME_S 120
+#define NUM_SAMPLES (FLIGHT_TIME_S * SAMPLE_RATE_HZ)
+
+// gyro bias left over after calibration, units: radians per second
+#define GYRO_BIAS_X 0.010
+#define GYRO_BIAS_Y -0.008
+#define GYRO_BIAS_Z 0.005
+
+#define GYRO_NOISE 0.002 // units: radians per second
+#define ACCEL_NOISE 0.02 // units: g
+
+// maximum tilt error at the end of the flight, units: degrees
+#define MAX_FINAL_TILT_ERROR 1.0
+
+typedef struct {
+    vector_t gyro;
+    vector_t accel;
+    vector_t gravity; // true direction of gravity in the sensor frame
+} Sample;
+
+typedef enum {
+    FILTER_GYRO,
+    FILTER_MAHONY,
+    FILTER_MADGWICK,
+    NUM_FILTERS
+} Filter;
+
+static const char *filter_names[NUM_FILTERS] = {
+    "gyro",
+    "mahony",
+    "madgwick"
+};
+
+static Sample samples[NUM_SAMPLES];
+
+// deterministic normally distributed noise
+static double noise(double sigma) {
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// rotates the level frame vector (0, 0, 1) into the frame of the sensor
+static vector_t gravity_in_sensor(double w, double x, double y, double z) {
+    vector_t v = {
+        .x = 2 * (x * z - w * y),
+        .y = 2 * (w * x + y * z),
+        .z = w * w - x * x - y * y + z * z
+    };
+    return v;
+}
+
+// integrates a true attitude in double precision and records what the sensor
+// would measure along the way
+static void generate_flight(void) {
+    double qw = cos(0.2), qx = sin(0.2), qy = 0, qz = 0;
+
+    srand(1);
+
+    for (int i = 0; i < NUM_SAMPLES; ++i) {
+        double t = i * SAMPLE_PERIOD_S;
+
+        double wx = 0.6 * sin(0.7 * t);
+        double wy = 0.5 * sin(0.5 * t + 1);
+        double wz = 0.4 * sin(0.3 * t);
+
+        vector_t g = gravity_in_sensor(qw, qx, qy, qz);
+
+        // a 2 second burst of 0.3g sideways acceleration every 20 seconds
+        double ax = fmod(t, 20) < 2 ? 0.3 : 0;
+
+        Sample *s = &samples[i];
+        s->gravity = g;
+        s->gyro.x = wx + GYRO_BIAS_X + noise(GYRO_NOISE);
+        s->gyro.y = wy + GYRO_BIAS_Y + noise(GYRO_NOISE);
+        s->gyro.z = wz + GYRO_BIAS_Z + noise(GYRO_NOISE);
+        s->accel.x = g.x + ax + noise(ACCEL_NOISE);
+        s->accel.y = g.y + noise(ACCEL_NOISE);
+        s->accel.z = g.z + noise(ACCEL_NOISE);
+
+        // exact rotation over the sample period
+        double w_norm = sqrt(wx * wx + wy * wy + wz * wz);
+        double a = 0.5 * w_norm * SAMPLE_PERIOD_S;
+        double c = cos(a);
+        double k = w_norm > 0 ? sin(a) / w_norm : 0;
+        double rw = c, rx = k * wx, ry = k * wy, rz = k * wz;
+
+        double nw = qw * rw - qx * rx - qy * ry - qz * rz;
+        double nx = qw * rx + qx * rw + qy * rz - qz * ry;
+        double ny = qw * ry - qx * rz + qy * rw + qz * rx;
+        double nz = qw * rz + qx * ry - qy * rx + qz * rw;
+
+        qw = nw;
+        qx = nx;
+        qy = ny;
+        qz = nz;
+    }
+}
+
+// the integrator used by mpu6050_rotate() without an attitude filter
+static void gyro_update(attitude_filter_t *f, const vector_t *w, float dt) {
+    float w_norm = vector_norm(w);
+
+    if (w_norm == 0)
+        w_norm = 0.00001f;
+
+    quaternion_t rotation = {
+        .w = cos((dt * w_norm) / 2),
+        .x = (sin((dt * w_norm) / 2) * w->x) / w_norm,
+        .y = (sin((dt * w_norm) / 2) * w->y) / w_norm,
+        .z = (sin((dt * w_norm) / 2) * w->z) / w_norm
+    };
+
+    f->q = quaternion_product(&f->q, &rotation);
+}
+
+static void filter_update(Filter filter, attitude_filter_t *f, const Sample *s) {
+    switch (filter) {
+    case FILTER_GYRO:
+        gyro_update(f, &s->gyro, SAMPLE_PERIOD_S);
+        break;
+    case FILTER_MAHONY:
+        attitude_mahony_update(f, &s->gyro, &s->accel, SAMPLE_PERIOD_S);
+        break;
+    case FILTER_MADGWICK:
+        attitude_madgwick_update(f, &s->gyro, &s->accel, SAMPLE_PERIOD_S);
+        break;
+    default:
+        break;
+    }
+}
+
+// angle between the true and estimated direction of gravity, units: degrees
+static double tilt_error(const attitude_filter_t *f, const Sample *s) {
+    const quaternion_t *q = &f->q;
+    vector_t g = gravity_in_sensor(q->w, q->x, q->y, q->z);
+
+    double dot = (g.x * s->gravity.x + g.y * s->gravity.y + g.z * s->gravity.z)
+        / (vector_norm(&g) * vector_norm(&s->gravity));
+    if (dot > 1) {
+        dot = 1;
+    }
+
+    return acos(dot) / RADIANS_PER_DEGREE;
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+    int failed = 0;
+
+    generate_flight();
+
+    printf("filter  final_deg  rms_deg  max_deg  bias_x  bias_y  bias_z  ns_per_update\n");
+
+    for (Filter filter = 0; filter < NUM_FILTERS; ++filter) {
+        attitude_filter_t f;
+        attitude_filter_init(&f, &samples[0].gravity);
+
+        double sum_sq = 0;
+        double max_error = 0;
+        double error = 0;
+
+        for (int i = 0; i < NUM_SAMPLES; ++i) {
+            filter_update(filter, &f, &samples[i]);
+
+            error = tilt_error(&f, &samples[i]);
+            sum_sq += error * error;
+            if (error > max_error) {
+                max_error = error;
+            }
+        }
+
+        // time the updates alone, without the error measurement
+        attitude_filter_t timed;
+        attitude_filter_init(&timed, &samples[0].gravity);
+
+        double start = seconds();
+        for (int i = 0; i < NUM_SAMPLES; ++i) {
+            filter_update(filter, &timed, &samples[i]);
+        }
+        double elapsed = seconds() - start;
+
+        printf("%-8s %9.3f %8.3f %8.3f %7.4f %7.4f %7.4f %14.1f\n",
+            filter_names[filter],
+            error,
+            sqrt(sum_sq / NUM_SAMPLES),
+            max_error,
+            f.bias.x,
+            f.bias.y,
+            f.bias.z,
+            elapsed / NUM_SAMPLES * 1e9
+        );
+
+        if (filter != FILTER_GYRO && error > MAX_FINAL_TILT_ERROR) {
+            printf("error: %s tilt error %.3f deg exceeds %.3f deg\n",
+                filter_names[filter], error, MAX_FINAL_TILT_ERROR);
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
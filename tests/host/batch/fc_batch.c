@@ -0,0 +1,737 @@
+#include <math.h>
+#include <string.h>
+
+#include "fc_batch.h"
+#include "gain_schedule.h"
+#include "pid_controller.h"
+
+// ********** Vector Kernels ********** //
+// Each lane gets exactly the float operations of the scalar code, in the same
+// order. Compares and selects stand in for its branches, so every branch is
+// computed and the lane keeps the one it would have taken.
+
+#if defined(__AVX2__) && !defined(FC_BATCH_SCALAR)
+#include <immintrin.h>
+
+#define FC_BATCH_WIDTH 8
+
+typedef __m256 vreal_t;
+typedef __m256 vmask_t;
+typedef __m256i vint_t;
+
+static inline vreal_t vset(float a) { return _mm256_set1_ps(a); }
+static inline vreal_t vload(const float *p) { return _mm256_loadu_ps(p); }
+static inline void vstore(float *p, vreal_t a) { _mm256_storeu_ps(p, a); }
+
+static inline vreal_t vadd(vreal_t a, vreal_t b) { return _mm256_add_ps(a, b); }
+static inline vreal_t vsub(vreal_t a, vreal_t b) { return _mm256_sub_ps(a, b); }
+static inline vreal_t vmul(vreal_t a, vreal_t b) { return _mm256_mul_ps(a, b); }
+static inline vreal_t vdiv(vreal_t a, vreal_t b) { return _mm256_div_ps(a, b); }
+static inline vreal_t vsqrt(vreal_t a) { return _mm256_sqrt_ps(a); }
+
+static inline vmask_t vlt(vreal_t a, vreal_t b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+static inline vmask_t vgt(vreal_t a, vreal_t b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+static inline vmask_t veq(vreal_t a, vreal_t b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+
+static inline vmask_t vand(vmask_t a, vmask_t b) { return _mm256_and_ps(a, b); }
+static inline vmask_t vor(vmask_t a, vmask_t b) { return _mm256_or_ps(a, b); }
+static inline vmask_t vandnot(vmask_t a, vmask_t b) { return _mm256_andnot_ps(b, a); }
+
+// mask ? a : b
+static inline vreal_t vselect(vmask_t mask, vreal_t a, vreal_t b) {
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+static inline vint_t vloadi(const int32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline void vstorei(int32_t *p, vint_t a) { _mm256_storeu_si256((__m256i *)p, a); }
+
+static inline vreal_t vitof(vint_t a) { return _mm256_cvtepi32_ps(a); }
+static inline vint_t vftoi(vreal_t a) { return _mm256_cvttps_epi32(a); }
+
+// lanes where any bit of bits is set
+static inline vmask_t vtest(vint_t a, int32_t bits) {
+    __m256i zero = _mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32(bits)), _mm256_setzero_si256());
+    return _mm256_xor_ps(_mm256_castsi256_ps(zero), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+}
+
+// a with bits set in the lanes of mask
+static inline vint_t vsetbits(vint_t a, vmask_t mask, int32_t bits) {
+    return _mm256_or_si256(a, _mm256_and_si256(_mm256_castps_si256(mask), _mm256_set1_epi32(bits)));
+}
+
+// base[index * stride]
+static inline vreal_t vgather(const float *base, vint_t index, int stride) {
+    return _mm256_i32gather_ps(base, _mm256_mullo_epi32(index, _mm256_set1_epi32(stride)), 4);
+}
+
+// a + b * k in double precision, as C does for a double constant k
+static inline vreal_t vmuladd_double(vreal_t a, vreal_t b, double k) {
+    __m256d kd = _mm256_set1_pd(k);
+    __m256d lo = _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(a)),
+        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(b)), kd));
+    __m256d hi = _mm256_add_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(a, 1)),
+        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(b, 1)), kd));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)), _mm256_cvtpd_ps(hi), 1);
+}
+#elif defined(__SSE2__) && !defined(FC_BATCH_SCALAR)
+#include <emmintrin.h>
+
+#define FC_BATCH_WIDTH 4
+
+typedef __m128 vreal_t;
+typedef __m128 vmask_t;
+typedef __m128i vint_t;
+
+static inline vreal_t vset(float a) { return _mm_set1_ps(a); }
+static inline vreal_t vload(const float *p) { return _mm_loadu_ps(p); }
+static inline void vstore(float *p, vreal_t a) { _mm_storeu_ps(p, a); }
+
+static inline vreal_t vadd(vreal_t a, vreal_t b) { return _mm_add_ps(a, b); }
+static inline vreal_t vsub(vreal_t a, vreal_t b) { return _mm_sub_ps(a, b); }
+static inline vreal_t vmul(vreal_t a, vreal_t b) { return _mm_mul_ps(a, b); }
+static inline vreal_t vdiv(vreal_t a, vreal_t b) { return _mm_div_ps(a, b); }
+static inline vreal_t vsqrt(vreal_t a) { return _mm_sqrt_ps(a); }
+
+static inline vmask_t vlt(vreal_t a, vreal_t b) { return _mm_cmplt_ps(a, b); }
+static inline vmask_t vgt(vreal_t a, vreal_t b) { return _mm_cmpgt_ps(a, b); }
+static inline vmask_t veq(vreal_t a, vreal_t b) { return _mm_cmpeq_ps(a, b); }
+
+static inline vmask_t vand(vmask_t a, vmask_t b) { return _mm_and_ps(a, b); }
+static inline vmask_t vor(vmask_t a, vmask_t b) { return _mm_or_ps(a, b); }
+static inline vmask_t vandnot(vmask_t a, vmask_t b) { return _mm_andnot_ps(b, a); }
+
+// mask ? a : b
+static inline vreal_t vselect(vmask_t mask, vreal_t a, vreal_t b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline vint_t vloadi(const int32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline void vstorei(int32_t *p, vint_t a) { _mm_storeu_si128((__m128i *)p, a); }
+
+static inline vreal_t vitof(vint_t a) { return _mm_cvtepi32_ps(a); }
+static inline vint_t vftoi(vreal_t a) { return _mm_cvttps_epi32(a); }
+
+// lanes where any bit of bits is set
+static inline vmask_t vtest(vint_t a, int32_t bits) {
+    __m128i zero = _mm_cmpeq_epi32(_mm_and_si128(a, _mm_set1_epi32(bits)), _mm_setzero_si128());
+    return _mm_xor_ps(_mm_castsi128_ps(zero), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+}
+
+// a with bits set in the lanes of mask
+static inline vint_t vsetbits(vint_t a, vmask_t mask, int32_t bits) {
+    return _mm_or_si128(a, _mm_and_si128(_mm_castps_si128(mask), _mm_set1_epi32(bits)));
+}
+
+// base[index * stride], sse2 has no gather
+static inline vreal_t vgather(const float *base, vint_t index, int stride) {
+    int32_t lanes[FC_BATCH_WIDTH];
+    vstorei(lanes, index);
+    return _mm_setr_ps(
+        base[lanes[0] * stride], base[lanes[1] * stride],
+        base[lanes[2] * stride], base[lanes[3] * stride]
+    );
+}
+
+// a + b * k in double precision, as C does for a double constant k
+static inline vreal_t vmuladd_double(vreal_t a, vreal_t b, double k) {
+    __m128d kd = _mm_set1_pd(k);
+    __m128d lo = _mm_add_pd(_mm_cvtps_pd(a), _mm_mul_pd(_mm_cvtps_pd(b), kd));
+    __m128d hi = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)),
+        _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(b, b)), kd));
+    return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+#else
+#define FC_BATCH_WIDTH 1
+
+typedef float vreal_t;
+typedef bool vmask_t;
+typedef int32_t vint_t;
+
+static inline vreal_t vset(float a) { return a; }
+static inline vreal_t vload(const float *p) { return *p; }
+static inline void vstore(float *p, vreal_t a) { *p = a; }
+
+static inline vreal_t vadd(vreal_t a, vreal_t b) { return a + b; }
+static inline vreal_t vsub(vreal_t a, vreal_t b) { return a - b; }
+static inline vreal_t vmul(vreal_t a, vreal_t b) { return a * b; }
+static inline vreal_t vdiv(vreal_t a, vreal_t b) { return a / b; }
+static inline vreal_t vsqrt(vreal_t a) { return sqrtf(a); }
+
+static inline vmask_t vlt(vreal_t a, vreal_t b) { return a < b; }
+static inline vmask_t vgt(vreal_t a, vreal_t b) { return a > b; }
+static inline vmask_t veq(vreal_t a, vreal_t b) { return a == b; }
+
+static inline vmask_t vand(vmask_t a, vmask_t b) { return a && b; }
+static inline vmask_t vor(vmask_t a, vmask_t b) { return a || b; }
+static inline vmask_t vandnot(vmask_t a, vmask_t b) { return a && !b; }
+
+// mask ? a : b
+static inline vreal_t vselect(vmask_t mask, vreal_t a, vreal_t b) {
+    return mask ? a : b;
+}
+
+static inline vint_t vloadi(const int32_t *p) { return *p; }
+static inline void vstorei(int32_t *p, vint_t a) { *p = a; }
+
+static inline vreal_t vitof(vint_t a) { return (float)a; }
+static inline vint_t vftoi(vreal_t a) { return (int32_t)a; }
+
+// lanes where any bit of bits is set
+static inline vmask_t vtest(vint_t a, int32_t bits) {
+    return (a & bits) != 0;
+}
+
+// a with bits set in the lanes of mask
+static inline vint_t vsetbits(vint_t a, vmask_t mask, int32_t bits) {
+    return mask ? a | bits : a;
+}
+
+// base[index * stride]
+static inline vreal_t vgather(const float *base, vint_t index, int stride) {
+    return base[index * stride];
+}
+
+// a + b * k in double precision, as C does for a double constant k
+static inline vreal_t vmuladd_double(vreal_t a, vreal_t b, double k) {
+    return (float)((double)a + (double)b * k);
+}
+#endif
+
+#define GAINS_STRIDE ((int)(sizeof(Fc_Gains) / sizeof(float)))
+#define ROTATION_STRIDE ((int)(sizeof(quaternion_t) / sizeof(float)))
+
+// stores a in the lanes of mask, the others keep their value
+static inline void vstore_masked(float *p, vmask_t mask, vreal_t a) {
+    vstore(p, vselect(mask, a, vload(p)));
+}
+
+// ********** Flight Controller ********** //
+// Named as in flight_controller.c, each with the same operations per lane.
+
+static inline vreal_t constrainf(vreal_t val, vreal_t min, vreal_t max) {
+    return vselect(vgt(val, max), max, vselect(vlt(val, min), min, val));
+}
+
+static inline vreal_t absf(vreal_t val) {
+    return vselect(vlt(val, vset(0)), vmul(val, vset(-1)), val);
+}
+
+static inline vreal_t interpolate(
+    vreal_t val,
+    float min_from,
+    float max_from,
+    float min_to,
+    float max_to
+) {
+    return vadd(vmul(vdiv(vsub(val, vset(min_from)), vset(max_from - min_from)),
+        vset(max_to - min_to)), vset(min_to));
+}
+
+static inline vreal_t constrain_output(vreal_t val) {
+    return constrainf(val, vset(FC_MIN_OUTPUT), vset(FC_MAX_OUTPUT));
+}
+
+static inline vreal_t constrain_angle(vreal_t angle) {
+    return vselect(vgt(angle, vset(180)), vsub(angle, vset(360)),
+        vselect(vlt(angle, vset(-180)), vadd(angle, vset(360)), angle));
+}
+
+static inline vreal_t optimize_target(vreal_t target, vreal_t current, float max_error) {
+    vreal_t bound_a = constrain_angle(vsub(current, vset(max_error)));
+    vreal_t bound_b = constrain_angle(vadd(current, vset(max_error)));
+
+    vreal_t cost_a = absf(constrain_angle(vsub(target, bound_a)));
+    vreal_t cost_b = absf(constrain_angle(vsub(target, bound_b)));
+
+    vmask_t keep = vand(vlt(cost_a, vset(2 * max_error)), vlt(cost_b, vset(2 * max_error)));
+
+    return vselect(keep, target, vselect(vlt(cost_a, cost_b), bound_a, bound_b));
+}
+
+// returns the Fc_Ctrl_Mode of each lane
+static inline vreal_t get_ctrl_mode(vreal_t aux1, vmask_t rx_failed, vmask_t imu_failed) {
+    vreal_t mode = vset(FC_CTRL_ANGLE);
+
+    mode = vselect(vlt(aux1, vset(FC_MODE_SWITCH_THRESHOLD_2)), vset(FC_CTRL_RATE), mode);
+    mode = vselect(vlt(aux1, vset(FC_MODE_SWITCH_THRESHOLD_1)), vset(FC_CTRL_MANUAL), mode);
+
+    mode = vselect(rx_failed, vset(FC_CTRL_ANGLE), mode);
+    mode = vselect(imu_failed, vset(FC_CTRL_MANUAL), mode);
+
+    return mode;
+}
+
+// returns the Fc_Flight_Mode of each lane
+static inline vreal_t get_flight_mode(vreal_t gear, vmask_t rx_failed, vmask_t imu_failed) {
+    vreal_t mode = vset(FC_FMODE_DISABLED);
+
+    mode = vselect(vlt(gear, vset(FC_MODE_SWITCH_THRESHOLD_2)), vset(FC_FMODE_VERTICAL), mode);
+    mode = vselect(vlt(gear, vset(FC_MODE_SWITCH_THRESHOLD_1)), vset(FC_FMODE_HORIZONTAL), mode);
+
+    mode = vselect(vor(rx_failed, imu_failed), vset(FC_FMODE_HORIZONTAL), mode);
+    mode = vselect(vand(rx_failed, imu_failed), vset(FC_FMODE_DISABLED), mode);
+
+    return mode;
+}
+
+static inline vreal_t get_target(
+    bool start,
+    vreal_t input,
+    vreal_t curr,
+    vreal_t target,
+    vreal_t mode,
+    float dt,
+    float max_target, // in angle control, 0 to integrate the rate as for yaw
+    float max_rate,
+    float max_error
+) {
+    if (start) {
+        return curr;
+    }
+
+    vreal_t rate_target = vadd(target, vmul(interpolate(input,
+        -FC_MAX_ATTITUDE, FC_MAX_ATTITUDE,
+        -max_rate, max_rate
+    ), vset(dt)));
+    rate_target = optimize_target(rate_target, curr, max_error);
+
+    vreal_t result = rate_target;
+    if (max_target) {
+        vreal_t angle_target = interpolate(input,
+            -FC_MAX_ATTITUDE, FC_MAX_ATTITUDE,
+            -max_target, max_target
+        );
+        result = vselect(veq(mode, vset(FC_CTRL_ANGLE)), angle_target, result);
+    }
+    return vselect(veq(mode, vset(FC_CTRL_MANUAL)), curr, result);
+}
+
+static inline vreal_t get_transition_state(bool start, vreal_t state, vreal_t mode, float dt) {
+    if (start) {
+        state = vset(0);
+    } else {
+        state = vselect(veq(mode, vset(FC_FMODE_HORIZONTAL)),
+            vsub(state, vset(FC_TSTATE_RATE_HORZ * dt)),
+            vadd(state, vset(FC_TSTATE_RATE_VERT * dt)));
+    }
+    return constrainf(state, vset(FC_MIN_TSTATE), vset(FC_MAX_TSTATE));
+}
+
+// pid_calculate_dt() with the gains of gains[index] on the lanes of active,
+// the others keep their state
+static inline vreal_t run_pid(
+    Fc_Batch *batch,
+    Fc_Batch_Pid *pid,
+    int lane,
+    const Fc_Pid_Gains *gains,
+    vint_t index,
+    vreal_t error,
+    uint32_t dt_us,
+    vmask_t active
+) {
+    vreal_t p = vmul(vgather(&gains->p, index, GAINS_STRIDE), vload(&batch->p_scale[lane]));
+    vreal_t i = vmul(vgather(&gains->i, index, GAINS_STRIDE), vload(&batch->i_scale[lane]));
+    vreal_t d = vmul(vgather(&gains->d, index, GAINS_STRIDE), vload(&batch->d_scale[lane]));
+    vreal_t i_max = vgather(&gains->i_max, index, GAINS_STRIDE);
+
+    vmask_t start = vtest(vloadi(&pid->start[lane]), 1);
+    vmask_t update = vandnot(active, start);
+
+    float t_delta = (float)(dt_us ? dt_us : 1) / 1000000.0f;
+
+    vreal_t output = vmul(p, error);
+
+    vreal_t i_output = vadd(vload(&pid->i_output[lane]), vmul(vset(t_delta), error));
+    i_output = constrainf(i_output, vdiv(vmul(vset(-1), i_max), i), vdiv(i_max, i));
+    output = vadd(output, constrainf(vmul(i, i_output), vmul(vset(-1), i_max), i_max));
+
+    // fir_filter_calculate() on the shifted history
+    vreal_t d_input = vdiv(vsub(error, vload(&pid->prev_error[lane])), vset(t_delta));
+
+    vreal_t window[FIR_NUM_TAPS];
+    window[0] = d_input;
+    for (int k = 1; k < FIR_NUM_TAPS; ++k) {
+        window[k] = vload(&pid->history[k - 1][lane]);
+    }
+
+    vreal_t filtered = vset(0);
+    for (int k = 0; k < FIR_NUM_TAPS; ++k) {
+        filtered = vadd(filtered, vmul(window[k], vset(batch->d_response[k])));
+    }
+
+    vint_t startup_counter = vloadi(&pid->startup_counter[lane]);
+    vmask_t filling = vlt(vitof(startup_counter), vset(FIR_NUM_TAPS));
+    vreal_t d_error = vselect(filling, d_input, filtered);
+
+    output = vadd(output, vmul(d, d_error));
+    output = constrainf(output, vset(-PID_MAX_OUTPUT), vset(PID_MAX_OUTPUT));
+
+    vstore_masked(&pid->i_output[lane], update, i_output);
+    vstore_masked(&pid->prev_error[lane], update, error);
+    for (int k = 0; k < FIR_NUM_TAPS; ++k) {
+        vstore_masked(&pid->history[k][lane], update, window[k]);
+    }
+    vstorei(&pid->startup_counter[lane],
+        vftoi(vselect(vand(update, filling), vadd(vitof(startup_counter), vset(1)), vitof(startup_counter))));
+    vstorei(&pid->start[lane], vftoi(vselect(active, vset(0), vitof(vloadi(&pid->start[lane])))));
+
+    return vselect(start, vset(0), output);
+}
+
+static inline vmask_t use_horz_ctrls(vreal_t tstate) {
+    return vlt(tstate, vset(FC_TSTATE_CTRL_THRESHOLD));
+}
+
+// get_output() and the mappings it uses, stores the outputs of active lanes
+static inline void get_output(
+    Fc_Batch *batch,
+    int lane,
+    vreal_t thro,
+    vreal_t elev,
+    vreal_t rudd,
+    vreal_t aile,
+    vreal_t ctrl_mode,
+    vreal_t tstate,
+    vmask_t active
+) {
+    vmask_t horz = use_horz_ctrls(tstate);
+    vmask_t manual = veq(ctrl_mode, vset(FC_CTRL_MANUAL));
+
+    vreal_t pid_roll = vload(&batch->pid_out_roll[lane]);
+    vreal_t pid_pitch = vload(&batch->pid_out_pitch[lane]);
+    vreal_t pid_yaw = vload(&batch->pid_out_yaw[lane]);
+
+    // NOTE: command is always with reference to horizontal flight
+    vreal_t pitch = vselect(manual, elev, pid_pitch);
+    vreal_t roll = vselect(manual,
+        vselect(horz, aile, rudd),
+        vselect(horz, pid_roll, pid_yaw));
+    vreal_t yaw = vselect(manual,
+        vselect(horz, rudd, aile),
+        vselect(horz, pid_yaw, pid_roll));
+
+    vreal_t right_elevon = constrain_output(vselect(horz, vadd(pitch, roll), vsub(pitch, roll)));
+    vreal_t left_elevon = constrain_output(vselect(horz, vsub(pitch, roll), vadd(pitch, roll)));
+
+    // the differential is a double constant, as in map_right_motor()
+    vreal_t right_motor = vmuladd_double(thro, yaw, -FC_YAW_DIFFERENTIAL);
+    right_motor = constrain_output(vsub(right_motor, vset(FC_YAW_TRIM / 2.0f)));
+    vreal_t left_motor = vmuladd_double(thro, yaw, FC_YAW_DIFFERENTIAL);
+    left_motor = constrain_output(vadd(left_motor, vset(FC_YAW_TRIM / 2.0f)));
+
+    vreal_t gear = vselect(vlt(tstate, vset(FC_TSTATE_CTRL_THRESHOLD)),
+        vset(FC_MIN_OUTPUT),
+        interpolate(tstate,
+            FC_TSTATE_CTRL_THRESHOLD, FC_MAX_TSTATE,
+            FC_MIN_OUTPUT, FC_MAX_OUTPUT
+        ));
+    gear = constrain_output(gear);
+
+    // only enable throttle mixing if there is some input throttle
+    vmask_t dead_stick = vlt(thro, vset(FC_MIN_OUTPUT + FC_DEAD_STICK));
+    right_motor = vselect(dead_stick, vset(FC_MIN_OUTPUT), right_motor);
+    left_motor = vselect(dead_stick, vset(FC_MIN_OUTPUT), left_motor);
+
+    Fc_Batch_Output *output = &batch->output;
+    vstore_masked(&output->right_elevon[lane], active, right_elevon);
+    vstore_masked(&output->left_elevon[lane], active, left_elevon);
+    vstore_masked(&output->right_motor[lane], active, right_motor);
+    vstore_masked(&output->left_motor[lane], active, left_motor);
+    vstore_masked(&output->gear[lane], active, gear);
+}
+
+#ifdef FC_CASCADED
+static inline vreal_t invert(vreal_t val, bool invert) {
+    return invert ? vmul(val, vset(-1)) : val;
+}
+
+// calc_rate() on the lanes of active
+static inline void calc_rate(
+    Fc_Batch *batch,
+    int lane,
+    vreal_t rates_x,
+    vreal_t rates_y,
+    vreal_t rates_z,
+    uint32_t dt_us,
+    vmask_t active
+) {
+    vint_t index = vloadi(&batch->tstate_index[lane]);
+    vreal_t tstate = vload(&batch->tstate[lane]);
+
+    // get_attitude_rates()
+    vreal_t r_w = vgather(&fc_tstate_rotation[0].w, index, ROTATION_STRIDE);
+    vreal_t r_y = vgather(&fc_tstate_rotation[0].y, index, ROTATION_STRIDE);
+    vreal_t c = vsub(vmul(r_w, r_w), vmul(r_y, r_y));
+    vreal_t s = vmul(vmul(vset(-2), r_w), r_y);
+
+    vreal_t roll_rate = invert(vadd(vmul(c, rates_x), vmul(s, rates_z)), FC_INVERT_ROLL == 1);
+    vreal_t pitch_rate = invert(rates_y, FC_INVERT_PITCH == 1);
+    vreal_t yaw_rate = invert(vsub(vmul(s, rates_x), vmul(c, rates_z)), FC_INVERT_YAW == 1);
+
+    vstore_masked(&batch->roll_rate[lane], active, roll_rate);
+    vstore_masked(&batch->pitch_rate[lane], active, pitch_rate);
+    vstore_masked(&batch->yaw_rate[lane], active, yaw_rate);
+
+    vreal_t error_roll = vsub(vload(&batch->target_roll_rate[lane]), roll_rate);
+    vreal_t error_pitch = vsub(vload(&batch->target_pitch_rate[lane]), pitch_rate);
+    vreal_t error_yaw = vsub(vload(&batch->target_yaw_rate[lane]), yaw_rate);
+
+    vstore_masked(&batch->pid_out_roll[lane], active, run_pid(batch, &batch->pid_roll_rate, lane,
+        &batch->rate_gain_schedule[0].roll, index, error_roll, dt_us, active));
+    vstore_masked(&batch->pid_out_pitch[lane], active, run_pid(batch, &batch->pid_pitch_rate, lane,
+        &batch->rate_gain_schedule[0].pitch, index, error_pitch, dt_us, active));
+    vstore_masked(&batch->pid_out_yaw[lane], active, run_pid(batch, &batch->pid_yaw_rate, lane,
+        &batch->rate_gain_schedule[0].yaw, index, error_yaw, dt_us, active));
+
+    get_output(batch, lane,
+        vload(&batch->ctrl_thro[lane]), vload(&batch->ctrl_elev[lane]),
+        vload(&batch->ctrl_rudd[lane]), vload(&batch->ctrl_aile[lane]),
+        vitof(vloadi(&batch->ctrl_mode[lane])), tstate, active);
+}
+#endif // FC_CASCADED
+
+// fc_calc() on the lanes from lane to lane + FC_BATCH_WIDTH
+static inline void calc(Fc_Batch *batch, int lane, uint32_t dt_us) {
+    const Fc_Batch_Input *input = &batch->input;
+    const vmask_t all = veq(vset(0), vset(0));
+
+    // units: seconds
+    float dt = dt_us / 1000000.0f;
+
+    vint_t flags = vloadi(&batch->flags[lane]);
+    vmask_t rx_failed = vtest(flags, FC_RX_FAILED);
+    vmask_t imu_failed = vtest(flags, FC_IMU_FAILED);
+
+    vreal_t thro = vload(&input->thro[lane]);
+    vreal_t elev = vload(&input->elev[lane]);
+    vreal_t rudd = vload(&input->rudd[lane]);
+    vreal_t aile = vload(&input->aile[lane]);
+
+    vreal_t ctrl_mode = get_ctrl_mode(vload(&input->aux1[lane]), rx_failed, imu_failed);
+    vreal_t flight_mode = get_flight_mode(vload(&input->gear[lane]), rx_failed, imu_failed);
+    vreal_t tstate = get_transition_state(batch->start, vload(&batch->tstate[lane]), flight_mode, dt);
+
+    vmask_t waiting = vtest(vloadi(&batch->waiting[lane]), 1);
+    vmask_t armed = vand(vand(veq(tstate, vset(0)),
+        veq(flight_mode, vset(FC_FMODE_HORIZONTAL))),
+        vandnot(vand(veq(ctrl_mode, vset(FC_CTRL_MANUAL)),
+            vlt(thro, vset(FC_MIN_INPUT + FC_DEAD_STICK))), rx_failed));
+    waiting = vandnot(waiting, armed);
+    flight_mode = vselect(waiting, vset(FC_FMODE_DISABLED), flight_mode);
+    flags = vsetbits(flags, waiting, FC_WAITING);
+
+    vmask_t failsafe = vor(veq(flight_mode, vset(FC_FMODE_DISABLED)), rx_failed);
+    thro = vselect(failsafe, vset(FC_MIN_INPUT), thro);
+    aile = vselect(failsafe, vset(FC_CEN_INPUT), aile);
+    elev = vselect(failsafe, vset(FC_CEN_INPUT), elev);
+    rudd = vselect(failsafe, vset(FC_CEN_INPUT), rudd);
+
+    vint_t index = vftoi(vadd(tstate, vset(0.5f)));
+
+    // compensate pitch based on transition state, quaternion_product()
+    vreal_t p_w = vload(&input->orientation_w[lane]);
+    vreal_t p_x = vload(&input->orientation_x[lane]);
+    vreal_t p_y = vload(&input->orientation_y[lane]);
+    vreal_t p_z = vload(&input->orientation_z[lane]);
+
+    vreal_t q_w = vgather(&fc_tstate_rotation[0].w, index, ROTATION_STRIDE);
+    vreal_t q_x = vgather(&fc_tstate_rotation[0].x, index, ROTATION_STRIDE);
+    vreal_t q_y = vgather(&fc_tstate_rotation[0].y, index, ROTATION_STRIDE);
+    vreal_t q_z = vgather(&fc_tstate_rotation[0].z, index, ROTATION_STRIDE);
+
+    vreal_t w = vsub(vsub(vsub(vmul(p_w, q_w), vmul(p_x, q_x)), vmul(p_y, q_y)), vmul(p_z, q_z));
+    vreal_t x = vsub(vadd(vadd(vmul(p_w, q_x), vmul(p_x, q_w)), vmul(p_y, q_z)), vmul(p_z, q_y));
+    vreal_t y = vadd(vadd(vsub(vmul(p_w, q_y), vmul(p_x, q_z)), vmul(p_y, q_w)), vmul(p_z, q_x));
+    vreal_t z = vadd(vsub(vadd(vmul(p_w, q_z), vmul(p_x, q_y)), vmul(p_y, q_x)), vmul(p_z, q_w));
+
+    vreal_t scale = vdiv(vset(1.0f), vsqrt(vadd(vadd(vadd(
+        vmul(w, w), vmul(x, x)), vmul(y, y)), vmul(z, z))));
+
+    // the euler angles need atan2f() and asinf(), taken one lane at a time
+    // from 3dmath so they round the same
+    float lane_w[FC_BATCH_WIDTH], lane_x[FC_BATCH_WIDTH], lane_y[FC_BATCH_WIDTH], lane_z[FC_BATCH_WIDTH];
+    vstore(lane_w, vmul(w, scale));
+    vstore(lane_x, vmul(x, scale));
+    vstore(lane_y, vmul(y, scale));
+    vstore(lane_z, vmul(z, scale));
+
+    for (int l = 0; l < FC_BATCH_WIDTH; ++l) {
+        quaternion_t q = { lane_w[l], lane_x[l], lane_y[l], lane_z[l] };
+        euler_t attitude;
+        quaternion_get_euler(&q, &attitude);
+
+#       if FC_INVERT_ROLL == 1
+            attitude.roll *= -1;
+#       endif
+
+#       if FC_INVERT_PITCH == 1
+            attitude.pitch *= -1;
+#       endif
+
+#       if FC_INVERT_YAW == 1
+            attitude.yaw *= -1;
+#       endif
+
+        batch->roll[lane + l] = attitude.roll;
+        batch->pitch[lane + l] = attitude.pitch;
+        batch->yaw[lane + l] = attitude.yaw;
+    }
+
+    vreal_t roll = vload(&batch->roll[lane]);
+    vreal_t pitch = vload(&batch->pitch[lane]);
+    vreal_t yaw = vload(&batch->yaw[lane]);
+
+    vreal_t target_roll = get_target(batch->start, aile, roll, vload(&batch->target_roll[lane]),
+        ctrl_mode, dt, FC_ANGLE_MAX_ROLL_TARGET, FC_RATE_MAX_ROLL_RATE, FC_RATE_MAX_ROLL_ERROR);
+    vreal_t target_pitch = get_target(batch->start, elev, pitch, vload(&batch->target_pitch[lane]),
+        ctrl_mode, dt, FC_ANGLE_MAX_PITCH_TARGET, FC_RATE_MAX_PITCH_RATE, FC_RATE_MAX_PITCH_ERROR);
+    vreal_t target_yaw = get_target(batch->start, rudd, yaw, vload(&batch->target_yaw[lane]),
+        ctrl_mode, dt, 0, FC_RATE_MAX_YAW_RATE, FC_RATE_MAX_YAW_ERROR);
+
+    vreal_t error_roll = constrain_angle(vsub(target_roll, roll));
+    vreal_t error_pitch = constrain_angle(vsub(target_pitch, pitch));
+    vreal_t error_yaw = constrain_angle(vsub(target_yaw, yaw));
+
+    vstorei(&batch->flags[lane], flags);
+    vstorei(&batch->ctrl_mode[lane], vftoi(ctrl_mode));
+    vstorei(&batch->flight_mode[lane], vftoi(flight_mode));
+    vstore(&batch->tstate[lane], tstate);
+    vstorei(&batch->tstate_index[lane], index);
+    vstorei(&batch->waiting[lane], vftoi(vselect(waiting, vset(1), vset(0))));
+
+    vstore(&batch->target_roll[lane], target_roll);
+    vstore(&batch->target_pitch[lane], target_pitch);
+    vstore(&batch->target_yaw[lane], target_yaw);
+
+    vreal_t pid_roll = run_pid(batch, &batch->pid_roll, lane,
+        &batch->gain_schedule[0].roll, index, error_roll, dt_us, all);
+    vreal_t pid_pitch = run_pid(batch, &batch->pid_pitch, lane,
+        &batch->gain_schedule[0].pitch, index, error_pitch, dt_us, all);
+    vreal_t pid_yaw = run_pid(batch, &batch->pid_yaw, lane,
+        &batch->gain_schedule[0].yaw, index, error_yaw, dt_us, all);
+
+#   ifdef FC_CASCADED
+        // the angle pids set the targets of the rate loop
+        vstore(&batch->target_roll_rate[lane], pid_roll);
+        vstore(&batch->target_pitch_rate[lane], pid_pitch);
+        vstore(&batch->target_yaw_rate[lane], pid_yaw);
+
+        vstore(&batch->ctrl_thro[lane], thro);
+        vstore(&batch->ctrl_elev[lane], elev);
+        vstore(&batch->ctrl_rudd[lane], rudd);
+        vstore(&batch->ctrl_aile[lane], aile);
+
+        if (batch->rate_loop_external) {
+            // the rate pids are stepped by fc_batch_calc_rate() on their own dt
+            get_output(batch, lane, thro, elev, rudd, aile, ctrl_mode, tstate, all);
+        } else {
+            calc_rate(batch, lane,
+                vload(&input->rates_x[lane]), vload(&input->rates_y[lane]),
+                vload(&input->rates_z[lane]), dt_us, all);
+        }
+#   else
+        vstore(&batch->pid_out_roll[lane], pid_roll);
+        vstore(&batch->pid_out_pitch[lane], pid_pitch);
+        vstore(&batch->pid_out_yaw[lane], pid_yaw);
+
+        get_output(batch, lane, thro, elev, rudd, aile, ctrl_mode, tstate, all);
+#   endif // FC_CASCADED
+}
+
+static void init_pid(Fc_Batch_Pid *pid) {
+    memset(pid, 0, sizeof(*pid));
+
+    for (int lane = 0; lane < FC_BATCH_SIZE; ++lane) {
+        pid->start[lane] = 1;
+    }
+}
+
+void fc_batch_init(Fc_Batch *batch) {
+    memset(batch, 0, sizeof(*batch));
+
+    batch->start = true;
+
+    batch->gain_schedule = fc_gain_schedule;
+    batch->rate_gain_schedule = fc_rate_gain_schedule;
+
+    for (int lane = 0; lane < FC_BATCH_SIZE; ++lane) {
+        batch->waiting[lane] = true;
+        batch->tstate[lane] = FC_MIN_TSTATE;
+
+        batch->p_scale[lane] = 1;
+        batch->i_scale[lane] = 1;
+        batch->d_scale[lane] = 1;
+    }
+
+    init_pid(&batch->pid_roll);
+    init_pid(&batch->pid_pitch);
+    init_pid(&batch->pid_yaw);
+    init_pid(&batch->pid_roll_rate);
+    init_pid(&batch->pid_pitch_rate);
+    init_pid(&batch->pid_yaw_rate);
+
+    // the taps pid_init() gives its derivative filter
+    pid_inst_t pid;
+    pid_init(&pid, 0, 0, 0, 0);
+    memcpy(batch->d_response, pid.d_filter.fir.response, sizeof(batch->d_response));
+}
+
+void fc_batch_calc(Fc_Batch *batch, uint32_t dt_us) {
+    for (int lane = 0; lane < FC_BATCH_SIZE; lane += FC_BATCH_WIDTH) {
+        calc(batch, lane, dt_us);
+    }
+
+    batch->start = false;
+}
+
+#ifdef FC_CASCADED
+void fc_batch_calc_rate(Fc_Batch *batch, uint32_t dt_us) {
+    batch->rate_loop_external = true;
+
+    for (int lane = 0; lane < FC_BATCH_SIZE; lane += FC_BATCH_WIDTH) {
+        // manual outputs do not depend on the rates, and are set by fc_batch_calc()
+        vmask_t active = vandnot(veq(vset(0), vset(0)),
+            veq(vitof(vloadi(&batch->ctrl_mode[lane])), vset(FC_CTRL_MANUAL)));
+
+        calc_rate(batch, lane,
+            vload(&batch->input.rates_x[lane]), vload(&batch->input.rates_y[lane]),
+            vload(&batch->input.rates_z[lane]), dt_us, active);
+    }
+}
+#endif // FC_CASCADED
+
+void fc_batch_set_input(Fc_Batch *batch, int lane, const Fc_Input *input, Fc_Flags flags) {
+    Fc_Batch_Input *batch_input = &batch->input;
+
+    batch_input->thro[lane] = input->thro;
+    batch_input->elev[lane] = input->elev;
+    batch_input->rudd[lane] = input->rudd;
+    batch_input->aile[lane] = input->aile;
+    batch_input->gear[lane] = input->gear;
+    batch_input->aux1[lane] = input->aux1;
+
+    batch_input->orientation_w[lane] = input->orientation.w;
+    batch_input->orientation_x[lane] = input->orientation.x;
+    batch_input->orientation_y[lane] = input->orientation.y;
+    batch_input->orientation_z[lane] = input->orientation.z;
+
+    batch_input->rates_x[lane] = input->rates.x;
+    batch_input->rates_y[lane] = input->rates.y;
+    batch_input->rates_z[lane] = input->rates.z;
+
+    batch->flags[lane] = flags;
+}
+
+void fc_batch_get_output(const Fc_Batch *batch, int lane, Fc_Output *output) {
+    const Fc_Batch_Output *batch_output = &batch->output;
+
+    output->right_elevon = batch_output->right_elevon[lane];
+    output->left_elevon = batch_output->left_elevon[lane];
+    output->right_motor = batch_output->right_motor[lane];
+    output->left_motor = batch_output->left_motor[lane];
+    output->gear = batch_output->gear[lane];
+}
+
+int fc_batch_width(void) {
+    return FC_BATCH_WIDTH;
+}
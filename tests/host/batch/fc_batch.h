@@ -0,0 +1,168 @@
+// Structure of arrays version of fc_calc() for sweeps over many aircraft on
+// the host. Each lane of a batch is one aircraft with the state of one
+// Fc_State. All lanes share dt and the gain schedule and are stepped by one
+// call. The math follows src/flight_controller.c operation for operation in
+// the same order, so each lane matches a scalar instance bit for bit.
+//
+// The kernels are built for the widest vector unit the compiler targets: AVX2
+// with -mavx2, SSE2 on any x86-64, otherwise one lane at a time. Define
+// FC_BATCH_SCALAR to build the one lane kernel on x86 as well.
+#ifndef __FC_BATCH_H__
+#define __FC_BATCH_H__
+
+#include "pico/stdlib.h"
+#include "flight_controller.h"
+#include "fir_filter.h"
+
+#if defined(PID_FIXED_POINT) || defined(FIR_FIXED_POINT)
+#   error "the batch kernels follow the float pid controller"
+#endif
+
+// lanes in a batch, a multiple of every vector width
+#define FC_BATCH_SIZE 256
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// Fc_Input, one array per field
+typedef struct {
+    float thro[FC_BATCH_SIZE];
+    float elev[FC_BATCH_SIZE];
+    float rudd[FC_BATCH_SIZE];
+    float aile[FC_BATCH_SIZE];
+    float gear[FC_BATCH_SIZE];
+    float aux1[FC_BATCH_SIZE];
+
+    float orientation_w[FC_BATCH_SIZE];
+    float orientation_x[FC_BATCH_SIZE];
+    float orientation_y[FC_BATCH_SIZE];
+    float orientation_z[FC_BATCH_SIZE];
+
+    // calibrated gyro rates, units: degrees per second
+    float rates_x[FC_BATCH_SIZE];
+    float rates_y[FC_BATCH_SIZE];
+    float rates_z[FC_BATCH_SIZE];
+} Fc_Batch_Input;
+
+// Fc_Output, one array per field
+typedef struct {
+    float right_elevon[FC_BATCH_SIZE];
+    float left_elevon[FC_BATCH_SIZE];
+    float right_motor[FC_BATCH_SIZE];
+    float left_motor[FC_BATCH_SIZE];
+    float gear[FC_BATCH_SIZE];
+} Fc_Batch_Output;
+
+// pid_inst_t with its fir derivative filter. The history is shifted instead
+// of kept in a ring, so every lane sums the same taps in the same order.
+typedef struct {
+    float i_output[FC_BATCH_SIZE];
+    float prev_error[FC_BATCH_SIZE];
+
+    float history[FIR_NUM_TAPS][FC_BATCH_SIZE]; // newest first
+    int32_t startup_counter[FC_BATCH_SIZE];
+
+    int32_t start[FC_BATCH_SIZE];
+} Fc_Batch_Pid;
+
+typedef struct {
+    // set by the caller before each fc_batch_calc(), see fc_batch_set_input()
+    Fc_Batch_Input input;
+
+    // Fc_Flags of each lane, set with the input. fc_batch_calc() adds
+    // FC_WAITING as fc_calc() does.
+    int32_t flags[FC_BATCH_SIZE];
+
+    // per lane multipliers of the scheduled p, i and d gains, to vary the
+    // tuning across a sweep. 1 after fc_batch_init().
+    float p_scale[FC_BATCH_SIZE];
+    float i_scale[FC_BATCH_SIZE];
+    float d_scale[FC_BATCH_SIZE];
+
+    // gain tables shared by every lane, as gain_schedule in Fc_State
+    const Fc_Gains *gain_schedule;
+    const Fc_Gains *rate_gain_schedule;
+
+    // the rest as in Fc_State
+    int32_t ctrl_mode[FC_BATCH_SIZE]; // Fc_Ctrl_Mode
+    int32_t flight_mode[FC_BATCH_SIZE]; // Fc_Flight_Mode
+
+    float roll[FC_BATCH_SIZE];
+    float pitch[FC_BATCH_SIZE];
+    float yaw[FC_BATCH_SIZE];
+
+    float target_roll[FC_BATCH_SIZE];
+    float target_pitch[FC_BATCH_SIZE];
+    float target_yaw[FC_BATCH_SIZE];
+
+    // only used with FC_CASCADED, units: degrees per second
+    float roll_rate[FC_BATCH_SIZE];
+    float pitch_rate[FC_BATCH_SIZE];
+    float yaw_rate[FC_BATCH_SIZE];
+
+    float target_roll_rate[FC_BATCH_SIZE];
+    float target_pitch_rate[FC_BATCH_SIZE];
+    float target_yaw_rate[FC_BATCH_SIZE];
+
+    float tstate[FC_BATCH_SIZE];
+    int32_t tstate_index[FC_BATCH_SIZE];
+
+    Fc_Batch_Pid pid_roll;
+    Fc_Batch_Pid pid_pitch;
+    Fc_Batch_Pid pid_yaw;
+
+    // sticks after failsafes, kept for fc_batch_calc_rate()
+    float ctrl_thro[FC_BATCH_SIZE];
+    float ctrl_elev[FC_BATCH_SIZE];
+    float ctrl_rudd[FC_BATCH_SIZE];
+    float ctrl_aile[FC_BATCH_SIZE];
+
+    Fc_Batch_Pid pid_roll_rate;
+    Fc_Batch_Pid pid_pitch_rate;
+    Fc_Batch_Pid pid_yaw_rate;
+
+    bool rate_loop_external;
+
+    float pid_out_roll[FC_BATCH_SIZE];
+    float pid_out_pitch[FC_BATCH_SIZE];
+    float pid_out_yaw[FC_BATCH_SIZE];
+
+    Fc_Batch_Output output;
+
+    int32_t waiting[FC_BATCH_SIZE];
+
+    // set by fc_batch_init(), the first fc_batch_calc() then starts from the
+    // attitude
+    bool start;
+
+    // taps of the derivative filter of pid_init()
+    float d_response[FIR_NUM_TAPS];
+} Fc_Batch;
+
+// Every lane starts as an Fc_State from fc_init(). The batch is too big for
+// most stacks, allocate it statically or on the heap.
+void fc_batch_init(Fc_Batch *batch);
+
+// fc_calc() on every lane, dt_us is the time since the last call
+void fc_batch_calc(Fc_Batch *batch, uint32_t dt_us);
+
+#ifdef FC_CASCADED
+// fc_calc_rate() on every lane, with the gyro rates of the input
+void fc_batch_calc_rate(Fc_Batch *batch, uint32_t dt_us);
+#endif // FC_CASCADED
+
+// Copies a scalar input and its flags into a lane
+void fc_batch_set_input(Fc_Batch *batch, int lane, const Fc_Input *input, Fc_Flags flags);
+
+// Copies the outputs of a lane out of the batch
+void fc_batch_get_output(const Fc_Batch *batch, int lane, Fc_Output *output);
+
+// number of lanes each kernel processes at once
+int fc_batch_width(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __FC_BATCH_H__
@@ -0,0 +1,85 @@
+// Compares the per sample cost of each filter in src/filter through the
+// generic filter_apply() interface
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "filter.h"
+
+#define SAMPLE_RATE_HZ 1000
+#define NUM_SAMPLES 10000000
+
+typedef enum {
+    BENCH_NONE,
+    BENCH_PT1,
+    BENCH_BIQUAD_LPF,
+    BENCH_NOTCH,
+    BENCH_FIR,
+    NUM_BENCHES
+} Bench;
+
+static const char *bench_names[NUM_BENCHES] = {
+    "none",
+    "pt1",
+    "biquad_lpf",
+    "notch",
+    "fir"
+};
+
+static const float fir_response[FIR_NUM_TAPS] = { 0.4, 0.3, 0.2, 0.1 };
+
+static float input[1024];
+
+static void init_filter(filter_t *filter, Bench bench) {
+    switch (bench) {
+    case BENCH_PT1:
+        filter_init_pt1(filter, 50, SAMPLE_RATE_HZ);
+        break;
+    case BENCH_BIQUAD_LPF:
+        filter_init_biquad_lpf(filter, 80, SAMPLE_RATE_HZ);
+        break;
+    case BENCH_NOTCH:
+        filter_init_notch(filter, 150, SAMPLE_RATE_HZ, filter_notch_q(150, 100));
+        break;
+    case BENCH_FIR:
+        filter_init_fir(filter, fir_response);
+        break;
+    default:
+        filter_init_none(filter);
+        break;
+    }
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void) {
+    srand(1);
+    for (size_t n = 0; n < sizeof(input) / sizeof(input[0]); ++n) {
+        input[n] = rand() / (float)RAND_MAX - 0.5f;
+    }
+
+    printf("filter       ns_per_sample\n");
+
+    for (int bench = 0; bench < NUM_BENCHES; ++bench) {
+        filter_t filter;
+        init_filter(&filter, bench);
+
+        volatile float sink = 0;
+        double start = now_ns();
+        for (int n = 0; n < NUM_SAMPLES; ++n) {
+            sink = filter_apply(&filter, input[n & 1023]);
+        }
+        double elapsed = now_ns() - start;
+        (void)sink;
+
+        printf("%-12s %13.2f\n", bench_names[bench], elapsed / NUM_SAMPLES);
+    }
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+// Measures how far the quaternion, fir and pid paths deviate from a double
+// precision reference. Built once with float and once with the fixed point
+// options, so both builds can be compared side by side.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3dmath.h>
+
+#include "fir_filter.h"
+#include "pid_controller.h"
+
+#define NUM_TRIALS 10000
+
+#define MAX_QUATERNION_ERROR 2e-4
+#define MAX_ANGLE_ERROR 0.01 // units: degrees
+#define MAX_FIR_ERROR 1e-3
+#define MAX_PID_ERROR 0.01
+
+#define PID_P 1.2
+#define PID_I 0.5
+#define PID_D 0.05
+#define PID_I_MAX 20
+
+static const float fir_response[FIR_NUM_TAPS] = { 0.4, 0.3, 0.2, 0.1 };
+
+typedef struct {
+    double w, x, y, z;
+} Quat;
+
+static double uniform(double min, double max) {
+    return min + (max - min) * rand() / (double)RAND_MAX;
+}
+
+static Quat random_quat(void) {
+    for (;;) {
+        Quat q = { uniform(-1, 1), uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+        double n = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+        if (n < 0.1) {
+            continue;
+        }
+        q.w /= n;
+        q.x /= n;
+        q.y /= n;
+        q.z /= n;
+
+        // stay away from pitch +/- 90, where roll and yaw are ill conditioned
+        if (fabs(2 * (q.x * q.y + q.z * q.w)) < 0.98) {
+            return q;
+        }
+    }
+}
+
+static quaternion_t to_float(Quat q) {
+    quaternion_t result = { q.w, q.x, q.y, q.z };
+    return result;
+}
+
+static Quat product(Quat p, Quat q) {
+    Quat r = {
+        p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z,
+        p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y,
+        p.w * q.y - p.x * q.z + p.y * q.w + p.z * q.x,
+        p.w * q.z + p.x * q.y - p.y * q.x + p.z * q.w
+    };
+    double n = sqrt(r.w * r.w + r.x * r.x + r.y * r.y + r.z * r.z);
+    r.w /= n;
+    r.x /= n;
+    r.y /= n;
+    r.z /= n;
+    return r;
+}
+
+static double quat_error(quaternion_t a, Quat b) {
+    double e = fabs(a.w - b.w);
+    e = fmax(e, fabs(a.x - b.x));
+    e = fmax(e, fabs(a.y - b.y));
+    e = fmax(e, fabs(a.z - b.z));
+    return e;
+}
+
+static double angle_error(double a, double b) {
+    double e = fmod(fabs(a - b), 360);
+    return e > 180 ? 360 - e : e;
+}
+
+static int check(const char *name, double error, double max_error) {
+    printf("%-20s max error %.3g (limit %.3g)\n", name, error, max_error);
+    if (error > max_error) {
+        printf("error: %s exceeds its limit\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+static int test_quaternions(void) {
+    double product_error = 0;
+    double rotate_error = 0;
+    double roll_error = 0;
+    double pitch_error = 0;
+    double yaw_error = 0;
+    double euler_error = 0;
+
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        Quat p = random_quat();
+        Quat q = random_quat();
+        quaternion_t fp = to_float(p);
+        quaternion_t fq = to_float(q);
+
+        quaternion_t r = quaternion_product(&fp, &fq);
+        product_error = fmax(product_error, quat_error(r, product(p, q)));
+
+        double angle = uniform(-180, 180);
+        double half = angle * M_PI / 360;
+        Quat roll = { cos(half), sin(half), 0, 0 };
+        Quat pitch = { cos(half), 0, sin(half), 0 };
+
+        r = quaternion_rotate_roll(&fp, angle);
+        rotate_error = fmax(rotate_error, quat_error(r, product(p, roll)));
+        r = quaternion_rotate_pitch(&fp, angle);
+        rotate_error = fmax(rotate_error, quat_error(r, product(p, pitch)));
+
+        double ref = atan2(2 * p.x * p.w - 2 * p.y * p.z,
+            1 - 2 * p.x * p.x - 2 * p.z * p.z) * 180 / M_PI - 90;
+        roll_error = fmax(roll_error, angle_error(quaternion_get_roll(&fp), ref));
+
+        ref = asin(2 * p.x * p.y + 2 * p.z * p.w) * 180 / M_PI;
+        pitch_error = fmax(pitch_error, angle_error(quaternion_get_pitch(&fp), ref));
+
+        ref = atan2(2 * p.y * p.w - 2 * p.x * p.z,
+            1 - 2 * p.y * p.y - 2 * p.z * p.z) * 180 / M_PI;
+        yaw_error = fmax(yaw_error, angle_error(quaternion_get_yaw(&fp), ref));
+
+        euler_t euler;
+        quaternion_get_euler(&fp, &euler);
+        euler_error = fmax(euler_error, angle_error(euler.roll, quaternion_get_roll(&fp)));
+        euler_error = fmax(euler_error, angle_error(euler.pitch, quaternion_get_pitch(&fp)));
+        euler_error = fmax(euler_error, angle_error(euler.yaw, ref));
+    }
+
+    int failed = 0;
+    failed |= check("quaternion_product", product_error, MAX_QUATERNION_ERROR);
+    failed |= check("quaternion_rotate", rotate_error, MAX_QUATERNION_ERROR);
+    failed |= check("quaternion_get_roll", roll_error, MAX_ANGLE_ERROR);
+    failed |= check("quaternion_get_pitch", pitch_error, MAX_ANGLE_ERROR);
+    failed |= check("quaternion_get_yaw", yaw_error, MAX_ANGLE_ERROR);
+    failed |= check("quaternion_get_euler", euler_error, MAX_ANGLE_ERROR);
+    return failed;
+}
+
+// double precision version of fir_filter_calculate()
+typedef struct {
+    double buffer[FIR_NUM_TAPS];
+    int front;
+    int startup_counter;
+} Ref_Fir;
+
+static double ref_fir(Ref_Fir *fir, double input) {
+    fir->front = (fir->front + 1) % FIR_NUM_TAPS;
+    fir->buffer[fir->front] = input;
+
+    if (fir->startup_counter < FIR_NUM_TAPS) {
+        ++fir->startup_counter;
+        return input;
+    }
+
+    double result = 0;
+    for (int i = 0; i < FIR_NUM_TAPS; ++i) {
+        int index = (fir->front - i + FIR_NUM_TAPS) % FIR_NUM_TAPS;
+        result += fir->buffer[index] * fir_response[i];
+    }
+    return result;
+}
+
+static int test_fir(void) {
+    fir_inst_t fir;
+    fir_filter_init(&fir, fir_response);
+
+    Ref_Fir ref = { { 0 }, 0, 0 };
+
+    double error = 0;
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        double input = uniform(-1000, 1000);
+        error = fmax(error, fabs(fir_filter_calculate(&fir, input) - ref_fir(&ref, input)));
+    }
+
+    return check("fir_filter_calculate", error, MAX_FIR_ERROR);
+}
+
+static double constrain(double val, double min, double max) {
+    return val > max ? max : (val < min ? min : val);
+}
+
+static int test_pid(void) {
+    pid_inst_t pid;
+    pid_init(&pid, PID_P, PID_I, PID_D, PID_I_MAX);
+
+    // the same controller stepped with the caller measured dt
+    pid_inst_t pid_dt;
+    pid_init(&pid_dt, PID_P, PID_I, PID_D, PID_I_MAX);
+
+    Ref_Fir ref_d = { { 0 }, 0, 0 };
+    double ref_i = 0;
+    double ref_prev = 0;
+
+    double error = 0;
+    double dt_error = 0;
+    double t = 0;
+
+    pid_calculate(&pid, 0);
+    pid_calculate_dt(&pid_dt, 0, 0);
+
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        // alternate between the current loop rate and the 1 kHz goal
+        uint64_t dt_us = (n / 1000) % 2 ? 1000 : 20000;
+        double dt = dt_us / 1e6;
+        host_time_advance_us(dt_us);
+        t += dt;
+
+        double e = 30 * sin(t) + uniform(-2, 2);
+
+        double ref = PID_P * e;
+        ref_i = constrain(ref_i + dt * e, -PID_I_MAX / PID_I, PID_I_MAX / PID_I);
+        ref += constrain(PID_I * ref_i, -PID_I_MAX, PID_I_MAX);
+        ref += PID_D * ref_fir(&ref_d, (e - ref_prev) / dt);
+        ref_prev = e;
+        ref = constrain(ref, -PID_MAX_OUTPUT, PID_MAX_OUTPUT);
+
+        float output = pid_calculate(&pid, e);
+        error = fmax(error, fabs(output - ref));
+        dt_error = fmax(dt_error, fabs(pid_calculate_dt(&pid_dt, e, dt_us) - output));
+    }
+
+    // both variants must agree exactly when given the same dt
+    return check("pid_calculate", error, MAX_PID_ERROR) |
+        check("pid_calculate_dt", dt_error, 0);
+}
+
+int main(void) {
+    int failed = 0;
+
+    srand(1);
+
+#   if defined(MATH3D_FIXED_POINT) || defined(PID_FIXED_POINT) || defined(FIR_FIXED_POINT)
+        printf("arithmetic: fixed point\n");
+#   else
+        printf("arithmetic: float\n");
+#   endif
+
+    failed |= test_quaternions();
+    failed |= test_fir();
+    failed |= test_pid();
+
+    return failed;
+}
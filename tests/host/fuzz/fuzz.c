@@ -0,0 +1,437 @@
+#include "fuzz.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *fuzz_property_names[FUZZ_NUM_PROPERTIES] = {
+    "ok",
+    "outputs are numbers",
+    "outputs within bounds",
+    "motors at minimum while waiting",
+    "motors at minimum while the receiver failed",
+    "motors at minimum at low throttle",
+    "tstate within range and rate"
+};
+
+// values at which fc_calc() switches, and beyond the stick range
+static const float stick_values[] = {
+    FC_MIN_INPUT,
+    FC_CEN_INPUT,
+    FC_MAX_INPUT,
+    FC_MODE_SWITCH_THRESHOLD_1,
+    FC_MODE_SWITCH_THRESHOLD_2,
+    FC_MIN_INPUT + FC_DEAD_STICK,
+    FC_MIN_INPUT - 50,
+    FC_MAX_INPUT + 50
+};
+
+#define NUM_STICK_VALUES (sizeof(stick_values) / sizeof(stick_values[0]))
+
+static const uint32_t dt_values[] = {
+    0,
+    1,
+    FC_PERIOD_US / 2,
+    FC_PERIOD_US * 2,
+    1000000,
+    UINT32_MAX
+};
+
+#define NUM_DT_VALUES (sizeof(dt_values) / sizeof(dt_values[0]))
+
+// FC_RX_FAILED up to FC_OVERRUN, the flags the drivers set
+#define NUM_INPUT_FLAGS 5
+
+// splitmix64, every seed gives a full sequence
+static uint64_t next(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint32_t below(uint64_t *state, uint32_t n) {
+    return (uint32_t)(((next(state) >> 32) * n) >> 32);
+}
+
+// true once in n
+static bool one_in(uint64_t *state, uint32_t n) {
+    return below(state, n) == 0;
+}
+
+static float uniform(uint64_t *state, float min, float max) {
+    return min + (max - min) * ((next(state) >> 40) / 16777216.0f);
+}
+
+// sticks hold most steps, and move to a switching value or anywhere
+static float next_stick(uint64_t *state, float stick) {
+    if (!one_in(state, 8)) {
+        return stick;
+    }
+    if (one_in(state, 2)) {
+        return uniform(state, FC_MIN_INPUT - 50, FC_MAX_INPUT + 50);
+    }
+
+    stick = stick_values[below(state, NUM_STICK_VALUES)];
+    switch (below(state, 3)) {
+    case 0:
+        return nextafterf(stick, -INFINITY);
+    case 1:
+        return nextafterf(stick, INFINITY);
+    default:
+        return stick;
+    }
+}
+
+static quaternion_t next_orientation(uint64_t *state, quaternion_t q) {
+    if (one_in(state, 32)) {
+        switch (below(state, 4)) {
+        case 0:
+            q = (quaternion_t){ 1, 0, 0, 0 };
+            break;
+        case 1:
+            // pitch at the pole of the euler angles
+            q = (quaternion_t){ 0.70710678f, 0, 0, one_in(state, 2) ? 0.70710678f : -0.70710678f };
+            break;
+        default:
+            q = (quaternion_t){
+                uniform(state, -1, 1), uniform(state, -1, 1),
+                uniform(state, -1, 1), uniform(state, -1, 1)
+            };
+            break;
+        }
+    }
+
+    // wanders between jumps
+    q.w += uniform(state, -0.01f, 0.01f);
+    q.x += uniform(state, -0.01f, 0.01f);
+    q.y += uniform(state, -0.01f, 0.01f);
+    q.z += uniform(state, -0.01f, 0.01f);
+
+    if (quaternion_norm(&q) < 0.1f) {
+        q = (quaternion_t){ 1, 0, 0, 0 };
+    }
+    return quaternion_normalize(q);
+}
+
+uint64_t fuzz_sequence_seed(uint64_t seed, uint64_t n) {
+    uint64_t state = seed ^ (n * 0xd1342543de82ef95ull);
+    return next(&state);
+}
+
+void fuzz_generate(uint64_t seed, Fuzz_Step *steps, int num_steps) {
+    uint64_t state = seed;
+
+    Fuzz_Step step;
+    memset(&step, 0, sizeof(step));
+    step.input.thro = FC_MIN_INPUT;
+    step.input.orientation = (quaternion_t){ 1, 0, 0, 0 };
+
+    for (int n = 0; n < num_steps; ++n) {
+        Fc_Input *input = &step.input;
+        input->thro = next_stick(&state, input->thro);
+        input->elev = next_stick(&state, input->elev);
+        input->rudd = next_stick(&state, input->rudd);
+        input->aile = next_stick(&state, input->aile);
+        input->gear = next_stick(&state, input->gear);
+        input->aux1 = next_stick(&state, input->aux1);
+
+        input->orientation = next_orientation(&state, input->orientation);
+        if (one_in(&state, 64)) {
+            input->alt = uniform(&state, -100, 1000);
+        }
+
+        input->rates.x = uniform(&state, -2000, 2000);
+        input->rates.y = uniform(&state, -2000, 2000);
+        input->rates.z = uniform(&state, -2000, 2000);
+        if (one_in(&state, 64)) {
+            input->noise_hz = one_in(&state, 2) ? 0 : uniform(&state, 0, 500);
+        }
+
+        // failures come and go, FC_WAITING is only set by fc_calc()
+        if (one_in(&state, 16)) {
+            step.flags ^= 1 << below(&state, NUM_INPUT_FLAGS);
+        }
+
+        step.dt_us = FC_PERIOD_US;
+        if (one_in(&state, 8)) {
+            step.dt_us = one_in(&state, 2) ?
+                dt_values[below(&state, NUM_DT_VALUES)] :
+                below(&state, 4 * FC_PERIOD_US);
+        }
+
+#       ifdef FC_CASCADED
+            // the rate loop runs between and before runs of fc_calc()
+            step.rate = one_in(&state, 2);
+#       endif // FC_CASCADED
+
+        steps[n] = step;
+    }
+}
+
+static bool is_number(float val) {
+    return isfinite(val);
+}
+
+static bool in_bounds(float val) {
+    return (val >= FC_MIN_OUTPUT) && (val <= FC_MAX_OUTPUT);
+}
+
+static bool motors_off(const Fc_Output *output) {
+    return (output->right_motor == FC_MIN_OUTPUT) && (output->left_motor == FC_MIN_OUTPUT);
+}
+
+Fuzz_Property fuzz_check_safety(const Fc_State *fc, const Fuzz_Step *step, float last_tstate) {
+    const Fc_Output *output = &fc->output;
+
+    const float values[] = {
+        output->right_elevon, output->left_elevon,
+        output->right_motor, output->left_motor, output->gear,
+        fc->pid_out.roll, fc->pid_out.pitch, fc->pid_out.yaw,
+        fc->target_roll, fc->target_pitch, fc->target_yaw,
+        fc->tstate
+    };
+    for (size_t n = 0; n < sizeof(values) / sizeof(values[0]); ++n) {
+        if (!is_number(values[n])) {
+            return FUZZ_NAN;
+        }
+    }
+
+    if (!in_bounds(output->right_elevon) || !in_bounds(output->left_elevon) ||
+        !in_bounds(output->right_motor) || !in_bounds(output->left_motor) ||
+        !in_bounds(output->gear)) {
+        return FUZZ_OUTPUT_BOUNDS;
+    }
+
+    // fc_calc_rate() keeps the flags and input of the last fc_calc()
+    if (!motors_off(output)) {
+        if (fc->waiting || (fc->flags & FC_WAITING)) {
+            return FUZZ_MOTORS_WAITING;
+        }
+        if (fc->flags & FC_RX_FAILED) {
+            return FUZZ_MOTORS_RX_FAILED;
+        }
+        if (fc->input.thro < FC_MIN_INPUT + FC_DEAD_STICK) {
+            return FUZZ_MOTORS_LOW_THROTTLE;
+        }
+    }
+
+    if ((fc->tstate < FC_MIN_TSTATE) || (fc->tstate > FC_MAX_TSTATE)) {
+        return FUZZ_TSTATE;
+    }
+    if (!step->rate) {
+        // units: degrees
+        float max_change = fmaxf(FC_TSTATE_RATE_VERT, FC_TSTATE_RATE_HORZ) * (step->dt_us / 1000000.0f);
+        if (fabsf(fc->tstate - last_tstate) > max_change * 1.001f + 1e-4f) {
+            return FUZZ_TSTATE;
+        }
+    } else if (fc->tstate != last_tstate) {
+        return FUZZ_TSTATE;
+    }
+
+    return FUZZ_OK;
+}
+
+bool fuzz_run(const Fuzz_Step *steps, int num_steps, Fuzz_Check check, Fuzz_Failure *failure) {
+    Fc_State fc;
+    fc_init(&fc);
+
+    for (int n = 0; n < num_steps; ++n) {
+        const Fuzz_Step *step = &steps[n];
+        float last_tstate = fc.tstate;
+
+#       ifdef FC_CASCADED
+            if (step->rate) {
+                fc_calc_rate(&fc, &step->input.rates, step->dt_us);
+            } else {
+                fc_calc(&fc, &step->input, step->flags, step->dt_us);
+            }
+#       else
+            fc_calc(&fc, &step->input, step->flags, step->dt_us);
+#       endif // FC_CASCADED
+
+        Fuzz_Property property = check(&fc, step, last_tstate);
+        if (property != FUZZ_OK) {
+            failure->property = property;
+            failure->step = n;
+            return false;
+        }
+    }
+
+    failure->property = FUZZ_OK;
+    failure->step = num_steps;
+    return true;
+}
+
+// true if the steps fail the same property, which failure then holds
+static bool still_fails(const Fuzz_Step *steps, int num_steps, Fuzz_Check check,
+    Fuzz_Failure *failure) {
+    Fuzz_Failure result;
+    if (fuzz_run(steps, num_steps, check, &result) || (result.property != failure->property)) {
+        return false;
+    }
+    *failure = result;
+    return true;
+}
+
+// Deletes runs of steps, from half the sequence down to single steps. Steps
+// after the failing one are dropped whenever it moves.
+static bool shrink_steps(Fuzz_Step *steps, Fuzz_Step *candidate, int *num_steps,
+    Fuzz_Check check, Fuzz_Failure *failure) {
+    bool shrunk = false;
+
+    for (int size = *num_steps / 2; size >= 1; size /= 2) {
+        for (int start = 0; start + size <= *num_steps; ) {
+            int count = *num_steps - size;
+            memcpy(candidate, steps, start * sizeof(Fuzz_Step));
+            memcpy(candidate + start, steps + start + size, (count - start) * sizeof(Fuzz_Step));
+
+            if (still_fails(candidate, count, check, failure)) {
+                *num_steps = failure->step + 1;
+                memcpy(steps, candidate, *num_steps * sizeof(Fuzz_Step));
+                shrunk = true;
+            } else {
+                start += size;
+            }
+        }
+    }
+    return shrunk;
+}
+
+// Tries a simpler value for a field of step n, keeping it if the steps still
+// fail. Nothing is tried once the failure moved before step n.
+#define TRY_VALUE(field, value) do { \
+        __typeof__(field) saved = (field); \
+        if ((n < *num_steps) && (saved != (value))) { \
+            (field) = (value); \
+            if (still_fails(steps, *num_steps, check, failure)) { \
+                *num_steps = failure->step + 1; \
+                shrunk = true; \
+            } else { \
+                (field) = saved; \
+            } \
+        } \
+    } while (0)
+
+// Zero, then a stick end, then the nearest whole number. Stops at the value
+// the stick has, so shrinking never cycles between them.
+static bool shrink_stick(Fuzz_Step *steps, int *num_steps, Fuzz_Check check,
+    Fuzz_Failure *failure, int n, float *stick) {
+    static const float simpler[] = { FC_CEN_INPUT, FC_MIN_INPUT, FC_MAX_INPUT };
+    bool shrunk = false;
+
+    for (size_t i = 0; i < sizeof(simpler) / sizeof(simpler[0]); ++i) {
+        if (*stick == simpler[i]) {
+            return shrunk;
+        }
+        TRY_VALUE(*stick, simpler[i]);
+        if (*stick == simpler[i]) {
+            return shrunk;
+        }
+    }
+    TRY_VALUE(*stick, roundf(*stick));
+    return shrunk;
+}
+
+static bool shrink_values(Fuzz_Step *steps, int *num_steps, Fuzz_Check check,
+    Fuzz_Failure *failure) {
+    bool shrunk = false;
+
+    for (int n = 0; n < *num_steps; ++n) {
+        Fuzz_Step *step = &steps[n];
+        Fc_Input *input = &step->input;
+
+        TRY_VALUE(step->rate, false);
+
+        float *sticks[] = {
+            &input->thro, &input->elev, &input->rudd,
+            &input->aile, &input->gear, &input->aux1
+        };
+        for (size_t i = 0; i < sizeof(sticks) / sizeof(sticks[0]); ++i) {
+            shrunk |= shrink_stick(steps, num_steps, check, failure, n, sticks[i]);
+        }
+
+        for (int bit = 0; bit < NUM_INPUT_FLAGS; ++bit) {
+            TRY_VALUE(step->flags, step->flags & ~(1 << bit));
+        }
+        TRY_VALUE(step->dt_us, FC_PERIOD_US);
+
+        TRY_VALUE(input->orientation.w, 1.0f);
+        TRY_VALUE(input->orientation.x, 0.0f);
+        TRY_VALUE(input->orientation.y, 0.0f);
+        TRY_VALUE(input->orientation.z, 0.0f);
+
+        TRY_VALUE(input->alt, 0.0f);
+        TRY_VALUE(input->rates.x, 0.0f);
+        TRY_VALUE(input->rates.y, 0.0f);
+        TRY_VALUE(input->rates.z, 0.0f);
+        TRY_VALUE(input->noise_hz, 0.0f);
+    }
+    return shrunk;
+}
+
+#undef TRY_VALUE
+
+int fuzz_shrink(Fuzz_Step *steps, int num_steps, Fuzz_Check check, Fuzz_Failure *failure) {
+    if (!still_fails(steps, num_steps, check, failure)) {
+        return num_steps;
+    }
+    num_steps = failure->step + 1;
+
+    Fuzz_Step *candidate = malloc(num_steps * sizeof(Fuzz_Step));
+    if (!candidate) {
+        return num_steps;
+    }
+
+    // until neither pass finds anything simpler
+    bool shrunk = true;
+    while (shrunk) {
+        shrunk = shrink_steps(steps, candidate, &num_steps, check, failure);
+        shrunk |= shrink_values(steps, &num_steps, check, failure);
+    }
+
+    free(candidate);
+    return num_steps;
+}
+
+void fuzz_print(FILE *file, const Fuzz_Step *steps, int num_steps, const Fuzz_Failure *failure) {
+    fprintf(file, "// %s fails at step %d of %d\n",
+        fuzz_property_names[failure->property], failure->step, num_steps);
+    fprintf(file, "static const Fuzz_Step steps[] = {\n");
+
+    for (int n = 0; n < num_steps; ++n) {
+        const Fuzz_Step *step = &steps[n];
+        const Fc_Input *input = &step->input;
+        fprintf(file,
+            "    { .input = { .thro = %.9g, .elev = %.9g, .rudd = %.9g, .aile = %.9g,"
+            " .gear = %.9g, .aux1 = %.9g,\n"
+            "        .orientation = { %.9g, %.9g, %.9g, %.9g }, .alt = %.9g,"
+            " .rates = { %.9g, %.9g, %.9g }, .noise_hz = %.9g },\n"
+            "      .flags = %d, .dt_us = %lu, .rate = %s },\n",
+            input->thro, input->elev, input->rudd, input->aile, input->gear, input->aux1,
+            input->orientation.w, input->orientation.x, input->orientation.y, input->orientation.z,
+            input->alt, input->rates.x, input->rates.y, input->rates.z, input->noise_hz,
+            (int)step->flags, (unsigned long)step->dt_us, step->rate ? "true" : "false");
+    }
+    fprintf(file, "};\n");
+
+    // the state the failing step left
+    Fc_State fc;
+    fc_init(&fc);
+    for (int n = 0; n <= failure->step && n < num_steps; ++n) {
+#       ifdef FC_CASCADED
+            if (steps[n].rate) {
+                fc_calc_rate(&fc, &steps[n].input.rates, steps[n].dt_us);
+                continue;
+            }
+#       endif // FC_CASCADED
+        fc_calc(&fc, &steps[n].input, steps[n].flags, steps[n].dt_us);
+    }
+
+    fprintf(file, "// ctrl mode %d, flight mode %d, tstate %g, flags %d, %s\n",
+        fc.ctrl_mode, fc.flight_mode, fc.tstate, (int)fc.flags,
+        fc.waiting ? "waiting" : "armed");
+    fprintf(file, "// outputs: elevons %g %g, motors %g %g, gear %g\n",
+        fc.output.right_elevon, fc.output.left_elevon,
+        fc.output.right_motor, fc.output.left_motor, fc.output.gear);
+}
@@ -0,0 +1,84 @@
+// Property based fuzzing of fc_calc() on the host. Sequences of random
+// inputs, flags and loop times are generated from a seed and run through a
+// fresh flight controller, checking the safety properties after every step:
+// - no output, pid output or target is a NaN or infinite
+// - every output is within FC_MIN_OUTPUT and FC_MAX_OUTPUT
+// - the motors are at FC_MIN_OUTPUT while waiting, while the receiver has
+//   failed and while the throttle is within FC_DEAD_STICK of the minimum
+// - tstate stays within its range and changes no faster than a transition
+// The inputs are finite, as the drivers deliver them, and favour the values
+// where fc_calc() switches: the stick ends, the mode switch thresholds and
+// the dead stick. A failing sequence is shrunk to the fewest and simplest
+// steps that still fail the same property.
+#ifndef __FUZZ_H__
+#define __FUZZ_H__
+
+#include <stdio.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+
+// steps of a generated sequence, over 20 s of flight at the loop period
+#define FUZZ_SEQUENCE_STEPS 1000
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+    Fc_Input input;
+    Fc_Flags flags;
+    uint32_t dt_us;
+
+    // runs fc_calc_rate() on input.rates instead of fc_calc(), only
+    // generated with FC_CASCADED
+    bool rate;
+} Fuzz_Step;
+
+typedef enum {
+    FUZZ_OK = 0,
+    FUZZ_NAN,
+    FUZZ_OUTPUT_BOUNDS,
+    FUZZ_MOTORS_WAITING,
+    FUZZ_MOTORS_RX_FAILED,
+    FUZZ_MOTORS_LOW_THROTTLE,
+    FUZZ_TSTATE,
+    FUZZ_NUM_PROPERTIES
+} Fuzz_Property;
+
+extern const char *fuzz_property_names[FUZZ_NUM_PROPERTIES];
+
+// Checks fc after a step, last_tstate is its tstate before the step. Returns
+// the first property that does not hold, FUZZ_OK if all do.
+typedef Fuzz_Property (*Fuzz_Check)(const Fc_State *fc, const Fuzz_Step *step, float last_tstate);
+
+typedef struct {
+    Fuzz_Property property;
+    int step;
+} Fuzz_Failure;
+
+// the safety properties above
+Fuzz_Property fuzz_check_safety(const Fc_State *fc, const Fuzz_Step *step, float last_tstate);
+
+// seed of sequence n of a run, so any sequence can be generated on its own
+uint64_t fuzz_sequence_seed(uint64_t seed, uint64_t n);
+
+void fuzz_generate(uint64_t seed, Fuzz_Step *steps, int num_steps);
+
+// Runs the steps from fc_init() and stops at the first step that fails
+// check. Returns true if every step passed.
+bool fuzz_run(const Fuzz_Step *steps, int num_steps, Fuzz_Check check, Fuzz_Failure *failure);
+
+// Shrinks a sequence that fails in place, keeping it failing the property of
+// failure, which is updated. Returns the new number of steps.
+int fuzz_shrink(Fuzz_Step *steps, int num_steps, Fuzz_Check check, Fuzz_Failure *failure);
+
+// Prints the steps as initializers of a Fuzz_Step array, and the state the
+// failing step left
+void fuzz_print(FILE *file, const Fuzz_Step *steps, int num_steps, const Fuzz_Failure *failure);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __FUZZ_H__
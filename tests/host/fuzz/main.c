@@ -0,0 +1,203 @@
+// Fuzzes fc_calc() against its safety properties, see fuzz.h:
+//   fuzz [-j workers] [-t seconds] [-n sequences] [-l steps] [-s seed] [-r sequence]
+//   -j 0, the default, runs one worker per core
+//   -t runs for a time, 60 s unless -n is given
+//   -n runs a number of sequences instead
+//   -l sets the steps of each sequence, FUZZ_SEQUENCE_STEPS
+//   -s sets the seed of the run, each sequence has a seed of its own
+//   -r runs only the given sequence of the seed, to reproduce a failure
+// The first failing sequence is shrunk and printed as steps that can be
+// pasted into a test. Exits with 1 if any sequence failed.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fuzz.h"
+#include "pool.h"
+
+// sequences of each task
+#define BLOCK_SEQUENCES 64
+
+// tasks per worker between looks at the clock
+#define BLOCKS_PER_ROUND 8
+
+#define DEFAULT_SECONDS 60
+
+typedef struct {
+    uint64_t seed;
+    int num_steps;
+
+    atomic_uint_fast64_t steps;
+
+    // the first sequence that failed, UINT64_MAX while none has
+    pthread_mutex_t lock;
+    uint64_t failed;
+    Fuzz_Failure failure;
+} Fuzzer;
+
+typedef struct {
+    Fuzzer *fuzzer;
+    uint64_t first; // sequence
+    uint64_t count;
+} Block;
+
+static void block_task(void *arg) {
+    Block *block = arg;
+    Fuzzer *fuzzer = block->fuzzer;
+
+    Fuzz_Step *steps = malloc(fuzzer->num_steps * sizeof(Fuzz_Step));
+    if (!steps) {
+        return;
+    }
+
+    uint64_t steps_run = 0;
+    for (uint64_t n = block->first; n < block->first + block->count; ++n) {
+        fuzz_generate(fuzz_sequence_seed(fuzzer->seed, n), steps, fuzzer->num_steps);
+
+        Fuzz_Failure failure;
+        bool ok = fuzz_run(steps, fuzzer->num_steps, fuzz_check_safety, &failure);
+        steps_run += failure.step + !ok;
+
+        if (!ok) {
+            pthread_mutex_lock(&fuzzer->lock);
+            if (n < fuzzer->failed) {
+                fuzzer->failed = n;
+                fuzzer->failure = failure;
+            }
+            pthread_mutex_unlock(&fuzzer->lock);
+            break;
+        }
+    }
+
+    atomic_fetch_add(&fuzzer->steps, steps_run);
+    free(steps);
+}
+
+static double elapsed_s(const struct timespec *begin, const struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j workers] [-t seconds] [-n sequences] [-l steps] [-s seed]"
+        " [-r sequence]\n", name);
+}
+
+int main(int argc, char **argv) {
+    int workers = 0;
+    double seconds = DEFAULT_SECONDS;
+    uint64_t sequences = 0;
+    uint64_t reproduce = UINT64_MAX;
+
+    static Fuzzer fuzzer;
+    fuzzer.seed = 1;
+    fuzzer.num_steps = FUZZ_SEQUENCE_STEPS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:t:n:l:s:r:")) != -1) {
+        switch (opt) {
+            case 'j': workers = atoi(optarg); break;
+            case 't': seconds = atof(optarg); break;
+            case 'n': sequences = strtoull(optarg, NULL, 0); break;
+            case 'l': fuzzer.num_steps = atoi(optarg); break;
+            case 's': fuzzer.seed = strtoull(optarg, NULL, 0); break;
+            case 'r': reproduce = strtoull(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if ((optind != argc) || (fuzzer.num_steps < 1)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    pthread_mutex_init(&fuzzer.lock, NULL);
+    fuzzer.failed = UINT64_MAX;
+
+    struct timespec begin, now;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    uint64_t sequences_run = 0;
+    int num_workers = 1;
+
+    if (reproduce != UINT64_MAX) {
+        Block block = { &fuzzer, reproduce, 1 };
+        block_task(&block);
+        sequences_run = 1;
+    } else {
+        static Pool pool;
+        if (!pool_init(&pool, workers)) {
+            fprintf(stderr, "error: could not start the workers\n");
+            return EXIT_FAILURE;
+        }
+        num_workers = pool.num_workers;
+
+        int blocks_per_round = num_workers * BLOCKS_PER_ROUND;
+        Block *blocks = calloc(blocks_per_round, sizeof(Block));
+        if (!blocks) {
+            fprintf(stderr, "error: out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        // in rounds, until the sequences or the time are used up or one fails
+        bool done = false;
+        while (!done) {
+            for (int n = 0; n < blocks_per_round; ++n) {
+                uint64_t count = BLOCK_SEQUENCES;
+                if (sequences && (sequences - sequences_run < count)) {
+                    count = sequences - sequences_run;
+                }
+                if (!count) {
+                    break;
+                }
+
+                blocks[n] = (Block){ &fuzzer, sequences_run, count };
+                sequences_run += count;
+                pool_submit(&pool, block_task, &blocks[n]);
+            }
+            pool_wait(&pool);
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            done = (fuzzer.failed != UINT64_MAX) ||
+                (sequences ? sequences_run >= sequences : elapsed_s(&begin, &now) >= seconds);
+        }
+
+        free(blocks);
+        pool_destroy(&pool);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double wall_s = elapsed_s(&begin, &now);
+    uint64_t steps = atomic_load(&fuzzer.steps);
+
+    printf("%llu sequences, %llu steps in %.2f s on %d workers, %.1f million steps per minute\n",
+        (unsigned long long)sequences_run, (unsigned long long)steps, wall_s, num_workers,
+        steps / wall_s * 60 / 1e6);
+
+    if (fuzzer.failed == UINT64_MAX) {
+        return EXIT_SUCCESS;
+    }
+
+    Fuzz_Step *steps_failed = malloc(fuzzer.num_steps * sizeof(Fuzz_Step));
+    if (!steps_failed) {
+        fprintf(stderr, "error: out of memory\n");
+        return EXIT_FAILURE;
+    }
+    fuzz_generate(fuzz_sequence_seed(fuzzer.seed, fuzzer.failed), steps_failed, fuzzer.num_steps);
+
+    printf("sequence %llu fails %s at step %d, reproduce with -s %llu -r %llu -l %d\n",
+        (unsigned long long)fuzzer.failed, fuzz_property_names[fuzzer.failure.property],
+        fuzzer.failure.step, (unsigned long long)fuzzer.seed,
+        (unsigned long long)fuzzer.failed, fuzzer.num_steps);
+
+    Fuzz_Failure failure = fuzzer.failure;
+    int num_steps = fuzz_shrink(steps_failed, fuzzer.num_steps, fuzz_check_safety, &failure);
+    fuzz_print(stdout, steps_failed, num_steps, &failure);
+
+    free(steps_failed);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,15 @@
+// Host stand-in for hardware/clocks.h
+#ifndef __HOST_HARDWARE_CLOCKS_H__
+#define __HOST_HARDWARE_CLOCKS_H__
+
+#include <stdint.h>
+
+enum clock_index {
+    clk_sys = 5
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) {
+    return 125000000;
+}
+
+#endif // __HOST_HARDWARE_CLOCKS_H__
@@ -0,0 +1,37 @@
+// Host stand-in for hardware/flash.h. The flash is an array in host memory
+// with the behaviour of nor flash: erasing sets every bit and programming can
+// only clear bits. Both take their typical time on the virtual clock.
+#ifndef __HOST_HARDWARE_FLASH_H__
+#define __HOST_HARDWARE_FLASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define FLASH_BLOCK_SIZE (1u << 16)
+
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+// typical times of the w25q16jv on the pico
+#define HOST_FLASH_PAGE_PROGRAM_US 400
+#define HOST_FLASH_SECTOR_ERASE_US 45000
+#define HOST_FLASH_BLOCK_ERASE_US 150000
+
+extern uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+// flash is read through its memory mapping
+#define XIP_BASE ((uintptr_t)host_flash)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_HARDWARE_FLASH_H__
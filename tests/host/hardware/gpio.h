@@ -0,0 +1,32 @@
+// Host stand-in for hardware/gpio.h, the pins are not connected to anything
+#ifndef __HOST_HARDWARE_GPIO_H__
+#define __HOST_HARDWARE_GPIO_H__
+
+#include <stdbool.h>
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+#define GPIO_IRQ_EDGE_RISE 0x8u
+
+enum gpio_function {
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+static inline void gpio_init(unsigned int gpio) {}
+static inline void gpio_set_dir(unsigned int gpio, bool out) {}
+static inline void gpio_put(unsigned int gpio, bool value) {}
+static inline void gpio_pull_up(unsigned int gpio) {}
+static inline void gpio_pull_down(unsigned int gpio) {}
+static inline void gpio_set_function(unsigned int gpio, enum gpio_function fn) {}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_HARDWARE_GPIO_H__
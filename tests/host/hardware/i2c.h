@@ -0,0 +1,17 @@
+// Host stand-in for hardware/i2c.h. There is no bus, the simulated drivers
+// only keep the instance pointer.
+#ifndef __HOST_HARDWARE_I2C_H__
+#define __HOST_HARDWARE_I2C_H__
+
+typedef struct i2c_inst {
+    unsigned int baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst;
+
+static inline unsigned int i2c_init(i2c_inst_t *i2c, unsigned int baudrate) {
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+#endif // __HOST_HARDWARE_I2C_H__
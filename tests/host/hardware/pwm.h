@@ -0,0 +1,4 @@
+// Host stand-in for hardware/pwm.h, only used by drivers that are simulated
+#ifndef __HOST_HARDWARE_PWM_H__
+#define __HOST_HARDWARE_PWM_H__
+#endif // __HOST_HARDWARE_PWM_H__
@@ -0,0 +1,22 @@
+// Host stand-in for hardware/structs/systick.h. The counter does not run,
+// so profiled phases measure zero cycles.
+#ifndef __HOST_HARDWARE_STRUCTS_SYSTICK_H__
+#define __HOST_HARDWARE_STRUCTS_SYSTICK_H__
+
+#include <stdint.h>
+
+#define M0PLUS_SYST_CSR_CLKSOURCE_BITS 0x00000004u
+#define M0PLUS_SYST_CSR_ENABLE_BITS 0x00000001u
+
+typedef struct {
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+} systick_hw_t;
+
+extern systick_hw_t host_systick;
+
+#define systick_hw (&host_systick)
+
+#endif // __HOST_HARDWARE_STRUCTS_SYSTICK_H__
@@ -0,0 +1,31 @@
+// Host stand-in for hardware/sync.h. Waiting for an event moves the virtual
+// clock to the next timer callback, so scheduled loops run as fast as the
+// host can execute them.
+#ifndef __HOST_HARDWARE_SYNC_H__
+#define __HOST_HARDWARE_SYNC_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+void __sev(void);
+void __wfe(void);
+
+// the cores never run at the same time, see pico/multicore.h
+static inline void __dmb(void) {}
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {}
+
+unsigned int get_core_num(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_HARDWARE_SYNC_H__
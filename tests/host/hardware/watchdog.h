@@ -0,0 +1,22 @@
+// Host stand-in for hardware/watchdog.h
+#ifndef __HOST_HARDWARE_WATCHDOG_H__
+#define __HOST_HARDWARE_WATCHDOG_H__
+
+// like the sdk header, brings in the platform basics through pico.h
+#include "pico/stdlib.h"
+
+// exit status of a host program that tried to reboot
+#define HOST_EXIT_REBOOT 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// ends the host program, a reboot can not be simulated
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_HARDWARE_WATCHDOG_H__
@@ -0,0 +1,70 @@
+// Host implementations of the pico sdk peripherals used by src/main.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/bootrom.h"
+#include "hardware/flash.h"
+#include "hardware/i2c.h"
+#include "hardware/structs/systick.h"
+#include "hardware/watchdog.h"
+
+i2c_inst_t i2c0_inst;
+
+systick_hw_t host_systick;
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+bool stdio_init_all(void) {
+    return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    busy_wait_until(get_absolute_time() + timeout_us);
+    return PICO_ERROR_TIMEOUT;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    if (flash_offs % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "host: flash erase of %zu bytes at %u is not sector aligned\n",
+            count, (unsigned)flash_offs);
+        abort();
+    }
+
+    memset(host_flash + flash_offs, 0xFF, count);
+
+    // the sdk erases whole blocks where it can
+    uint64_t blocks = count / FLASH_BLOCK_SIZE;
+    uint64_t sectors = (count % FLASH_BLOCK_SIZE) / FLASH_SECTOR_SIZE;
+    host_time_advance_us(blocks * HOST_FLASH_BLOCK_ERASE_US +
+        sectors * HOST_FLASH_SECTOR_ERASE_US);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    if (flash_offs % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE ||
+        flash_offs + count > PICO_FLASH_SIZE_BYTES) {
+        fprintf(stderr, "host: flash program of %zu bytes at %u is not page aligned\n",
+            count, (unsigned)flash_offs);
+        abort();
+    }
+
+    // programming can only clear bits
+    for (size_t i = 0; i < count; ++i) {
+        host_flash[flash_offs + i] &= data[i];
+    }
+
+    host_time_advance_us(count / FLASH_PAGE_SIZE * HOST_FLASH_PAGE_PROGRAM_US);
+}
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+    fflush(stdout);
+    exit(HOST_EXIT_REBOOT);
+}
+
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask) {
+    fflush(stdout);
+    exit(HOST_EXIT_REBOOT);
+}
@@ -0,0 +1,176 @@
+#include <stddef.h>
+#include <ucontext.h>
+
+#include "pico/time.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+// stack of the core1 coroutine, the rp2040 gives core1 4 kB but the host
+// compiler and libc need more
+#define CORE1_STACK_SIZE (256 * 1024)
+
+static absolute_time_t now_us;
+
+static repeating_timer_t *timer;
+static bool event;
+
+// core1 is a coroutine that runs from core0's waits until it waits itself
+static ucontext_t core0_context;
+static ucontext_t core1_context;
+static void (*core1_entry)(void);
+static bool core1_launched;
+static bool core1_victim;
+static absolute_time_t core1_wake;
+static unsigned int core_num;
+
+absolute_time_t get_absolute_time(void) {
+    return now_us;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+    return (int64_t)(to - from);
+}
+
+static uint64_t timer_period_us(const repeating_timer_t *t) {
+    return t->delay_us < 0 ? (uint64_t)-t->delay_us : (uint64_t)t->delay_us;
+}
+
+// runs the timer callback and sets the time it runs next
+static void run_timer(void) {
+    repeating_timer_t *t = timer;
+    if (!t->callback(t)) {
+        timer = NULL;
+    } else if (t->delay_us < 0) {
+        t->target += timer_period_us(t);
+    } else {
+        t->target = now_us + timer_period_us(t);
+    }
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+    void *user_data, repeating_timer_t *out) {
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->target = now_us + timer_period_us(out);
+
+    timer = out;
+    return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *t) {
+    if (timer != t) {
+        return false;
+    }
+    timer = NULL;
+    return true;
+}
+
+void host_time_advance_us(uint64_t us) {
+    uint64_t end_us = now_us + us;
+
+    // stop at every callback so it sees the time it was due at
+    while (timer && timer->target <= end_us) {
+        if (timer->target > now_us) {
+            now_us = timer->target;
+        }
+        run_timer();
+    }
+    now_us = end_us;
+}
+
+// runs core1 from its wake time until it waits again
+static void run_core1(void) {
+    if (core1_wake > now_us) {
+        now_us = core1_wake;
+    }
+
+    core_num = 1;
+    swapcontext(&core0_context, &core1_context);
+    core_num = 0;
+}
+
+// Waits on core0 until the time end, or until an event if wake_on_event.
+// core1 and the timer run at the times they are due, core1 first on a tie.
+static void core0_wait(absolute_time_t end, bool wake_on_event) {
+    for (;;) {
+        if (wake_on_event && event) {
+            event = false;
+            return;
+        }
+        if (!wake_on_event && now_us >= end) {
+            return;
+        }
+        // nothing can wake the host up
+        if (wake_on_event && !timer && !core1_launched) {
+            return;
+        }
+
+        absolute_time_t next = end;
+        if (timer && timer->target < next) {
+            next = timer->target;
+        }
+
+        if (core1_launched && core1_wake <= next) {
+            run_core1();
+        } else {
+            host_time_advance_us(next > now_us ? next - now_us : 0);
+        }
+    }
+}
+
+void busy_wait_until(absolute_time_t time) {
+    if (core_num == 1) {
+        core1_wake = time;
+        swapcontext(&core1_context, &core0_context);
+    } else {
+        core0_wait(time, false);
+    }
+}
+
+void __sev(void) {
+    event = true;
+}
+
+void __wfe(void) {
+    if (core_num == 1) {
+        // core1 only waits on time in this project
+        busy_wait_until(now_us);
+    } else {
+        core0_wait(UINT64_MAX, true);
+    }
+}
+
+unsigned int get_core_num(void) {
+    return core_num;
+}
+
+static void core1_trampoline(void) {
+    core1_entry();
+
+    // returning from the core1 entry halts the core
+    core1_launched = false;
+    swapcontext(&core1_context, &core0_context);
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    static char stack[CORE1_STACK_SIZE];
+
+    getcontext(&core1_context);
+    core1_context.uc_stack.ss_sp = stack;
+    core1_context.uc_stack.ss_size = sizeof(stack);
+    core1_context.uc_link = NULL;
+    makecontext(&core1_context, core1_trampoline, 0);
+
+    core1_entry = entry;
+    core1_wake = now_us;
+    core1_launched = true;
+}
+
+void multicore_lockout_victim_init(void) {
+    core1_victim = true;
+}
+
+bool multicore_lockout_victim_is_initialized(unsigned int core_num) {
+    return core_num == 1 && core1_victim;
+}
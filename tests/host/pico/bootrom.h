@@ -0,0 +1,18 @@
+// Host stand-in for pico/bootrom.h
+#ifndef __HOST_PICO_BOOTROM_H__
+#define __HOST_PICO_BOOTROM_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+// ends the host program with HOST_EXIT_REBOOT, there is no bootloader
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_PICO_BOOTROM_H__
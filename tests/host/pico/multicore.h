@@ -0,0 +1,25 @@
+// Host stand-in for pico/multicore.h. core1 runs as a coroutine on the host
+// thread and only runs while core0 waits, see host_time.c. Since the cores
+// never run at the same time, the lockout does nothing.
+#ifndef __HOST_PICO_MULTICORE_H__
+#define __HOST_PICO_MULTICORE_H__
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+void multicore_launch_core1(void (*entry)(void));
+
+void multicore_lockout_victim_init(void);
+bool multicore_lockout_victim_is_initialized(unsigned int core_num);
+
+static inline void multicore_lockout_start_blocking(void) {}
+static inline void multicore_lockout_end_blocking(void) {}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_PICO_MULTICORE_H__
@@ -0,0 +1,25 @@
+// Host stand-in for pico/stdio.h. printf goes to the host stdout and there is
+// never any usb input.
+#ifndef __HOST_PICO_STDIO_H__
+#define __HOST_PICO_STDIO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define PICO_ERROR_TIMEOUT -1
+
+bool stdio_init_all(void);
+
+// waits out the timeout on the virtual clock
+int getchar_timeout_us(uint32_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_PICO_STDIO_H__
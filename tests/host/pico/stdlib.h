@@ -0,0 +1,17 @@
+// Host stand-in for the parts of the pico sdk used by the platform
+// independent sources under test
+#ifndef __HOST_PICO_STDLIB_H__
+#define __HOST_PICO_STDLIB_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/stdio.h"
+#include "pico/time.h"
+
+typedef unsigned int uint;
+
+static inline void tight_loop_contents(void) {}
+
+#endif // __HOST_PICO_STDLIB_H__
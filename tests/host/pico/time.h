@@ -0,0 +1,67 @@
+// Host stand-in for pico/time.h. Time only moves when a test advances it, so
+// timing dependent code runs deterministically.
+#ifndef __HOST_PICO_TIME_H__
+#define __HOST_PICO_TIME_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time(void);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+    return t;
+}
+
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) {
+    return t + us;
+}
+
+static inline uint32_t time_us_32(void) {
+    return (uint32_t)get_absolute_time();
+}
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *timer);
+
+struct repeating_timer {
+    int64_t delay_us;
+    repeating_timer_callback_t callback;
+    void *user_data;
+
+    absolute_time_t target; // host only, next time the callback fires
+};
+
+// On core0, waits on the virtual clock while core1 and the timer run. On
+// core1, hands the host thread back to core0 until time.
+void busy_wait_until(absolute_time_t time);
+
+static inline void sleep_us(uint64_t us) {
+    busy_wait_until(get_absolute_time() + us);
+}
+
+static inline void sleep_ms(uint32_t ms) {
+    sleep_us(1000ull * ms);
+}
+
+// Only one timer can run at a time. A negative delay fixes the period from
+// the previous target, a positive one from the end of the callback, which
+// take no virtual time here.
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback,
+    void *user_data, repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+// moves the virtual clock forward, running the timer callbacks that fall due
+void host_time_advance_us(uint64_t us);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __HOST_PICO_TIME_H__
@@ -0,0 +1,290 @@
+#include "plant.h"
+
+// the imu reads level with the aircraft rolled 90 degrees from its frame, see
+// quaternion_get_roll() and tests/sim_input.py
+static const quaternion_t imu_mount = { 0.70710678f, 0.70710678f, 0.0f, 0.0f };
+
+static inline vector_t vector_add(vector_t a, vector_t b, float scale) {
+    vector_t result = {
+        a.x + b.x * scale,
+        a.y + b.y * scale,
+        a.z + b.z * scale
+    };
+    return result;
+}
+
+static inline vector_t vector_cross(vector_t a, vector_t b) {
+    vector_t result = {
+        a.y * b.z - a.z * b.y,
+        a.z * b.x - a.x * b.z,
+        a.x * b.y - a.y * b.x
+    };
+    return result;
+}
+
+// rotates v from the body frame to the world frame by q
+static vector_t rotate(const quaternion_t *q, vector_t v) {
+    // v + 2 w (u x v) + 2 u x (u x v), with u the vector part of q
+    vector_t u = { q->x, q->y, q->z };
+    vector_t t = vector_cross(u, v);
+    t.x *= 2;
+    t.y *= 2;
+    t.z *= 2;
+    return vector_add(vector_add(v, t, q->w), vector_cross(u, t), 1.0f);
+}
+
+static vector_t rotate_inverse(const quaternion_t *q, vector_t v) {
+    quaternion_t conjugate = { q->w, -q->x, -q->y, -q->z };
+    return rotate(&conjugate, v);
+}
+
+static inline float constrainf(float val, float min, float max) {
+    if (val < min) {
+        return min;
+    } else if (val > max) {
+        return max;
+    } else {
+        return val;
+    }
+}
+
+// thrust of an output of -100 to 100, units: N
+static float motor_thrust(float output) {
+    float throttle = constrainf((output - FC_MIN_OUTPUT) / (FC_MAX_OUTPUT - FC_MIN_OUTPUT), 0, 1);
+    return PLANT_MOTOR_MAX_THRUST * throttle * throttle;
+}
+
+// deflection of an output of -100 to 100, units: degrees
+static float elevon_deflection(float output) {
+    return constrainf(output, FC_MIN_OUTPUT, FC_MAX_OUTPUT) / FC_MAX_OUTPUT *
+        PLANT_ELEVON_MAX_DEFLECTION;
+}
+
+// Forces and moments on the body in the body frame, from the actuators as
+// they are and the motion of body. The force includes gravity.
+static void get_loads(const Plant *plant, const Plant_Body *body, vector_t *force, vector_t *moment) {
+    const float thrust_r = plant->motor_thrust[PLANT_RIGHT];
+    const float thrust_l = plant->motor_thrust[PLANT_LEFT];
+
+    vector_t air = rotate_inverse(&body->attitude, body->velocity);
+    float airspeed_xz = sqrtf(air.x * air.x + air.z * air.z);
+    float pressure = 0.5f * PLANT_AIR_DENSITY * (airspeed_xz * airspeed_xz + air.y * air.y);
+
+    *force = (vector_t){ thrust_r + thrust_l, 0, 0 };
+    *moment = (vector_t){ 0, 0, PLANT_MOTOR_ARM * (thrust_r - thrust_l) };
+
+    // flat plate wing, lift across and drag along the flow in the xz plane
+    if (airspeed_xz > 0.01f) {
+        float sin_a = air.z / airspeed_xz;
+        float cos_a = air.x / airspeed_xz;
+        float lift = 2 * sin_a * cos_a;
+        float drag = PLANT_WING_DRAG + 2 * sin_a * sin_a;
+        float scale = pressure * PLANT_WING_AREA / airspeed_xz;
+
+        force->x += scale * (lift * air.z - drag * air.x);
+        force->z += scale * (-lift * air.x - drag * air.z);
+
+        moment->y -= pressure * PLANT_WING_AREA * PLANT_WING_CHORD *
+            PLANT_WING_STABILITY * 2 * sin_a * cos_a;
+    }
+    force->y -= 0.5f * PLANT_AIR_DENSITY * PLANT_SIDE_AREA * fabsf(air.y) * air.y;
+
+    // elevons in the airflow and the wash of the prop in front of them
+    float wash_r = thrust_r / PLANT_PROP_AREA;
+    float wash_l = thrust_l / PLANT_PROP_AREA;
+    float lift_slope = PLANT_ELEVON_AREA * PLANT_ELEVON_LIFT_SLOPE * RADIANS_PER_DEGREE;
+    float elevon_r = (pressure + wash_r) * lift_slope * plant->elevon[PLANT_RIGHT];
+    float elevon_l = (pressure + wash_l) * lift_slope * plant->elevon[PLANT_LEFT];
+
+    force->z += elevon_r + elevon_l;
+    moment->x += PLANT_ELEVON_ARM_Y * (elevon_l - elevon_r);
+    moment->y += PLANT_ELEVON_ARM_X * (elevon_r + elevon_l);
+
+    // the damping of the wing grows with the airspeed
+    float airspeed = sqrtf(airspeed_xz * airspeed_xz + air.y * air.y);
+    float damping = PLANT_DAMPING + 0.25f * PLANT_AIR_DENSITY * airspeed *
+        PLANT_WING_AREA * PLANT_WING_CHORD * PLANT_WING_CHORD * PLANT_WING_DAMPING;
+    *moment = vector_add(*moment, body->rates, -damping);
+
+    vector_t gravity = rotate_inverse(&body->attitude, (vector_t){ 0, 0, PLANT_MASS * PLANT_GRAVITY });
+    *force = vector_add(*force, gravity, 1.0f);
+}
+
+static Plant_Body get_derivative(const Plant *plant, const Plant_Body *body) {
+    vector_t force, moment;
+    get_loads(plant, body, &force, &moment);
+
+    const vector_t inertia = { PLANT_INERTIA_X, PLANT_INERTIA_Y, PLANT_INERTIA_Z };
+    const vector_t *w = &body->rates;
+    vector_t momentum = { inertia.x * w->x, inertia.y * w->y, inertia.z * w->z };
+    vector_t torque = vector_add(moment, vector_cross(*w, momentum), -1.0f);
+
+    const quaternion_t *q = &body->attitude;
+
+    Plant_Body derivative = {
+        .position = body->velocity,
+        .velocity = rotate(q, (vector_t){
+            force.x / PLANT_MASS,
+            force.y / PLANT_MASS,
+            force.z / PLANT_MASS
+        }),
+        // half the product of q with the rates
+        .attitude = {
+            0.5f * (-q->x * w->x - q->y * w->y - q->z * w->z),
+            0.5f * (q->w * w->x + q->y * w->z - q->z * w->y),
+            0.5f * (q->w * w->y - q->x * w->z + q->z * w->x),
+            0.5f * (q->w * w->z + q->x * w->y - q->y * w->x)
+        },
+        .rates = { torque.x / inertia.x, torque.y / inertia.y, torque.z / inertia.z }
+    };
+    return derivative;
+}
+
+static Plant_Body body_add(const Plant_Body *body, const Plant_Body *derivative, float h) {
+    Plant_Body result = {
+        .position = vector_add(body->position, derivative->position, h),
+        .velocity = vector_add(body->velocity, derivative->velocity, h),
+        .attitude = {
+            body->attitude.w + derivative->attitude.w * h,
+            body->attitude.x + derivative->attitude.x * h,
+            body->attitude.y + derivative->attitude.y * h,
+            body->attitude.z + derivative->attitude.z * h
+        },
+        .rates = vector_add(body->rates, derivative->rates, h)
+    };
+    return result;
+}
+
+static void update_actuators(Plant *plant, float dt) {
+    float lag = 1 - expf(-dt / PLANT_MOTOR_LAG_S);
+    float max_move = PLANT_SERVO_RATE * dt;
+
+    for (int side = 0; side < PLANT_SIDES; ++side) {
+        plant->motor_thrust[side] += (plant->motor_cmd[side] - plant->motor_thrust[side]) * lag;
+
+        float move = plant->elevon_cmd[side] - plant->elevon[side];
+        plant->elevon[side] += constrainf(move, -max_move, max_move);
+    }
+}
+
+// Stays on the ground until the thrust lifts the aircraft off, and stops on
+// it when it comes down
+static void update_ground(Plant *plant) {
+    Plant_Body *body = &plant->body;
+    const float ground_z = -PLANT_GROUND_ALT;
+
+    if (plant->on_ground) {
+        vector_t thrust = { plant->motor_thrust[PLANT_RIGHT] + plant->motor_thrust[PLANT_LEFT], 0, 0 };
+        if (rotate(&body->attitude, thrust).z < -PLANT_MASS * PLANT_GRAVITY) {
+            plant->on_ground = false;
+        }
+    } else if (body->position.z > ground_z) {
+        plant->on_ground = true;
+        plant->touchdown_speed = plant_get_airspeed(plant);
+    }
+
+    if (plant->on_ground) {
+        body->position.z = ground_z;
+        body->velocity = (vector_t){ 0, 0, 0 };
+        body->rates = (vector_t){ 0, 0, 0 };
+    }
+}
+
+// one fourth order runge kutta step with the actuators held
+static void step_body(Plant *plant, float dt) {
+    const Plant_Body *y = &plant->body;
+
+    Plant_Body k1 = get_derivative(plant, y);
+    Plant_Body y2 = body_add(y, &k1, 0.5f * dt);
+    Plant_Body k2 = get_derivative(plant, &y2);
+    Plant_Body y3 = body_add(y, &k2, 0.5f * dt);
+    Plant_Body k3 = get_derivative(plant, &y3);
+    Plant_Body y4 = body_add(y, &k3, dt);
+    Plant_Body k4 = get_derivative(plant, &y4);
+
+    Plant_Body next = body_add(y, &k1, dt / 6);
+    next = body_add(&next, &k2, dt / 3);
+    next = body_add(&next, &k3, dt / 3);
+    next = body_add(&next, &k4, dt / 6);
+    next.attitude = quaternion_normalize(next.attitude);
+
+    plant->body = next;
+}
+
+static void init(Plant *plant) {
+    plant->body.position = (vector_t){ 0, 0, -PLANT_GROUND_ALT };
+    plant->body.velocity = (vector_t){ 0, 0, 0 };
+    plant->body.attitude = (quaternion_t){ 1, 0, 0, 0 };
+    plant->body.rates = (vector_t){ 0, 0, 0 };
+
+    for (int side = 0; side < PLANT_SIDES; ++side) {
+        plant->motor_cmd[side] = 0;
+        plant->motor_thrust[side] = 0;
+        plant->elevon_cmd[side] = 0;
+        plant->elevon[side] = 0;
+    }
+
+    plant->on_ground = false;
+    plant->touchdown_speed = 0;
+    plant->pending_us = 0;
+    plant->time_us = 0;
+}
+
+void plant_init_ground(Plant *plant) {
+    init(plant);
+
+    // pitched up 90 degrees, nose to the sky
+    const quaternion_t level = { 1, 0, 0, 0 };
+    plant->body.attitude = quaternion_rotate_pitch(&level, 90);
+    plant->on_ground = true;
+}
+
+void plant_init_level(Plant *plant, float alt, float speed) {
+    init(plant);
+
+    plant->body.position.z = -alt;
+    plant->body.velocity.x = speed;
+}
+
+void plant_set_output(Plant *plant, const Fc_Output *output) {
+    plant->motor_cmd[PLANT_RIGHT] = motor_thrust(output->right_motor) * PLANT_RIGHT_MOTOR_EFFICIENCY;
+    plant->motor_cmd[PLANT_LEFT] = motor_thrust(output->left_motor);
+    plant->elevon_cmd[PLANT_RIGHT] = elevon_deflection(output->right_elevon);
+    plant->elevon_cmd[PLANT_LEFT] = elevon_deflection(output->left_elevon);
+}
+
+void plant_step(Plant *plant, uint32_t dt_us) {
+    const float dt = PLANT_STEP_US / 1000000.0f;
+
+    plant->pending_us += dt_us;
+    while (plant->pending_us >= PLANT_STEP_US) {
+        plant->pending_us -= PLANT_STEP_US;
+        plant->time_us += PLANT_STEP_US;
+
+        update_actuators(plant, dt);
+        if (!plant->on_ground) {
+            step_body(plant, dt);
+        }
+        update_ground(plant);
+    }
+}
+
+void plant_get_input(const Plant *plant, Fc_Input *input) {
+    input->orientation = quaternion_product(&imu_mount, &plant->body.attitude);
+
+    const vector_t *w = &plant->body.rates;
+    input->rates.x = w->x / RADIANS_PER_DEGREE;
+    input->rates.y = w->y / RADIANS_PER_DEGREE;
+    input->rates.z = w->z / RADIANS_PER_DEGREE;
+
+    input->alt = plant_get_altitude(plant);
+}
+
+float plant_get_altitude(const Plant *plant) {
+    return -plant->body.position.z;
+}
+
+float plant_get_airspeed(const Plant *plant) {
+    const vector_t *v = &plant->body.velocity;
+    return sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
+}
@@ -0,0 +1,130 @@
+// Rigid body model of the tail-sitter, to close the loop around fc_calc() on
+// the host. Takes the motor and elevon outputs and gives the orientation and
+// gyro rates the imu would report.
+//
+// The body frame is forward, right, down and the world frame north, east,
+// down. Right and left are named as seen from the front of the aircraft, the
+// way the mixer in flight_controller.c drives them, so the right motor and
+// elevon are on the -y side. With those signs a positive roll, pitch or yaw
+// command turns the aircraft the way the flight controller measures it.
+#ifndef __PLANT_H__
+#define __PLANT_H__
+
+#include <3dmath.h>
+
+#include "pico/stdlib.h"
+#include "flight_controller.h"
+
+// fixed integration step, the outputs are held over each step
+#define PLANT_STEP_US 2000
+
+#define PLANT_GRAVITY 9.81f // units: m/s^2
+#define PLANT_AIR_DENSITY 1.225f // units: kg/m^3
+
+#define PLANT_MASS 0.8f // units: kg
+#define PLANT_INERTIA_X 0.010f // about the nose, units: kg m^2
+#define PLANT_INERTIA_Y 0.012f // units: kg m^2
+#define PLANT_INERTIA_Z 0.020f // units: kg m^2
+
+// Thrust of each motor grows with the square of the throttle, the output
+// mapped from -100..100 to 0..1. Motors follow their command with a first
+// order lag.
+#define PLANT_MOTOR_MAX_THRUST 8.0f // units: N
+#define PLANT_MOTOR_LAG_S 0.05f
+#define PLANT_MOTOR_ARM 0.2f // distance from the center line, units: m
+#define PLANT_PROP_AREA 0.0314f // disk of a 8 inch prop, units: m^2
+
+// the right motor makes less thrust for the same output, which is what
+// FC_YAW_TRIM trims out
+#define PLANT_RIGHT_MOTOR_EFFICIENCY 0.89f
+
+// Elevons move at most PLANT_SERVO_RATE towards their command, full output
+// is PLANT_ELEVON_MAX_DEFLECTION. They act with the dynamic pressure of the
+// airspeed plus the prop wash, so they keep authority in the hover.
+#define PLANT_ELEVON_MAX_DEFLECTION 30.0f // units: degrees
+#define PLANT_SERVO_RATE 400.0f // units: degrees per second
+#define PLANT_ELEVON_AREA 0.01f // in the prop wash, per side, units: m^2
+#define PLANT_ELEVON_LIFT_SLOPE 3.0f // units: per radian
+#define PLANT_ELEVON_ARM_X 0.12f // behind the center of gravity, units: m
+#define PLANT_ELEVON_ARM_Y 0.15f // from the center line, units: m
+
+// The wing is a flat plate over the whole range of angle of attack, which a
+// tail-sitter sweeps through in the transition
+#define PLANT_WING_AREA 0.15f // units: m^2
+#define PLANT_WING_DRAG 0.05f // drag coefficient at zero angle of attack
+#define PLANT_WING_CHORD 0.25f // units: m
+#define PLANT_SIDE_AREA 0.04f // of the body and fins, units: m^2
+
+// nose down moment coefficient per sin(2 alpha), keeps the wing weathervaning
+#define PLANT_WING_STABILITY 0.05f
+
+// damping of the body rates at rest, units: N m per rad/s
+#define PLANT_DAMPING 0.004f
+
+// damping coefficient of the wing, acts with the airspeed on every axis
+#define PLANT_WING_DAMPING 8.0f
+
+// ground level, the aircraft rests there on its tail
+#define PLANT_GROUND_ALT 0.0f // units: m
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef enum {
+    PLANT_RIGHT = 0,
+    PLANT_LEFT = 1,
+    PLANT_SIDES = 2
+} Plant_Side;
+
+// the integrated state of the rigid body
+typedef struct {
+    vector_t position; // world frame, units: m
+    vector_t velocity; // world frame, units: m/s
+    quaternion_t attitude; // body to world
+    vector_t rates; // body frame, units: rad/s
+} Plant_Body;
+
+typedef struct {
+    Plant_Body body;
+
+    float motor_cmd[PLANT_SIDES]; // units: N
+    float motor_thrust[PLANT_SIDES]; // units: N
+
+    float elevon_cmd[PLANT_SIDES]; // units: degrees
+    float elevon[PLANT_SIDES]; // units: degrees
+
+    bool on_ground;
+    float touchdown_speed; // at the last touchdown, units: m/s
+    uint32_t pending_us; // carried to the next step
+    uint64_t time_us;
+} Plant;
+
+// On the ground at PLANT_GROUND_ALT, nose up as it waits to take off
+void plant_init_ground(Plant *plant);
+
+// In level flight at alt, heading north at speed, units: m, m/s
+void plant_init_level(Plant *plant, float alt, float speed);
+
+// Sets the commands of the actuators, held until the next call
+void plant_set_output(Plant *plant, const Fc_Output *output);
+
+// Advances the model by dt_us in steps of PLANT_STEP_US. The remainder of a
+// step is carried to the next call, so any dt keeps the same step.
+void plant_step(Plant *plant, uint32_t dt_us);
+
+// Fills the orientation, gyro rates and altitude of input as the imu and
+// barometer would, the sticks are left as they are
+void plant_get_input(const Plant *plant, Fc_Input *input);
+
+// units: m
+float plant_get_altitude(const Plant *plant);
+
+// speed through the air, units: m/s
+float plant_get_airspeed(const Plant *plant);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __PLANT_H__
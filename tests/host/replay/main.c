@@ -0,0 +1,146 @@
+// Replays recorded flash logs through the flight controller of this build and
+// reports how far its outputs stray from the logged ones:
+//   replay [-j workers] [-t tolerance] [-d] [-v] <log>...
+//   -j 0, the default, replays one log per core at a time
+//   -t sets the output divergence that fails a record, REPLAY_TOLERANCE
+//   -d writes the divergence of every record next to each log, as
+//      <log>.divergence.csv
+//   -v prints the largest divergence of every field
+// Exits with 1 if any record of any log diverged, see replay.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "replay.h"
+
+typedef struct {
+    const char *path;
+    float tolerance;
+    bool write_records;
+
+    bool ok;
+    Replay_Stats stats;
+} Log_Task;
+
+static void replay_task(void *arg) {
+    Log_Task *task = arg;
+
+    FILE *records = NULL;
+    if (task->write_records) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.divergence.csv", task->path);
+        records = fopen(path, "w");
+        if (!records) {
+            perror(path);
+            return;
+        }
+    }
+
+    // each log on its own instance, from power on
+    Fc_State fc;
+    fc_init(&fc);
+    task->ok = replay_file(task->path, &fc, task->tolerance, records, &task->stats);
+
+    if (records) {
+        fclose(records);
+    }
+}
+
+static double elapsed_s(const struct timespec *begin, const struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j workers] [-t tolerance] [-d] [-v] <log>...\n", name);
+}
+
+int main(int argc, char **argv) {
+    int workers = 0;
+    float tolerance = REPLAY_TOLERANCE;
+    bool write_records = false;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:t:dv")) != -1) {
+        switch (opt) {
+            case 'j': workers = atoi(optarg); break;
+            case 't': tolerance = strtof(optarg, NULL); break;
+            case 'd': write_records = true; break;
+            case 'v': verbose = true; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    int num_logs = argc - optind;
+    if (num_logs < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Log_Task *tasks = calloc(num_logs, sizeof(Log_Task));
+    static Pool pool;
+    if (!tasks || !pool_init(&pool, workers)) {
+        fprintf(stderr, "error: could not start the workers\n");
+        return EXIT_FAILURE;
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (int n = 0; n < num_logs; ++n) {
+        tasks[n].path = argv[optind + n];
+        tasks[n].tolerance = tolerance;
+        tasks[n].write_records = write_records;
+        pool_submit(&pool, replay_task, &tasks[n]);
+    }
+    pool_wait(&pool);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = elapsed_s(&begin, &end);
+    int num_workers = pool.num_workers;
+    pool_destroy(&pool);
+
+    uint64_t records = 0;
+    int failed = 0;
+    for (int n = 0; n < num_logs; ++n) {
+        const Log_Task *task = &tasks[n];
+        const Replay_Stats *stats = &task->stats;
+        records += stats->records;
+
+        if (!task->ok) {
+            printf("%s: could not be replayed\n", task->path);
+            ++failed;
+            continue;
+        }
+
+        printf("%s: %llu records, max output divergence %g, mean %g",
+            task->path, (unsigned long long)stats->records, stats->max_output,
+            stats->records ? stats->sum_output / stats->records : 0.0);
+        if (stats->diverged) {
+            printf(", %llu diverged from record %llu", (unsigned long long)stats->diverged,
+                (unsigned long long)stats->first_diverged);
+            ++failed;
+        }
+        if (stats->mode_mismatches) {
+            printf(", %llu mode mismatches", (unsigned long long)stats->mode_mismatches);
+        }
+        printf("\n");
+
+        if (verbose) {
+            for (int field = 0; field < REPLAY_NUM_FIELDS; ++field) {
+                printf("  %-13s %g\n", replay_field_names[field], stats->max_field[field]);
+            }
+        }
+    }
+
+    printf("replayed %llu records of %d logs in %.3f s on %d workers, %.2f million per second\n",
+        (unsigned long long)records, num_logs, wall_s, num_workers, records / wall_s / 1e6);
+
+    free(tasks);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,355 @@
+#include "replay.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gain_schedule.h"
+
+// fields of a dump_logs() line, dump_logs.py puts the time in front
+#define CSV_FIELDS 25
+#define CSV_LINE 1024
+
+// At a pitch of 90 degrees roll and yaw turn about the same axis, and the
+// split between them that fc_calc() logged comes from rounding. Rebuilding
+// records there this far below the pole keeps the logged split, units:
+// degrees
+#define POLE_MARGIN 0.05f
+
+const char *replay_field_names[REPLAY_NUM_FIELDS] = {
+    "right elevon",
+    "left elevon",
+    "right motor",
+    "left motor",
+    "gear",
+    "pid roll",
+    "pid pitch",
+    "pid yaw",
+    "target roll",
+    "target pitch",
+    "target yaw"
+};
+
+static bool ends_with(const char *text, const char *end) {
+    size_t length = strlen(text);
+    size_t end_length = strlen(end);
+    return length >= end_length && !strcmp(text + length - end_length, end);
+}
+
+bool replay_open(Replay_Reader *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->first = true;
+    reader->format = ends_with(path, ".csv") || ends_with(path, ".txt") ? REPLAY_CSV : REPLAY_RAW;
+
+    reader->file = fopen(path, reader->format == REPLAY_CSV ? "r" : "rb");
+    if (!reader->file) {
+        perror(path);
+        return false;
+    }
+
+    if (reader->format == REPLAY_RAW) {
+        // an image of the whole flash starts with the program
+        fseek(reader->file, 0, SEEK_END);
+        long size = ftell(reader->file);
+        fseek(reader->file, size == PICO_FLASH_SIZE_BYTES ? LOG_FLASH_START : 0, SEEK_SET);
+    }
+    return true;
+}
+
+void replay_close(Replay_Reader *reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
+
+// as left by init_logging()
+static bool erased(const Log_Data *row) {
+    const uint8_t *bytes = (const uint8_t *)row;
+    for (size_t i = 0; i < sizeof(*row); ++i) {
+        if (bytes[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the numbers of a line, -1 if anything else is on it
+static int parse_csv(char *line, double *values, int max_values) {
+    int count = 0;
+    char *next = line;
+    for (;;) {
+        char *end;
+        double value = strtod(next, &end);
+        if (end == next || count == max_values) {
+            return -1;
+        }
+        values[count++] = value;
+
+        while (*end == ' ' || *end == '\t' || *end == '\r' || *end == '\n') {
+            ++end;
+        }
+        if (!*end) {
+            return count;
+        }
+        if (*end != ',') {
+            return -1;
+        }
+        next = end + 1;
+    }
+}
+
+static bool read_csv(Replay_Reader *reader, Log_Data *row, uint32_t *dt_us) {
+    char line[CSV_LINE];
+    double values[CSV_FIELDS + 1];
+
+    while (fgets(line, sizeof(line), reader->file)) {
+        int count = parse_csv(line, values, CSV_FIELDS + 1);
+        if (count != CSV_FIELDS && count != CSV_FIELDS + 1) {
+            // the heading, or a line dump_logs.py could not decode
+            continue;
+        }
+
+        const double *v = values;
+        *dt_us = FC_PERIOD_US;
+        if (count == CSV_FIELDS + 1) {
+            double time = *v++;
+            if (!reader->first) {
+                *dt_us = (uint32_t)lround((time - reader->last_time) * 1000000);
+            }
+            reader->last_time = time;
+        }
+
+        row->input_thro = (int8_t)v[0];
+        row->input_aile = (int8_t)v[1];
+        row->input_elev = (int8_t)v[2];
+        row->input_rudd = (int8_t)v[3];
+        row->input_gear = (int8_t)v[4];
+        row->input_aux1 = (int8_t)v[5];
+
+        row->current_roll = (float)v[6];
+        row->current_pitch = (float)v[7];
+        row->current_yaw = (float)v[8];
+
+        row->target_roll = (float)v[9];
+        row->target_pitch = (float)v[10];
+        row->target_yaw = (float)v[11];
+
+        row->pid_roll = (float)v[12];
+        row->pid_pitch = (float)v[13];
+        row->pid_yaw = (float)v[14];
+
+        row->output_right_elevon = (float)v[15];
+        row->output_left_elevon = (float)v[16];
+        row->output_right_motor = (float)v[17];
+        row->output_left_motor = (float)v[18];
+        row->output_gear = (int8_t)v[19];
+
+        row->ctrl_mode = (uint8_t)v[20];
+        row->flight_mode = (uint8_t)v[21];
+        row->tstate = (uint8_t)v[22];
+        row->flags = (uint8_t)v[23];
+        row->noise_peak = (uint8_t)(v[24] / 2);
+
+        // dump_logs() prints the erased records after the log too
+        if (row->ctrl_mode == UINT8_MAX && row->flight_mode == UINT8_MAX &&
+            row->tstate == UINT8_MAX && row->flags == UINT8_MAX) {
+            return false;
+        }
+
+        reader->first = false;
+        return true;
+    }
+    return false;
+}
+
+bool replay_read(Replay_Reader *reader, Log_Data *row, uint32_t *dt_us) {
+    if (reader->format == REPLAY_CSV) {
+        return read_csv(reader, row, dt_us);
+    }
+
+    if (fread(row, sizeof(*row), 1, reader->file) != 1 || erased(row)) {
+        return false;
+    }
+    *dt_us = FC_PERIOD_US;
+    reader->first = false;
+    return true;
+}
+
+quaternion_t replay_orientation(const Log_Data *row) {
+    float roll = row->current_roll;
+    float pitch = row->current_pitch;
+    float yaw = row->current_yaw;
+
+#   if FC_INVERT_ROLL == 1
+        roll *= -1;
+#   endif
+#   if FC_INVERT_PITCH == 1
+        pitch *= -1;
+#   endif
+#   if FC_INVERT_YAW == 1
+        yaw *= -1;
+#   endif
+
+    pitch = fminf(fmaxf(pitch, -90 + POLE_MARGIN), 90 - POLE_MARGIN);
+
+    // quaternion_get_euler() backwards: yaw about y, then pitch about z, then
+    // roll about x, with roll offset by 90 degrees
+    double half = RADIANS_PER_DEGREE / 2.0;
+    double c1 = cos(yaw * half), s1 = sin(yaw * half);
+    double c2 = cos(pitch * half), s2 = sin(pitch * half);
+    double c3 = cos((roll + 90) * half), s3 = sin((roll + 90) * half);
+
+    quaternion_t compensated = {
+        (float)(c1 * c2 * c3 - s1 * s2 * s3),
+        (float)(s1 * s2 * c3 + c1 * c2 * s3),
+        (float)(s1 * c2 * c3 + c1 * s2 * s3),
+        (float)(c1 * s2 * c3 - s1 * c2 * s3)
+    };
+
+    // undo the pitch compensation of fc_calc()
+    int tstate = row->tstate > FC_MAX_TSTATE ? FC_MAX_TSTATE : row->tstate;
+    const quaternion_t *r = &fc_tstate_rotation[tstate];
+    quaternion_t inverse = { r->w, -r->x, -r->y, -r->z };
+    return quaternion_product(&compensated, &inverse);
+}
+
+void replay_input(const Log_Data *row, const quaternion_t *last_orientation, uint32_t dt_us,
+    Fc_Input *input, Fc_Flags *flags) {
+    memset(input, 0, sizeof(*input));
+
+    // fc_calc() adds the waiting flag itself
+    *flags = (Fc_Flags)(row->flags & ~FC_WAITING);
+
+    input->thro = row->input_thro;
+    input->aile = row->input_aile;
+    input->elev = row->input_elev;
+    input->rudd = row->input_rudd;
+    input->gear = row->input_gear;
+    input->aux1 = row->input_aux1;
+
+    if (row->flags & FC_WAITING) {
+        input->thro = FC_MAX_INPUT;
+    }
+
+    input->orientation = replay_orientation(row);
+    input->noise_hz = row->noise_peak * 2.0f;
+
+    // body rates from the turn between the records
+    if (last_orientation && dt_us) {
+        const quaternion_t *q = last_orientation;
+        quaternion_t inverse = { q->w, -q->x, -q->y, -q->z };
+        quaternion_t turn = quaternion_product(&inverse, &input->orientation);
+        if (turn.w < 0) {
+            turn = (quaternion_t){ -turn.w, -turn.x, -turn.y, -turn.z };
+        }
+
+        float scale = 2 / (dt_us / 1000000.0f) / RADIANS_PER_DEGREE;
+        input->rates.x = turn.x * scale;
+        input->rates.y = turn.y * scale;
+        input->rates.z = turn.z * scale;
+    }
+}
+
+static float angle_difference(float a, float b) {
+    float difference = fmodf(fabsf(a - b), 360);
+    return difference > 180 ? 360 - difference : difference;
+}
+
+void replay_compare(const Fc_State *fc, const Log_Data *row, Replay_Divergence *divergence) {
+    float *field = divergence->field;
+
+    field[REPLAY_RIGHT_ELEVON] = fabsf(fc->output.right_elevon - row->output_right_elevon);
+    field[REPLAY_LEFT_ELEVON] = fabsf(fc->output.left_elevon - row->output_left_elevon);
+    field[REPLAY_RIGHT_MOTOR] = fabsf(fc->output.right_motor - row->output_right_motor);
+    field[REPLAY_LEFT_MOTOR] = fabsf(fc->output.left_motor - row->output_left_motor);
+    field[REPLAY_GEAR] = fabsf((float)(int8_t)fc->output.gear - row->output_gear);
+
+    field[REPLAY_PID_ROLL] = fabsf(fc->pid_out.roll - row->pid_roll);
+    field[REPLAY_PID_PITCH] = fabsf(fc->pid_out.pitch - row->pid_pitch);
+    field[REPLAY_PID_YAW] = fabsf(fc->pid_out.yaw - row->pid_yaw);
+
+    field[REPLAY_TARGET_ROLL] = angle_difference(fc->target_roll, row->target_roll);
+    field[REPLAY_TARGET_PITCH] = angle_difference(fc->target_pitch, row->target_pitch);
+    field[REPLAY_TARGET_YAW] = angle_difference(fc->target_yaw, row->target_yaw);
+
+    divergence->output = 0;
+    for (int n = 0; n < REPLAY_NUM_OUTPUTS; ++n) {
+        // nan in either counts as far apart
+        divergence->output = fmaxf(divergence->output, isnan(field[n]) ? INFINITY : field[n]);
+    }
+
+    divergence->modes = fc->ctrl_mode != row->ctrl_mode ||
+        fc->flight_mode != row->flight_mode ||
+        (uint8_t)(fc->tstate + 0.5f) != row->tstate ||
+        (uint8_t)fc->flags != row->flags;
+}
+
+static void write_heading(FILE *records) {
+    fprintf(records, "record, output");
+    for (int n = 0; n < REPLAY_NUM_FIELDS; ++n) {
+        fprintf(records, ", %s", replay_field_names[n]);
+    }
+    fprintf(records, ", modes\n");
+}
+
+static void write_record(FILE *records, uint64_t record, const Replay_Divergence *divergence) {
+    fprintf(records, "%llu, %g", (unsigned long long)record, divergence->output);
+    for (int n = 0; n < REPLAY_NUM_FIELDS; ++n) {
+        fprintf(records, ", %g", divergence->field[n]);
+    }
+    fprintf(records, ", %d\n", divergence->modes);
+}
+
+bool replay_file(const char *path, Fc_State *fc, float tolerance, FILE *records,
+    Replay_Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->first_diverged = UINT64_MAX;
+
+    Replay_Reader reader;
+    if (!replay_open(&reader, path)) {
+        return false;
+    }
+    if (records) {
+        write_heading(records);
+    }
+
+    Log_Data row;
+    uint32_t dt_us;
+    quaternion_t last_orientation;
+
+    while (replay_read(&reader, &row, &dt_us)) {
+        Fc_Input input;
+        Fc_Flags flags;
+        replay_input(&row, stats->records ? &last_orientation : NULL, dt_us, &input, &flags);
+        last_orientation = input.orientation;
+
+        fc_calc(fc, &input, flags, dt_us);
+
+        Replay_Divergence divergence;
+        replay_compare(fc, &row, &divergence);
+
+        for (int n = 0; n < REPLAY_NUM_FIELDS; ++n) {
+            stats->max_field[n] = fmaxf(stats->max_field[n], divergence.field[n]);
+        }
+        stats->max_output = fmaxf(stats->max_output, divergence.output);
+        stats->sum_output += divergence.output;
+        if (divergence.output > tolerance) {
+            if (!stats->diverged) {
+                stats->first_diverged = stats->records;
+            }
+            ++stats->diverged;
+        }
+        if (divergence.modes) {
+            ++stats->mode_mismatches;
+        }
+
+        if (records) {
+            write_record(records, stats->records, &divergence);
+        }
+        ++stats->records;
+    }
+
+    replay_close(&reader);
+    return true;
+}
@@ -0,0 +1,118 @@
+// Replays flash logs of do_logging() through fc_calc() on the host and
+// measures how far the replayed controller strays from the logged one. Takes
+// the csv of dump_logs(), with or without the time column of dump_logs.py,
+// and raw images of the flash, either the whole flash or the log from
+// LOG_FLASH_START. Records are read up to the first erased one.
+//
+// Each record is turned back into the Fc_Input and Fc_Flags of its loop:
+// - the orientation is rebuilt from the logged attitude and tstate
+// - the sticks are logged as whole numbers, so a replay of a real flight
+//   differs by that rounding, a fraction of a degree of target
+// - the sticks of records that kept waiting are overridden by fc_calc(), a
+//   high throttle keeps the replay waiting on them as well
+// - the log holds no gyro rates. With FC_CASCADED they are taken from the
+//   change of the orientation, and fc_calc() runs the rate loop once per
+//   record instead of at the imu rate.
+// Virtual time advances by the loop period for every record, or by the
+// steps of the time column when there is one.
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <stdio.h>
+
+#include "flight_controller.h"
+#include "logging.h"
+
+#if LOG_PERIOD_US != FC_PERIOD_US
+#   error "replay takes one log record per run of fc_calc()"
+#endif
+
+// outputs of a record further than this from the log count as diverged
+#define REPLAY_TOLERANCE 0.01f
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef enum {
+    REPLAY_RAW,
+    REPLAY_CSV
+} Replay_Format;
+
+typedef struct {
+    FILE *file;
+    Replay_Format format;
+    bool has_time;
+    double last_time; // units: seconds
+    bool first;
+} Replay_Reader;
+
+// values compared between the replay and the log
+typedef enum {
+    REPLAY_RIGHT_ELEVON,
+    REPLAY_LEFT_ELEVON,
+    REPLAY_RIGHT_MOTOR,
+    REPLAY_LEFT_MOTOR,
+    REPLAY_GEAR,
+    REPLAY_NUM_OUTPUTS,
+    REPLAY_PID_ROLL = REPLAY_NUM_OUTPUTS,
+    REPLAY_PID_PITCH,
+    REPLAY_PID_YAW,
+    REPLAY_TARGET_ROLL,
+    REPLAY_TARGET_PITCH,
+    REPLAY_TARGET_YAW,
+    REPLAY_NUM_FIELDS
+} Replay_Field;
+
+extern const char *replay_field_names[REPLAY_NUM_FIELDS];
+
+// absolute differences of one record
+typedef struct {
+    float field[REPLAY_NUM_FIELDS];
+    float output; // largest of the outputs
+    bool modes; // control mode, flight mode, tstate or flags differ
+} Replay_Divergence;
+
+typedef struct {
+    uint64_t records;
+    uint64_t diverged; // records with an output over the tolerance
+    uint64_t first_diverged; // record, UINT64_MAX if none
+    uint64_t mode_mismatches;
+    float max_field[REPLAY_NUM_FIELDS];
+    float max_output;
+    double sum_output;
+} Replay_Stats;
+
+// The format is taken from the name: .csv and .txt are csv, anything else a
+// raw image. Prints the error and returns false if the file can not be read.
+bool replay_open(Replay_Reader *reader, const char *path);
+
+// The next record and the time since the last one, false at the end of the
+// log. Lines of a csv that are not records are skipped.
+bool replay_read(Replay_Reader *reader, Log_Data *row, uint32_t *dt_us);
+
+void replay_close(Replay_Reader *reader);
+
+// the orientation for which fc_calc() gives the logged attitude at the
+// logged tstate
+quaternion_t replay_orientation(const Log_Data *row);
+
+// The input and flags fc_calc() got for the row. Rates are rebuilt from the
+// orientation of the record before, if there is one.
+void replay_input(const Log_Data *row, const quaternion_t *last_orientation, uint32_t dt_us,
+    Fc_Input *input, Fc_Flags *flags);
+
+// Compares the state after replaying a record with the record
+void replay_compare(const Fc_State *fc, const Log_Data *row, Replay_Divergence *divergence);
+
+// Replays a whole log through fc, which the caller initialized, and
+// accumulates the divergence of every record into stats. Writes a csv row of
+// the divergence of each record to records if it is not NULL.
+bool replay_file(const char *path, Fc_State *fc, float tolerance, FILE *records,
+    Replay_Stats *stats);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __REPLAY_H__
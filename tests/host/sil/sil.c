@@ -0,0 +1,356 @@
+// Software in the loop test of src/main.c. Every flight runs the whole
+// program, scheduler, imu core, logging and all, on the virtual clock with the
+// simulated drivers of this directory, then checks the outputs it saw and the
+// log rows left in flash. Flights run in forked processes since main.c and
+// the drivers keep their state in statics.
+//   sil [-n flights] [-s seed] [-o] [-v]
+//   -o stalls the receiver once mid flight and expects the overrun flag
+//   -v keeps the output of main.c
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "flight_controller.h"
+#include "logging.h"
+
+#include "sil.h"
+
+#define SIL_FLIGHT_US 10000000 // from the first receiver read
+
+// log rows before the loop timing settles
+#define SIL_SETTLE_ROWS 3
+
+// time the dynamic notch gets to find the vibration, units: seconds
+#define SIL_NOISE_SETTLE_S 3
+#define SIL_NOISE_MAX_ERROR_HZ 10
+
+#define SIL_VIBRATION_MIN_HZ 100
+#define SIL_VIBRATION_MAX_HZ 300
+#define SIL_VIBRATION_AMPLITUDE 20 // units: degrees per second
+
+#define SIL_WOBBLE_HZ 0.5f
+#define SIL_WOBBLE_DEG 5.0f
+
+#define SIL_DROPOUT_US 500000
+#define SIL_STALL_AT_US 5000000
+#define SIL_STALL_US 30000
+
+#define SIL_MAX_READS (SIL_FLIGHT_US / RX_PERIOD_US + 2)
+
+typedef struct {
+    float time; // units: seconds
+    float thro;
+    float aile;
+    float elev;
+    float rudd;
+    float gear;
+    float aux1;
+} Sil_Point;
+
+// Arms in horizontal manual, throttles up, flies rate mode, transitions to
+// vertical angle mode and cuts the throttle. Sticks are interpolated.
+static const Sil_Point flight_script[] = {
+//    time  thro  aile  elev  rudd  gear  aux1
+    { 0.0f, -100,    0,    0,    0, -100, -100 },
+    { 1.0f, -100,    0,    0,    0, -100, -100 },
+    { 2.0f,   30,    0,    0,    0, -100, -100 },
+    { 3.0f,   30,    0,    0,    0, -100,    0 },
+    { 4.0f,   30,   20,  -10,    0, -100,    0 },
+    { 5.0f,   30,    0,    0,    0, -100,    0 },
+    { 6.0f,   40,    0,    0,    0,    0,  100 },
+    { 8.5f,   40,    0,   10,   10,    0,  100 },
+    { 9.0f, -100,    0,    0,    0,    0,  100 },
+    { 10.0f, -100,   0,    0,    0,    0,  100 },
+};
+
+#define SIL_NUM_POINTS (sizeof(flight_script) / sizeof(flight_script[0]))
+
+typedef struct {
+    // faults, drawn from the seed
+    float vibration_hz;
+    bool has_dropout;
+    int64_t dropout_us; // start of the receiver dropout
+    bool stall;
+    bool stalled;
+
+    const Fc_State *fc; // set by main.c through sil_fc_init()
+
+    bool started;
+    absolute_time_t start;
+
+    int reads;
+    int8_t read_thro[SIL_MAX_READS];
+
+    int failures;
+} Sil_Flight;
+
+static Sil_Flight flight;
+
+static void expect(bool ok, const char *name, int at) {
+    if (!ok) {
+        if (flight.failures < 10) {
+            fprintf(stderr, "fail: %s at %d\n", name, at);
+        }
+        ++flight.failures;
+    }
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static float flight_time(absolute_time_t time) {
+    return absolute_time_diff_us(flight.start, time) / 1000000.0f;
+}
+
+static bool motor_safe(const Fc_State *state) {
+    return !((state->flags & FC_WAITING) ||
+        (state->flags & FC_RX_FAILED) ||
+        (state->input.thro < FC_MIN_INPUT + FC_DEAD_STICK));
+}
+
+static void check_log(void) {
+    const Log_Data *rows = (const Log_Data *)(XIP_BASE + LOG_FLASH_START);
+    const int max_rows = LOG_FLASH_SIZE_BYTES / sizeof(Log_Data);
+
+    static Log_Data erased;
+    memset(&erased, 0xFF, sizeof(erased));
+
+    int n = 0;
+    while (n < max_rows && memcmp(&rows[n], &erased, sizeof(erased))) {
+        ++n;
+    }
+
+    // the read that ends the flight was not logged
+    expect(n == flight.reads - 1, "number of log rows", n);
+
+    int overruns = 0;
+    int noise_rows = 0;
+    static uint8_t noise[SIL_MAX_READS];
+
+    for (int i = 0; i < n && i < flight.reads; ++i) {
+        const Log_Data *row = &rows[i];
+
+        if (row->flight_mode != FC_FMODE_DISABLED && !(row->flags & FC_RX_FAILED)) {
+            expect(row->input_thro == flight.read_thro[i], "logged throttle", i);
+        }
+
+        if ((row->flags & (FC_WAITING | FC_RX_FAILED)) ||
+            row->input_thro < FC_MIN_INPUT + FC_DEAD_STICK) {
+            expect(row->output_right_motor == FC_MIN_OUTPUT, "logged right motor safety", i);
+            expect(row->output_left_motor == FC_MIN_OUTPUT, "logged left motor safety", i);
+        }
+
+        if (i >= SIL_SETTLE_ROWS && (row->flags & FC_OVERRUN)) {
+            ++overruns;
+        }
+
+        if (i * RX_PERIOD_US >= SIL_NOISE_SETTLE_S * 1000000) {
+            noise[noise_rows++] = row->noise_peak;
+        }
+    }
+
+    if (flight.stall) {
+        expect(overruns > 0, "overrun after the receiver stall", overruns);
+    } else {
+        expect(overruns == 0, "loop timing", overruns);
+    }
+
+    // median of the logged peaks, in units of 2 Hz
+    for (int i = 1; i < noise_rows; ++i) {
+        for (int j = i; j > 0 && noise[j - 1] > noise[j]; --j) {
+            uint8_t tmp = noise[j];
+            noise[j] = noise[j - 1];
+            noise[j - 1] = tmp;
+        }
+    }
+    float median_hz = noise_rows ? noise[noise_rows / 2] * 2.0f : 0.0f;
+    expect(fabsf(median_hz - flight.vibration_hz) <= SIL_NOISE_MAX_ERROR_HZ,
+        "logged noise peak", (int)median_hz);
+}
+
+static void end_flight(void) {
+    check_log();
+
+    fflush(stdout);
+    if (flight.failures) {
+        fprintf(stderr, "%d checks failed, vibration %.0f Hz, dropout at %lld us\n",
+            flight.failures, flight.vibration_hz,
+            flight.has_dropout ? (long long)flight.dropout_us : -1LL);
+    }
+    exit(flight.failures ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+void sil_read_sticks(absolute_time_t time, Sil_Sticks *sticks) {
+    if (!flight.started) {
+        flight.started = true;
+        flight.start = time;
+    }
+
+    int64_t t_us = absolute_time_diff_us(flight.start, time);
+    if (t_us >= SIL_FLIGHT_US) {
+        ++flight.reads;
+        end_flight();
+    }
+
+    // the receiver blocks the loop for longer than a tick
+    if (flight.stall && !flight.stalled && t_us >= SIL_STALL_AT_US) {
+        flight.stalled = true;
+        busy_wait_until(time + SIL_STALL_US);
+    }
+
+    float t = flight_time(time);
+    size_t i = 1;
+    while (i < SIL_NUM_POINTS - 1 && flight_script[i].time <= t) {
+        ++i;
+    }
+    const Sil_Point *a = &flight_script[i - 1];
+    const Sil_Point *b = &flight_script[i];
+    float f = (t - a->time) / (b->time - a->time);
+    f = f < 0 ? 0 : (f > 1 ? 1 : f);
+
+    sticks->thro = a->thro + f * (b->thro - a->thro);
+    sticks->aile = a->aile + f * (b->aile - a->aile);
+    sticks->elev = a->elev + f * (b->elev - a->elev);
+    sticks->rudd = a->rudd + f * (b->rudd - a->rudd);
+    sticks->gear = a->gear + f * (b->gear - a->gear);
+    sticks->aux1 = a->aux1 + f * (b->aux1 - a->aux1);
+
+    sticks->connected = !flight.has_dropout ||
+        t_us < flight.dropout_us || t_us >= flight.dropout_us + SIL_DROPOUT_US;
+
+    if (flight.reads < SIL_MAX_READS) {
+        flight.read_thro[flight.reads] = (int8_t)sticks->thro;
+    }
+    ++flight.reads;
+}
+
+void sil_get_motion(absolute_time_t time, quaternion_t *orientation, vector_t *rates) {
+    const quaternion_t level = { .w = 1, .x = 0, .y = 0, .z = 0 };
+    float phase = 2 * (float)M_PI * SIL_WOBBLE_HZ * flight_time(time);
+
+    *orientation = quaternion_rotate_pitch(&level, SIL_WOBBLE_DEG * sinf(phase));
+
+    rates->x = 0;
+    rates->y = SIL_WOBBLE_DEG * 2 * (float)M_PI * SIL_WOBBLE_HZ * cosf(phase);
+    rates->z = 0;
+}
+
+vector_t sil_get_vibration(absolute_time_t time) {
+    float phase = 2 * (float)M_PI * flight.vibration_hz * (to_us_since_boot(time) / 1000000.0f);
+
+    vector_t vibration = {
+        .x = SIL_VIBRATION_AMPLITUDE * sinf(phase),
+        .y = SIL_VIBRATION_AMPLITUDE * sinf(phase + 1),
+        .z = SIL_VIBRATION_AMPLITUDE * sinf(phase + 2)
+    };
+    return vibration;
+}
+
+void sil_fc_init(Fc_State *fc) {
+    flight.fc = fc;
+    fc_init(fc);
+}
+
+void sil_set_output(Sil_Output output, float value) {
+    if (output == SIL_RIGHT_MOTOR || output == SIL_LEFT_MOTOR) {
+        if (!motor_safe(flight.fc)) {
+            expect(value == FC_MIN_OUTPUT, "motor safety", flight.reads);
+        }
+    }
+    expect(value >= FC_MIN_OUTPUT && value <= FC_MAX_OUTPUT, "output range", flight.reads);
+}
+
+void sil_disable_outputs(void) {}
+
+int fc_main(void);
+
+static int run_flight(uint32_t seed, bool stall, bool verbose) {
+    uint32_t state = seed * 2654435761u + 1;
+    xorshift(&state);
+
+    flight.vibration_hz = SIL_VIBRATION_MIN_HZ +
+        xorshift(&state) % (SIL_VIBRATION_MAX_HZ - SIL_VIBRATION_MIN_HZ);
+    flight.has_dropout = xorshift(&state) % 2;
+    if (flight.has_dropout) {
+        flight.dropout_us = 2000000 + xorshift(&state) % 6000000;
+    }
+    flight.stall = stall;
+
+    if (!verbose) {
+        if (!freopen("/dev/null", "w", stdout)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    fc_main();
+
+    // main.c only returns if it never started the loop
+    fprintf(stderr, "fail: the flight controller did not start\n");
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    int flights = 1;
+    uint32_t seed = 1;
+    bool stall = false;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:ov")) != -1) {
+        switch (opt) {
+            case 'n': flights = atoi(optarg); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'o': stall = true; break;
+            case 'v': verbose = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n flights] [-s seed] [-o] [-v]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    int failed = 0;
+    for (int i = 0; i < flights; ++i) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return EXIT_FAILURE;
+        }
+        if (pid == 0) {
+            _exit(run_flight(seed + i, stall, verbose));
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            printf("fail: flight with seed %lu\n", (unsigned long)(seed + i));
+            ++failed;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_ms = (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6;
+    printf("%d flights of %.0f s in %.1f ms, %.0f flights per minute\n",
+        flights, SIL_FLIGHT_US / 1e6, wall_ms, flights * 60000.0 / wall_ms);
+
+    if (failed) {
+        printf("%d of %d flights failed\n", failed, flights);
+        return EXIT_FAILURE;
+    }
+
+    printf("all flights passed\n");
+    return EXIT_SUCCESS;
+}
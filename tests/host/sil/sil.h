@@ -0,0 +1,63 @@
+// Software in the loop harness for src/main.c. The simulated drivers in this
+// directory replace lib/mpu6050.c, lib/ar610.c and src/pwm.c behind their own
+// headers, which are the hardware abstraction. They take the flight from the
+// harness and report the outputs back through this interface.
+#ifndef __SIL_H__
+#define __SIL_H__
+
+#include <3dmath.h>
+
+#include "pico/stdlib.h"
+#include "flight_controller.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+    float thro;
+    float aile;
+    float elev;
+    float rudd;
+    float gear;
+    float aux1;
+
+    bool connected;
+} Sil_Sticks;
+
+typedef enum {
+    SIL_RIGHT_ELEVON = 0,
+    SIL_LEFT_ELEVON = 1,
+    SIL_RIGHT_MOTOR = 2,
+    SIL_LEFT_MOTOR = 3,
+    SIL_NUM_OUTPUTS = 4
+} Sil_Output;
+
+// Reads the receiver at time, called once per receiver update. The flight
+// starts at the first read and ends at a read after the flight time, which
+// ends the program with the result of the checks.
+void sil_read_sticks(absolute_time_t time, Sil_Sticks *sticks);
+
+// Attitude of the aircraft and its body rates at time, without sensor noise.
+// units: degrees per second
+void sil_get_motion(absolute_time_t time, quaternion_t *orientation, vector_t *rates);
+
+// Gyro vibration from the props at time, added to every gyro sample.
+// units: degrees per second
+vector_t sil_get_vibration(absolute_time_t time);
+
+// main.c is built with fc_init() renamed to this, which hands the harness the
+// flight controller instance of the flight before it initializes it
+void sil_fc_init(Fc_State *fc);
+
+// Called with every servo and motor output, -100 to 100
+void sil_set_output(Sil_Output output, float value);
+
+// Called when the pwm outputs are turned off
+void sil_disable_outputs(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __SIL_H__
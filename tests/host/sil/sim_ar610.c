@@ -0,0 +1,88 @@
+// Simulated receiver, reads the sticks of the sil flight. Values are held
+// while the transmitter is disconnected.
+
+#include <ar610.h>
+
+#include "sil.h"
+
+static Sil_Sticks sticks;
+
+static uint16_t to_us(float val) {
+    return (uint16_t)(AR610_PWM_CEN_PULSEWIDTH +
+        val * (AR610_PWM_MAX_PULSEWIDTH - AR610_PWM_CEN_PULSEWIDTH) / AR610_MAX_VAL);
+}
+
+void ar610_init(ar610_inst_t* inst,
+    uint thro_pin, uint aile_pin, uint elev_pin,
+    uint rudd_pin, uint gear_pin, uint aux1_pin) {
+    sticks.thro = AR610_MIN_VAL;
+    sticks.aile = 0;
+    sticks.elev = 0;
+    sticks.rudd = 0;
+    sticks.gear = 0;
+    sticks.aux1 = 0;
+    sticks.connected = false;
+}
+
+void ar610_update_state(ar610_inst_t* inst) {
+    Sil_Sticks read;
+    sil_read_sticks(get_absolute_time(), &read);
+
+    if (read.connected) {
+        sticks = read;
+    } else {
+        sticks.connected = false;
+    }
+}
+
+uint8_t ar610_is_connected(ar610_inst_t* inst) {
+    return sticks.connected;
+}
+
+uint16_t ar610_get_thro_us(ar610_inst_t* inst) {
+    return to_us(sticks.thro);
+}
+
+uint16_t ar610_get_aile_us(ar610_inst_t* inst) {
+    return to_us(sticks.aile);
+}
+
+uint16_t ar610_get_elev_us(ar610_inst_t* inst) {
+    return to_us(sticks.elev);
+}
+
+uint16_t ar610_get_rudd_us(ar610_inst_t* inst) {
+    return to_us(sticks.rudd);
+}
+
+uint16_t ar610_get_gear_us(ar610_inst_t* inst) {
+    return to_us(sticks.gear);
+}
+
+uint16_t ar610_get_aux1_us(ar610_inst_t* inst) {
+    return to_us(sticks.aux1);
+}
+
+float ar610_get_thro(ar610_inst_t* inst) {
+    return sticks.thro;
+}
+
+float ar610_get_aile(ar610_inst_t* inst) {
+    return sticks.aile;
+}
+
+float ar610_get_elev(ar610_inst_t* inst) {
+    return sticks.elev;
+}
+
+float ar610_get_rudd(ar610_inst_t* inst) {
+    return sticks.rudd;
+}
+
+float ar610_get_gear(ar610_inst_t* inst) {
+    return sticks.gear;
+}
+
+float ar610_get_aux1(ar610_inst_t* inst) {
+    return sticks.aux1;
+}
@@ -0,0 +1,137 @@
+// Simulated imu. Samples the sil motion every MPU6050_SAMPLE_PERIOD_US like
+// the sensor fifo, adds the prop vibration and passes every sample through
+// the gyro filter. The orientation is reported without estimation error.
+
+#include <mpu6050.h>
+
+#include "sil.h"
+
+#define FIFO_CAPACITY (MPU6050_FIFO_SIZE / MPU6050_FIFO_SAMPLE_SIZE)
+
+static void mpu6050_sample(mpu6050_inst_t *inst, absolute_time_t time) {
+    vector_t rates;
+    sil_get_motion(time, &inst->orientation, &rates);
+
+    vector_t vibration = sil_get_vibration(time);
+    rates.x += vibration.x;
+    rates.y += vibration.y;
+    rates.z += vibration.z;
+
+    if (inst->gyro_filter) {
+        inst->gyro_filter(inst->gyro_filter_context, &rates);
+    }
+    inst->rates = rates;
+}
+
+int mpu6050_init(mpu6050_inst_t *inst, i2c_inst_t *i2c, uint pin) {
+    inst->i2c = i2c;
+    inst->led_pin = pin;
+    inst->gyro_filter = NULL;
+    inst->gyro_filter_context = NULL;
+    inst->dma_busy = 0;
+    inst->start = 1;
+
+    sil_get_motion(get_absolute_time(), &inst->orientation, &inst->rates);
+
+    return 0;
+}
+
+int mpu6050_avg_reading(mpu6050_inst_t *inst, mpu6050_data_t *data, uint16_t n) {
+    return 1;
+}
+
+int mpu6050_update_state(mpu6050_inst_t *inst) {
+    return mpu6050_update_state_at(inst, get_absolute_time());
+}
+
+int mpu6050_update_state_at(mpu6050_inst_t *inst, absolute_time_t time) {
+    if (inst->start) {
+        inst->start = 0;
+        inst->timer = time;
+        return 0;
+    }
+
+#   ifdef MPU6050_FIFO
+        int ret = 0;
+
+        uint64_t n = absolute_time_diff_us(inst->timer, time) / MPU6050_SAMPLE_PERIOD_US;
+        if (n > FIFO_CAPACITY) {
+            // the oldest samples were overwritten
+            inst->timer += (n - FIFO_CAPACITY) * MPU6050_SAMPLE_PERIOD_US;
+            n = FIFO_CAPACITY;
+            ret = MPU6050_FIFO_OVERFLOW;
+        }
+        if (n > MPU6050_FIFO_MAX_SAMPLES) {
+            n = MPU6050_FIFO_MAX_SAMPLES;
+        }
+
+        for (uint64_t i = 0; i < n; ++i) {
+            inst->timer += MPU6050_SAMPLE_PERIOD_US;
+            mpu6050_sample(inst, inst->timer);
+        }
+
+        return ret;
+#   else
+        inst->timer = time;
+        mpu6050_sample(inst, time);
+
+        return 0;
+#   endif // MPU6050_FIFO
+}
+
+void mpu6050_init_dma(mpu6050_inst_t *inst) {
+    inst->dma_busy = 0;
+}
+
+int mpu6050_start_update(mpu6050_inst_t *inst) {
+    return mpu6050_start_update_at(inst, get_absolute_time());
+}
+
+int mpu6050_start_update_at(mpu6050_inst_t *inst, absolute_time_t time) {
+    if (!inst->dma_busy) {
+        inst->dma_time = time;
+        inst->dma_busy = 1;
+    }
+    return 0;
+}
+
+#ifdef MPU6050_DATA_READY
+int mpu6050_init_data_ready(mpu6050_inst_t *inst, uint pin) {
+    inst->int_pin = pin;
+    return 0;
+}
+#endif // MPU6050_DATA_READY
+
+int mpu6050_finish_update(mpu6050_inst_t *inst) {
+    if (!inst->dma_busy) {
+        return 0;
+    }
+    inst->dma_busy = 0;
+
+    return mpu6050_update_state_at(inst, inst->dma_time);
+}
+
+void mpu6050_set_gyro_filter(mpu6050_inst_t *inst, mpu6050_gyro_filter_t filter, void *context) {
+    inst->gyro_filter = filter;
+    inst->gyro_filter_context = context;
+}
+
+quaternion_t mpu6050_get_quaternion(const mpu6050_inst_t *inst) {
+    return inst->orientation;
+}
+
+vector_t mpu6050_get_rates(const mpu6050_inst_t *inst) {
+    return inst->rates;
+}
+
+float mpu6050_get_roll(const mpu6050_inst_t *inst) {
+    return quaternion_get_roll(&inst->orientation);
+}
+
+float mpu6050_get_pitch(const mpu6050_inst_t *inst) {
+    return quaternion_get_pitch(&inst->orientation);
+}
+
+float mpu6050_get_yaw(const mpu6050_inst_t *inst) {
+    return quaternion_get_yaw(&inst->orientation);
+}
@@ -0,0 +1,29 @@
+// Simulated servo and motor outputs, reported to the sil harness
+
+#include "pwm.h"
+
+#include "sil.h"
+
+void pwm_esc_patch() {}
+
+void pwm_init_all_outputs() {}
+
+void pwm_set_right_elevon(float input) {
+    sil_set_output(SIL_RIGHT_ELEVON, input);
+}
+
+void pwm_set_left_elevon(float input) {
+    sil_set_output(SIL_LEFT_ELEVON, input);
+}
+
+void pwm_set_right_motor(float input) {
+    sil_set_output(SIL_RIGHT_MOTOR, input);
+}
+
+void pwm_set_left_motor(float input) {
+    sil_set_output(SIL_LEFT_MOTOR, input);
+}
+
+void pwm_disable_all_outputs() {
+    sil_disable_outputs();
+}
@@ -0,0 +1,185 @@
+// Unit tests for the float implementation of lib/3dmath against a double
+// precision reference
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3dmath.h>
+
+#define NUM_TRIALS 100000
+
+#define TOLERANCE 1e-5
+#define ANGLE_TOLERANCE 1e-3 // units: degrees
+
+typedef struct {
+    double w, x, y, z;
+} Quat;
+
+static int failures = 0;
+
+static void expect(int ok, const char *name, double got, double want) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("fail: %s got %.9g want %.9g\n", name, got, want);
+        }
+        ++failures;
+    }
+}
+
+static void expect_near(const char *name, double got, double want, double tolerance) {
+    expect(fabs(got - want) <= tolerance, name, got, want);
+}
+
+static void expect_angle(const char *name, double got, double want) {
+    double e = fmod(fabs(got - want), 360);
+    expect((e > 180 ? 360 - e : e) <= ANGLE_TOLERANCE, name, got, want);
+}
+
+static double uniform(double min, double max) {
+    return min + (max - min) * rand() / (double)RAND_MAX;
+}
+
+static Quat normalized(Quat q) {
+    double n = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+    Quat r = { q.w / n, q.x / n, q.y / n, q.z / n };
+    return r;
+}
+
+// a random unit quaternion away from pitch +/- 90, where roll and yaw are
+// ill conditioned
+static Quat random_quat(void) {
+    for (;;) {
+        Quat q = { uniform(-1, 1), uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+        if (sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z) < 0.1) {
+            continue;
+        }
+        q = normalized(q);
+        if (fabs(2 * (q.x * q.y + q.z * q.w)) < 0.98) {
+            return q;
+        }
+    }
+}
+
+static quaternion_t to_float(Quat q) {
+    quaternion_t result = { q.w, q.x, q.y, q.z };
+    return result;
+}
+
+static Quat product(Quat p, Quat q) {
+    Quat r = {
+        p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z,
+        p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y,
+        p.w * q.y - p.x * q.z + p.y * q.w + p.z * q.x,
+        p.w * q.z + p.x * q.y - p.y * q.x + p.z * q.w
+    };
+    return normalized(r);
+}
+
+static void expect_quat(const char *name, quaternion_t got, Quat want) {
+    expect_near(name, got.w, want.w, TOLERANCE);
+    expect_near(name, got.x, want.x, TOLERANCE);
+    expect_near(name, got.y, want.y, TOLERANCE);
+    expect_near(name, got.z, want.z, TOLERANCE);
+}
+
+static double ref_roll(Quat q) {
+    double roll = atan2(2 * q.x * q.w - 2 * q.y * q.z,
+        1 - 2 * q.x * q.x - 2 * q.z * q.z) * 180 / M_PI;
+    return roll < -90 ? roll + 270 : roll - 90;
+}
+
+static double ref_pitch(Quat q) {
+    return asin(2 * q.x * q.y + 2 * q.z * q.w) * 180 / M_PI;
+}
+
+static double ref_yaw(Quat q) {
+    return atan2(2 * q.y * q.w - 2 * q.x * q.z,
+        1 - 2 * q.y * q.y - 2 * q.z * q.z) * 180 / M_PI;
+}
+
+static void test_norms(void) {
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        vector_t v = { uniform(-10, 10), uniform(-10, 10), uniform(-10, 10) };
+        double want = sqrt((double)v.x * v.x + (double)v.y * v.y + (double)v.z * v.z);
+        expect_near("vector_norm", vector_norm(&v), want, want * TOLERANCE);
+
+        Quat q = { uniform(-2, 2), uniform(-2, 2), uniform(-2, 2), uniform(-2, 2) };
+        quaternion_t fq = to_float(q);
+        want = sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+        expect_near("quaternion_norm", quaternion_norm(&fq), want, want * TOLERANCE);
+    }
+}
+
+static void test_product(void) {
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        Quat p = random_quat();
+        Quat q = random_quat();
+        quaternion_t fp = to_float(p);
+        quaternion_t fq = to_float(q);
+
+        expect_quat("quaternion_product", quaternion_product(&fp, &fq), product(p, q));
+    }
+
+    // every component is normalized, not just some of them
+    quaternion_t p = { 1.1f, 0.2f, 0.3f, 0.4f };
+    quaternion_t q = { 0.9f, -0.1f, 0.5f, 0.6f };
+    quaternion_t r = quaternion_product(&p, &q);
+    expect_near("quaternion_product norm", quaternion_norm(&r), 1, TOLERANCE);
+}
+
+static void test_rotate(void) {
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        Quat p = random_quat();
+        quaternion_t fp = to_float(p);
+
+        double angle = uniform(-180, 180);
+        double half = angle * M_PI / 360;
+        Quat roll = { cos(half), sin(half), 0, 0 };
+        Quat pitch = { cos(half), 0, sin(half), 0 };
+
+        expect_quat("quaternion_rotate_roll",
+            quaternion_rotate_roll(&fp, angle), product(p, roll));
+        expect_quat("quaternion_rotate_pitch",
+            quaternion_rotate_pitch(&fp, angle), product(p, pitch));
+    }
+}
+
+static void test_euler(void) {
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        Quat q = random_quat();
+        quaternion_t fq = to_float(q);
+
+        expect_angle("quaternion_get_roll", quaternion_get_roll(&fq), ref_roll(q));
+        expect_angle("quaternion_get_pitch", quaternion_get_pitch(&fq), ref_pitch(q));
+        expect_angle("quaternion_get_yaw", quaternion_get_yaw(&fq), ref_yaw(q));
+
+        euler_t euler;
+        quaternion_get_euler(&fq, &euler);
+        expect_angle("quaternion_get_euler roll", euler.roll, ref_roll(q));
+        expect_angle("quaternion_get_euler pitch", euler.pitch, ref_pitch(q));
+        expect_angle("quaternion_get_euler yaw", euler.yaw, ref_yaw(q));
+    }
+
+    // rounding can leave the asin argument just above 1
+    quaternion_t up = { 0.70710678f, 0.0f, 0.0f, 0.70710678f };
+    float pitch = quaternion_get_pitch(&up);
+    expect(!isnan(pitch), "quaternion_get_pitch at 90", pitch, 90);
+}
+
+int main(void) {
+    srand(1);
+
+    test_norms();
+    test_product();
+    test_rotate();
+    test_euler();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
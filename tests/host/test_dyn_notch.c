@@ -0,0 +1,207 @@
+// Tests the dynamic notch in src/dyn_notch on synthetic gyro traces: slow
+// maneuvers plus sensor noise plus prop vibration whose frequency follows the
+// throttle. Checks that the peaks are found, tracked through a throttle ramp
+// and removed by the notches, and reports the worst case cost of one step.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "dyn_notch.h"
+
+#define SAMPLE_RATE_HZ 1000
+
+#define MANEUVER_HZ 2
+#define MANEUVER_AMPLITUDE 50 // units: degrees per second
+#define GYRO_NOISE 2 // units: degrees per second
+
+#define MAX_PEAK_ERROR 4 // units: Hz
+#define MAX_TRACKING_ERROR 15 // units: Hz, well inside the notch width
+#define MAX_RESIDUAL 0.1 // fraction of the vibration left after the notch
+#define MAX_FALSE_PEAKS 0.05 // fraction of analyses reporting a peak without vibration
+
+static const double vibration_amplitude[DYN_NOTCH_AXES] = { 20, 15, 10 };
+
+static int failures = 0;
+
+static double worst_step_ns = 0;
+
+typedef struct {
+    double time;
+    double phase; // of the vibration, continuous through frequency changes
+} Trace;
+
+// deterministic normally distributed noise
+static double noise(double sigma) {
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// next gyro sample with vibration at vibration_hz, or none if 0. The vibration
+// alone is returned in vibration.
+static vector_t next_sample(Trace *trace, double vibration_hz, vector_t *vibration) {
+    trace->time += 1.0 / SAMPLE_RATE_HZ;
+    trace->phase += 2 * M_PI * vibration_hz / SAMPLE_RATE_HZ;
+
+    double maneuver = MANEUVER_AMPLITUDE * sin(2 * M_PI * MANEUVER_HZ * trace->time);
+    double on = vibration_hz > 0 ? 1 : 0;
+
+    vibration->x = on * vibration_amplitude[0] * sin(trace->phase);
+    vibration->y = on * vibration_amplitude[1] * sin(trace->phase + 1);
+    vibration->z = on * vibration_amplitude[2] * sin(trace->phase + 2);
+
+    vector_t rates = {
+        maneuver + vibration->x + noise(GYRO_NOISE),
+        -maneuver + vibration->y + noise(GYRO_NOISE),
+        0.5 * maneuver + vibration->z + noise(GYRO_NOISE)
+    };
+    return rates;
+}
+
+static void step(Dyn_Notch *dn, vector_t *rates) {
+    dyn_notch_apply(dn, rates);
+
+    double start = now_ns();
+    dyn_notch_update(dn);
+    double elapsed = now_ns() - start;
+    if (elapsed > worst_step_ns) {
+        worst_step_ns = elapsed;
+    }
+}
+
+static void expect_below(const char *name, double got, double max) {
+    printf("%-28s %8.3f (limit %.3f)\n", name, got, max);
+    if (got > max) {
+        printf("fail: %s\n", name);
+        ++failures;
+    }
+}
+
+// constant throttle: the peak is found on every axis and the notch removes it
+static void test_constant(double vibration_hz) {
+    Dyn_Notch dn;
+    dyn_notch_init(&dn, SAMPLE_RATE_HZ);
+    Trace trace = { 0, 0 };
+
+    // settle
+    for (int n = 0; n < SAMPLE_RATE_HZ; ++n) {
+        vector_t vibration;
+        vector_t rates = next_sample(&trace, vibration_hz, &vibration);
+        step(&dn, &rates);
+    }
+
+    // measure the vibration left in the output by correlating with the
+    // input vibration, for the worst axis
+    double correlation[DYN_NOTCH_AXES] = { 0 };
+    double energy[DYN_NOTCH_AXES] = { 0 };
+    for (int n = 0; n < SAMPLE_RATE_HZ / 2; ++n) {
+        vector_t vibration;
+        vector_t rates = next_sample(&trace, vibration_hz, &vibration);
+        step(&dn, &rates);
+
+        const float out[DYN_NOTCH_AXES] = { rates.x, rates.y, rates.z };
+        const float vib[DYN_NOTCH_AXES] = { vibration.x, vibration.y, vibration.z };
+        for (int axis = 0; axis < DYN_NOTCH_AXES; ++axis) {
+            // the in phase and quadrature parts both count as residual
+            correlation[axis] += out[axis] * vib[axis];
+            energy[axis] += vib[axis] * vib[axis];
+        }
+    }
+
+    double peak_error = 0;
+    double residual = 0;
+    for (int axis = 0; axis < DYN_NOTCH_AXES; ++axis) {
+        peak_error = fmax(peak_error, fabs(dn.center_hz[axis] - vibration_hz));
+        residual = fmax(residual, fabs(correlation[axis]) / energy[axis]);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "peak error at %.0f Hz", vibration_hz);
+    expect_below(name, peak_error, MAX_PEAK_ERROR);
+    snprintf(name, sizeof(name), "reported peak at %.0f Hz", vibration_hz);
+    expect_below(name, fabs(dyn_notch_get_peak_hz(&dn) - vibration_hz), MAX_PEAK_ERROR);
+    snprintf(name, sizeof(name), "residual at %.0f Hz", vibration_hz);
+    expect_below(name, residual, MAX_RESIDUAL);
+}
+
+// throttle ramp: the notches follow the vibration as it moves
+static void test_ramp(double from_hz, double to_hz, double seconds) {
+    Dyn_Notch dn;
+    dyn_notch_init(&dn, SAMPLE_RATE_HZ);
+    Trace trace = { 0, 0 };
+
+    double worst = 0;
+    int samples = seconds * SAMPLE_RATE_HZ;
+    for (int n = 0; n < samples; ++n) {
+        double hz = from_hz + (to_hz - from_hz) * n / samples;
+
+        vector_t vibration;
+        vector_t rates = next_sample(&trace, hz, &vibration);
+        step(&dn, &rates);
+
+        // after the first analysis of every axis
+        if (n > SAMPLE_RATE_HZ / 2) {
+            for (int axis = 0; axis < DYN_NOTCH_AXES; ++axis) {
+                worst = fmax(worst, fabs(dn.center_hz[axis] - hz));
+            }
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "tracking %.0f to %.0f Hz", from_hz, to_hz);
+    expect_below(name, worst, MAX_TRACKING_ERROR);
+}
+
+// no vibration: maneuvers and noise alone should rarely look like a peak
+static void test_quiet(void) {
+    Dyn_Notch dn;
+    dyn_notch_init(&dn, SAMPLE_RATE_HZ);
+    Trace trace = { 0, 0 };
+
+    int analyses = 0;
+    int peaks = 0;
+    for (int n = 0; n < 10 * SAMPLE_RATE_HZ; ++n) {
+        vector_t vibration;
+        vector_t rates = next_sample(&trace, 0, &vibration);
+        uint8_t axis = dn.axis;
+        step(&dn, &rates);
+
+        if (dn.axis != axis) {
+            ++analyses;
+            if (dn.peak_power[axis] > 0) {
+                ++peaks;
+            }
+        }
+    }
+
+    expect_below("false peaks", (double)peaks / analyses, MAX_FALSE_PEAKS);
+}
+
+int main(void) {
+    srand(1);
+
+    test_constant(90);
+    test_constant(170);
+    test_constant(320);
+    test_ramp(100, 300, 3);
+    test_ramp(300, 120, 3);
+    test_quiet();
+
+    printf("worst step %.0f ns\n", worst_step_ns);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,263 @@
+// Steps every lane of a batch next to a scalar flight controller instance on
+// the same inputs and checks that their outputs and states match bit for bit.
+// The inputs are random walks of the sticks, switches, attitude and failure
+// flags of each lane, so every mode and failsafe is visited. Also compares
+// the time per aircraft of both.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "fc_batch.h"
+#include "flight_controller.h"
+
+#define NUM_TICKS 5000
+
+// lanes switch modes and fail about this often, units: ticks
+#define SWITCH_TICKS 400
+#define FAILURE_TICKS 2000
+
+// ctest skips the test with this code
+#define SKIP_RETURN_CODE 77
+
+typedef struct {
+    Fc_Input input;
+    Fc_Flags flags;
+    uint32_t random;
+} Lane;
+
+static Fc_Batch batch;
+static Fc_State scalar[FC_BATCH_SIZE];
+static Lane lanes[FC_BATCH_SIZE];
+
+static int failures = 0;
+
+// bit per Fc_Ctrl_Mode then per Fc_Flight_Mode reached by any lane
+static int visited = 0;
+
+static void expect(bool ok, const char *name, int tick, int lane) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("fail: %s at tick %d lane %d\n", name, tick, lane);
+        }
+        ++failures;
+    }
+}
+
+static bool same(float a, float b) {
+    return !memcmp(&a, &b, sizeof(a));
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// uniform in -1..1
+static float random_unit(uint32_t *state) {
+    return (xorshift(state) % 20001) / 10000.0f - 1;
+}
+
+static float walk(float val, uint32_t *state, float step, float min, float max) {
+    val += step * random_unit(state);
+    return val < min ? min : val > max ? max : val;
+}
+
+// one of the three positions of a switch
+static float random_switch(uint32_t *state) {
+    static const float positions[] = { FC_MIN_INPUT, FC_CEN_INPUT, FC_MAX_INPUT };
+    return positions[xorshift(state) % 3];
+}
+
+static void init_lane(Lane *lane, int n) {
+    memset(lane, 0, sizeof(*lane));
+    lane->random = n * 2654435761u + 1;
+
+    // armed from the start by most lanes
+    lane->input.thro = FC_MIN_INPUT;
+    lane->input.gear = FC_MIN_INPUT;
+    lane->input.aux1 = n % 8 ? FC_MIN_INPUT : FC_MAX_INPUT;
+    lane->input.orientation = (quaternion_t){ 1, 0, 0, 0 };
+}
+
+static void move_lane(Lane *lane, int tick) {
+    Fc_Input *input = &lane->input;
+    uint32_t *random = &lane->random;
+
+    if (tick < 10) {
+        return;
+    }
+
+    input->thro = walk(input->thro, random, 5, FC_MIN_INPUT, FC_MAX_INPUT);
+    input->elev = walk(input->elev, random, 5, FC_MIN_INPUT, FC_MAX_INPUT);
+    input->rudd = walk(input->rudd, random, 5, FC_MIN_INPUT, FC_MAX_INPUT);
+    input->aile = walk(input->aile, random, 5, FC_MIN_INPUT, FC_MAX_INPUT);
+
+    if (xorshift(random) % SWITCH_TICKS == 0) {
+        input->gear = random_switch(random);
+    }
+    if (xorshift(random) % SWITCH_TICKS == 0) {
+        input->aux1 = random_switch(random);
+    }
+
+    // tumbling through every attitude, wrapping the angles
+    quaternion_t q = input->orientation;
+    q = quaternion_rotate_roll(&q, 3 * random_unit(random));
+    q = quaternion_rotate_pitch(&q, 3 * random_unit(random));
+    input->orientation = q;
+
+    input->rates.x = walk(input->rates.x, random, 20, -500, 500);
+    input->rates.y = walk(input->rates.y, random, 20, -500, 500);
+    input->rates.z = walk(input->rates.z, random, 20, -500, 500);
+
+    lane->flags = 0;
+    if (xorshift(random) % FAILURE_TICKS < 20) {
+        lane->flags |= FC_RX_FAILED;
+    }
+    if (xorshift(random) % FAILURE_TICKS < 10) {
+        lane->flags |= FC_IMU_FAILED;
+    }
+    if (xorshift(random) % FAILURE_TICKS < 5) {
+        lane->flags |= FC_OVERRUN;
+    }
+}
+
+static void compare_pid(const pid_inst_t *pid, const Fc_Batch_Pid *batch_pid,
+    const char *name, int tick, int n) {
+    expect(same(pid->i_output, batch_pid->i_output[n]), name, tick, n);
+    expect(same(pid->prev_error, batch_pid->prev_error[n]), name, tick, n);
+}
+
+static void compare(int tick, int n) {
+    const Fc_State *fc = &scalar[n];
+
+    visited |= 1 << fc->ctrl_mode;
+    visited |= 8 << fc->flight_mode;
+
+    Fc_Output output;
+    fc_batch_get_output(&batch, n, &output);
+
+    expect(same(fc->output.right_elevon, output.right_elevon), "right elevon", tick, n);
+    expect(same(fc->output.left_elevon, output.left_elevon), "left elevon", tick, n);
+    expect(same(fc->output.right_motor, output.right_motor), "right motor", tick, n);
+    expect(same(fc->output.left_motor, output.left_motor), "left motor", tick, n);
+    expect(same(fc->output.gear, output.gear), "gear", tick, n);
+
+    expect(fc->flags == (Fc_Flags)batch.flags[n], "flags", tick, n);
+    expect(fc->ctrl_mode == (Fc_Ctrl_Mode)batch.ctrl_mode[n], "ctrl mode", tick, n);
+    expect(fc->flight_mode == (Fc_Flight_Mode)batch.flight_mode[n], "flight mode", tick, n);
+    expect(fc->waiting == (bool)batch.waiting[n], "waiting", tick, n);
+
+    expect(same(fc->tstate, batch.tstate[n]), "tstate", tick, n);
+    expect(same(fc->roll, batch.roll[n]), "roll", tick, n);
+    expect(same(fc->pitch, batch.pitch[n]), "pitch", tick, n);
+    expect(same(fc->yaw, batch.yaw[n]), "yaw", tick, n);
+    expect(same(fc->target_roll, batch.target_roll[n]), "target roll", tick, n);
+    expect(same(fc->target_pitch, batch.target_pitch[n]), "target pitch", tick, n);
+    expect(same(fc->target_yaw, batch.target_yaw[n]), "target yaw", tick, n);
+
+    expect(same(fc->pid_out.roll, batch.pid_out_roll[n]), "pid roll", tick, n);
+    expect(same(fc->pid_out.pitch, batch.pid_out_pitch[n]), "pid pitch", tick, n);
+    expect(same(fc->pid_out.yaw, batch.pid_out_yaw[n]), "pid yaw", tick, n);
+
+    compare_pid(&fc->pid_roll, &batch.pid_roll, "pid roll state", tick, n);
+    compare_pid(&fc->pid_pitch, &batch.pid_pitch, "pid pitch state", tick, n);
+    compare_pid(&fc->pid_yaw, &batch.pid_yaw, "pid yaw state", tick, n);
+
+#   ifdef FC_CASCADED
+        expect(same(fc->target_roll_rate, batch.target_roll_rate[n]), "target roll rate", tick, n);
+        expect(same(fc->roll_rate, batch.roll_rate[n]), "roll rate", tick, n);
+        compare_pid(&fc->pid_roll_rate, &batch.pid_roll_rate, "pid roll rate state", tick, n);
+        compare_pid(&fc->pid_pitch_rate, &batch.pid_pitch_rate, "pid pitch rate state", tick, n);
+        compare_pid(&fc->pid_yaw_rate, &batch.pid_yaw_rate, "pid yaw rate state", tick, n);
+#   endif // FC_CASCADED
+}
+
+static double elapsed_s(const struct timespec *begin, const struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+int main(void) {
+    // built with FC_BATCH_AVX2 against the avx2 kernels
+#   ifdef FC_BATCH_AVX2
+        if (!__builtin_cpu_supports("avx2")) {
+            printf("skipped: no avx2 on this cpu\n");
+            return SKIP_RETURN_CODE;
+        }
+#   endif
+
+    fc_batch_init(&batch);
+    for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+        fc_init(&scalar[n]);
+        init_lane(&lanes[n], n);
+    }
+
+    uint32_t random = 12345;
+    double scalar_s = 0;
+    double batch_s = 0;
+
+    for (int tick = 0; tick < NUM_TICKS; ++tick) {
+        // jitter in the loop period, the same for every lane
+        uint32_t dt_us = FC_PERIOD_US - 500 + xorshift(&random) % 1000;
+
+        for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+            move_lane(&lanes[n], tick);
+            fc_batch_set_input(&batch, n, &lanes[n].input, lanes[n].flags);
+        }
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+
+        for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+            fc_calc(&scalar[n], &lanes[n].input, lanes[n].flags, dt_us);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        fc_batch_calc(&batch, dt_us);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+
+        scalar_s += elapsed_s(&t0, &t1);
+        batch_s += elapsed_s(&t1, &t2);
+
+        for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+            compare(tick, n);
+        }
+
+#       ifdef FC_CASCADED
+            // the rate loop at the imu rate in between, from the second half
+            if (tick >= NUM_TICKS / 2) {
+                uint32_t rate_dt_us = IMU_PERIOD_US;
+                for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+                    fc_calc_rate(&scalar[n], &lanes[n].input.rates, rate_dt_us);
+                }
+                fc_batch_calc_rate(&batch, rate_dt_us);
+
+                for (int n = 0; n < FC_BATCH_SIZE; ++n) {
+                    compare(tick, n);
+                }
+            }
+#       endif // FC_CASCADED
+    }
+
+    // the walks must have reached every mode for the comparison to mean much
+    expect(visited == 0x3f, "every mode visited", NUM_TICKS, 0);
+
+    double aircraft_ticks = (double)NUM_TICKS * FC_BATCH_SIZE;
+    printf("%d lanes, %d wide: scalar %.1f ns, batch %.1f ns per aircraft, %.1fx\n",
+        FC_BATCH_SIZE, fc_batch_width(),
+        1e9 * scalar_s / aircraft_ticks, 1e9 * batch_s / aircraft_ticks, scalar_s / batch_s);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,59 @@
+// Checks the cascaded controller of src/flight_controller.c, built with
+// FC_CASCADED: fc_calc() runs the rate loop itself until fc_calc_rate() takes
+// it over, and in a tick where src/main.c runs both fc_rate and fc_calc the
+// rate pids are stepped once.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+
+static int failures = 0;
+
+static void expect(bool ok, const char *name) {
+    if (!ok) {
+        printf("fail: %s\n", name);
+        ++failures;
+    }
+}
+
+static bool same_rate_pids(const Fc_State *a, const Fc_State *b) {
+    return !memcmp(&a->pid_roll_rate, &b->pid_roll_rate, sizeof(a->pid_roll_rate)) &&
+        !memcmp(&a->pid_pitch_rate, &b->pid_pitch_rate, sizeof(a->pid_pitch_rate)) &&
+        !memcmp(&a->pid_yaw_rate, &b->pid_yaw_rate, sizeof(a->pid_yaw_rate));
+}
+
+int main(void) {
+    // level in angle control, turning on every axis
+    Fc_Input input;
+    memset(&input, 0, sizeof(input));
+    input.orientation = (quaternion_t){ 1, 0, 0, 0 };
+    input.aux1 = FC_MAX_INPUT;
+    input.rates = (vector_t){ 10, -10, 5 };
+
+    Fc_State fc;
+    fc_init(&fc);
+    fc_calc(&fc, &input, 0, FC_PERIOD_US);
+
+    Fc_State last = fc;
+    fc_calc(&fc, &input, 0, FC_PERIOD_US);
+    expect(!same_rate_pids(&fc, &last), "fc_calc() runs the rate loop");
+
+    // a tick of the loop, fc_rate then fc_calc
+    last = fc;
+    fc_calc_rate(&fc, &input.rates, IMU_PERIOD_US);
+    expect(!same_rate_pids(&fc, &last), "fc_calc_rate() runs the rate loop");
+
+    last = fc;
+    fc_calc(&fc, &input, 0, FC_PERIOD_US);
+    expect(same_rate_pids(&fc, &last), "rate pids stepped once per tick");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Flies many aircraft in one process, each with its own flight controller
+// instance and plant, and checks that they do not share any state. Every
+// aircraft is first flown alone, then all of them again interleaved tick by
+// tick across threads. Both runs must give the same outputs bit for bit.
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "plant.h"
+
+#define NUM_AIRCRAFT 64
+#define NUM_THREADS 8
+#define FLIGHT_S 20
+
+// the sticks are centered in manual to arm, then fly angle mode
+#define ARM_S 0.5f
+
+typedef struct {
+    Fc_State fc;
+    Plant plant;
+    Fc_Input input;
+
+    // stick inputs, different for each aircraft
+    float stick_amplitude;
+    float stick_hz;
+
+    uint64_t hash; // of every output
+    uint32_t tick;
+} Aircraft;
+
+typedef struct {
+    Aircraft *aircraft;
+    int count;
+} Worker;
+
+static int failures = 0;
+
+static void expect(bool ok, const char *name) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("fail: %s\n", name);
+        }
+        ++failures;
+    }
+}
+
+// fnv-1a over the bytes of the output
+static uint64_t hash_output(uint64_t hash, const Fc_Output *output) {
+    const uint8_t *bytes = (const uint8_t *)output;
+    for (size_t i = 0; i < sizeof(*output); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211u;
+    }
+    return hash;
+}
+
+static void aircraft_init(Aircraft *aircraft, int n) {
+    memset(aircraft, 0, sizeof(*aircraft));
+
+    fc_init(&aircraft->fc);
+    plant_init_level(&aircraft->plant, 100 + n, 15);
+
+    aircraft->stick_amplitude = 10 + n % 8 * 5;
+    aircraft->stick_hz = 0.1f + n / 8 * 0.05f;
+    aircraft->hash = 14695981039346656037u;
+}
+
+static void aircraft_fly(Aircraft *aircraft, float t) {
+    Fc_Input *input = &aircraft->input;
+
+    input->gear = FC_MIN_INPUT;
+    input->thro = FC_MIN_INPUT;
+    input->aile = FC_CEN_INPUT;
+    input->elev = FC_CEN_INPUT;
+    input->rudd = FC_CEN_INPUT;
+    input->aux1 = FC_MIN_INPUT;
+
+    if (t >= ARM_S) {
+        float phase = 2 * (float)M_PI * aircraft->stick_hz * t;
+        input->thro = 30;
+        input->aile = aircraft->stick_amplitude * sinf(phase);
+        input->elev = aircraft->stick_amplitude * cosf(phase) / 2;
+        input->rudd = aircraft->stick_amplitude * sinf(2 * phase) / 2;
+        input->aux1 = FC_MAX_INPUT;
+    }
+}
+
+// one imu period of the loop in test_plant.c
+static void aircraft_step(Aircraft *aircraft) {
+    const uint32_t fc_ticks = FC_PERIOD_US / IMU_PERIOD_US;
+    float t = aircraft->tick * (IMU_PERIOD_US / 1000000.0f);
+
+    plant_get_input(&aircraft->plant, &aircraft->input);
+
+    const Fc_Output *output = NULL;
+    if (aircraft->tick % fc_ticks == 0) {
+        aircraft_fly(aircraft, t);
+        output = fc_calc(&aircraft->fc, &aircraft->input, 0, FC_PERIOD_US);
+    }
+#   ifdef FC_CASCADED
+        else {
+            output = fc_calc_rate(&aircraft->fc, &aircraft->input.rates, IMU_PERIOD_US);
+        }
+#   endif // FC_CASCADED
+
+    if (output) {
+        aircraft->hash = hash_output(aircraft->hash, output);
+        plant_set_output(&aircraft->plant, output);
+    }
+
+    plant_step(&aircraft->plant, IMU_PERIOD_US);
+    ++aircraft->tick;
+}
+
+// steps every aircraft of the worker in turn, so any state shared between
+// instances would mix their flights
+static void *worker_run(void *context) {
+    Worker *worker = context;
+    const uint32_t ticks = FLIGHT_S * (1000000 / IMU_PERIOD_US);
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        for (int i = 0; i < worker->count; ++i) {
+            aircraft_step(&worker->aircraft[i]);
+        }
+    }
+    return NULL;
+}
+
+static Aircraft alone[NUM_AIRCRAFT];
+static Aircraft together[NUM_AIRCRAFT];
+
+int main(void) {
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    for (int n = 0; n < NUM_AIRCRAFT; ++n) {
+        aircraft_init(&alone[n], n);
+
+        Worker worker = { &alone[n], 1 };
+        worker_run(&worker);
+    }
+
+    for (int n = 0; n < NUM_AIRCRAFT; ++n) {
+        aircraft_init(&together[n], n);
+    }
+
+    pthread_t threads[NUM_THREADS];
+    Worker workers[NUM_THREADS];
+    const int per_thread = NUM_AIRCRAFT / NUM_THREADS;
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        workers[i].aircraft = &together[i * per_thread];
+        workers[i].count = per_thread;
+        expect(!pthread_create(&threads[i], NULL, worker_run, &workers[i]), "thread start");
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("flew %d aircraft for %d s twice in %.3f s\n", NUM_AIRCRAFT, FLIGHT_S, wall_s);
+
+    int distinct = 0;
+    for (int n = 0; n < NUM_AIRCRAFT; ++n) {
+        expect(together[n].hash == alone[n].hash, "same outputs alone and together");
+        expect(!memcmp(&together[n].plant.body, &alone[n].plant.body, sizeof(Plant_Body)),
+            "same flight alone and together");
+        expect(!together[n].fc.waiting, "armed");
+
+        if (n == 0 || alone[n].hash != alone[n - 1].hash) {
+            ++distinct;
+        }
+    }
+
+    // otherwise the comparison above shows nothing
+    expect(distinct == NUM_AIRCRAFT, "distinct flights");
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
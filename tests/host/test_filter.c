@@ -0,0 +1,111 @@
+// Frequency response tests for src/filter. Each filter is driven with sine
+// waves at a 1 kHz loop rate and the steady state gain is compared with what
+// the filter was designed for.
+
+#include <math.h>
+#include <stdio.h>
+
+#include "filter.h"
+
+#define SAMPLE_RATE_HZ 1000
+#define SETTLE_SAMPLES 2000
+#define MEASURE_SAMPLES 1000 // a whole number of cycles for integer frequencies
+
+static int failures = 0;
+
+// steady state gain of filter at freq_hz, by correlating the output with the
+// input sine and cosine
+static double measure_gain(filter_t filter, double freq_hz) {
+    double in_phase = 0;
+    double quadrature = 0;
+
+    for (int n = 0; n < SETTLE_SAMPLES + MEASURE_SAMPLES; ++n) {
+        double phase = 2 * M_PI * freq_hz * n / SAMPLE_RATE_HZ;
+        double output = filter_apply(&filter, sin(phase));
+
+        if (n >= SETTLE_SAMPLES) {
+            in_phase += output * sin(phase);
+            quadrature += output * cos(phase);
+        }
+    }
+
+    return 2 * sqrt(in_phase * in_phase + quadrature * quadrature) / MEASURE_SAMPLES;
+}
+
+static void expect_gain(const char *name, const filter_t *filter, double freq_hz,
+    double min, double max
+) {
+    double gain = measure_gain(*filter, freq_hz);
+    printf("%-16s %6.1f Hz  gain %.4f\n", name, freq_hz, gain);
+    if (gain < min || gain > max) {
+        printf("fail: %s gain at %.1f Hz not in [%.4f, %.4f]\n", name, freq_hz, min, max);
+        ++failures;
+    }
+}
+
+static void test_none(void) {
+    filter_t filter;
+    filter_init_none(&filter);
+
+    expect_gain("none", &filter, 100, 0.9999, 1.0001);
+}
+
+static void test_pt1(void) {
+    filter_t filter;
+    filter_init_pt1(&filter, 50, SAMPLE_RATE_HZ);
+
+    expect_gain("pt1", &filter, 1, 0.99, 1.01);
+    // the discrete pole sits a little below the analog one at 1 kHz
+    expect_gain("pt1", &filter, 50, 0.64, 0.72);
+    expect_gain("pt1", &filter, 400, 0, 0.2);
+}
+
+static void test_biquad_lpf(void) {
+    filter_t filter;
+    filter_init_biquad_lpf(&filter, 80, SAMPLE_RATE_HZ);
+
+    expect_gain("biquad_lpf", &filter, 1, 0.999, 1.001);
+    expect_gain("biquad_lpf", &filter, 80, 0.69, 0.72);
+    expect_gain("biquad_lpf", &filter, 400, 0, 0.02);
+}
+
+static void test_notch(void) {
+    filter_t filter;
+    filter_init_notch(&filter, 150, SAMPLE_RATE_HZ, filter_notch_q(150, 100));
+
+    expect_gain("notch", &filter, 10, 0.99, 1.01);
+    expect_gain("notch", &filter, 150, 0, 0.01);
+    expect_gain("notch", &filter, 400, 0.95, 1.01);
+
+    // moving the notch keeps the history and rejects the new center
+    biquad_filter_update_notch(&filter.biquad, 200, SAMPLE_RATE_HZ, filter_notch_q(200, 140));
+    expect_gain("notch moved", &filter, 200, 0, 0.01);
+    expect_gain("notch moved", &filter, 10, 0.99, 1.01);
+}
+
+static void test_fir(void) {
+    static const float response[FIR_NUM_TAPS] = { 0.4, 0.3, 0.2, 0.1 };
+
+    filter_t filter;
+    filter_init_fir(&filter, response);
+
+    // |0.4 + 0.3 z^-1 + 0.2 z^-2 + 0.1 z^-3| at dc and a quarter of the rate
+    expect_gain("fir", &filter, 1, 0.99, 1.0);
+    expect_gain("fir", &filter, 250, 0.280, 0.286);
+}
+
+int main(void) {
+    test_none();
+    test_pt1();
+    test_biquad_lpf();
+    test_notch();
+    test_fir();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
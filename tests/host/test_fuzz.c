@@ -0,0 +1,167 @@
+// Checks the parts of the fuzzer: sequences are reproducible from their seed
+// and finite, each safety property catches a state that breaks it, and a
+// planted property that any armed flight breaks is shrunk to the two steps
+// that arm and open the throttle.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fuzz.h"
+
+#define SEED 1
+
+// sequences searched for the planted property
+#define MAX_SEQUENCES 1000
+
+static int failures = 0;
+
+static void expect(bool ok, const char *name) {
+    if (!ok) {
+        printf("fail: %s\n", name);
+        ++failures;
+    }
+}
+
+static Fuzz_Step steps[FUZZ_SEQUENCE_STEPS];
+static Fuzz_Step again[FUZZ_SEQUENCE_STEPS];
+
+static bool finite_input(const Fc_Input *input) {
+    return isfinite(input->thro) && isfinite(input->elev) && isfinite(input->rudd) &&
+        isfinite(input->aile) && isfinite(input->gear) && isfinite(input->aux1) &&
+        isfinite(input->alt) && isfinite(input->noise_hz) &&
+        isfinite(input->rates.x) && isfinite(input->rates.y) && isfinite(input->rates.z);
+}
+
+static void test_generate(void) {
+    fuzz_generate(fuzz_sequence_seed(SEED, 3), steps, FUZZ_SEQUENCE_STEPS);
+    fuzz_generate(fuzz_sequence_seed(SEED, 3), again, FUZZ_SEQUENCE_STEPS);
+    expect(!memcmp(steps, again, sizeof(steps)), "same seed, same sequence");
+
+    fuzz_generate(fuzz_sequence_seed(SEED, 4), again, FUZZ_SEQUENCE_STEPS);
+    expect(memcmp(steps, again, sizeof(steps)), "other seed, other sequence");
+
+    bool finite = true;
+    float max_norm_error = 0;
+    for (int n = 0; n < FUZZ_SEQUENCE_STEPS; ++n) {
+        const Fc_Input *input = &steps[n].input;
+        finite &= finite_input(input);
+        max_norm_error = fmaxf(max_norm_error, fabsf(quaternion_norm(&input->orientation) - 1));
+    }
+    expect(finite, "finite inputs");
+    expect(max_norm_error < 1e-5f, "unit orientations");
+}
+
+// a state after a few steps on the ground, to break one property at a time
+static void ground_state(Fc_State *fc, Fuzz_Step *step, bool armed) {
+    memset(step, 0, sizeof(*step));
+    step->input.orientation = (quaternion_t){ 1, 0, 0, 0 };
+    step->input.thro = FC_MIN_INPUT;
+    step->input.gear = FC_MIN_INPUT;
+    step->input.aux1 = armed ? FC_MIN_INPUT : FC_MAX_INPUT;
+    step->dt_us = FC_PERIOD_US;
+
+    fc_init(fc);
+    for (int n = 0; n < 3; ++n) {
+        fc_calc(fc, &step->input, step->flags, step->dt_us);
+    }
+}
+
+static void test_checks(void) {
+    Fc_State fc;
+    Fuzz_Step step;
+
+    ground_state(&fc, &step, false);
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_OK, "waiting on the ground passes");
+    fc.output.left_motor = 0;
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_MOTORS_WAITING, "motors while waiting");
+
+    ground_state(&fc, &step, true);
+    expect(!fc.waiting, "armed on the ground");
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_OK, "armed on the ground passes");
+
+    fc.output.right_motor = 0;
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_MOTORS_LOW_THROTTLE, "motors at low throttle");
+    fc.input.thro = 0;
+    fc.flags = FC_RX_FAILED;
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_MOTORS_RX_FAILED, "motors after a receiver failure");
+
+    ground_state(&fc, &step, true);
+    fc.output.gear = nanf("");
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_NAN, "nan output");
+    fc.output.gear = FC_MIN_OUTPUT;
+    fc.target_yaw = INFINITY;
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_NAN, "infinite target");
+
+    ground_state(&fc, &step, true);
+    fc.output.left_elevon = nextafterf(FC_MAX_OUTPUT, INFINITY);
+    expect(fuzz_check_safety(&fc, &step, fc.tstate) == FUZZ_OUTPUT_BOUNDS, "output over the maximum");
+
+    ground_state(&fc, &step, true);
+    expect(fuzz_check_safety(&fc, &step, fc.tstate - 2) == FUZZ_TSTATE, "tstate faster than a transition");
+}
+
+// planted: the motors never leave the minimum, broken by any armed flight
+static Fuzz_Property check_motors_never_run(const Fc_State *fc, const Fuzz_Step *step,
+    float last_tstate) {
+    if ((fc->output.right_motor != FC_MIN_OUTPUT) || (fc->output.left_motor != FC_MIN_OUTPUT)) {
+        return FUZZ_OUTPUT_BOUNDS;
+    }
+    return FUZZ_OK;
+}
+
+static bool whole(float val) {
+    return val == roundf(val);
+}
+
+static void test_shrink(void) {
+    Fuzz_Failure failure;
+    uint64_t n = 0;
+    for (; n < MAX_SEQUENCES; ++n) {
+        fuzz_generate(fuzz_sequence_seed(SEED, n), steps, FUZZ_SEQUENCE_STEPS);
+        if (!fuzz_run(steps, FUZZ_SEQUENCE_STEPS, check_motors_never_run, &failure)) {
+            break;
+        }
+    }
+    expect(n < MAX_SEQUENCES, "planted property fails");
+    if (n == MAX_SEQUENCES) {
+        return;
+    }
+
+    int found = failure.step + 1;
+    int num_steps = fuzz_shrink(steps, FUZZ_SEQUENCE_STEPS, check_motors_never_run, &failure);
+    printf("sequence %llu fails at step %d, shrunk to %d steps\n",
+        (unsigned long long)n, found - 1, num_steps);
+    fuzz_print(stdout, steps, num_steps, &failure);
+
+    // arms in the first step and opens the throttle in the second
+    expect(num_steps == 2, "shrunk to two steps");
+    expect(failure.property == FUZZ_OUTPUT_BOUNDS && failure.step == num_steps - 1,
+        "same property at the last step");
+    expect(!fuzz_run(steps, num_steps, check_motors_never_run, &failure), "shrunk steps still fail");
+
+    bool simple = true;
+    for (int i = 0; i < num_steps; ++i) {
+        const Fc_Input *input = &steps[i].input;
+        simple &= whole(input->thro) && whole(input->elev) && whole(input->rudd) &&
+            whole(input->aile) && whole(input->gear) && whole(input->aux1);
+        simple &= steps[i].dt_us == FC_PERIOD_US && !steps[i].rate;
+        simple &= steps[i].input.orientation.w == 1;
+    }
+    expect(simple, "shrunk to whole sticks, level and on time");
+    expect(steps[0].input.thro < FC_MIN_INPUT + FC_DEAD_STICK, "arms at low throttle");
+}
+
+int main(void) {
+    test_generate();
+    test_checks();
+    test_shrink();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Checks the tables generated by src/gain_schedule.py from
+// gain_schedule_points.txt against the breakpoints and against
+// quaternion_rotate_pitch()
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <3dmath.h>
+
+#include "gain_schedule.h"
+
+#define NUM_TRIALS 10000
+
+#define GAIN_TOLERANCE 1e-5
+#define QUATERNION_TOLERANCE 1e-5
+
+static int failures = 0;
+
+static void expect_near(const char *name, int tstate, double got, double want, double tolerance) {
+    if (fabs(got - want) > tolerance) {
+        if (failures < 10) {
+            printf("fail: %s at tstate %d got %.9g want %.9g\n", name, tstate, got, want);
+        }
+        ++failures;
+    }
+}
+
+static void expect_gains(int tstate, const Fc_Pid_Gains *want) {
+    const Fc_Pid_Gains *got = &fc_gain_schedule[tstate].pitch;
+    expect_near("pitch p", tstate, got->p, want->p, GAIN_TOLERANCE);
+    expect_near("pitch i", tstate, got->i, want->i, GAIN_TOLERANCE);
+    expect_near("pitch d", tstate, got->d, want->d, GAIN_TOLERANCE);
+    expect_near("pitch i_max", tstate, got->i_max, want->i_max, GAIN_TOLERANCE);
+}
+
+static void test_gains(void) {
+    // values from gain_schedule_points.txt
+    const Fc_Pid_Gains at_0 = { 3.0, 0.0, 0.0, 1.0 };
+    const Fc_Pid_Gains at_15 = { 2.5, 0.05, 0.05, 1.5 };
+    const Fc_Pid_Gains at_30 = { 2.0, 0.1, 0.1, 2.0 };
+    const Fc_Pid_Gains at_60 = { 2.5, 0.05, 0.15, 1.5 };
+    const Fc_Pid_Gains at_90 = { 3.0, 0.0, 0.2, 1.0 };
+
+    expect_gains(0, &at_0);
+    expect_gains(15, &at_15);
+    expect_gains(30, &at_30);
+    expect_gains(60, &at_60);
+    expect_gains(90, &at_90);
+
+    expect_near("roll p", 30, fc_gain_schedule[30].roll.p, 1.0, GAIN_TOLERANCE);
+    expect_near("roll i_max", 90, fc_gain_schedule[90].roll.i_max, 5.0, GAIN_TOLERANCE);
+    expect_near("yaw i", 30, fc_gain_schedule[30].yaw.i, 0.2, GAIN_TOLERANCE);
+    expect_near("yaw p", 60, fc_gain_schedule[60].yaw.p, 2.0, GAIN_TOLERANCE);
+}
+
+static double uniform(double min, double max) {
+    return min + (max - min) * rand() / (double)RAND_MAX;
+}
+
+static void test_rotation(void) {
+    for (int n = 0; n < NUM_TRIALS; ++n) {
+        quaternion_t q = { uniform(-1, 1), uniform(-1, 1), uniform(-1, 1), uniform(-1, 1) };
+        float norm = quaternion_norm(&q);
+        if (norm < 0.1f) {
+            continue;
+        }
+        q.w /= norm;
+        q.x /= norm;
+        q.y /= norm;
+        q.z /= norm;
+
+        int tstate = rand() % (FC_MAX_TSTATE + 1);
+        quaternion_t got = quaternion_product(&q, &fc_tstate_rotation[tstate]);
+        quaternion_t want = quaternion_rotate_pitch(&q, tstate * -1);
+
+        expect_near("rotation w", tstate, got.w, want.w, QUATERNION_TOLERANCE);
+        expect_near("rotation x", tstate, got.x, want.x, QUATERNION_TOLERANCE);
+        expect_near("rotation y", tstate, got.y, want.y, QUATERNION_TOLERANCE);
+        expect_near("rotation z", tstate, got.z, want.z, QUATERNION_TOLERANCE);
+    }
+}
+
+int main(void) {
+    srand(1);
+
+    test_gains();
+    test_rotation();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
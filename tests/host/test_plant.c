@@ -0,0 +1,346 @@
+// Checks the tail-sitter model against simple cases, then closes the loop
+// around fc_calc() for a ten minute flight: take off and hover, transition to
+// horizontal flight, cruise with turns, transition back and land. A scripted
+// pilot holds the altitude with the sticks. Pass -v to print the flight.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "plant.h"
+
+#define FLIGHT_S 600
+// to simulate the whole flight, which takes a fraction of a second with the
+// plant at -O2; loose so that a loaded machine does not fail the test
+#define MAX_WALL_S 5.0
+
+// seconds after a phase starts before its checks apply
+#define SETTLE_S 10
+
+#define MAX_ATTITUDE_ERROR 10.0f // units: degrees
+#define MAX_ALTITUDE_ERROR 5.0f // units: m
+#define MAX_TOUCHDOWN_SPEED 2.0f // units: m/s
+
+#define HOVER_ALT 30.0f // units: m
+#define LAND_RATE 1.0f // units: m/s
+
+// the pilot keeps the throttle near the hover, clear of the motor limits
+#define HOVER_THRO 40.0f
+#define MAX_THRO_CHANGE 20.0f
+
+typedef enum {
+    PHASE_ARM,
+    PHASE_TRANSITION_UP, // on the ground, until tstate is vertical
+    PHASE_HOVER,
+    PHASE_TRANSITION_OUT,
+    PHASE_CRUISE,
+    PHASE_TURNS,
+    PHASE_TRANSITION_BACK,
+    PHASE_LAND,
+    NUM_PHASES
+} Phase;
+
+static const char *phase_names[NUM_PHASES] = {
+    "arm",
+    "transition up",
+    "hover",
+    "transition out",
+    "cruise",
+    "turns",
+    "transition back",
+    "land"
+};
+
+// start of each phase, units: seconds
+static const float phase_start[NUM_PHASES] = {
+    0, 1, 6, 90, 100, 300, 500, 540
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *name) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("fail: %s\n", name);
+        }
+        ++failures;
+    }
+}
+
+static bool near(float a, float b, float limit) {
+    return fabsf(a - b) <= limit;
+}
+
+static void test_free_fall(void) {
+    Plant plant;
+    plant_init_ground(&plant);
+    plant.body.position.z = -100;
+    plant.on_ground = false;
+
+    // nose first, the wing is edge on to the flow and the drag is small
+    plant_step(&plant, 500000);
+    expect(near(plant.body.velocity.z, PLANT_GRAVITY * 0.5f, 0.02f * PLANT_GRAVITY),
+        "free fall");
+}
+
+static void test_hover_thrust(void) {
+    Plant plant;
+    plant_init_ground(&plant);
+    plant.body.position.z = -100;
+    plant.on_ground = false;
+
+    // the output of each motor that carries half the weight
+    float left = sqrtf(PLANT_MASS * PLANT_GRAVITY / 2 / PLANT_MOTOR_MAX_THRUST);
+    float right = sqrtf(PLANT_MASS * PLANT_GRAVITY / 2 / PLANT_MOTOR_MAX_THRUST /
+        PLANT_RIGHT_MOTOR_EFFICIENCY);
+    Fc_Output output = {
+        .right_motor = right * 200 - 100,
+        .left_motor = left * 200 - 100
+    };
+    plant_set_output(&plant, &output);
+    plant.motor_thrust[PLANT_RIGHT] = plant.motor_cmd[PLANT_RIGHT];
+    plant.motor_thrust[PLANT_LEFT] = plant.motor_cmd[PLANT_LEFT];
+
+    plant_step(&plant, 1000000);
+    expect(plant_get_airspeed(&plant) < 0.05f, "hover thrust");
+    expect(near(plant.body.rates.z, 0, 0.01f), "balanced motors");
+}
+
+static void test_actuators(void) {
+    Plant plant;
+    plant_init_ground(&plant);
+
+    Fc_Output output = {
+        .right_elevon = FC_MAX_OUTPUT,
+        .left_elevon = FC_MIN_OUTPUT,
+        .right_motor = FC_MAX_OUTPUT,
+        .left_motor = FC_MAX_OUTPUT
+    };
+    plant_set_output(&plant, &output);
+
+    // one time constant of the motor lag
+    plant_step(&plant, PLANT_MOTOR_LAG_S * 1000000);
+    expect(near(plant.motor_thrust[PLANT_LEFT], 0.632f * PLANT_MOTOR_MAX_THRUST,
+        0.01f * PLANT_MOTOR_MAX_THRUST), "motor lag");
+
+    // elevons still moving at the servo rate
+    float moved = PLANT_SERVO_RATE * PLANT_MOTOR_LAG_S;
+    expect(near(plant.elevon[PLANT_RIGHT], moved, 0.01f), "right servo rate");
+    expect(near(plant.elevon[PLANT_LEFT], -moved, 0.01f), "left servo rate");
+
+    // partial steps are carried over
+    Plant whole = plant;
+    plant_step(&whole, PLANT_STEP_US);
+    plant_step(&plant, PLANT_STEP_US / 2);
+    plant_step(&plant, PLANT_STEP_US / 2);
+    expect(!memcmp(&whole, &plant, sizeof(Plant)), "step carry");
+}
+
+typedef struct {
+    Phase phase;
+    float phase_time; // units: seconds
+
+    float alt_target;
+    bool airborne;
+    bool landed;
+
+    float max_attitude_error[NUM_PHASES];
+    float max_altitude_error[NUM_PHASES];
+} Pilot;
+
+static float constrain(float val, float min, float max) {
+    return val < min ? min : (val > max ? max : val);
+}
+
+// Sets the sticks for the phase at time t, holding the altitude with the
+// throttle in the hover and with the elevator in horizontal flight
+static void fly(Pilot *pilot, const Plant *plant, float t, Fc_Input *input) {
+    while (pilot->phase + 1 < NUM_PHASES && t >= phase_start[pilot->phase + 1]) {
+        ++pilot->phase;
+    }
+    pilot->phase_time = t - phase_start[pilot->phase];
+
+    float alt = plant_get_altitude(plant);
+    float climb = -plant->body.velocity.z;
+
+    input->aile = 0;
+    input->elev = 0;
+    input->rudd = 0;
+    input->gear = 0; // vertical
+    input->aux1 = FC_MAX_INPUT; // angle
+
+    switch (pilot->phase) {
+    case PHASE_ARM:
+        input->thro = FC_MIN_INPUT;
+        input->gear = FC_MIN_INPUT;
+        input->aux1 = FC_MIN_INPUT;
+        break;
+    case PHASE_TRANSITION_UP:
+        input->thro = FC_MIN_INPUT;
+        break;
+    case PHASE_HOVER:
+    case PHASE_TRANSITION_BACK:
+    case PHASE_LAND:
+        if (pilot->phase == PHASE_LAND) {
+            pilot->alt_target = HOVER_ALT - LAND_RATE * pilot->phase_time;
+        } else {
+            pilot->alt_target = HOVER_ALT;
+        }
+        input->thro = constrain(HOVER_THRO + 4 * (pilot->alt_target - alt) - 8 * climb,
+            HOVER_THRO - MAX_THRO_CHANGE, HOVER_THRO + MAX_THRO_CHANGE);
+        if (pilot->landed) {
+            input->thro = FC_MIN_INPUT;
+        }
+        break;
+    case PHASE_TRANSITION_OUT:
+    case PHASE_CRUISE:
+    case PHASE_TURNS:
+        pilot->alt_target = HOVER_ALT;
+        input->gear = FC_MIN_INPUT;
+        input->thro = 30;
+        input->elev = constrain(5 * (pilot->alt_target - alt) - 10 * climb,
+            FC_MIN_INPUT, FC_MAX_INPUT);
+        if (pilot->phase == PHASE_TURNS) {
+            // a gentle turn each way every 40 s
+            input->aile = 40 * sinf(2 * (float)M_PI * pilot->phase_time / 40);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void check_flight(Pilot *pilot, const Plant *plant, const Fc_State *state) {
+    if (plant->on_ground) {
+        if (pilot->airborne) {
+            pilot->landed = true;
+        }
+    } else {
+        pilot->airborne = true;
+    }
+
+    // transitions are not held to the limits
+    Phase phase = pilot->phase;
+    bool steady = phase == PHASE_HOVER || phase == PHASE_CRUISE || phase == PHASE_TURNS;
+    if (!steady || pilot->phase_time < SETTLE_S) {
+        return;
+    }
+
+    float attitude_error = fmaxf(fabsf(state->target_roll - state->roll),
+        fmaxf(fabsf(state->target_pitch - state->pitch), fabsf(state->target_yaw - state->yaw)));
+    float altitude_error = fabsf(pilot->alt_target - plant_get_altitude(plant));
+
+    pilot->max_attitude_error[phase] = fmaxf(pilot->max_attitude_error[phase], attitude_error);
+    pilot->max_altitude_error[phase] = fmaxf(pilot->max_altitude_error[phase], altitude_error);
+}
+
+static void test_flight(bool verbose) {
+    Plant plant;
+    plant_init_ground(&plant);
+
+    Pilot pilot;
+    memset(&pilot, 0, sizeof(pilot));
+
+    Fc_State fc;
+    fc_init(&fc);
+
+    Fc_Input input;
+    memset(&input, 0, sizeof(input));
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    // the imu period paces the loop as in src/main.c
+    const uint32_t ticks = FLIGHT_S * (1000000 / IMU_PERIOD_US);
+    const uint32_t fc_ticks = FC_PERIOD_US / IMU_PERIOD_US;
+    bool touched_down_early = false;
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        float t = tick * (IMU_PERIOD_US / 1000000.0f);
+
+        plant_get_input(&plant, &input);
+
+        const Fc_Output *output = NULL;
+        if (tick % fc_ticks == 0) {
+            fly(&pilot, &plant, t, &input);
+            output = fc_calc(&fc, &input, 0, FC_PERIOD_US);
+            check_flight(&pilot, &plant, &fc);
+
+            if (pilot.airborne && plant.on_ground && pilot.phase != PHASE_LAND) {
+                touched_down_early = true;
+            }
+
+            if (verbose && tick % (1000000 / IMU_PERIOD_US) == 0) {
+                const Fc_State *state = &fc;
+                printf("%5.0f %-15s alt %6.1f speed %5.1f tstate %4.1f "
+                    "roll %6.1f/%6.1f pitch %6.1f/%6.1f yaw %6.1f/%6.1f thro %5.1f\n",
+                    t, phase_names[pilot.phase], plant_get_altitude(&plant),
+                    plant_get_airspeed(&plant), state->tstate,
+                    state->roll, state->target_roll, state->pitch, state->target_pitch,
+                    state->yaw, state->target_yaw, input.thro);
+            }
+        }
+#       ifdef FC_CASCADED
+            else {
+                output = fc_calc_rate(&fc, &input.rates, IMU_PERIOD_US);
+            }
+#       endif // FC_CASCADED
+
+        if (output) {
+            // the outputs are off until the flight controller arms, as in
+            // run_serv_set()
+            if (fc.waiting || fc.flight_mode == FC_FMODE_DISABLED) {
+                Fc_Output off = *output;
+                off.right_motor = FC_MIN_OUTPUT;
+                off.left_motor = FC_MIN_OUTPUT;
+                plant_set_output(&plant, &off);
+            } else {
+                plant_set_output(&plant, output);
+            }
+        }
+
+        plant_step(&plant, IMU_PERIOD_US);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("simulated %d s of flight in %.3f s, touched down at %.2f m/s\n",
+        FLIGHT_S, wall_s, plant.touchdown_speed);
+
+    for (int phase = 0; phase < NUM_PHASES; ++phase) {
+        if (pilot.max_attitude_error[phase] || pilot.max_altitude_error[phase]) {
+            printf("%-15s max attitude error %5.2f deg, max altitude error %5.2f m\n",
+                phase_names[phase],
+                pilot.max_attitude_error[phase], pilot.max_altitude_error[phase]);
+        }
+        expect(pilot.max_attitude_error[phase] <= MAX_ATTITUDE_ERROR, "attitude error");
+        expect(pilot.max_altitude_error[phase] <= MAX_ALTITUDE_ERROR, "altitude error");
+    }
+
+    expect(pilot.airborne, "take off");
+    expect(!touched_down_early, "stay airborne");
+    expect(pilot.landed, "landing");
+    expect(plant.touchdown_speed <= MAX_TOUCHDOWN_SPEED, "touchdown speed");
+    expect(wall_s < MAX_WALL_S, "simulation speed");
+}
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && !strcmp(argv[1], "-v");
+
+    test_free_fall();
+    test_hover_thrust();
+    test_actuators();
+
+    test_flight(verbose);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
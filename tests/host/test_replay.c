@@ -0,0 +1,328 @@
+// Flies the plant with do_logging() writing to the host flash, then replays
+// the log as a raw image, a whole flash image and the csv of dump_logs(),
+// with and without the time column of dump_logs.py. The replays must follow
+// the flight, and a replay with other gains must diverge from it. Also checks
+// that the orientation rebuilt from a record gives back its attitude.
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "gain_schedule.h"
+#include "logging.h"
+#include "plant.h"
+#include "replay.h"
+
+#define FLIGHT_S 60
+
+// written to the working directory of the test
+#define RAW_LOG "replay_log.bin"
+#define FLASH_IMAGE "replay_flash.bin"
+#define CSV_LOG "replay_log.csv"
+#define TIMED_CSV_LOG "replay_log_timed.csv"
+
+#define MAX_ATTITUDE_ERROR 1e-3f // units: degrees
+
+// rounds of the raw log for the throughput
+#define SPEED_ROUNDS 20
+
+static int failures = 0;
+
+static void expect(bool ok, const char *name) {
+    if (!ok) {
+        if (failures < 10) {
+            printf("fail: %s\n", name);
+        }
+        ++failures;
+    }
+}
+
+// points stdout at path, or back at the terminal for NULL
+static void redirect_stdout(const char *path) {
+    static int saved = -1;
+    fflush(stdout);
+    if (path) {
+        saved = dup(STDOUT_FILENO);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    } else {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static float random_unit(uint32_t *state) {
+    return (xorshift(state) % 20001) / 10000.0f - 1;
+}
+
+static void test_orientation(void) {
+    uint32_t random = 7;
+    float max_error = 0;
+
+    for (int n = 0; n < 100000; ++n) {
+        quaternion_t q = {
+            random_unit(&random), random_unit(&random),
+            random_unit(&random), random_unit(&random)
+        };
+        q = quaternion_normalize(q);
+        int tstate = xorshift(&random) % (FC_MAX_TSTATE + 1);
+
+        // the attitude fc_calc() logs for q
+        quaternion_t compensated = quaternion_product(&q, &fc_tstate_rotation[tstate]);
+        euler_t logged;
+        quaternion_get_euler(&compensated, &logged);
+        if (fabsf(logged.pitch) > 80) {
+            // roll and yaw lose their meaning towards the pole
+            continue;
+        }
+
+        Log_Data row;
+        memset(&row, 0, sizeof(row));
+        row.current_roll = FC_INVERT_ROLL ? -logged.roll : logged.roll;
+        row.current_pitch = FC_INVERT_PITCH ? -logged.pitch : logged.pitch;
+        row.current_yaw = FC_INVERT_YAW ? -logged.yaw : logged.yaw;
+        row.tstate = tstate;
+
+        quaternion_t rebuilt = replay_orientation(&row);
+        compensated = quaternion_product(&rebuilt, &fc_tstate_rotation[tstate]);
+        euler_t replayed;
+        quaternion_get_euler(&compensated, &replayed);
+
+        max_error = fmaxf(max_error, fabsf(replayed.pitch - logged.pitch));
+        for (int i = 0; i < 2; ++i) {
+            float a = i ? replayed.yaw : replayed.roll;
+            float b = i ? logged.yaw : logged.roll;
+            float error = fmodf(fabsf(a - b), 360);
+            max_error = fmaxf(max_error, error > 180 ? 360 - error : error);
+        }
+    }
+
+    printf("orientation rebuilt to %g degrees\n", max_error);
+    expect(max_error < MAX_ATTITUDE_ERROR, "rebuilt orientation");
+}
+
+// Sticks of the flight, whole numbers as the log keeps them: waits, arms,
+// transitions up on the ground, hovers with steps and a receiver dropout,
+// transitions out and turns
+static void fly(float t, const Plant *plant, Fc_Input *input, Fc_Flags *flags) {
+    float alt = plant_get_altitude(plant);
+    float climb = -plant->body.velocity.z;
+
+    *flags = 0;
+    input->thro = FC_MIN_INPUT;
+    input->aile = 0;
+    input->elev = 0;
+    input->rudd = 0;
+    input->gear = 0;
+    input->aux1 = FC_MAX_INPUT;
+
+    if (t < 0.5f) {
+        // not armable, waits
+        return;
+    }
+    if (t < 1.5f) {
+        input->gear = FC_MIN_INPUT;
+        input->aux1 = FC_MIN_INPUT;
+        return;
+    }
+    if (t < 6) {
+        return;
+    }
+
+    if (t < 35) {
+        input->thro = roundf(fminf(fmaxf(40 + 4 * (20 - alt) - 8 * climb, 20), 60));
+        if (t >= 16 && t < 19) {
+            input->aile = 40;
+        } else if (t >= 20 && t < 23) {
+            input->elev = -40;
+        } else if (t >= 24 && t < 24.5f) {
+            input->rudd = 30;
+        } else if (t >= 28 && t < 28.2f) {
+            *flags = FC_RX_FAILED;
+        }
+        return;
+    }
+
+    input->gear = FC_MIN_INPUT;
+    input->thro = 30;
+    input->elev = roundf(fminf(fmaxf(5 * (20 - alt) - 10 * climb, FC_MIN_INPUT), FC_MAX_INPUT));
+    if (t >= 45) {
+        input->aile = roundf(40 * sinf(2 * (float)M_PI * (t - 45) / 10));
+    }
+}
+
+// the flight of test_plant.c, logging every run of fc_calc()
+static uint64_t fly_logged(void) {
+    Plant plant;
+    plant_init_ground(&plant);
+
+    Fc_State fc;
+    fc_init(&fc);
+
+    Fc_Input input;
+    memset(&input, 0, sizeof(input));
+
+    // do_logging() prints every record as well
+    redirect_stdout("/dev/null");
+    init_logging();
+
+    const uint32_t ticks = FLIGHT_S * (1000000 / IMU_PERIOD_US);
+    const uint32_t fc_ticks = FC_PERIOD_US / IMU_PERIOD_US;
+    uint64_t records = 0;
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        plant_get_input(&plant, &input);
+
+        const Fc_Output *output = NULL;
+        if (tick % fc_ticks == 0) {
+            Fc_Flags flags;
+            fly(tick * (IMU_PERIOD_US / 1000000.0f), &plant, &input, &flags);
+            output = fc_calc(&fc, &input, flags, FC_PERIOD_US);
+            do_logging(&fc);
+            ++records;
+        }
+#       ifdef FC_CASCADED
+            else {
+                output = fc_calc_rate(&fc, &input.rates, IMU_PERIOD_US);
+            }
+#       endif // FC_CASCADED
+
+        if (output) {
+            if (fc.waiting || fc.flight_mode == FC_FMODE_DISABLED) {
+                Fc_Output off = *output;
+                off.right_motor = FC_MIN_OUTPUT;
+                off.left_motor = FC_MIN_OUTPUT;
+                plant_set_output(&plant, &off);
+            } else {
+                plant_set_output(&plant, output);
+            }
+        }
+        plant_step(&plant, IMU_PERIOD_US);
+    }
+
+    redirect_stdout(NULL);
+
+    expect(plant_get_altitude(&plant) > 10, "flight stays airborne");
+    return records;
+}
+
+static void write_logs(void) {
+    FILE *file = fopen(RAW_LOG, "wb");
+    fwrite(host_flash + LOG_FLASH_START, 1, LOG_FLASH_SIZE_BYTES, file);
+    fclose(file);
+
+    file = fopen(FLASH_IMAGE, "wb");
+    fwrite(host_flash, 1, PICO_FLASH_SIZE_BYTES, file);
+    fclose(file);
+
+    redirect_stdout(CSV_LOG);
+    dump_logs();
+    redirect_stdout(NULL);
+
+    // as dump_logs.py saves it
+    FILE *csv = fopen(CSV_LOG, "r");
+    FILE *timed = fopen(TIMED_CSV_LOG, "w");
+    fprintf(timed, "time, input thro, input aile, ...\n");
+    char line[1024];
+    for (int n = 0; fgets(line, sizeof(line), csv); ++n) {
+        fprintf(timed, "%.2f, %s", n * FC_PERIOD_US / 1000000.0, line);
+    }
+    fclose(timed);
+    fclose(csv);
+}
+
+static void check_replay(const char *path, uint64_t records) {
+    Fc_State fc;
+    fc_init(&fc);
+
+    Replay_Stats stats;
+    expect(replay_file(path, &fc, REPLAY_TOLERANCE, NULL, &stats), "replay opens the log");
+    printf("%-20s %llu records, max output divergence %g\n",
+        path, (unsigned long long)stats.records, stats.max_output);
+
+    expect(stats.records == records, "every record replayed");
+    expect(!stats.mode_mismatches, "same modes");
+
+#   ifdef FC_CASCADED
+        // the rate loop ran at the imu rate on gyro rates the log does not keep
+        expect(stats.max_output > 0, "rate loop of the replay");
+#   else
+        expect(!stats.diverged, "replay follows the log");
+#   endif // FC_CASCADED
+}
+
+static void check_other_gains(const char *path) {
+    static Fc_Gains table[FC_MAX_TSTATE + 1];
+    memcpy(table, fc_gain_schedule, sizeof(table));
+    for (int tstate = FC_MIN_TSTATE; tstate <= FC_MAX_TSTATE; ++tstate) {
+        table[tstate].roll.p *= 1.2f;
+        table[tstate].pitch.p *= 1.2f;
+        table[tstate].yaw.p *= 1.2f;
+    }
+
+    Fc_State fc;
+    fc_init(&fc);
+    fc.gain_schedule = table;
+
+    Replay_Stats stats;
+    replay_file(path, &fc, REPLAY_TOLERANCE, NULL, &stats);
+    printf("other gains diverge from record %llu, max %g\n",
+        (unsigned long long)stats.first_diverged, stats.max_output);
+    expect(stats.diverged > 0, "other gains diverge");
+}
+
+static void check_speed(const char *path) {
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    uint64_t records = 0;
+    for (int n = 0; n < SPEED_ROUNDS; ++n) {
+        Fc_State fc;
+        fc_init(&fc);
+        Replay_Stats stats;
+        replay_file(path, &fc, REPLAY_TOLERANCE, NULL, &stats);
+        records += stats.records;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+    printf("replayed %llu records in %.3f s, %.2f million per second\n",
+        (unsigned long long)records, wall_s, records / wall_s / 1e6);
+}
+
+int main(void) {
+    test_orientation();
+
+    uint64_t records = fly_logged();
+    write_logs();
+
+    check_replay(RAW_LOG, records);
+    check_replay(FLASH_IMAGE, records);
+    check_replay(CSV_LOG, records);
+    check_replay(TIMED_CSV_LOG, records);
+
+    check_other_gains(RAW_LOG);
+    check_speed(RAW_LOG);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Runs the flight controller regression sim of tests/sim.c on the host, with
+// the scheduler on the virtual clock, and checks the invariants of
+// tests/sim_tests.py on every row the target would have logged. Tasks take no
+// virtual time here, so the loop timing invariant is left to the receiver
+// stall of sil -o, which does overrun the loop.
+
+#include <stdio.h>
+#include <time.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "scheduler.h"
+
+#include "sim_input.h"
+
+typedef struct {
+    Fc_State fc;
+    Fc_Flags flags;
+    Fc_Input input;
+    Fc_Output output;
+
+    const Fc_Input *sim_input_ptr;
+
+    int rows;
+    int failures;
+} Sim_Context;
+
+static void expect(Sim_Context *ctx, bool ok, const char *name) {
+    if (!ok) {
+        if (ctx->failures < 10) {
+            printf("fail: %s at row %d\n", name, ctx->rows);
+        }
+        ++ctx->failures;
+    }
+}
+
+// make sure motors do not turn on while waiting, without the receiver or
+// without throttle
+static void test_motor_safety(Sim_Context *ctx, const Fc_State *state) {
+    if ((state->flags & FC_WAITING) ||
+        (state->flags & FC_RX_FAILED) ||
+        (state->input.thro < FC_MIN_INPUT + FC_DEAD_STICK)) {
+        expect(ctx, state->output.right_motor == FC_MIN_OUTPUT, "right motor safety");
+        expect(ctx, state->output.left_motor == FC_MIN_OUTPUT, "left motor safety");
+    }
+}
+
+static void run_sim_input(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    ctx->input = *ctx->sim_input_ptr;
+    ++ctx->sim_input_ptr;
+}
+
+static void run_fc_calc(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    ctx->output = *fc_calc(&ctx->fc, &ctx->input, ctx->flags, time->dt_us);
+    ctx->flags = 0;
+}
+
+// stands in for logging, checks the state the target would log
+static void run_checks(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    const Fc_State *state = &ctx->fc;
+
+    test_motor_safety(ctx, state);
+
+    ++ctx->rows;
+}
+
+// mirrors the task table in tests/sim.c
+static Sched_Task sim_tasks[] = {
+//    name         period_us      phase_us  deadline_us      run
+    { "sim_input", RX_PERIOD_US,  1000,     LOOP_PERIOD_US,  run_sim_input },
+    { "fc_calc",   FC_PERIOD_US,  3000,     LOOP_PERIOD_US,  run_fc_calc },
+    { "checks",    LOG_PERIOD_US, 4000,     LOG_PERIOD_US,   run_checks },
+};
+
+int main(void) {
+    Sim_Context ctx = {
+        .flags = 0,
+        .sim_input_ptr = sim_input,
+        .rows = 0,
+        .failures = 0
+    };
+    fc_init(&ctx.fc);
+
+    Sched_Inst sched;
+    sched_init(&sched,
+        sim_tasks, sizeof(sim_tasks) / sizeof(sim_tasks[0]),
+        LOOP_PERIOD_US, &ctx
+    );
+
+    clock_t start = clock();
+
+    // the sim input task runs once per rx period
+    size_t ticks = SIM_INPUT_SIZE * (RX_PERIOD_US / LOOP_PERIOD_US);
+    sched_start(&sched);
+    for (size_t i = 0; i < ticks; ++i) {
+        absolute_time_t release = sched_wait(&sched);
+        if (sched_run(&sched, release)) {
+            ctx.flags |= FC_OVERRUN;
+        }
+    }
+
+    double wall_ms = 1000.0 * (clock() - start) / CLOCKS_PER_SEC;
+    printf("simulated %.1f s in %.1f ms, %d rows\n",
+        to_us_since_boot(get_absolute_time()) / 1e6, wall_ms, ctx.rows);
+
+    if (ctx.sim_input_ptr != sim_input + SIM_INPUT_SIZE) {
+        printf("fail: %d of %d sim inputs used\n",
+            (int)(ctx.sim_input_ptr - sim_input), SIM_INPUT_SIZE);
+        ++ctx.failures;
+    }
+
+    if (ctx.failures) {
+        printf("%d checks failed\n", ctx.failures);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
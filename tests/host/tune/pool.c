@@ -0,0 +1,189 @@
+#include "pool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// the worker running on this thread, NULL outside the pool
+static _Thread_local Pool_Worker *current = NULL;
+
+static bool push(Pool_Queue *queue, Pool_Fn fn, void *arg) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = queue->tail - queue->head < POOL_QUEUE_SIZE;
+    if (ok) {
+        queue->tasks[queue->tail++ % POOL_QUEUE_SIZE] = (Pool_Task){ fn, arg };
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok;
+}
+
+// newest task of the own queue
+static bool pop(Pool_Queue *queue, Pool_Task *task) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = queue->tail != queue->head;
+    if (ok) {
+        *task = queue->tasks[--queue->tail % POOL_QUEUE_SIZE];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok;
+}
+
+// oldest task of another queue
+static bool steal(Pool_Queue *queue, Pool_Task *task) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = queue->tail != queue->head;
+    if (ok) {
+        *task = queue->tasks[queue->head++ % POOL_QUEUE_SIZE];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok;
+}
+
+static bool take(Pool *pool, int index, Pool_Task *task) {
+    Pool_Queue *own = &pool->queues[index];
+    if (pop(own, task)) {
+        return true;
+    }
+    for (int i = 1; i < pool->num_workers; ++i) {
+        if (steal(&pool->queues[(index + i) % pool->num_workers], task)) {
+            ++own->stolen;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void finish(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->pending == 0) {
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *worker_run(void *context) {
+    Pool_Worker *worker = context;
+    Pool *pool = worker->pool;
+    current = worker;
+
+    for (;;) {
+        Pool_Task task;
+        if (take(pool, worker->index, &task)) {
+            pthread_mutex_lock(&pool->lock);
+            --pool->queued;
+            pthread_mutex_unlock(&pool->lock);
+
+            task.fn(task.arg);
+            ++pool->queues[worker->index].run;
+            finish(pool);
+            continue;
+        }
+
+        // the count goes up before the task is pushed, so a task counted
+        // here is taken on the next pass
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->queued && !pool->stop) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        bool stop = pool->stop && !pool->queued;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+bool pool_init(Pool *pool, int num_workers) {
+    if (num_workers <= 0) {
+        num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_workers < 1) {
+        num_workers = 1;
+    } else if (num_workers > POOL_MAX_WORKERS) {
+        num_workers = POOL_MAX_WORKERS;
+    }
+
+    pool->num_workers = num_workers;
+    pool->queued = 0;
+    pool->pending = 0;
+    pool->next = 0;
+    pool->stop = false;
+
+    pool->queues = calloc(num_workers, sizeof(Pool_Queue));
+    if (!pool->queues) {
+        return false;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int i = 0; i < num_workers; ++i) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+    }
+    for (int i = 0; i < num_workers; ++i) {
+        pool->workers[i] = (Pool_Worker){ pool, i };
+        if (pthread_create(&pool->threads[i], NULL, worker_run, &pool->workers[i])) {
+            pool->num_workers = i;
+            pool_destroy(pool);
+            return false;
+        }
+    }
+    return true;
+}
+
+void pool_submit(Pool *pool, Pool_Fn fn, void *arg) {
+    int index;
+
+    pthread_mutex_lock(&pool->lock);
+    ++pool->pending;
+    ++pool->queued;
+    if (current && current->pool == pool) {
+        index = current->index;
+    } else {
+        index = pool->next++ % pool->num_workers;
+    }
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!push(&pool->queues[index], fn, arg)) {
+        // full, the caller does the work instead
+        pthread_mutex_lock(&pool->lock);
+        --pool->queued;
+        pthread_mutex_unlock(&pool->lock);
+
+        fn(arg);
+        finish(pool);
+    }
+}
+
+void pool_wait(Pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(Pool *pool) {
+    pool_wait(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_workers; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->num_workers; ++i) {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->queues);
+    pool->queues = NULL;
+}
@@ -0,0 +1,80 @@
+// Work-stealing thread pool for the host tools. Each worker owns a queue:
+// it takes its newest task first and, once its own queue is empty, steals
+// the oldest task of another worker. Tasks of uneven length, such as flights
+// that crash early, then keep every core busy until the batch is done.
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// tasks each queue holds, pool_submit() runs a task itself once it is full
+#define POOL_QUEUE_SIZE 1024
+
+#define POOL_MAX_WORKERS 256
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef void (*Pool_Fn)(void *arg);
+
+typedef struct {
+    Pool_Fn fn;
+    void *arg;
+} Pool_Task;
+
+typedef struct {
+    pthread_mutex_t lock;
+    Pool_Task tasks[POOL_QUEUE_SIZE];
+    uint32_t head; // oldest, where others steal
+    uint32_t tail; // newest, where the owner pushes and pops
+
+    // per worker statistics
+    uint64_t run;
+    uint64_t stolen;
+} Pool_Queue;
+
+typedef struct Pool Pool;
+
+typedef struct {
+    Pool *pool;
+    int index;
+} Pool_Worker;
+
+struct Pool {
+    int num_workers;
+    pthread_t threads[POOL_MAX_WORKERS];
+    Pool_Worker workers[POOL_MAX_WORKERS];
+    Pool_Queue *queues;
+
+    // guards the counts below, workers sleep on work while nothing is queued
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    uint32_t queued; // in any queue
+    uint32_t pending; // submitted and not finished
+    uint32_t next; // queue of the next submit from outside the pool
+    bool stop;
+};
+
+// Starts num_workers threads, 0 for one per online core
+bool pool_init(Pool *pool, int num_workers);
+
+// Queues fn(arg). From a task the new task goes to the queue of its worker,
+// from any other thread to the queues in turn.
+void pool_submit(Pool *pool, Pool_Fn fn, void *arg);
+
+// Waits until every submitted task, and any task those submit, has finished.
+// Not to be called from a task.
+void pool_wait(Pool *pool);
+
+// Waits for the tasks, then stops and joins the workers
+void pool_destroy(Pool *pool);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __POOL_H__
@@ -0,0 +1,973 @@
+// Searches the pid gains of the gain schedule against the tail-sitter plant
+// and writes the schedule back with the tuned gains, ready to replace
+// src/gain_schedule.txt:
+//   tune [-j workers] [-g generations] [-l candidates] [-s seed] [-o output] [-v] <schedule>
+//   -j 0, the default, runs one worker per core
+//   the schedule goes to stdout without -o, the report always to stderr
+//
+// Each breakpoint of the default table is tuned in turn, horizontal and
+// vertical flight first, then any breakpoints of the transition. A candidate
+// is the schedule with new p, i and d gains at the breakpoint, i_max is kept.
+// It is flown closed loop in the flight condition of its tstate:
+//   0 - level cruise, angle mode steps of roll, pitch and yaw
+//   90 - hover, the same steps
+//   in between - transitions out and back, scored while the breakpoint is the
+//                nearest one to tstate
+// The score adds the tracking error and the overshoot of each step to the
+// actuator effort, lower is better.
+//
+// The search is a (1 + lambda) evolution strategy. Each generation mutates
+// the best gains so far into new candidates, flies them all on the
+// work-stealing pool and keeps the best one. Every candidate flies to the
+// start of its steps, then hands one copy of the flight per axis back to the
+// pool, so idle workers steal the steps of busy ones. Candidates are drawn on
+// the main thread from the seed, so the result is the same for any number of
+// workers.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "plant.h"
+#include "pool.h"
+
+#define MAX_LINES 1024
+#define MAX_LINE 512
+#define MAX_BREAKPOINTS 32
+#define NUM_VALUES 13 // tstate and 12 gains per line, as in gain_schedule.py
+
+#define DEFAULT_GENERATIONS 20
+#define DEFAULT_CANDIDATES 32
+
+// step of the log of a gain, grown after a better candidate and shrunk after
+// a generation without one
+#define SIGMA_START 0.3f
+#define SIGMA_MIN 0.02f
+#define SIGMA_MAX 1.0f
+#define SIGMA_UP 1.5f
+#define SIGMA_DOWN 0.8f
+
+#define MUTATE_CHANCE 0.4f // of each gain
+#define ZERO_CHANCE 0.05f // an i or d gain turned off
+#define REVIVE_CHANCE 0.2f // a zero gain turned on at REVIVE_FRACTION of p
+#define REVIVE_FRACTION 0.1f
+
+// significant digits of the written gains, candidates are rounded to them so
+// the written schedule flies as it scored
+#define GAIN_DIGITS 4
+
+#define OVERSHOOT_WEIGHT 2.0f
+#define EFFORT_WEIGHT 0.05f
+
+// a crash scores this plus the seconds it cut from the flight
+#define CRASH_SCORE 100.0f
+
+#define HOVER_ALT 20.0f // units: m
+#define HOVER_THRO 40.0f
+#define MAX_THRO_CHANGE 20.0f
+
+#define CRUISE_ALT 100.0f // units: m
+#define CRUISE_SPEED 15.0f // units: m/s
+#define CRUISE_THRO 30.0f
+
+// flight up to the steps, units: seconds
+#define ARM_S 1.0f
+#define TRANSITION_UP_S 5.0f // on the ground, to vertical
+#define TAKEOFF_S 10.0f
+#define CRUISE_SETTLE_S 3.0f
+
+// the transitions, units: seconds
+#define TRANSITION_OUT_S 8.0f
+#define TRANSITION_BACK_S 10.0f
+
+// sticks of the steps, held STEP_S each way. The yaw stick is a pulse, as
+// angle mode steers the yaw by rate.
+#define STEP_ROLL 50.0f // 10 degrees
+#define STEP_PITCH 50.0f // 10 degrees
+#define STEP_YAW 40.0f // 20 degrees over the pulse
+#define YAW_PULSE_S 0.4f
+#define STEP_S 3
+
+// any larger attitude error is a loss of control, units: degrees
+#define MAX_ERROR 45.0f
+#define MIN_HOVER_ALT 2.0f // units: m, once airborne
+#define MIN_CRUISE_ALT 20.0f // units: m
+
+// scale of the attitude errors of the transitions, units: degrees
+#define TRANSITION_ERROR 10.0f
+
+#define FC_TICKS (FC_PERIOD_US / IMU_PERIOD_US)
+#define MAX_SAMPLES (STEP_S * 1000000 / FC_PERIOD_US + 1)
+
+typedef enum {
+    AXIS_ROLL,
+    AXIS_PITCH,
+    AXIS_YAW,
+    NUM_AXES
+} Axis;
+
+static const char *axis_names[NUM_AXES] = { "roll", "pitch", "yaw" };
+
+typedef enum {
+    PILOT_STICKS, // as set
+    PILOT_HOVER, // the throttle holds HOVER_ALT
+    PILOT_CRUISE // the elevator holds CRUISE_ALT
+} Pilot;
+
+typedef struct {
+    float tracking; // mean error per degree of step
+    float overshoot; // per degree of step, or peak error of the transitions
+    float effort; // mean square of the output change per tick, units: percent^2
+    float total;
+    bool crashed;
+} Score;
+
+typedef struct {
+    int tstate;
+    Fc_Gains gains;
+    int line; // in the schedule file
+} Breakpoint;
+
+typedef struct {
+    Fc_State fc;
+    Plant plant;
+    Fc_Input input;
+
+    Fc_Input sticks;
+    Pilot pilot;
+
+    uint32_t tick;
+    float min_alt; // 0 until airborne
+    bool check_attitude;
+    bool crashed;
+    float crash_s; // of flight cut by the crash
+
+    Fc_Output last_output;
+    double effort;
+    uint32_t effort_ticks;
+
+    // attitude errors while tstate is inside the window
+    float window_min;
+    float window_max;
+    double window_error;
+    float window_peak;
+    uint32_t window_ticks;
+} Flight;
+
+typedef struct {
+    float target[MAX_SAMPLES];
+    float actual[MAX_SAMPLES];
+    int count;
+} Trace;
+
+typedef struct Candidate Candidate;
+
+typedef struct {
+    Candidate *candidate;
+    Axis axis;
+    Flight flight;
+    Trace trace;
+    Score score;
+} Axis_Test;
+
+struct Candidate {
+    Pool *pool;
+    const Breakpoint *points; // the schedule, read only while flying
+    int num_points;
+    int breakpoint;
+    Fc_Gains gains; // replaces the breakpoint
+
+    Fc_Gains table[FC_MAX_TSTATE + 1];
+    Flight flight;
+    Axis_Test axes[NUM_AXES];
+    bool steps;
+
+    Score score;
+};
+
+typedef struct {
+    char *lines[MAX_LINES];
+    int num_lines;
+
+    Breakpoint points[MAX_BREAKPOINTS];
+    int num_points;
+} Schedule;
+
+typedef struct {
+    Pool pool;
+    Candidate *candidates; // the parent first
+    int num_candidates;
+    int generations;
+    uint32_t random;
+    bool verbose;
+
+    uint64_t evaluations;
+} Tuner;
+
+static float constrain(float val, float min, float max) {
+    return val < min ? min : (val > max ? max : val);
+}
+
+// angle difference in -180..180, as the flight controller takes its errors
+static float wrap(float angle) {
+    while (angle > 180) {
+        angle -= 360;
+    }
+    while (angle < -180) {
+        angle += 360;
+    }
+    return angle;
+}
+
+static uint32_t xorshift(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+// in 0..1
+static float uniform(uint32_t *state) {
+    return (xorshift(state) >> 8) / 16777216.0f;
+}
+
+static float gaussian(uint32_t *state) {
+    float u = uniform(state);
+    float v = uniform(state);
+    return sqrtf(-2 * logf(1 - u)) * cosf(2 * (float)M_PI * v);
+}
+
+static float round_gain(float gain) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.*g", GAIN_DIGITS, gain);
+    return strtof(text, NULL);
+}
+
+static Fc_Pid_Gains *axis_gains(Fc_Gains *gains, Axis axis) {
+    switch (axis) {
+    case AXIS_ROLL: return &gains->roll;
+    case AXIS_PITCH: return &gains->pitch;
+    default: return &gains->yaw;
+    }
+}
+
+static float axis_actual(const Fc_State *fc, Axis axis) {
+    switch (axis) {
+    case AXIS_ROLL: return fc->roll;
+    case AXIS_PITCH: return fc->pitch;
+    default: return fc->yaw;
+    }
+}
+
+static float axis_target(const Fc_State *fc, Axis axis) {
+    switch (axis) {
+    case AXIS_ROLL: return fc->target_roll;
+    case AXIS_PITCH: return fc->target_pitch;
+    default: return fc->target_yaw;
+    }
+}
+
+static float attitude_error(const Fc_State *fc) {
+    float error = 0;
+    for (int axis = 0; axis < NUM_AXES; ++axis) {
+        error = fmaxf(error, fabsf(wrap(axis_target(fc, axis) - axis_actual(fc, axis))));
+    }
+    return error;
+}
+
+static float *gain_values(Fc_Gains *gains) {
+    return &gains->roll.p;
+}
+
+// the tables of gain_schedule.py, interpolated linearly between breakpoints
+static void build_table(const Breakpoint *points, int num_points, int replace,
+    const Fc_Gains *gains, Fc_Gains *table) {
+    for (int tstate = FC_MIN_TSTATE; tstate <= FC_MAX_TSTATE; ++tstate) {
+        int n = 1;
+        while (n < num_points - 1 && tstate > points[n].tstate) {
+            ++n;
+        }
+        Fc_Gains first = n - 1 == replace ? *gains : points[n - 1].gains;
+        Fc_Gains second = n == replace ? *gains : points[n].gains;
+        double a = points[n - 1].tstate;
+        double b = points[n].tstate;
+
+        float *x = gain_values(&first);
+        float *y = gain_values(&second);
+        float *out = gain_values(&table[tstate]);
+        for (int i = 0; i < NUM_VALUES - 1; ++i) {
+            out[i] = (float)(((tstate - a) / (b - a)) * (y[i] - x[i]) + x[i]);
+        }
+    }
+}
+
+////////// Closed Loop //////////
+
+static void flight_init(Flight *flight, const Fc_Gains *table) {
+    memset(flight, 0, sizeof(*flight));
+
+    fc_init(&flight->fc);
+    flight->fc.gain_schedule = table;
+
+    flight->window_min = 1;
+    flight->window_max = 0;
+}
+
+static void flight_check(Flight *flight) {
+    const Fc_State *fc = &flight->fc;
+    float alt = plant_get_altitude(&flight->plant);
+
+    if (flight->min_alt && alt < flight->min_alt) {
+        flight->crashed = true;
+    }
+    if (flight->check_attitude && attitude_error(fc) > MAX_ERROR) {
+        flight->crashed = true;
+    }
+
+    if (fc->tstate >= flight->window_min && fc->tstate <= flight->window_max) {
+        float error = attitude_error(fc);
+        flight->window_error += error;
+        flight->window_peak = fmaxf(flight->window_peak, error);
+        ++flight->window_ticks;
+    }
+}
+
+static void flight_effort(Flight *flight, const Fc_Output *output) {
+    const Fc_Output *last = &flight->last_output;
+    float elevons = powf(output->right_elevon - last->right_elevon, 2) +
+        powf(output->left_elevon - last->left_elevon, 2);
+    float motors = powf(output->right_motor - last->right_motor, 2) +
+        powf(output->left_motor - last->left_motor, 2);
+
+    // the outputs span 200 percent
+    flight->effort += (elevons + motors) / 4;
+    ++flight->effort_ticks;
+    flight->last_output = *output;
+}
+
+// Flies for seconds in the loop of test_plant.c, recording the axis into the
+// trace if there is one. Stops early on a crash.
+static void flight_run(Flight *flight, float seconds, Trace *trace, Axis axis) {
+    uint32_t ticks = (uint32_t)(seconds * (1000000 / IMU_PERIOD_US));
+
+    for (uint32_t n = 0; n < ticks && !flight->crashed; ++n, ++flight->tick) {
+        Fc_State *fc = &flight->fc;
+        Fc_Input *input = &flight->input;
+        plant_get_input(&flight->plant, input);
+
+        const Fc_Output *output = NULL;
+        if (flight->tick % FC_TICKS == 0) {
+            float alt = plant_get_altitude(&flight->plant);
+            float climb = -flight->plant.body.velocity.z;
+
+            input->thro = flight->sticks.thro;
+            input->elev = flight->sticks.elev;
+            input->rudd = flight->sticks.rudd;
+            input->aile = flight->sticks.aile;
+            input->gear = flight->sticks.gear;
+            input->aux1 = flight->sticks.aux1;
+
+            if (flight->pilot == PILOT_HOVER) {
+                input->thro = constrain(HOVER_THRO + 4 * (HOVER_ALT - alt) - 8 * climb,
+                    HOVER_THRO - MAX_THRO_CHANGE, HOVER_THRO + MAX_THRO_CHANGE);
+            } else if (flight->pilot == PILOT_CRUISE) {
+                input->elev = constrain(5 * (CRUISE_ALT - alt) - 10 * climb,
+                    FC_MIN_INPUT, FC_MAX_INPUT);
+            }
+
+            output = fc_calc(fc, input, 0, FC_PERIOD_US);
+            flight_check(flight);
+            flight_effort(flight, output);
+
+            if (trace && trace->count < MAX_SAMPLES) {
+                trace->target[trace->count] = axis_target(fc, axis);
+                trace->actual[trace->count] = axis_actual(fc, axis);
+                ++trace->count;
+            }
+        }
+#       ifdef FC_CASCADED
+            else {
+                output = fc_calc_rate(fc, &input->rates, IMU_PERIOD_US);
+            }
+#       endif // FC_CASCADED
+
+        if (output) {
+            // the motors are off until the flight controller arms
+            if (fc->waiting || fc->flight_mode == FC_FMODE_DISABLED) {
+                Fc_Output off = *output;
+                off.right_motor = FC_MIN_OUTPUT;
+                off.left_motor = FC_MIN_OUTPUT;
+                plant_set_output(&flight->plant, &off);
+            } else {
+                plant_set_output(&flight->plant, output);
+            }
+        }
+
+        plant_step(&flight->plant, IMU_PERIOD_US);
+
+        if (flight->crashed) {
+            flight->crash_s = (ticks - n) * (IMU_PERIOD_US / 1000000.0f);
+        }
+    }
+}
+
+// on the ground in manual horizontal, the throttle down
+static void fly_arm(Flight *flight) {
+    flight->sticks = (Fc_Input){
+        .thro = FC_MIN_INPUT,
+        .gear = FC_MIN_INPUT,
+        .aux1 = FC_MIN_INPUT
+    };
+    flight->pilot = PILOT_STICKS;
+    flight_run(flight, ARM_S, NULL, 0);
+}
+
+// arms, transitions to vertical on the ground and climbs to HOVER_ALT
+static void fly_hover(Flight *flight) {
+    plant_init_ground(&flight->plant);
+    fly_arm(flight);
+
+    flight->sticks.gear = FC_CEN_INPUT;
+    flight->sticks.aux1 = FC_MAX_INPUT;
+    flight_run(flight, TRANSITION_UP_S, NULL, 0);
+
+    flight->pilot = PILOT_HOVER;
+    flight->check_attitude = true;
+    flight_run(flight, TAKEOFF_S, NULL, 0);
+    flight->min_alt = MIN_HOVER_ALT;
+}
+
+// arms in level flight at CRUISE_ALT, then angle mode
+static void fly_cruise(Flight *flight) {
+    plant_init_level(&flight->plant, CRUISE_ALT, CRUISE_SPEED);
+    fly_arm(flight);
+
+    flight->sticks.thro = CRUISE_THRO;
+    flight->sticks.aux1 = FC_MAX_INPUT;
+    flight->check_attitude = true;
+    flight->min_alt = MIN_CRUISE_ALT;
+    flight_run(flight, CRUISE_SETTLE_S, NULL, 0);
+}
+
+////////// Scores //////////
+
+static void score_total(Score *score) {
+    if (!score->crashed) {
+        score->total = score->tracking + OVERSHOOT_WEIGHT * score->overshoot +
+            EFFORT_WEIGHT * score->effort;
+    }
+}
+
+static void score_crash(Score *score, const Flight *flight) {
+    score->crashed = true;
+    score->total = CRASH_SCORE + flight->crash_s;
+}
+
+// Adds the error and overshoot of the trace, a step of the target of the
+// axis from before to where the trace ends
+static void score_step(const Trace *trace, float before, Score *score) {
+    float after = trace->target[trace->count - 1];
+    float step = fabsf(wrap(after - before));
+    float sign = wrap(after - before) < 0 ? -1.0f : 1.0f;
+
+    float error = 0;
+    float overshoot = 0;
+    for (int n = 0; n < trace->count; ++n) {
+        error += fabsf(wrap(trace->target[n] - trace->actual[n]));
+        overshoot = fmaxf(overshoot, sign * wrap(trace->actual[n] - after));
+    }
+
+    score->tracking += error / trace->count / step;
+    score->overshoot += overshoot / step;
+}
+
+////////// Tasks //////////
+
+static float step_stick(Axis axis) {
+    switch (axis) {
+    case AXIS_ROLL: return STEP_ROLL;
+    case AXIS_PITCH: return STEP_PITCH;
+    default: return STEP_YAW;
+    }
+}
+
+static void set_stick(Flight *flight, Axis axis, float stick) {
+    switch (axis) {
+    case AXIS_ROLL: flight->sticks.aile = stick; break;
+    case AXIS_PITCH: flight->sticks.elev = stick; break;
+    default: flight->sticks.rudd = stick; break;
+    }
+}
+
+// one way of a step of the axis, with the stick held or pulsed for yaw
+static void fly_step(Axis_Test *test, float stick) {
+    Flight *flight = &test->flight;
+    float before = axis_target(&flight->fc, test->axis);
+    test->trace.count = 0;
+
+    set_stick(flight, test->axis, stick);
+    if (test->axis == AXIS_YAW) {
+        flight_run(flight, YAW_PULSE_S, &test->trace, test->axis);
+        set_stick(flight, test->axis, 0);
+        flight_run(flight, STEP_S - YAW_PULSE_S, &test->trace, test->axis);
+    } else {
+        flight_run(flight, STEP_S, &test->trace, test->axis);
+    }
+
+    if (!flight->crashed) {
+        score_step(&test->trace, before, &test->score);
+    }
+}
+
+// steps the axis out and back from a copy of the candidate's flight
+static void axis_task(void *arg) {
+    Axis_Test *test = arg;
+    Flight *flight = &test->flight;
+    float stick = step_stick(test->axis);
+
+    memset(&test->score, 0, sizeof(test->score));
+    flight->effort = 0;
+    flight->effort_ticks = 0;
+
+    fly_step(test, stick);
+    fly_step(test, test->axis == AXIS_YAW ? -stick : 0);
+
+    if (flight->crashed) {
+        score_crash(&test->score, flight);
+        return;
+    }
+
+    test->score.tracking /= 2;
+    test->score.overshoot /= 2;
+    test->score.effort = flight->effort / flight->effort_ticks;
+    score_total(&test->score);
+}
+
+static void transition_score(Candidate *candidate) {
+    Flight *flight = &candidate->flight;
+    Score *score = &candidate->score;
+
+    const Breakpoint *points = candidate->points;
+    int n = candidate->breakpoint;
+    flight->window_min = (points[n - 1].tstate + points[n].tstate) / 2.0f;
+    flight->window_max = (points[n].tstate + points[n + 1].tstate) / 2.0f;
+
+    // out to horizontal flight, the elevator holding the altitude
+    flight->sticks.gear = FC_MIN_INPUT;
+    flight->sticks.thro = CRUISE_THRO;
+    flight->pilot = PILOT_CRUISE;
+    flight->min_alt = 0;
+    flight_run(flight, TRANSITION_OUT_S, NULL, 0);
+
+    // and back to the hover
+    flight->sticks.gear = FC_CEN_INPUT;
+    flight->pilot = PILOT_HOVER;
+    flight_run(flight, TRANSITION_BACK_S, NULL, 0);
+
+    if (flight->crashed || !flight->window_ticks) {
+        score_crash(score, flight);
+        return;
+    }
+
+    score->tracking = flight->window_error / flight->window_ticks / TRANSITION_ERROR;
+    score->overshoot = flight->window_peak / TRANSITION_ERROR;
+    score->effort = flight->effort / flight->effort_ticks;
+    score_total(score);
+}
+
+// Flies the candidate to the start of its steps and queues the steps, or
+// flies the transitions for a breakpoint in between
+static void candidate_task(void *arg) {
+    Candidate *candidate = arg;
+    Flight *flight = &candidate->flight;
+    int tstate = candidate->points[candidate->breakpoint].tstate;
+
+    memset(&candidate->score, 0, sizeof(candidate->score));
+    build_table(candidate->points, candidate->num_points, candidate->breakpoint,
+        &candidate->gains, candidate->table);
+    flight_init(flight, candidate->table);
+
+    candidate->steps = tstate == FC_HORZ_TSTATE || tstate == FC_VERT_TSTATE;
+    if (tstate == FC_HORZ_TSTATE) {
+        fly_cruise(flight);
+    } else {
+        fly_hover(flight);
+    }
+
+    if (flight->crashed) {
+        candidate->steps = false;
+        score_crash(&candidate->score, flight);
+    } else if (candidate->steps) {
+        for (int axis = 0; axis < NUM_AXES; ++axis) {
+            Axis_Test *test = &candidate->axes[axis];
+            test->candidate = candidate;
+            test->axis = axis;
+            test->flight = *flight;
+            pool_submit(candidate->pool, axis_task, test);
+        }
+    } else {
+        transition_score(candidate);
+    }
+}
+
+// the mean over the axes, once their tasks are done
+static void candidate_finish(Candidate *candidate) {
+    if (!candidate->steps) {
+        return;
+    }
+
+    Score *score = &candidate->score;
+    for (int axis = 0; axis < NUM_AXES; ++axis) {
+        const Score *axis_score = &candidate->axes[axis].score;
+        if (axis_score->crashed) {
+            *score = *axis_score;
+            return;
+        }
+        score->tracking += axis_score->tracking / NUM_AXES;
+        score->overshoot += axis_score->overshoot / NUM_AXES;
+        score->effort += axis_score->effort / NUM_AXES;
+    }
+    score_total(score);
+}
+
+////////// Search //////////
+
+// Scales some of the p, i and d gains by a log-normal step of sigma, turning
+// an i or d gain off now and then and a zero gain back on
+static void mutate(Fc_Gains *gains, float sigma, uint32_t *random) {
+    bool changed = false;
+    while (!changed) {
+        for (int axis = 0; axis < NUM_AXES; ++axis) {
+            Fc_Pid_Gains *pid = axis_gains(gains, axis);
+            float *terms[] = { &pid->p, &pid->i, &pid->d };
+
+            for (int term = 0; term < 3; ++term) {
+                if (uniform(random) >= MUTATE_CHANCE) {
+                    continue;
+                }
+                float *gain = terms[term];
+                if (*gain > 0) {
+                    if (term > 0 && uniform(random) < ZERO_CHANCE) {
+                        *gain = 0;
+                    } else {
+                        *gain *= expf(sigma * gaussian(random));
+                    }
+                } else if (uniform(random) < REVIVE_CHANCE) {
+                    *gain = REVIVE_FRACTION * (pid->p > 0 ? pid->p : 1);
+                } else {
+                    continue;
+                }
+                *gain = round_gain(*gain);
+                changed = true;
+            }
+        }
+    }
+}
+
+// flies candidates 0 to count - 1 on the pool and waits for their scores
+static void evaluate(Tuner *tuner, int count) {
+    for (int n = 0; n < count; ++n) {
+        pool_submit(&tuner->pool, candidate_task, &tuner->candidates[n]);
+    }
+    pool_wait(&tuner->pool);
+
+    for (int n = 0; n < count; ++n) {
+        candidate_finish(&tuner->candidates[n]);
+    }
+    tuner->evaluations += count;
+}
+
+static void print_score(const char *name, const Score *score) {
+    if (score->crashed) {
+        fprintf(stderr, "  %-6s %8.3f crashed\n", name, score->total);
+    } else {
+        fprintf(stderr, "  %-6s %8.3f tracking %.3f overshoot %.3f effort %.2f\n",
+            name, score->total, score->tracking, score->overshoot, score->effort);
+    }
+}
+
+static void print_gains(const Fc_Gains *gains) {
+    Fc_Gains copy = *gains;
+    for (int axis = 0; axis < NUM_AXES; ++axis) {
+        const Fc_Pid_Gains *pid = axis_gains(&copy, axis);
+        fprintf(stderr, "  %-6s p %-8.4g i %-8.4g d %-8.4g i_max %g\n",
+            axis_names[axis], pid->p, pid->i, pid->d, pid->i_max);
+    }
+}
+
+static void tune_breakpoint(Tuner *tuner, Schedule *schedule, int breakpoint) {
+    Breakpoint *point = &schedule->points[breakpoint];
+
+    for (int n = 0; n < tuner->num_candidates; ++n) {
+        Candidate *candidate = &tuner->candidates[n];
+        candidate->pool = &tuner->pool;
+        candidate->points = schedule->points;
+        candidate->num_points = schedule->num_points;
+        candidate->breakpoint = breakpoint;
+    }
+
+    Candidate *parent = &tuner->candidates[0];
+    parent->gains = point->gains;
+    evaluate(tuner, 1);
+
+    Fc_Gains best = point->gains;
+    Score before = parent->score;
+    Score best_score = before;
+    float sigma = SIGMA_START;
+
+    for (int generation = 0; generation < tuner->generations; ++generation) {
+        // the parent is not flown again, its flights are deterministic
+        for (int n = 1; n < tuner->num_candidates; ++n) {
+            tuner->candidates[n].gains = best;
+            mutate(&tuner->candidates[n].gains, sigma, &tuner->random);
+        }
+        evaluate(tuner, tuner->num_candidates);
+
+        int winner = 0;
+        for (int n = 1; n < tuner->num_candidates; ++n) {
+            if (tuner->candidates[n].score.total < best_score.total) {
+                best_score = tuner->candidates[n].score;
+                winner = n;
+            }
+        }
+
+        if (winner) {
+            best = tuner->candidates[winner].gains;
+            sigma = fminf(sigma * SIGMA_UP, SIGMA_MAX);
+        } else {
+            sigma = fmaxf(sigma * SIGMA_DOWN, SIGMA_MIN);
+        }
+
+        if (tuner->verbose) {
+            fprintf(stderr, "tstate %d generation %d score %.4f sigma %.3f\n",
+                point->tstate, generation, best_score.total, sigma);
+        }
+    }
+
+    point->gains = best;
+
+    fprintf(stderr, "tstate %d\n", point->tstate);
+    print_score("before", &before);
+    print_score("after", &best_score);
+    print_gains(&best);
+}
+
+////////// Schedule File //////////
+
+// the breakpoint on a line, false for comments, blank lines and table names
+static bool parse_line(const char *line, float *values, int *count) {
+    char text[MAX_LINE];
+    snprintf(text, sizeof(text), "%s", line);
+    char *comment = strchr(text, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    *count = 0;
+    char *next = text;
+    for (;;) {
+        while (*next == ' ' || *next == '\t') {
+            ++next;
+        }
+        if (!*next || *next == '\n') {
+            break;
+        }
+        char *end;
+        float value = strtof(next, &end);
+        if (end == next || *count >= NUM_VALUES) {
+            *count = -1;
+            return true;
+        }
+        values[(*count)++] = value;
+        next = end;
+    }
+    return *count > 0;
+}
+
+static bool read_schedule(const char *path, Schedule *schedule) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return false;
+    }
+
+    char line[MAX_LINE];
+    bool default_table = true;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        if (schedule->num_lines == MAX_LINES) {
+            fprintf(stderr, "error: too many lines in %s\n", path);
+            ok = false;
+            break;
+        }
+        int number = schedule->num_lines + 1;
+        schedule->lines[schedule->num_lines++] = strdup(line);
+
+        const char *start = line + strspn(line, " \t");
+        if (*start == '[') {
+            // the other tables are copied through
+            default_table = false;
+        }
+        float values[NUM_VALUES];
+        int count;
+        if (!default_table || !parse_line(line, values, &count)) {
+            continue;
+        }
+
+        Breakpoint *last = schedule->num_points ? &schedule->points[schedule->num_points - 1] : NULL;
+        if (count != NUM_VALUES) {
+            fprintf(stderr, "error: expected %d values (line %d)\n", NUM_VALUES, number);
+            ok = false;
+        } else if (values[0] != (int)values[0] || (last && values[0] <= last->tstate)) {
+            fprintf(stderr, "error: invalid tstate (line %d)\n", number);
+            ok = false;
+        } else if (schedule->num_points == MAX_BREAKPOINTS) {
+            fprintf(stderr, "error: too many breakpoints (line %d)\n", number);
+            ok = false;
+        } else {
+            Breakpoint *point = &schedule->points[schedule->num_points++];
+            point->tstate = (int)values[0];
+            point->line = schedule->num_lines - 1;
+            memcpy(gain_values(&point->gains), &values[1], sizeof(Fc_Gains));
+        }
+    }
+    fclose(file);
+
+    if (ok && (schedule->num_points < 2 ||
+        schedule->points[0].tstate != FC_MIN_TSTATE ||
+        schedule->points[schedule->num_points - 1].tstate != FC_MAX_TSTATE)) {
+        fprintf(stderr, "error: breakpoints must run from tstate %d to %d\n",
+            FC_MIN_TSTATE, FC_MAX_TSTATE);
+        ok = false;
+    }
+    return ok;
+}
+
+// the schedule as read, with the breakpoint lines of the default table
+// rewritten, keeping any comment at their end
+static void write_schedule(FILE *file, const Schedule *schedule) {
+    int next = 0;
+    for (int n = 0; n < schedule->num_lines; ++n) {
+        const char *line = schedule->lines[n];
+        if (next == schedule->num_points || schedule->points[next].line != n) {
+            fputs(line, file);
+            continue;
+        }
+
+        Breakpoint point = schedule->points[next++];
+        char text[MAX_LINE];
+        int length = snprintf(text, sizeof(text), "%-16d", point.tstate);
+        for (int axis = 0; axis < NUM_AXES; ++axis) {
+            const Fc_Pid_Gains *pid = axis_gains(&point.gains, axis);
+            length += snprintf(text + length, sizeof(text) - length,
+                "%-8.*g%-8.*g%-8.*g%-10.*g", GAIN_DIGITS, pid->p, GAIN_DIGITS, pid->i,
+                GAIN_DIGITS, pid->d, GAIN_DIGITS, pid->i_max);
+        }
+        while (length > 0 && text[length - 1] == ' ') {
+            text[--length] = '\0';
+        }
+        fputs(text, file);
+
+        const char *comment = strchr(line, '#');
+        if (comment) {
+            fprintf(file, " %s", comment);
+        } else {
+            fputs("\n", file);
+        }
+    }
+}
+
+static double elapsed_s(const struct timespec *begin, const struct timespec *end) {
+    return (end->tv_sec - begin->tv_sec) + (end->tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-j workers] [-g generations] [-l candidates] [-s seed] "
+        "[-o output] [-v] <schedule>\n", name);
+}
+
+int main(int argc, char **argv) {
+    int workers = 0;
+    int generations = DEFAULT_GENERATIONS;
+    int candidates = DEFAULT_CANDIDATES;
+    uint32_t seed = 1;
+    const char *output = NULL;
+    bool verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "j:g:l:s:o:v")) != -1) {
+        switch (opt) {
+            case 'j': workers = atoi(optarg); break;
+            case 'g': generations = atoi(optarg); break;
+            case 'l': candidates = atoi(optarg); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'o': output = optarg; break;
+            case 'v': verbose = true; break;
+            default:
+                usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || generations < 0 || candidates < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static Schedule schedule;
+    if (!read_schedule(argv[optind], &schedule)) {
+        return EXIT_FAILURE;
+    }
+
+    static Tuner tuner;
+    tuner.generations = generations;
+    tuner.num_candidates = candidates + 1;
+    tuner.random = seed ? seed : 1;
+    tuner.verbose = verbose;
+    tuner.candidates = calloc(tuner.num_candidates, sizeof(Candidate));
+    if (!tuner.candidates || !pool_init(&tuner.pool, workers)) {
+        fprintf(stderr, "error: could not start the workers\n");
+        return EXIT_FAILURE;
+    }
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+
+    // horizontal and vertical flight first, the transition depends on both
+    tune_breakpoint(&tuner, &schedule, 0);
+    tune_breakpoint(&tuner, &schedule, schedule.num_points - 1);
+    for (int n = 1; n < schedule.num_points - 1; ++n) {
+        tune_breakpoint(&tuner, &schedule, n);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall_s = elapsed_s(&begin, &end);
+
+    int num_workers = tuner.pool.num_workers;
+    uint64_t stolen = 0;
+    for (int n = 0; n < num_workers; ++n) {
+        stolen += tuner.pool.queues[n].stolen;
+    }
+    fprintf(stderr, "%llu candidates flown in %.2f s on %d workers, %.1f per second, "
+        "%llu tasks stolen\n", (unsigned long long)tuner.evaluations, wall_s, num_workers,
+        tuner.evaluations / wall_s, (unsigned long long)stolen);
+
+    pool_destroy(&tuner.pool);
+    free(tuner.candidates);
+
+    FILE *file = output ? fopen(output, "w") : stdout;
+    if (!file) {
+        perror(output);
+        return EXIT_FAILURE;
+    }
+    write_schedule(file, &schedule);
+    if (output) {
+        fclose(file);
+    }
+    return EXIT_SUCCESS;
+}
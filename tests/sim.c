@@ -8,82 +8,88 @@
 #include "flight_controller.h"
 #include "logging.h"
 #include "reboot.h"
+#include "scheduler.h"
 
 #include "sim_input.h"
 
-typedef enum {
-    RUN_BMP_REQ = 0,
-    RUN_AR_GET = 1,
-    RUN_BMP_GET = 2,
-    RUN_FC_CALC = 3,
-    RUN_SERV_SET = 4
-} Loop_State;
+typedef struct {
+    Fc_State *fc;
+    Fc_Flags flags;
+    Fc_Input input;
+    Fc_Output output;
 
-void loop() {
-    static Loop_State loop_state = RUN_BMP_GET;
+    const Fc_Input *sim_input_ptr;
+} Sim_Context;
 
-    static Fc_Flags fc_flags = 0;
-    static Fc_Input fc_input;
-    static Fc_Output fc_output;
+static void run_sim_input(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    ctx->input = *ctx->sim_input_ptr;
+    ++ctx->sim_input_ptr;
+}
 
-    static absolute_time_t time = { 0 };
+static void run_fc_calc(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    ctx->output = *fc_calc(ctx->fc, &ctx->input, ctx->flags, time->dt_us);
+    ctx->flags = 0;
+}
 
-    static Fc_Input *sim_input_ptr = sim_input;
+static void run_logging(void *context, const Sched_Time *time) {
+    Sim_Context *ctx = context;
+    do_logging(ctx->fc);
+}
 
-    int32_t diff_us;
-    if (to_us_since_boot(time) == 0) { // takes if first call
-        diff_us = LOOP_PERIOD_US - (2 * USB_TIMEOUT_PADDING_US);
-    } else {
-        diff_us = absolute_time_diff_us(time, get_absolute_time());
+// mirrors the task table in main.c, one sim input is consumed per rx period
+static Sched_Task sim_tasks[] = {
+//    name         period_us      phase_us  deadline_us      run
+    { "sim_input", RX_PERIOD_US,  1000,     LOOP_PERIOD_US,  run_sim_input },
+    { "fc_calc",   FC_PERIOD_US,  3000,     LOOP_PERIOD_US,  run_fc_calc },
+    { "logging",   LOG_PERIOD_US, 4000,     LOG_PERIOD_US,   run_logging },
+};
+
+static void handle_usb_command(Sched_Inst *sched) {
+    int ch = getchar_timeout_us(0);
+    if (ch == COMMAND_REBOOT) {
+        reboot();
+    } else if (ch == COMMAND_BOOTSEL) {
+        bootsel();
     }
+}
 
-    int32_t timeout_us = LOOP_PERIOD_US - diff_us - USB_TIMEOUT_PADDING_US;
-    if (timeout_us > 0) {
-        char ch = getchar_timeout_us(timeout_us);
-        if (ch == COMMAND_REBOOT) {
-            reboot();
-        } else if (ch == COMMAND_BOOTSEL) {
-            bootsel();
-        }
-    }
+void loop(Sched_Inst *sched, Sim_Context *ctx) {
+    absolute_time_t release = sched_wait(sched);
 
-    diff_us = absolute_time_diff_us(time, get_absolute_time());
-    if (diff_us < LOOP_PERIOD_US) {
-        while (diff_us < LOOP_PERIOD_US) {
-            diff_us = absolute_time_diff_us(time, get_absolute_time());
-        }
-    } else {
-        fc_flags |= FC_OVERRUN;
+    if (sched_run(sched, release)) {
+        ctx->flags |= FC_OVERRUN;
     }
-    time = get_absolute_time();
-
-    switch (loop_state) {
-    case RUN_BMP_REQ:
-        break;
-    case RUN_AR_GET:
-        fc_input = *sim_input_ptr;
-        ++sim_input_ptr;
-        break;
-    case RUN_BMP_GET:
-        break;
-    case RUN_FC_CALC:
-        fc_output = *fc_calc(&fc_input, fc_flags);
-        fc_flags = 0;
-        break;
-    case RUN_SERV_SET:
-        do_logging();
-        break;
-    };
 
-    loop_state = (loop_state + 1) % 5;
+    // usb commands are handled off the critical path, after the tick's tasks
+    handle_usb_command(sched);
 }
 
 int main() {
     stdio_init_all();
     sleep_ms(3000);
 
-    for (size_t i = 0; i < SIM_INPUT_SIZE * 5; ++i) {
-        loop();
+    static Fc_State fc;
+    fc_init(&fc);
+
+    Sim_Context ctx = {
+        .fc = &fc,
+        .flags = 0,
+        .sim_input_ptr = sim_input
+    };
+
+    Sched_Inst sched;
+    sched_init(&sched,
+        sim_tasks, sizeof(sim_tasks) / sizeof(sim_tasks[0]),
+        LOOP_PERIOD_US, &ctx
+    );
+
+    // the sim input task runs once per rx period
+    size_t ticks = SIM_INPUT_SIZE * (RX_PERIOD_US / LOOP_PERIOD_US);
+    sched_start(&sched);
+    for (size_t i = 0; i < ticks; ++i) {
+        loop(&sched, &ctx);
     }
 
     bootsel();
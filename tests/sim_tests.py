@@ -31,6 +31,7 @@ f_mode = 20
 c_mode = 21
 tstate = 22
 flags = 23
+noise = 24
 
 MIN_VAL = -100
 CEN_VAL = 0
@@ -72,7 +73,7 @@ def test_motor_safety(f: FileIO) -> None:
     '''
     for line in f:
         line = [ float(val.strip()) for val in line.split(',') ]
-        assert(len(line) == flags + 1)
+        assert(len(line) == noise + 1)
         if (int(line[flags]) & FC_WAITING) or \
            (int(line[flags]) & FC_RX_FAILED) or \
            (line[thro] < MIN_VAL + FC_DEAD_STICK):
@@ -84,7 +85,7 @@ def test_loop_timing(f: FileIO) -> None:
         next(f)
     for line in f:
         line = [ float(val.strip()) for val in line.split(',') ]
-        assert(len(line) == flags + 1)
+        assert(len(line) == noise + 1)
         test_eq(int(line[flags]) & FC_OVERRUN, False)
 
 def test_wait_state(f: FileIO) -> None:
@@ -0,0 +1,420 @@
+// executable for worst case execution times of the control paths
+//
+// Drives fc_calc() through every combination of control mode, flight mode,
+// waiting and tstate, and do_logging() through every entry of the flash log,
+// timing each call in clk_sys cycles on the SysTick counter of the profiler.
+// fc_calc() is timed with interrupts off, once with the XIP cache warm and
+// once right after a flush, as after a log write to flash. do_logging() is
+// timed as the loop runs it, with interrupts on for the usb logging. The
+// table of worst cases and the headroom in a scheduler tick are printed over
+// usb, and again on COMMAND_DUMP_PROFILE.
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/sync.h"
+
+#include "constants.h"
+#include "flight_controller.h"
+#include "logging.h"
+#include "profiler.h"
+#include "reboot.h"
+
+#define WCET_WARMUP 3 // runs of a path before it is timed, past the first run of the pids
+#define WCET_SAMPLES 64 // timed runs of each path, every other one with a cold cache
+
+// armed paths run with the motors mixed in
+#define WCET_THROTTLE 50
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t max_cold; // after an XIP cache flush
+} Wcet_Stats;
+
+typedef struct {
+    const char *name;
+    float stick;
+} Wcet_Mode;
+
+static const Wcet_Mode ctrl_modes[] = {
+    { "manual", FC_MIN_INPUT },
+    { "rate", FC_CEN_INPUT },
+    { "angle", FC_MAX_INPUT }
+};
+
+static const Wcet_Mode flight_modes[] = {
+    { "disabled", FC_MAX_INPUT },
+    { "vertical", FC_CEN_INPUT },
+    { "horizontal", FC_MIN_INPUT }
+};
+
+// Each end of the transition, and either side of the switch to vertical
+// controls. tstate moves by up to a degree per call, so the sides keep clear
+// of the threshold.
+static const float tstates[] = {
+    FC_MIN_TSTATE,
+    FC_TSTATE_CTRL_THRESHOLD - 2,
+    FC_TSTATE_CTRL_THRESHOLD + 2,
+    FC_MAX_TSTATE
+};
+
+#define NUM_CTRL_MODES (sizeof(ctrl_modes) / sizeof(ctrl_modes[0]))
+#define NUM_FLIGHT_MODES (sizeof(flight_modes) / sizeof(flight_modes[0]))
+#define NUM_TSTATES (sizeof(tstates) / sizeof(tstates[0]))
+
+typedef enum {
+    LOG_NEW_PAGE = 0, // clears the page buffer
+    LOG_ENTRY_1 = 1,
+    LOG_ENTRY_2 = 2,
+    LOG_ROLLOVER = 3, // moves to the next page
+    LOG_WRAP = 4, // rollover at the end of the flash, back to LOG_FLASH_START
+    LOG_NUM_TICKS = 5
+} Log_Tick;
+
+static const char *log_tick_names[LOG_NUM_TICKS] = {
+    "new page",
+    "entry 1",
+    "entry 2",
+    "page rollover",
+    "log wrap"
+};
+
+static Wcet_Stats fc_stats[NUM_CTRL_MODES][NUM_FLIGHT_MODES][2][NUM_TSTATES];
+static Wcet_Stats start_stats;
+#ifdef FC_CASCADED
+static Wcet_Stats rate_stats[NUM_CTRL_MODES][NUM_FLIGHT_MODES][2][NUM_TSTATES];
+#endif // FC_CASCADED
+static Wcet_Stats log_stats[LOG_NUM_TICKS];
+
+// cycles of reading the counter twice, taken off every measurement
+static uint32_t overhead;
+
+static inline uint32_t cycles_since(uint32_t start) {
+    // the counter counts down
+    return (start - profiler_now()) & PROFILER_COUNTER_MASK;
+}
+
+static void stats_init(Wcet_Stats *stats) {
+    *stats = (Wcet_Stats){ .min = UINT32_MAX };
+}
+
+static void stats_record(Wcet_Stats *stats, uint32_t cycles, bool cold) {
+    cycles = cycles > overhead ? cycles - overhead : 0;
+
+    if (cold) {
+        if (cycles > stats->max_cold) {
+            stats->max_cold = cycles;
+        }
+        return;
+    }
+
+    ++stats->count;
+    stats->sum += cycles;
+    if (cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+}
+
+static uint32_t stats_worst(const Wcet_Stats *stats) {
+    return stats->max > stats->max_cold ? stats->max : stats->max_cold;
+}
+
+static void measure_overhead(void) {
+    overhead = UINT32_MAX;
+    for (int n = 0; n < 16; ++n) {
+        uint32_t start = profiler_now();
+        uint32_t cycles = cycles_since(start);
+        if (cycles < overhead) {
+            overhead = cycles;
+        }
+    }
+}
+
+// the next fetches from flash miss the cache, as after a flash write
+static inline void flush_xip_cache(void) {
+    xip_ctrl_hw->flush = 1;
+    // reading stalls until the flush is done
+    (void)xip_ctrl_hw->flush;
+}
+
+// moves the attitude and sticks between samples, so the pids and targets are
+// not run on the same numbers every time
+static void vary_input(Fc_Input *input, int n) {
+    const quaternion_t level = { 1, 0, 0, 0 };
+    quaternion_t pitched = quaternion_rotate_pitch(&level, (n % 7) * 15.0f - 45);
+    input->orientation = quaternion_rotate_roll(&pitched, (n % 16) * 22.5f - 180);
+
+    input->aile = (n % 5) * 50.0f - 100;
+    input->elev = (n % 3) * 100.0f - 100;
+    input->rudd = (n % 4) * 66.0f - 100;
+
+    input->rates.x = (n % 9) * 50.0f - 200;
+    input->rates.y = (n % 5) * 100.0f - 200;
+    input->rates.z = (n % 7) * 60.0f - 180;
+}
+
+static uint32_t time_fc_calc(Fc_State *fc, const Fc_Input *input, bool cold) {
+    if (cold) {
+        flush_xip_cache();
+    }
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = profiler_now();
+    fc_calc(fc, input, 0, FC_PERIOD_US);
+    uint32_t cycles = cycles_since(start);
+    restore_interrupts(ints);
+
+    return cycles;
+}
+
+#ifdef FC_CASCADED
+static uint32_t time_fc_calc_rate(Fc_State *fc, const Fc_Input *input, bool cold) {
+    if (cold) {
+        flush_xip_cache();
+    }
+
+    uint32_t ints = save_and_disable_interrupts();
+    uint32_t start = profiler_now();
+    fc_calc_rate(fc, &input->rates, IMU_PERIOD_US);
+    uint32_t cycles = cycles_since(start);
+    restore_interrupts(ints);
+
+    return cycles;
+}
+#endif // FC_CASCADED
+
+// the first call after fc_init(), which takes the targets from the attitude
+static void measure_start(Fc_State *fc) {
+    stats_init(&start_stats);
+
+    Fc_Input input = { 0 };
+    input.thro = WCET_THROTTLE;
+
+    for (int n = 0; n < WCET_SAMPLES; ++n) {
+        vary_input(&input, n);
+        fc_init(fc);
+        bool cold = n % 2;
+        stats_record(&start_stats, time_fc_calc(fc, &input, cold), cold);
+    }
+}
+
+// Starts fc waiting or armed on the ground. Waiting paths keep a high
+// throttle, so that no combination arms.
+static void start_path(Fc_State *fc, bool waiting) {
+    Fc_Input input = { 0 };
+    input.orientation = (quaternion_t){ 1, 0, 0, 0 };
+
+    if (waiting) {
+        input.thro = WCET_THROTTLE;
+    } else {
+        input.thro = FC_MIN_INPUT;
+        input.gear = FC_MIN_INPUT;
+        input.aux1 = FC_MIN_INPUT;
+    }
+
+    fc_init(fc);
+    fc_calc(fc, &input, 0, FC_PERIOD_US);
+}
+
+static void measure_path(Fc_State *fc, size_t ctrl, size_t flight, size_t waiting, size_t tstate) {
+    Wcet_Stats *stats = &fc_stats[ctrl][flight][waiting][tstate];
+    stats_init(stats);
+#   ifdef FC_CASCADED
+        Wcet_Stats *rate = &rate_stats[ctrl][flight][waiting][tstate];
+        stats_init(rate);
+#   endif // FC_CASCADED
+
+    start_path(fc, waiting);
+
+    Fc_Input input = { 0 };
+    input.thro = WCET_THROTTLE;
+    input.aux1 = ctrl_modes[ctrl].stick;
+    input.gear = flight_modes[flight].stick;
+
+    for (int n = 0; n < WCET_WARMUP + WCET_SAMPLES; ++n) {
+        vary_input(&input, n);
+
+        // held against the transition, which would move it on every call
+        fc->tstate = tstates[tstate];
+
+        bool cold = n % 2;
+        uint32_t cycles = time_fc_calc(fc, &input, cold);
+        if (n >= WCET_WARMUP) {
+            stats_record(stats, cycles, cold);
+        }
+
+#       ifdef FC_CASCADED
+            // as in the loop, where fc_calc() leaves the rate loop to fc_calc_rate()
+            cycles = time_fc_calc_rate(fc, &input, cold);
+            if (n >= WCET_WARMUP) {
+                stats_record(rate, cycles, cold);
+            }
+#       endif // FC_CASCADED
+    }
+}
+
+// A whole pass of the flash log, so the wrap at the end of the flash is timed
+// as well. Every call prints a usb log line when DO_USB_LOGGING is defined.
+static void measure_logging(Fc_State *fc) {
+    for (int tick = 0; tick < LOG_NUM_TICKS; ++tick) {
+        stats_init(&log_stats[tick]);
+    }
+
+    start_path(fc, false);
+
+    const uint32_t entries = LOG_FLASH_SIZE_BYTES / sizeof(Log_Data);
+    for (uint32_t n = 0; n < entries; ++n) {
+        uint32_t start = profiler_now();
+        do_logging(fc);
+        uint32_t cycles = cycles_since(start);
+
+        Log_Tick tick = (n == entries - 1) ? LOG_WRAP : (Log_Tick)(n % 4);
+        stats_record(&log_stats[tick], cycles, false);
+    }
+}
+
+static float cycles_to_us(uint32_t cycles) {
+    return cycles * 1000000.0f / clock_get_hz(clk_sys);
+}
+
+static void print_fc_row(const char *name, const Wcet_Stats *stats) {
+    printf("wcet: %-40s %8lu %8lu %8lu %8lu %8.1f\n",
+        name,
+        (unsigned long)stats->min,
+        (unsigned long)(stats->count ? stats->sum / stats->count : 0),
+        (unsigned long)stats->max,
+        (unsigned long)stats->max_cold,
+        cycles_to_us(stats_worst(stats))
+    );
+}
+
+static void print_headroom(const char *name, uint32_t cycles, uint32_t period_us) {
+    float us = cycles_to_us(cycles);
+    printf("wcet: worst %s %lu cycles, %.1f us, %.1f%% of a %lu us tick\n",
+        name, (unsigned long)cycles, us, 100 * us / period_us, (unsigned long)period_us);
+}
+
+static void path_name(char *name, size_t size, size_t ctrl, size_t flight, size_t waiting, size_t tstate) {
+    snprintf(name, size, "%s %s %s tstate %d",
+        ctrl_modes[ctrl].name,
+        flight_modes[flight].name,
+        waiting ? "waiting" : "armed",
+        (int)tstates[tstate]
+    );
+}
+
+static void print_fc_table(const char *title, Wcet_Stats table[NUM_CTRL_MODES][NUM_FLIGHT_MODES][2][NUM_TSTATES]) {
+    printf("wcet: %-40s %8s %8s %8s %8s %8s\n", title, "min", "mean", "max", "cold", "worst us");
+
+    char name[64];
+    uint32_t worst = 0;
+    size_t worst_path[4] = { 0 };
+
+    for (size_t ctrl = 0; ctrl < NUM_CTRL_MODES; ++ctrl) {
+        for (size_t flight = 0; flight < NUM_FLIGHT_MODES; ++flight) {
+            for (size_t waiting = 0; waiting < 2; ++waiting) {
+                for (size_t tstate = 0; tstate < NUM_TSTATES; ++tstate) {
+                    const Wcet_Stats *stats = &table[ctrl][flight][waiting][tstate];
+                    path_name(name, sizeof(name), ctrl, flight, waiting, tstate);
+                    print_fc_row(name, stats);
+
+                    if (stats_worst(stats) > worst) {
+                        worst = stats_worst(stats);
+                        worst_path[0] = ctrl;
+                        worst_path[1] = flight;
+                        worst_path[2] = waiting;
+                        worst_path[3] = tstate;
+                    }
+                }
+            }
+        }
+    }
+
+    path_name(name, sizeof(name), worst_path[0], worst_path[1], worst_path[2], worst_path[3]);
+    printf("wcet: worst path of %s: %s\n", title, name);
+    print_headroom(title, worst, LOOP_PERIOD_US);
+}
+
+static void print_tables(void) {
+    printf("wcet: clk_sys %lu Hz, cycles less %lu of timing overhead\n",
+        (unsigned long)clock_get_hz(clk_sys), (unsigned long)overhead);
+
+    print_fc_row("fc_calc start", &start_stats);
+    print_fc_table("fc_calc", fc_stats);
+#   ifdef FC_CASCADED
+        print_fc_table("fc_calc_rate", rate_stats);
+#   endif // FC_CASCADED
+
+    printf("wcet: %-40s %8s %8s %8s %8s %8s\n", "do_logging", "min", "mean", "max", "count", "worst us");
+
+    uint32_t worst = 0;
+    for (int tick = 0; tick < LOG_NUM_TICKS; ++tick) {
+        const Wcet_Stats *stats = &log_stats[tick];
+        printf("wcet: %-40s %8lu %8lu %8lu %8lu %8.1f\n",
+            log_tick_names[tick],
+            (unsigned long)stats->min,
+            (unsigned long)(stats->count ? stats->sum / stats->count : 0),
+            (unsigned long)stats->max,
+            (unsigned long)stats->count,
+            cycles_to_us(stats->max)
+        );
+        if (stats->max > worst) {
+            worst = stats->max;
+        }
+    }
+    // the logging task has a whole log period for its deadline, see main.c
+    print_headroom("do_logging", worst, LOG_PERIOD_US);
+}
+
+static void handle_usb_command(void) {
+    int ch = getchar_timeout_us(0);
+    if (ch == COMMAND_DUMP_PROFILE) {
+        print_tables();
+    } else if (ch == COMMAND_REBOOT) {
+        reboot();
+    } else if (ch == COMMAND_BOOTSEL) {
+        bootsel();
+    }
+}
+
+int main() {
+    stdio_init_all();
+    sleep_ms(3000);
+
+    profiler_init();
+    measure_overhead();
+
+    static Fc_State fc;
+
+    printf("info: timing fc_calc ...\n");
+    measure_start(&fc);
+    for (size_t ctrl = 0; ctrl < NUM_CTRL_MODES; ++ctrl) {
+        for (size_t flight = 0; flight < NUM_FLIGHT_MODES; ++flight) {
+            for (size_t waiting = 0; waiting < 2; ++waiting) {
+                for (size_t tstate = 0; tstate < NUM_TSTATES; ++tstate) {
+                    measure_path(&fc, ctrl, flight, waiting, tstate);
+                }
+            }
+        }
+    }
+
+    printf("info: erasing flash log ...\n");
+    init_logging();
+    printf("info: timing do_logging over the whole log ...\n");
+    measure_logging(&fc);
+
+    print_tables();
+
+    while (true) {
+        handle_usb_command();
+        sleep_ms(100);
+    }
+}
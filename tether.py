@@ -24,7 +24,8 @@ DATA_LABELS = ' '.join([
     'fm',
     'cm',
     'ts',
-    'fl'
+    'fl',
+    ' noise'
 ])
 
 csv_file = None